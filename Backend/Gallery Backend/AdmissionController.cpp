@@ -0,0 +1,200 @@
+#include "AdmissionController.h"
+
+#include "Constants.h"
+#include "Logger.h"
+
+
+AdmissionController::AdmissionController()
+{
+	const std::chrono::milliseconds maxWait(ADMISSION_MAX_WAIT_MILLISECONDS);
+
+	laneOf(RouteClass::READ).limits = { ADMISSION_READ_MAX_RUNNING, ADMISSION_READ_MAX_QUEUED, maxWait };
+	laneOf(RouteClass::LISTING).limits = { ADMISSION_LISTING_MAX_RUNNING, ADMISSION_LISTING_MAX_QUEUED, maxWait };
+	laneOf(RouteClass::WRITE).limits = { ADMISSION_WRITE_MAX_RUNNING, ADMISSION_WRITE_MAX_QUEUED, maxWait };
+	laneOf(RouteClass::ADMIN).limits = { ADMISSION_ADMIN_MAX_RUNNING, ADMISSION_ADMIN_MAX_QUEUED, maxWait };
+
+	m_expiryThread = std::thread([this] { expiryLoop(); });
+}
+
+AdmissionController::~AdmissionController()
+{
+	{
+		const std::lock_guard lock(m_mutex);
+		m_isRunning = false;
+	}
+
+	m_expiryWake.notify_one();
+	m_expiryThread.join();
+}
+
+
+// admission related functions //
+void AdmissionController::submit(RouteClass routeClass, Work work, Reject reject, Fail fail)
+{
+	std::vector<Reject> expired;
+	bool isAdmitted = false;
+	bool isRejected = false;
+
+	{
+		const std::lock_guard lock(m_mutex);
+		Lane& lane = laneOf(routeClass);
+		const auto now = Clock::now();
+
+		dropExpired(lane, now, expired);
+
+		if (lane.running < lane.limits.maxRunning)
+		{
+			lane.running++;
+			lane.admitted++;
+			isAdmitted = true;
+		}
+		else if (lane.waiting.size() < lane.limits.maxQueued)
+		{
+			lane.waiting.push_back({ std::move(work), std::move(reject), std::move(fail), now + lane.limits.maxWait });
+
+			// the deadlines of a lane only grow, only the first waiter of a lane can be the earliest one
+			if (lane.waiting.size() == 1)
+				m_expiryWake.notify_one();
+		}
+		else
+		{
+			lane.rejected++;
+			isRejected = true;
+		}
+	}
+
+	// the callbacks reply to clients, which is never done under the lock
+	for (const auto& expiredReject : expired)
+		expiredReject();
+
+	if (isAdmitted)
+		start(routeClass, work, fail);
+	else if (isRejected)
+		reject();
+}
+
+AdmissionController::Stats AdmissionController::getStats(RouteClass routeClass) const
+{
+	const std::lock_guard lock(m_mutex);
+	const Lane& lane = m_lanes[static_cast<size_t>(routeClass)];
+
+	return { lane.running, lane.waiting.size(), lane.admitted, lane.rejected, lane.expired };
+}
+
+
+// helper functions //
+// the slot of the request is held until its task completes, whether it replied with a success or not.
+// A queued request is started from the completion of another one, where nothing would catch what its work
+// throws - so a throwing work is answered here, wherever it was started from
+void AdmissionController::start(RouteClass routeClass, const Work& work, const Fail& fail)
+{
+	pplx::task<void> task;
+
+	try
+	{
+		task = work();
+	}
+	catch (const std::exception& e)
+	{
+		Logger::failure("admission", std::string("Internal server error occurred: ") + e.what(), { { "class", routeClassName(routeClass) } });
+		fail();
+		release(routeClass);
+		return;
+	}
+	catch (...)
+	{
+		Logger::failure("admission", "Internal server error occurred.", { { "class", routeClassName(routeClass) } });
+		fail();
+		release(routeClass);
+		return;
+	}
+
+	task.then([this, routeClass](const pplx::task<void>&)
+	{
+		release(routeClass);
+	});
+}
+
+void AdmissionController::release(RouteClass routeClass)
+{
+	std::vector<Reject> expired;
+	Work next;
+	Fail nextFail;
+
+	{
+		const std::lock_guard lock(m_mutex);
+		Lane& lane = laneOf(routeClass);
+
+		lane.running--;
+		dropExpired(lane, Clock::now(), expired);
+
+		if (!lane.waiting.empty())
+		{
+			next = std::move(lane.waiting.front().work);
+			nextFail = std::move(lane.waiting.front().fail);
+			lane.waiting.pop_front();
+			lane.running++;
+			lane.admitted++;
+		}
+	}
+
+	for (const auto& expiredReject : expired)
+		expiredReject();
+
+	if (next)
+		start(routeClass, next, nextFail);
+}
+
+// sleeps until the earliest deadline of all the lanes, and rejects the waiters that reached theirs
+void AdmissionController::expiryLoop()
+{
+	std::unique_lock lock(m_mutex);
+
+	while (m_isRunning)
+	{
+		std::vector<Reject> expired;
+		const auto now = Clock::now();
+
+		for (Lane& lane : m_lanes)
+			dropExpired(lane, now, expired);
+
+		if (!expired.empty())
+		{
+			lock.unlock();
+
+			for (const auto& expiredReject : expired)
+				expiredReject();
+
+			lock.lock();
+			continue;
+		}
+
+		std::optional<Clock::time_point> earliest;
+		for (const Lane& lane : m_lanes)
+		{
+			if (!lane.waiting.empty() && (!earliest || lane.waiting.front().deadline < *earliest))
+				earliest = lane.waiting.front().deadline;
+		}
+
+		if (earliest)
+			m_expiryWake.wait_until(lock, *earliest);
+		else
+			m_expiryWake.wait(lock);
+	}
+}
+
+AdmissionController::Lane& AdmissionController::laneOf(RouteClass routeClass)
+{
+	return m_lanes[static_cast<size_t>(routeClass)];
+}
+
+// waiters are queued in order of arrival and share the wait limit, so the expired ones are at the front
+void AdmissionController::dropExpired(Lane& lane, Clock::time_point now, std::vector<Reject>& expired)
+{
+	while (!lane.waiting.empty() && lane.waiting.front().deadline <= now)
+	{
+		expired.push_back(std::move(lane.waiting.front().reject));
+		lane.waiting.pop_front();
+		lane.expired++;
+	}
+}
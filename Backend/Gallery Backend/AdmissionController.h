@@ -0,0 +1,94 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cpprest/http_msg.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "Router.h"
+
+
+/*
+ * Limits how many requests of every route class run at once, so a burst of heavy listings can not take
+ * the threads the cheap reads and the writes need. A request over the limit of its class waits in a
+ * bounded queue of the class, and one that finds the queue full is rejected right away.
+ * Nothing here blocks - a queued request is started by the completion of a running one of its class,
+ * and a request that waited longer than the limit is rejected instead of started. The expiry thread
+ * rejects a waiter once its deadline passes, even while no request of its class is submitted or completes.
+ */
+class AdmissionController
+{
+public:
+	using Work = std::function<pplx::task<void>()>;		// the task completes once the request was handled
+	using Reject = std::function<void()>;
+	using Fail = std::function<void()>;						// answers a request whose work threw before it replied
+
+	struct Limits
+	{
+		size_t maxRunning;
+		size_t maxQueued;
+		std::chrono::milliseconds maxWait;
+	};
+
+	struct Stats
+	{
+		size_t running;
+		size_t queued;
+		uint64_t admitted;
+		uint64_t rejected;		// the queue was full
+		uint64_t expired;		// waited in the queue for too long
+	};
+
+	AdmissionController();
+	~AdmissionController();
+
+	AdmissionController(const AdmissionController&) = delete;
+	AdmissionController& operator=(const AdmissionController&) = delete;
+
+	// runs work now, queues it, or calls reject - whichever the load of the class allows
+	void submit(RouteClass routeClass, Work work, Reject reject, Fail fail);
+
+	Stats getStats(RouteClass routeClass) const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Waiter
+	{
+		Work work;
+		Reject reject;
+		Fail fail;
+		Clock::time_point deadline;
+	};
+
+	struct Lane
+	{
+		Limits limits;
+		size_t running{ 0 };
+		std::deque<Waiter> waiting;
+		uint64_t admitted{ 0 };
+		uint64_t rejected{ 0 };
+		uint64_t expired{ 0 };
+	};
+
+	mutable std::mutex m_mutex;
+	std::array<Lane, ROUTE_CLASSES_COUNT> m_lanes;
+
+	std::condition_variable m_expiryWake;	// notified when the earliest deadline may have moved, or on stop
+	bool m_isRunning{ true };				// guarded by m_mutex
+	std::thread m_expiryThread;
+
+	void start(RouteClass routeClass, const Work& work, const Fail& fail);
+	void release(RouteClass routeClass);
+	void expiryLoop();
+
+	Lane& laneOf(RouteClass routeClass);
+	static void dropExpired(Lane& lane, Clock::time_point now, std::vector<Reject>& expired);
+};
@@ -2,30 +2,57 @@
 
 #include <algorithm>
 #include <ctime>   // for std::localtime_s, std::times
+#include "ItemAlreadyExistsException.h"
 #include "ItemNotFoundException.h"
 #include <iomanip>
 #include <sstream>
+#include <utility>
 
 
-Album::Album(int ownerId, std::string name) :
-	m_ownerId(ownerId), m_name(std::move(name)), m_pictures{}
+Album::Album(int ownerId, std::string_view name) :
+	m_ownerId(ownerId), m_name(name)
 {
 	setCreationDateNow();
 }
 
-Album::Album(int ownerId, std::string name, std::string creationTime) :
-	m_ownerId(ownerId), m_name(std::move(name)), m_creationDate(std::move(creationTime)), m_pictures{}
+Album::Album(int ownerId, std::string_view name, std::string creationTime) :
+	m_ownerId(ownerId), m_name(name), m_creationDate(std::move(creationTime))
+{
+	// Left empty
+}
+
+Album::Album(const allocator_type& allocator) :
+	m_pictures(allocator), m_pictureIndex(allocator)
+{
+	// Left empty
+}
+
+Album::Album(const Album& other, const allocator_type& allocator) :
+	m_ownerId(other.m_ownerId), m_owner_name(other.m_owner_name), m_name(other.m_name), m_creationDate(other.m_creationDate),
+	m_pictures(other.m_pictures, allocator), m_pictureIndex(other.m_pictureIndex, allocator)
+{
+	// Left empty
+}
+
+Album::Album(Album&& other, const allocator_type& allocator) :
+	m_ownerId(other.m_ownerId), m_owner_name(other.m_owner_name), m_name(other.m_name), m_creationDate(std::move(other.m_creationDate)),
+	m_pictures(std::move(other.m_pictures), allocator), m_pictureIndex(std::move(other.m_pictureIndex), allocator)
 {
 	// Left empty
 }
 
 
 const std::string& Album::getName() const
+{
+	return m_name.str();
+}
+
+const InternedString& Album::getInternedName() const
 {
 	return m_name;
 }
 
-void Album::setName(const std::string& name)
+void Album::setName(std::string_view name)
 {
 	m_name = name;
 }
@@ -61,30 +88,31 @@ void Album::setCreationDateNow()
 	m_creationDate = oss.str();
 }
 
-std::string Album::getOwnerName() const
+const std::string& Album::getOwnerName() const
 {
-	return m_owner_name;
+	return m_owner_name.str();
 }
 
-void Album::setOwnerName(const std::string& name)
+void Album::setOwnerName(std::string_view name)
 {
 	m_owner_name = name;
 }
 
 
-Picture Album::getPicture(const std::string& pictureName) const
+const Picture& Album::getPicture(const std::string& pictureName) const
 {
-	for (auto& picture : m_pictures) {
-		if (pictureName == picture.getName())
-			return picture;
-	}
-	throw ItemNotFoundException("Picture", pictureName);
+	const Picture* picture = findPicture(pictureName);
+
+	if (picture == nullptr)
+		throw ItemNotFoundException("Picture", pictureName);
+
+	return *picture;
 }
 
 
-std::list<Picture> Album::getPictures() const
+Album::PictureRange Album::getPictures() const
 {
-	return m_pictures;
+	return { m_pictures.data(), m_pictures.size() };
 }
 
 void Album::untagUserInAlbum(int userId)
@@ -101,44 +129,51 @@ void Album::tagUserInAlbum(const User& user)
 
 void Album::untagUserInPicture(int userId, const std::string& pictureName)
 {
-	for (auto& picture : m_pictures) {
-		if (picture.getName() == pictureName)
-			picture.untagUser(userId);
-	}
+	if (Picture* picture = findPicture(pictureName))
+		picture->untagUser(userId);
 }
 
 void Album::tagUserInPicture(const User& user, const std::string& pictureName)
 {
-	for (auto& picture : m_pictures) {
-		if (picture.getName() == pictureName)
-			picture.tagUser(user);
-	}
+	if (Picture* picture = findPicture(pictureName))
+		picture->tagUser(user);
 }
 
 void Album::addPicture(const Picture& picture)
 {
+	if (!m_pictureIndex.emplace(picture.getInternedName(), m_pictures.size()).second)
+		throw ItemAlreadyExistsException("Picture", picture.getName());
+
 	m_pictures.push_back(picture);
 }
 
 
 void Album::removePicture(const std::string& pictureName)
 {
-	for (const auto& picture : m_pictures) {
-		if (pictureName == picture.getName()) {
-			m_pictures.remove(picture);
-			return;
-		}
-	}
+	const auto name = InternedString::find(pictureName);
+	const auto position = name ? m_pictureIndex.find(*name) : m_pictureIndex.end();
+
+	if (position == m_pictureIndex.end())
+		throw ItemNotFoundException("Picture", pictureName);
 
-	throw ItemNotFoundException("Picture", pictureName);
+	// keep the pictures in insertion order, the pictures after the removed one move back by one
+	const size_t index = position->second;
+	m_pictureIndex.erase(position);
+	m_pictures.erase(m_pictures.begin() + static_cast<std::ptrdiff_t>(index));
+
+	for (size_t i = index; i < m_pictures.size(); i++)
+		m_pictureIndex[m_pictures[i].getInternedName()] = i;
 }
 
 
 bool Album::doesPictureExists(const std::string& name) const
 {
-	auto isSameName = [&](const Picture& picture) { return name == picture.getName(); };
+	return findPicture(name) != nullptr;
+}
 
-	return std::any_of(m_pictures.begin(), m_pictures.end(), isSameName);
+Album::allocator_type Album::get_allocator() const
+{
+	return m_pictures.get_allocator();
 }
 
 bool Album::operator==(const Album& other) const
@@ -148,9 +183,26 @@ bool Album::operator==(const Album& other) const
 
 
 
+const Picture* Album::findPicture(const std::string& pictureName) const
+{
+	// a name that is not interned can not be the name of any picture
+	const auto name = InternedString::find(pictureName);
+	if (!name)
+		return nullptr;
+
+	const auto position = m_pictureIndex.find(*name);
+	return position != m_pictureIndex.end() ? &m_pictures[position->second] : nullptr;
+}
+
+Picture* Album::findPicture(const std::string& pictureName)
+{
+	return const_cast<Picture*>(std::as_const(*this).findPicture(pictureName));
+}
+
+
 std::ostream& operator<<(std::ostream& strOut, const Album& album)
 {
-	strOut << "[" << album.m_name << "] - created by user@"
+	strOut << "[" << album.m_name.str() << "] - created by user@"
 		<< album.getOwnerId() << " on (" << album.getCreationDate() << ")" << '\n';
 
 	return strOut;
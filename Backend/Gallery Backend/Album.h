@@ -1,17 +1,50 @@
 ﻿#pragma once
 #include "Picture.h"
+#include <cstddef>
 #include <list>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 
 class Album
 {
 public:
+	// read-only view of the pictures of an album, valid until the album is modified
+	class PictureRange
+	{
+	public:
+		PictureRange(const Picture* first, size_t count) : m_first(first), m_count(count) {}
+
+		const Picture* begin() const { return m_first; }
+		const Picture* end() const { return m_first + m_count; }
+		size_t size() const { return m_count; }
+		bool empty() const { return m_count == 0; }
+
+	private:
+		const Picture* m_first;
+		size_t m_count;
+	};
+
+	// the pictures of an album allocate from the resource of the container holding the album,
+	// so an album stored in a request arena list keeps its pictures in the arena as well
+	using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
 	Album() = default;
-	Album(int ownerId, std::string name);
-	Album(int ownerId, std::string name, std::string creationTime);
+	explicit Album(const allocator_type& allocator);
+	Album(const Album& other) = default;
+	Album(const Album& other, const allocator_type& allocator);
+	Album(Album&& other) noexcept = default;
+	Album(Album&& other, const allocator_type& allocator);
+	Album& operator=(const Album& other) = default;
+	Album& operator=(Album&& other) = default;
+	Album(int ownerId, std::string_view name);
+	Album(int ownerId, std::string_view name, std::string creationTime);
 
 	const std::string& getName() const;
-	void setName(const std::string& name);
+	const InternedString& getInternedName() const;
+	void setName(std::string_view name);
 
 	int getOwnerId() const;
 	void setOwner(int userId);
@@ -20,15 +53,15 @@ public:
 	void setCreationDate(const std::string& creationTime);
 	void setCreationDateNow();
 
-	std::string getOwnerName() const;
-	void setOwnerName(const std::string& name);
+	const std::string& getOwnerName() const;
+	void setOwnerName(std::string_view name);
 
 	bool doesPictureExists(const std::string& name) const;
 	void addPicture(const Picture& picture);
 	void removePicture(const std::string& pictureName);
 
-	Picture getPicture(const std::string& name) const;
-	std::list<Picture> getPictures() const;
+	const Picture& getPicture(const std::string& name) const;
+	PictureRange getPictures() const;
 
 	void untagUserInAlbum(int userId);
 	void tagUserInAlbum(const User& userId);
@@ -36,13 +69,19 @@ public:
 	void untagUserInPicture(int userId, const std::string& pictureName);
 	void tagUserInPicture(const User& user, const std::string& pictureName);
 
+	allocator_type get_allocator() const;
+
 	bool operator==(const Album& other) const;
 	friend std::ostream& operator<<(std::ostream& strOut, const Album& album);
 
 private:
 	int m_ownerId{ 0 };
-	std::string m_owner_name;
-	std::string m_name;
+	InternedString m_owner_name;
+	InternedString m_name;
 	std::string m_creationDate;
-	std::list<Picture> m_pictures;
+	std::pmr::vector<Picture> m_pictures;
+	std::pmr::unordered_map<InternedString, size_t> m_pictureIndex;	// picture name -> position in m_pictures
+
+	const Picture* findPicture(const std::string& pictureName) const;
+	Picture* findPicture(const std::string& pictureName);
 };
@@ -0,0 +1,328 @@
+#include "BatchExecutor.h"
+
+#include "Constants.h"
+#include "InvalidRequestException.h"
+#include "ItemAlreadyExistsException.h"
+#include "ItemNotFoundException.h"
+#include "JsonHelper.h"
+#include "Logger.h"
+#include "RequestArena.h"
+
+
+// thrown out of an atomic batch once one of its operations failed, to roll back the ones before it
+struct BatchAbortedException
+{
+};
+
+
+// registers an operation that decodes its body into a Request
+template <typename Request>
+void BatchExecutor::add(const std::string& name, RouteClass routeClass, std::function<void(StreamWriter&, const Request&)> run)
+{
+	m_operations[name] = { [run](StreamWriter& writer, const RawValue& body) { run(writer, decodeRequest<Request>(body)); }, routeClass };
+}
+
+
+BatchExecutor::BatchExecutor(const DatabaseAccess& db) :
+	m_db(db)
+{
+	// write operations, they reply with the same messages as their endpoints
+	add<AlbumRequest>("create_album", RouteClass::WRITE, [this](StreamWriter& writer, const AlbumRequest& input)
+	{
+		m_db.createAlbum(Album(input.userId, input.name));
+		writer.value("Album created successfully.");
+	});
+
+	add<CreateUserRequest>("create_user", RouteClass::WRITE, [this](StreamWriter& writer, const CreateUserRequest& input)
+	{
+		m_db.createUser(User(-1, input.name));
+		writer.value("User created successfully.");
+	});
+
+	add<AddPictureRequest>("add_picture_to_album", RouteClass::WRITE, [this](StreamWriter& writer, const AddPictureRequest& input)
+	{
+		Picture newPicture(-1, input.pictureName);
+		newPicture.setPath(input.path);
+
+		m_db.addPictureToAlbumByName(input.albumName, newPicture);
+		writer.value("Picture added to album successfully.");
+	});
+
+	add<TagRequest>("tag_user_in_picture", RouteClass::WRITE, [this](StreamWriter& writer, const TagRequest& input)
+	{
+		m_db.tagUserInPicture(input.albumName, input.pictureName, input.userId);
+		writer.value("User tagged in picture successfully.");
+	});
+
+	add<UserRequest>("delete_user", RouteClass::WRITE, [this](StreamWriter& writer, const UserRequest& input)
+	{
+		m_db.deleteUser(User(input.id, ""));
+		writer.value("User deleted successfully.");
+	});
+
+	add<AlbumRequest>("delete_album", RouteClass::WRITE, [this](StreamWriter& writer, const AlbumRequest& input)
+	{
+		m_db.deleteAlbum(input.name, input.userId);
+		writer.value("Album deleted successfully.");
+	});
+
+	add<PictureRequest>("remove_picture_from_album", RouteClass::WRITE, [this](StreamWriter& writer, const PictureRequest& input)
+	{
+		m_db.removePictureFromAlbumByName(input.albumName, input.pictureName);
+		writer.value("Picture removed from album successfully.");
+	});
+
+	add<TagRequest>("untag_user_in_picture", RouteClass::WRITE, [this](StreamWriter& writer, const TagRequest& input)
+	{
+		m_db.untagUserInPicture(input.albumName, input.pictureName, input.userId);
+		writer.value("User untagged from picture successfully.");
+	});
+
+	// read operations, they write the same JSON as their endpoints
+	add<EmptyRequest>("get_albums", RouteClass::LISTING, [this](StreamWriter& writer, const EmptyRequest&)
+	{
+		writer.beginArray();
+		m_db.forEachAlbum([&writer](const Album& album, int picturesCount) { JsonHelper::writeAlbum(writer, album, picturesCount); });
+		writer.endArray();
+	});
+
+	add<UserRequest>("get_albums_of_user", RouteClass::LISTING, [this](StreamWriter& writer, const UserRequest& input)
+	{
+		if (!m_db.doesUserExists(input.id))
+			throw ItemNotFoundException("User", input.id);
+
+		writer.beginArray();
+		m_db.forEachAlbumOfUser(User(input.id, ""), [&writer](const Album& album, int picturesCount) { JsonHelper::writeAlbum(writer, album, picturesCount); });
+		writer.endArray();
+	});
+
+	add<EmptyRequest>("get_users", RouteClass::LISTING, [this](StreamWriter& writer, const EmptyRequest&)
+	{
+		writer.beginArray();
+		m_db.forEachUser([&writer](const User& user) { JsonHelper::writeUser(writer, user); });
+		writer.endArray();
+	});
+
+	add<UserRequest>("get_user", RouteClass::READ, [this](StreamWriter& writer, const UserRequest& input)
+	{
+		JsonHelper::writeUser(writer, m_db.getUser(input.id));
+	});
+
+	add<UserRequest>("get_user_albums_count", RouteClass::READ, [this](StreamWriter& writer, const UserRequest& input)
+	{
+		writer.value(m_db.countAlbumsOwnedOfUser(User(input.id, "")));
+	});
+
+	add<UserRequest>("get_albums_tagged_user_count", RouteClass::READ, [this](StreamWriter& writer, const UserRequest& input)
+	{
+		writer.value(m_db.countAlbumsTaggedOfUser(User(input.id, "")));
+	});
+
+	add<UserRequest>("get_count_tags_of_user", RouteClass::READ, [this](StreamWriter& writer, const UserRequest& input)
+	{
+		writer.value(m_db.countTagsOfUser(User(input.id, "")));
+	});
+
+	add<UserRequest>("get_average_tags_of_user_per_album", RouteClass::READ, [this](StreamWriter& writer, const UserRequest& input)
+	{
+		writer.value(static_cast<double>(m_db.averageTagsPerAlbumOfUser(User(input.id, ""))));
+	});
+
+	add<AlbumPicturesRequest>("get_album_pictures", RouteClass::LISTING, [this](StreamWriter& writer, const AlbumPicturesRequest& input)
+	{
+		if (!m_db.doesAlbumExists(input.albumName, input.ownerId))
+			throw ItemNotFoundException("Album", input.albumName);
+
+		writer.beginArray();
+		m_db.forEachAlbumPicture(Album(input.ownerId, input.albumName), [&writer](const Picture& picture) { JsonHelper::writePicture(writer, picture); });
+		writer.endArray();
+	});
+
+	add<PictureTagsRequest>("get_picture_tags", RouteClass::READ, [this](StreamWriter& writer, const PictureTagsRequest& input)
+	{
+		RequestArena arena;
+
+		writer.beginArray();
+		for (const User& user : m_db.getPictureTags(Picture(input.id, input.name), arena.resource()))
+			JsonHelper::writeUser(writer, user);
+		writer.endArray();
+	});
+
+	add<IDsRequest>("get_users_by_ids", RouteClass::LISTING, [this](StreamWriter& writer, const IDsRequest& input)
+	{
+		checkLookupSize(input.ids);
+		JsonHelper::writeUsersLookup(writer, input.ids, m_db.lookupUsers(input.ids));
+	});
+
+	add<NamesRequest>("get_albums_by_names", RouteClass::LISTING, [this](StreamWriter& writer, const NamesRequest& input)
+	{
+		checkLookupSize(input.names);
+		JsonHelper::writeAlbumsLookup(writer, input.names, m_db.lookupAlbums(input.names));
+	});
+
+	add<IDsRequest>("get_pictures_by_ids", RouteClass::LISTING, [this](StreamWriter& writer, const IDsRequest& input)
+	{
+		checkLookupSize(input.ids);
+		JsonHelper::writePicturesLookup(writer, input.ids, m_db.lookupPictures(input.ids));
+	});
+
+	// the query is the whole body, as in the endpoint, so it is decoded as it is instead of through a request struct
+	m_operations["query_tagged_pictures"] = { [this](StreamWriter& writer, const RawValue& body)
+	{
+		JsonHelper::writeValue(writer, JsonHelper::pictureIDsToJson(m_db.queryTaggedPictures(decodeTagQuery(body))));
+	}, RouteClass::READ };
+
+	add<CoTaggedUsersRequest>("get_co_tagged_users", RouteClass::READ, [this](StreamWriter& writer, const CoTaggedUsersRequest& input)
+	{
+		const auto coTaggedUsers = m_db.getTopCoTaggedUsers(User(input.id, ""), input.count);
+		JsonHelper::writeValue(writer, JsonHelper::coTaggedUsersToJson(coTaggedUsers));
+	});
+
+	add<CoTagStrengthRequest>("get_co_tag_strength", RouteClass::READ, [this](StreamWriter& writer, const CoTagStrengthRequest& input)
+	{
+		writer.value(m_db.countCoTags(User(input.firstId, ""), User(input.secondId, "")));
+	});
+
+	add<SuggestTagsRequest>("suggest_tags", RouteClass::READ, [this](StreamWriter& writer, const SuggestTagsRequest& input)
+	{
+		const auto suggestions = m_db.suggestTags(input.albumName, input.pictureName, input.count);
+		JsonHelper::writeValue(writer, JsonHelper::tagSuggestionsToJson(suggestions));
+	});
+}
+
+
+// a batch of reads that is not atomic is admitted as a read, or as a listing if any of its reads is one,
+// since it takes no write lock. Any other batch is admitted as a write
+RouteClass BatchExecutor::classify(const BatchRequest& batch) const
+{
+	RouteClass routeClass = batch.atomic ? RouteClass::WRITE : RouteClass::READ;
+
+	// every operation is looked up, so an unknown one is found before anything runs
+	for (const auto& operation : batch.operations)
+	{
+		const RouteClass operationClass = findOperation(operation.op).routeClass;
+
+		if (operationClass == RouteClass::WRITE || (operationClass == RouteClass::LISTING && routeClass == RouteClass::READ))
+			routeClass = operationClass;
+	}
+
+	return routeClass;
+}
+
+std::string BatchExecutor::execute(const BatchRequest& batch, StreamWriter::Format format) const
+{
+	if (batch.operations.size() > BATCH_MAX_OPERATIONS)
+		throw InvalidRequestException("A batch may hold at most " + std::to_string(BATCH_MAX_OPERATIONS) + " operations.");
+
+	// an unknown operation fails the whole batch before anything runs
+	const bool isReadOnly = classify(batch) != RouteClass::WRITE;
+
+	std::string results;
+	bool isCommitted = true;
+
+	const auto runAll = [&]
+	{
+		results.clear();
+
+		const auto writer = StreamWriter::create(format, [&results](const char* data, size_t size) { results.append(data, size); });
+		writer->beginArray();
+
+		for (const auto& operation : batch.operations)
+		{
+			if (!runOperation(*writer, operation, format) && batch.atomic)
+			{
+				writer->endArray();
+				writer->flush();
+				throw BatchAbortedException();
+			}
+		}
+
+		writer->endArray();
+		writer->flush();
+	};
+
+	if (batch.atomic)
+	{
+		try
+		{
+			m_db.runInTransaction(runAll);
+		}
+		catch (const BatchAbortedException&)
+		{
+			isCommitted = false;
+		}
+	}
+	else if (isReadOnly)
+		m_db.runReadTransaction(runAll);
+	else
+		runAll();
+
+	std::string result;
+	const auto writer = StreamWriter::create(format, [&result](const char* data, size_t size) { result.append(data, size); });
+
+	writer->beginObject();
+	writer->key("committed").value(isCommitted);
+	writer->key("results").raw(results);
+	writer->endObject();
+	writer->flush();
+
+	return result;
+}
+
+
+// helper functions //
+const BatchExecutor::Operation& BatchExecutor::findOperation(const std::string& name) const
+{
+	const auto operation = m_operations.find(name);
+	if (operation == m_operations.end())
+		throw InvalidRequestException("Unknown operation '" + name + "' in the batch.");
+
+	return operation->second;
+}
+
+// runs a single operation and writes its result, returns whether it succeeded
+bool BatchExecutor::runOperation(StreamWriter& results, const BatchOperationRequest& request, StreamWriter::Format format) const
+{
+	std::string body;
+	int status = 200;
+	std::string error;
+
+	// the same statuses reply_on_failure replies with for the endpoint
+	try
+	{
+		const auto writer = StreamWriter::create(format, [&body](const char* data, size_t size) { body.append(data, size); });
+		findOperation(request.op).run(*writer, request.body);
+		writer->flush();
+	}
+	catch (const InvalidRequestException& e)
+	{
+		status = 400;
+		error = e.what();
+	}
+	catch (const ItemAlreadyExistsException& e)
+	{
+		status = 409;
+		error = e.what();
+	}
+	catch (const ItemNotFoundException& e)
+	{
+		status = 404;
+		error = e.what();
+	}
+	catch (const std::exception& e)
+	{
+		Logger::failure("batch", std::string("Internal server error occurred: ") + e.what(), { { "op", request.op } });
+		status = 500;
+		error = "Internal server error occurred.";
+	}
+
+	results.beginObject().key("op").value(request.op).key("status").value(status);
+
+	if (status == 200)
+		results.key("body").raw(body);
+	else
+		results.key("error").value(error);
+
+	results.endObject();
+	return status == 200;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "DatabaseAccess.h"
+#include "StreamWriter.h"
+#include "Requests.h"
+#include "Router.h"
+
+
+/*
+ * Runs the operations of a batch request, in order, and writes their results as a JSON (or CBOR) object:
+ *     {"committed": true, "results": [{"op": "get_user", "status": 200, "body": {...}}, {"op": ..., "status": 404, "error": "..."}]}
+ * The operations are the endpoints of the API by name, each with the body it takes on its own.
+ * - a batch of reads only runs as one read transaction, so all its results come from the same data
+ * - an atomic batch runs as one transaction and stops at the first failed operation, rolling back the
+ *   operations before it - committed is false then, and the results end with the failed operation
+ * - any other batch runs its operations one after the other, each one commits or fails on its own
+ */
+class BatchExecutor
+{
+public:
+	explicit BatchExecutor(const DatabaseAccess& db);
+
+	// the admission class of the batch, throws InvalidRequestException for an unknown operation
+	RouteClass classify(const BatchRequest& batch) const;
+
+	// returns the results encoded in the given format, throws InvalidRequestException for a malformed batch
+	std::string execute(const BatchRequest& batch, StreamWriter::Format format) const;
+
+private:
+	struct Operation
+	{
+		std::function<void(StreamWriter& writer, const RawValue& body)> run;
+		RouteClass routeClass;		// of the endpoint of the operation
+	};
+
+	const DatabaseAccess& m_db;
+	std::unordered_map<std::string, Operation> m_operations;
+
+	template <typename Request>
+	void add(const std::string& name, RouteClass routeClass, std::function<void(StreamWriter&, const Request&)> run);
+
+	const Operation& findOperation(const std::string& name) const;
+	bool runOperation(StreamWriter& results, const BatchOperationRequest& request, StreamWriter::Format format) const;
+};
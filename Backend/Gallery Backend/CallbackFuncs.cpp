@@ -1,6 +1,10 @@
 #include "CallbackFuncs.h"
 #include <list>
+#include <memory_resource>
+#include <map>
+#include <set>
 #include "Album.h"
+#include "TagIndex.h"
 #include "User.h"
 
 
@@ -29,6 +33,25 @@ int getIDCallback(void* data, int argc, char** argv, char** azColName)
 
 	return 0;
 }
+int countPerIDCallback(void* data, int argc, char** argv, char** azColName)
+{
+	std::map<int, int>* counts = static_cast<std::map<int, int>*>(data);
+
+	// rows of (ID, COUNT), counts of the same id coming from different shards are summed
+	if (argv[0] != nullptr && argv[1] != nullptr)
+		(*counts)[std::stoi(argv[0])] += std::stoi(argv[1]);
+
+	return 0;
+}
+int getSequenceCallback(void* data, int argc, char** argv, char** azColName)
+{
+	uint64_t* sequence = static_cast<uint64_t*>(data);
+
+	if (argv[0] != nullptr)
+		*sequence = std::stoull(argv[0]);
+
+	return 0;
+}
 
 
 
@@ -53,7 +76,7 @@ int getAlbumCallback(void* data, int argc, char** argv, char** azColName)
 }
 int getAlbumsCallback(void* data, int argc, char** argv, char** azColName)
 {
-	std::list<Album>* albums = static_cast<std::list<Album>*>(data);
+	std::pmr::list<Album>* albums = static_cast<std::pmr::list<Album>*>(data);
 	Album album;
 
 	for (int i = 0; i < argc; i++)
@@ -84,7 +107,7 @@ int getAlbumsCallback(void* data, int argc, char** argv, char** azColName)
 // user related callbacks //
 int getUsersCallback(void* data, int argc, char** argv, char** azColName)
 {
-	std::list<User>* users = static_cast<std::list<User>*>(data);
+	std::pmr::list<User>* users = static_cast<std::pmr::list<User>*>(data);
 	User user(-1, "");
 
 	for (int i = 0; i < argc; i++)
@@ -150,7 +173,7 @@ int getPictureCallback(void* data, int argc, char** argv, char** azColName)
 }
 int getPicturesCallback(void* data, int argc, char** argv, char** azColName)
 {
-	std::list<Picture>* pictures = static_cast<std::list<Picture>*>(data);
+	std::pmr::list<Picture>* pictures = static_cast<std::pmr::list<Picture>*>(data);
 	Picture picture(-1, "");
 
 	for (int i = 0; i < argc; i++)
@@ -175,6 +198,16 @@ int getPicturesCallback(void* data, int argc, char** argv, char** azColName)
 
 	return 0;
 }
+int getPictureLocationsCallback(void* data, int argc, char** argv, char** azColName)
+{
+	std::vector<PictureLocation>* locations = static_cast<std::vector<PictureLocation>*>(data);
+
+	// rows of (picture ID, album NAME, owner USER_ID)
+	if (argv[0] != nullptr && argv[1] != nullptr && argv[2] != nullptr)
+		locations->push_back({ std::stoi(argv[0]), argv[1], std::stoi(argv[2]) });
+
+	return 0;
+}
 
 
 
@@ -191,3 +224,135 @@ int getTagsCallback(void* data, int argc, char** argv, char** azColName)
 	return 0;
 }
 
+
+int tagUserCallback(void* data, int argc, char** argv, char** azColName)
+{
+	Picture* picture = static_cast<Picture*>(data);
+
+	if (argv[0] != nullptr)
+		picture->tagUser(std::stoi(argv[0]));
+
+	return 0;
+}
+
+
+
+// tag index related callbacks //
+int indexPictureCallback(void* data, int argc, char** argv, char** azColName)
+{
+	TagIndex* index = static_cast<TagIndex*>(data);
+
+	// picture id, album id, owner id
+	if (argv[0] != nullptr && argv[1] != nullptr && argv[2] != nullptr)
+		index->addPicture(std::stoi(argv[0]), std::stoi(argv[1]), std::stoi(argv[2]));
+
+	return 0;
+}
+
+int indexTagCallback(void* data, int argc, char** argv, char** azColName)
+{
+	TagIndex* index = static_cast<TagIndex*>(data);
+
+	// picture id, user id
+	if (argv[0] != nullptr && argv[1] != nullptr)
+		index->tagUser(std::stoi(argv[0]), std::stoi(argv[1]));
+
+	return 0;
+}
+
+
+
+// streamed listing callbacks //
+int getAlbumSummariesCallback(void* data, int argc, char** argv, char** azColName)
+{
+	std::vector<AlbumSummary>* albums = static_cast<std::vector<AlbumSummary>*>(data);
+	Album album;
+	int picturesCount = 0;
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (argv[i] == nullptr)
+			continue;
+
+		if (std::string(azColName[i]) == "USER_ID")
+			album.setOwner(std::stoi(argv[i]));
+		else if (std::string(azColName[i]) == "NAME")
+			album.setName(argv[i]);
+		else if (std::string(azColName[i]) == "CREATION_DATE")
+			album.setCreationDate(argv[i]);
+		else if (std::string(azColName[i]) == "PICTURES_COUNT")
+			picturesCount = std::stoi(argv[i]);
+	}
+
+	// missing data
+	if (album.getOwnerId() == 0 || album.getCreationDate().empty())
+		return 0;
+
+	albums->emplace_back(std::move(album), picturesCount);
+
+	return 0;
+}
+
+// rows are ordered by picture id, a picture is visited once the rows of the next one start
+int visitPicturesCallback(void* data, int argc, char** argv, char** azColName)
+{
+	PictureCursor* cursor = static_cast<PictureCursor*>(data);
+	int pictureId = -1;
+	int taggedUserId = -1;
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (argv[i] == nullptr)
+			continue;
+
+		if (std::string(azColName[i]) == "ID")
+			pictureId = std::stoi(argv[i]);
+		else if (std::string(azColName[i]) == "TAGGED_USER_ID")
+			taggedUserId = std::stoi(argv[i]);
+	}
+
+	// missing data
+	if (pictureId == -1)
+		return 0;
+
+	if (pictureId != cursor->current.getId())
+	{
+		if (cursor->current.getId() != -1)
+			cursor->visit(cursor->current);
+
+		cursor->current = Picture(pictureId, "");
+
+		for (int i = 0; i < argc; i++)
+		{
+			if (argv[i] == nullptr)
+				continue;
+
+			if (std::string(azColName[i]) == "NAME")
+				cursor->current.setName(argv[i]);
+			else if (std::string(azColName[i]) == "LOCATION")
+				cursor->current.setPath(argv[i]);
+			else if (std::string(azColName[i]) == "CREATION_DATE")
+				cursor->current.setCreationDate(argv[i]);
+		}
+	}
+
+	// pictures without tags have a single row with no tagged user
+	if (taggedUserId != -1)
+		cursor->current.tagUser(taggedUserId);
+
+	return 0;
+}
+
+
+
+// change log related callbacks //
+int getChangeLogCallback(void* data, int argc, char** argv, char** azColName)
+{
+	std::vector<ChangeLogEntry>* changes = static_cast<std::vector<ChangeLogEntry>*>(data);
+
+	// rows of (SEQUENCE, ENTITY, ENTITY_ID, OP, PAYLOAD)
+	if (argv[0] != nullptr && argv[1] != nullptr && argv[2] != nullptr && argv[3] != nullptr && argv[4] != nullptr)
+		changes->push_back({ std::stoull(argv[0]), argv[1], argv[2], argv[3], argv[4] });
+
+	return 0;
+}
@@ -1,9 +1,36 @@
 #pragma once
+#include <functional>
+#include <utility>
+#include <vector>
+#include "Album.h"
+#include "ChangeFeed.h"
+
+
+// an album row with the number of pictures in it, read without reading the pictures themselves
+using AlbumSummary = std::pair<Album, int>;
+
+// where a picture is, as the directory knows it
+struct PictureLocation
+{
+	int pictureId;
+	std::string albumName;
+	int ownerId;
+};
+
+// a streamed listing of pictures, the rows of a picture arrive together - one row per tag of it
+struct PictureCursor
+{
+	std::function<void(const Picture&)> visit;
+	Picture current{ -1, "" };
+};
+
 
 // general callback functions
 int existenceCallback(void* data, int argc, char** argv, char** azColName);
 int countCallback(void* data, int argc, char** argv, char** azColName);
 int getIDCallback(void* data, int argc, char** argv, char** azColName);
+int countPerIDCallback(void* data, int argc, char** argv, char** azColName);
+int getSequenceCallback(void* data, int argc, char** argv, char** azColName);
 
 
 // album related callbacks
@@ -19,7 +46,23 @@ int getUserCallback(void* data, int argc, char** argv, char** azColName);
 // picture related callbacks
 int getPictureCallback(void* data, int argc, char** argv, char** azColName);
 int getPicturesCallback(void* data, int argc, char** argv, char** azColName);
+int getPictureLocationsCallback(void* data, int argc, char** argv, char** azColName);
 
 
 // tag related callbacks
-int getTagsCallback(void* data, int argc, char** argv, char** azColName);
\ No newline at end of file
+int getTagsCallback(void* data, int argc, char** argv, char** azColName);
+int tagUserCallback(void* data, int argc, char** argv, char** azColName);
+
+
+// tag index related callbacks
+int indexPictureCallback(void* data, int argc, char** argv, char** azColName);
+int indexTagCallback(void* data, int argc, char** argv, char** azColName);
+
+
+// streamed listing callbacks
+int getAlbumSummariesCallback(void* data, int argc, char** argv, char** azColName);
+int visitPicturesCallback(void* data, int argc, char** argv, char** azColName);
+
+
+// change log related callbacks
+int getChangeLogCallback(void* data, int argc, char** argv, char** azColName);
@@ -0,0 +1,362 @@
+#include "CborReader.h"
+#include <climits>
+
+#include "InvalidRequestException.h"
+
+
+// nesting limit of skipped values, so a hostile body can not exhaust the stack
+constexpr int MAX_NESTING_DEPTH = 64;
+
+// the additional information of an initial byte that marks an indefinite length
+constexpr uint8_t INDEFINITE_LENGTH = 31;
+constexpr uint8_t BREAK = 0xFF;
+
+// major types of the initial byte
+constexpr uint8_t UNSIGNED_INTEGER = 0;
+constexpr uint8_t NEGATIVE_INTEGER = 1;
+constexpr uint8_t BYTE_STRING = 2;
+constexpr uint8_t TEXT_STRING = 3;
+constexpr uint8_t ARRAY = 4;
+constexpr uint8_t MAP = 5;
+constexpr uint8_t TAG = 6;
+constexpr uint8_t SIMPLE = 7;
+
+// simple values and floats, by their additional information
+constexpr uint8_t FALSE_VALUE = 20;
+constexpr uint8_t TRUE_VALUE = 21;
+constexpr uint8_t NULL_VALUE = 22;
+constexpr uint8_t UNDEFINED_VALUE = 23;
+constexpr uint8_t HALF_FLOAT = 25;
+constexpr uint8_t DOUBLE_FLOAT = 27;
+
+
+CborReader::CborReader(std::string_view data) :
+	m_data(data)
+{
+	// Left empty
+}
+
+
+// container related functions //
+void CborReader::beginObject()
+{
+	skipTags();
+
+	if (m_position == m_data.size() || peekByte() >> 5 != MAP)
+		throw InvalidRequestException("The request body must be a CBOR map.");
+
+	beginContainer();
+}
+
+bool CborReader::nextKey(std::string& key)
+{
+	if (!nextMember())
+		return false;
+
+	const uint8_t initial = readByte();
+	if (initial >> 5 != TEXT_STRING)
+		fail("map key is not a text string");
+
+	key = readText(initial & 0x1F);
+	return true;
+}
+
+void CborReader::beginArray()
+{
+	skipTags();
+
+	if (peekByte() >> 5 != ARRAY)
+		fail("expected an array");
+
+	beginContainer();
+}
+
+bool CborReader::nextElement()
+{
+	return nextMember();
+}
+
+void CborReader::end()
+{
+	if (m_position != m_data.size())
+		fail("unexpected data after the body");
+}
+
+
+// value related functions //
+CborReader::Type CborReader::peekType()
+{
+	skipTags();
+	const uint8_t initial = peekByte();
+
+	switch (initial >> 5)
+	{
+	case UNSIGNED_INTEGER:
+	case NEGATIVE_INTEGER:
+		return Type::NUMBER;
+	case BYTE_STRING:
+		fail("byte strings are not supported");
+	case TEXT_STRING:
+		return Type::STRING;
+	case ARRAY:
+		return Type::ARRAY;
+	case MAP:
+		return Type::OBJECT;
+	}
+
+	switch (initial & 0x1F)
+	{
+	case FALSE_VALUE:
+	case TRUE_VALUE:
+		return Type::BOOLEAN;
+	case NULL_VALUE:
+	case UNDEFINED_VALUE:
+		return Type::NULL_VALUE;
+	case INDEFINITE_LENGTH:
+		fail("unexpected break");
+	default:
+		if ((initial & 0x1F) >= HALF_FLOAT && (initial & 0x1F) <= DOUBLE_FLOAT)
+			return Type::NUMBER;
+
+		fail("unsupported simple value");
+	}
+}
+
+void CborReader::readString(std::string& value)
+{
+	skipTags();
+
+	const uint8_t initial = readByte();
+	if (initial >> 5 != TEXT_STRING)
+		fail("expected a text string");
+
+	value = readText(initial & 0x1F);
+}
+
+// a negative integer n is encoded as -1 - n, a float is never an integer even if it has no fraction
+bool CborReader::readInteger(int& value)
+{
+	skipTags();
+
+	const uint8_t initial = readByte();
+	const uint8_t majorType = initial >> 5;
+	const uint64_t argument = readArgument(initial & 0x1F);
+
+	if (majorType != UNSIGNED_INTEGER && majorType != NEGATIVE_INTEGER)
+	{
+		if ((initial & 0x1F) < HALF_FLOAT || (initial & 0x1F) > DOUBLE_FLOAT)
+			fail("expected a number");
+
+		return false;
+	}
+
+	if (argument > INT_MAX)
+		return false;
+
+	value = majorType == UNSIGNED_INTEGER ? static_cast<int>(argument) : -static_cast<int>(argument) - 1;
+	return true;
+}
+
+bool CborReader::readBoolean()
+{
+	skipTags();
+
+	const uint8_t initial = readByte();
+	if (initial >> 5 != SIMPLE || ((initial & 0x1F) != FALSE_VALUE && (initial & 0x1F) != TRUE_VALUE))
+		fail("expected a boolean");
+
+	return (initial & 0x1F) == TRUE_VALUE;
+}
+
+std::string_view CborReader::readRaw()
+{
+	const size_t start = m_position;
+	skipValue();
+
+	return m_data.substr(start, m_position - start);
+}
+
+void CborReader::skipValue()
+{
+	skipValue(0);
+}
+
+
+// helper functions //
+void CborReader::beginContainer()
+{
+	const uint8_t additional = readByte() & 0x1F;
+
+	// a definite count is not trusted beyond the data there is, every member reads at least a byte
+	if (additional == INDEFINITE_LENGTH)
+		m_containers.push_back({ 0, true });
+	else
+		m_containers.push_back({ readArgument(additional), false });
+}
+
+// moves to the next member of the innermost map or array, or past its end
+bool CborReader::nextMember()
+{
+	Container& container = m_containers.back();
+
+	if (container.isIndefinite ? skipBreak() : container.remaining == 0)
+	{
+		m_containers.pop_back();
+		return false;
+	}
+
+	if (!container.isIndefinite)
+		container.remaining--;
+
+	return true;
+}
+
+void CborReader::skipValue(int depth)
+{
+	if (depth > MAX_NESTING_DEPTH)
+		fail("too deeply nested");
+
+	const uint8_t initial = readByte();
+	const uint8_t majorType = initial >> 5;
+	const uint8_t additional = initial & 0x1F;
+
+	switch (majorType)
+	{
+	case UNSIGNED_INTEGER:
+	case NEGATIVE_INTEGER:
+		readArgument(additional);
+		return;
+	case BYTE_STRING:
+		fail("byte strings are not supported");
+	case TEXT_STRING:
+		readText(additional);
+		return;
+	case ARRAY:
+	case MAP:
+	{
+		const bool isIndefinite = additional == INDEFINITE_LENGTH;
+		const uint64_t count = isIndefinite ? 0 : readArgument(additional);
+
+		for (uint64_t i = 0; isIndefinite ? !skipBreak() : i < count; i++)
+		{
+			if (majorType == MAP)
+			{
+				const uint8_t keyInitial = readByte();
+				if (keyInitial >> 5 != TEXT_STRING)
+					fail("map key is not a text string");
+
+				readText(keyInitial & 0x1F);
+			}
+
+			skipValue(depth + 1);
+		}
+
+		return;
+	}
+	case TAG:
+		// a tag only gives a meaning to the item after it
+		readArgument(additional);
+		skipValue(depth + 1);
+		return;
+	}
+
+	switch (additional)
+	{
+	case FALSE_VALUE:
+	case TRUE_VALUE:
+	case NULL_VALUE:
+	case UNDEFINED_VALUE:
+		return;
+	case INDEFINITE_LENGTH:
+		fail("unexpected break");
+	default:
+		if (additional < HALF_FLOAT || additional > DOUBLE_FLOAT)
+			fail("unsupported simple value");
+
+		readArgument(additional);
+	}
+}
+
+void CborReader::skipTags()
+{
+	while (m_position < m_data.size() && peekByte() >> 5 == TAG)
+		readArgument(readByte() & 0x1F);
+}
+
+uint8_t CborReader::peekByte()
+{
+	if (m_position == m_data.size())
+		fail("unexpected end of the body");
+
+	return static_cast<uint8_t>(m_data[m_position]);
+}
+
+uint8_t CborReader::readByte()
+{
+	const uint8_t byte = peekByte();
+	m_position++;
+
+	return byte;
+}
+
+// the argument of an initial byte - its additional information itself, or the big endian bytes after it
+uint64_t CborReader::readArgument(uint8_t additional)
+{
+	if (additional < 24)
+		return additional;
+
+	if (additional > 27)
+		fail("invalid length");
+
+	const int bytes = 1 << (additional - 24);
+	uint64_t argument = 0;
+
+	for (int i = 0; i < bytes; i++)
+		argument = (argument << 8) | readByte();
+
+	return argument;
+}
+
+// a text string is a definite length run of UTF-8, or an indefinite sequence of such runs
+std::string CborReader::readText(uint8_t additional)
+{
+	if (additional != INDEFINITE_LENGTH)
+	{
+		const uint64_t length = readArgument(additional);
+		if (length > m_data.size() - m_position)
+			fail("unexpected end of the body");
+
+		const std::string text(m_data.substr(m_position, static_cast<size_t>(length)));
+		m_position += static_cast<size_t>(length);
+
+		return text;
+	}
+
+	std::string text;
+	while (!skipBreak())
+	{
+		const uint8_t initial = readByte();
+		if (initial >> 5 != TEXT_STRING || (initial & 0x1F) == INDEFINITE_LENGTH)
+			fail("invalid text string chunk");
+
+		text += readText(initial & 0x1F);
+	}
+
+	return text;
+}
+
+bool CborReader::skipBreak()
+{
+	if (m_position < m_data.size() && static_cast<uint8_t>(m_data[m_position]) == BREAK)
+	{
+		m_position++;
+		return true;
+	}
+
+	return false;
+}
+
+void CborReader::fail(const std::string& reason) const
+{
+	throw InvalidRequestException("The request body is not valid CBOR: " + reason + " at offset " + std::to_string(m_position) + ".");
+}
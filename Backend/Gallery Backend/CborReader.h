@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/*
+ * Pull parser that reads a CBOR (RFC 8949) request body the way JsonReader reads a JSON one, so the
+ * request schemas decode a body sent as CBOR straight into their structs, without going through JSON
+ * text. Definite and indefinite lengths are both read. Tags are skipped, keeping the value they tag,
+ * byte strings have no JSON counterpart and are rejected, and so are map keys that are not text.
+ * Every problem with the body is thrown as an InvalidRequestException.
+ */
+class CborReader
+{
+public:
+	enum class Type { OBJECT, ARRAY, STRING, NUMBER, BOOLEAN, NULL_VALUE };
+
+	explicit CborReader(std::string_view data);
+
+	void beginObject();
+	bool nextKey(std::string& key);		// false once the map ended
+	void beginArray();
+	bool nextElement();					// false once the array ended
+	void end();							// nothing may follow the map
+
+	Type peekType();
+	void readString(std::string& value);
+	bool readInteger(int& value);		// false if the number is a float or does not fit an int
+	bool readBoolean();
+	std::string_view readRaw();			// the bytes of the next value as they are, for decoding it later
+	void skipValue();
+
+private:
+	// an open map or array, a definite one counts down its members and an indefinite one ends with a break
+	struct Container
+	{
+		uint64_t remaining;
+		bool isIndefinite;
+	};
+
+	std::string_view m_data;
+	size_t m_position{ 0 };
+	std::vector<Container> m_containers;	// innermost last
+
+	void beginContainer();
+	bool nextMember();
+	void skipValue(int depth);
+	void skipTags();
+
+	uint8_t peekByte();
+	uint8_t readByte();
+	uint64_t readArgument(uint8_t additional);
+	std::string readText(uint8_t additional);
+	bool skipBreak();
+	[[noreturn]] void fail(const std::string& reason) const;
+};
@@ -0,0 +1,193 @@
+#include "CborStreamWriter.h"
+#include <cstring>
+
+#include "MyException.h"
+
+
+// major types of the initial byte of a data item, in its top 3 bits
+constexpr uint8_t CBOR_UNSIGNED = 0;
+constexpr uint8_t CBOR_NEGATIVE = 1;
+constexpr uint8_t CBOR_TEXT = 3;
+constexpr uint8_t CBOR_ARRAY = 4;
+constexpr uint8_t CBOR_MAP = 5;
+
+// initial bytes of the simple values and the markers of indefinite lengths
+constexpr char CBOR_FALSE = static_cast<char>(0xF4);
+constexpr char CBOR_TRUE = static_cast<char>(0xF5);
+constexpr char CBOR_NULL = static_cast<char>(0xF6);
+constexpr char CBOR_DOUBLE = static_cast<char>(0xFB);
+constexpr char CBOR_INDEFINITE_ARRAY = static_cast<char>(0x9F);
+constexpr char CBOR_INDEFINITE_MAP = static_cast<char>(0xBF);
+constexpr char CBOR_BREAK = static_cast<char>(0xFF);
+
+
+CborStreamWriter::CborStreamWriter(Sink sink, size_t chunkSize) :
+	StreamWriter(std::move(sink), chunkSize)
+{
+	// Left empty
+}
+
+
+// structure functions //
+StreamWriter& CborStreamWriter::beginObject()
+{
+	writeValueStart();
+	append(CBOR_INDEFINITE_MAP);
+	m_depth++;
+
+	return *this;
+}
+
+StreamWriter& CborStreamWriter::endObject()
+{
+	if (m_depth == 0 || m_afterKey)
+		throw MyException("CBOR map closed without being opened, or right after a key.");
+
+	m_depth--;
+	append(CBOR_BREAK);
+
+	return *this;
+}
+
+StreamWriter& CborStreamWriter::beginArray()
+{
+	writeValueStart();
+	append(CBOR_INDEFINITE_ARRAY);
+	m_depth++;
+
+	return *this;
+}
+
+StreamWriter& CborStreamWriter::endArray()
+{
+	if (m_depth == 0)
+		throw MyException("CBOR array closed without being opened.");
+
+	m_depth--;
+	append(CBOR_BREAK);
+
+	return *this;
+}
+
+StreamWriter& CborStreamWriter::key(std::string_view name)
+{
+	writeHead(CBOR_TEXT, name.size());
+	append(name);
+	m_afterKey = true;
+
+	return *this;
+}
+
+
+// value functions //
+StreamWriter& CborStreamWriter::value(std::string_view text)
+{
+	writeValueStart();
+	writeHead(CBOR_TEXT, text.size());
+	append(text);
+
+	return *this;
+}
+
+StreamWriter& CborStreamWriter::value(int number)
+{
+	writeValueStart();
+
+	// a negative integer n is written as -1 - n
+	if (number >= 0)
+		writeHead(CBOR_UNSIGNED, static_cast<uint64_t>(number));
+	else
+		writeHead(CBOR_NEGATIVE, static_cast<uint64_t>(-(static_cast<int64_t>(number) + 1)));
+
+	return *this;
+}
+
+StreamWriter& CborStreamWriter::value(size_t number)
+{
+	writeValueStart();
+	writeHead(CBOR_UNSIGNED, number);
+
+	return *this;
+}
+
+StreamWriter& CborStreamWriter::value(double number)
+{
+	uint64_t bits;
+	std::memcpy(&bits, &number, sizeof(bits));
+
+	writeValueStart();
+	append(CBOR_DOUBLE);
+
+	for (int shift = 56; shift >= 0; shift -= 8)
+		append(static_cast<char>(bits >> shift));
+
+	return *this;
+}
+
+StreamWriter& CborStreamWriter::value(bool boolean)
+{
+	writeValueStart();
+	append(boolean ? CBOR_TRUE : CBOR_FALSE);
+
+	return *this;
+}
+
+StreamWriter& CborStreamWriter::null()
+{
+	writeValueStart();
+	append(CBOR_NULL);
+
+	return *this;
+}
+
+StreamWriter& CborStreamWriter::raw(std::string_view cbor)
+{
+	writeValueStart();
+	append(cbor);
+
+	return *this;
+}
+
+
+// helper functions //
+// the initial byte holds the argument itself up to 23, and otherwise the size of the big endian argument after it
+void CborStreamWriter::writeHead(uint8_t majorType, uint64_t argument)
+{
+	const char type = static_cast<char>(majorType << 5);
+
+	if (argument < 24)
+	{
+		append(static_cast<char>(type | argument));
+		return;
+	}
+
+	int bytes = 8;
+	char additional = 27;
+
+	if (argument <= UINT8_MAX)
+	{
+		bytes = 1;
+		additional = 24;
+	}
+	else if (argument <= UINT16_MAX)
+	{
+		bytes = 2;
+		additional = 25;
+	}
+	else if (argument <= UINT32_MAX)
+	{
+		bytes = 4;
+		additional = 26;
+	}
+
+	append(static_cast<char>(type | additional));
+
+	for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8)
+		append(static_cast<char>(argument >> shift));
+}
+
+// maps need no separators, a value only ends the key before it
+void CborStreamWriter::writeValueStart()
+{
+	m_afterKey = false;
+}
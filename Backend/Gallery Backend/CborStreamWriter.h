@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "StreamWriter.h"
+
+
+/*
+ * Writes CBOR (RFC 8949) straight to a sink, the binary counterpart of JsonStreamWriter.
+ * Objects and arrays are written with indefinite lengths, so they can be streamed without knowing how
+ * many elements they will have. Integers take as few bytes as their value needs, strings are written
+ * as they are without escaping, and numbers that are not integers are written as doubles.
+ */
+class CborStreamWriter : public StreamWriter
+{
+public:
+	explicit CborStreamWriter(Sink sink, size_t chunkSize = RESPONSE_CHUNK_SIZE);
+
+	StreamWriter& beginObject() override;
+	StreamWriter& endObject() override;
+	StreamWriter& beginArray() override;
+	StreamWriter& endArray() override;
+
+	StreamWriter& key(std::string_view name) override;
+
+	using StreamWriter::value;
+	StreamWriter& value(std::string_view text) override;
+	StreamWriter& value(int number) override;
+	StreamWriter& value(size_t number) override;
+	StreamWriter& value(double number) override;
+	StreamWriter& value(bool boolean) override;
+	StreamWriter& null() override;
+	StreamWriter& raw(std::string_view cbor) override;
+
+private:
+	size_t m_depth{ 0 };		// open objects and arrays
+	bool m_afterKey{ false };
+
+	void writeHead(uint8_t majorType, uint64_t argument);
+	void writeValueStart();
+};
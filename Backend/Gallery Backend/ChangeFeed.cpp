@@ -0,0 +1,191 @@
+#include "ChangeFeed.h"
+
+
+// change event related functions //
+const char* ChangeEvent::typeName(Type type)
+{
+	switch (type)
+	{
+	case Type::ALBUM_CREATED:
+		return "album_created";
+	case Type::ALBUM_DELETED:
+		return "album_deleted";
+	case Type::PICTURE_ADDED:
+		return "picture_added";
+	case Type::PICTURE_REMOVED:
+		return "picture_removed";
+	case Type::USER_TAGGED:
+		return "user_tagged";
+	case Type::USER_UNTAGGED:
+		return "user_untagged";
+	case Type::USER_CREATED:
+		return "user_created";
+	case Type::USER_DELETED:
+		return "user_deleted";
+	default:
+		return "cleared";
+	}
+}
+
+const char* ChangeEvent::entityName(Type type)
+{
+	switch (type)
+	{
+	case Type::ALBUM_CREATED:
+	case Type::ALBUM_DELETED:
+		return "album";
+	case Type::PICTURE_ADDED:
+	case Type::PICTURE_REMOVED:
+		return "picture";
+	case Type::USER_TAGGED:
+	case Type::USER_UNTAGGED:
+		return "tag";
+	case Type::USER_CREATED:
+	case Type::USER_DELETED:
+		return "user";
+	default:
+		return "gallery";
+	}
+}
+
+const char* ChangeEvent::operationName(Type type)
+{
+	switch (type)
+	{
+	case Type::ALBUM_CREATED:
+	case Type::PICTURE_ADDED:
+	case Type::USER_TAGGED:
+	case Type::USER_CREATED:
+		return "create";
+	case Type::CLEARED:
+		return "clear";
+	default:
+		return "delete";
+	}
+}
+
+// a tag is identified by its picture and its user
+std::string ChangeEvent::entityId() const
+{
+	switch (type)
+	{
+	case Type::ALBUM_CREATED:
+	case Type::ALBUM_DELETED:
+		return albumName;
+	case Type::PICTURE_ADDED:
+	case Type::PICTURE_REMOVED:
+		return std::to_string(pictureId);
+	case Type::USER_TAGGED:
+	case Type::USER_UNTAGGED:
+		return std::to_string(pictureId) + ':' + std::to_string(userId);
+	case Type::USER_CREATED:
+	case Type::USER_DELETED:
+		return std::to_string(userId);
+	default:
+		return "";
+	}
+}
+
+// clearing the gallery concerns every subscriber
+bool ChangeFilter::matches(const ChangeEvent& event) const
+{
+	if (event.type == ChangeEvent::Type::CLEARED)
+		return true;
+
+	if (albumName && *albumName != event.albumName)
+		return false;
+
+	return !userId || *userId == event.ownerId || *userId == event.userId;
+}
+
+
+// change feed related functions //
+ChangeFeed::ChangeFeed(size_t maxSubscribers, std::chrono::seconds heartbeatInterval) :
+	m_maxSubscribers(maxSubscribers), m_heartbeatInterval(heartbeatInterval)
+{
+	m_heartbeatThread = std::thread([this] { heartbeatLoop(); });
+}
+
+ChangeFeed::~ChangeFeed()
+{
+	{
+		const std::lock_guard lock(m_mutex);
+		m_isRunning = false;
+	}
+
+	m_heartbeatWake.notify_one();
+	m_heartbeatThread.join();
+}
+
+std::optional<uint64_t> ChangeFeed::subscribe(ChangeFilter filter, Deliver deliver, Ping ping)
+{
+	const std::lock_guard lock(m_mutex);
+
+	if (m_subscribers.size() >= m_maxSubscribers)
+		return std::nullopt;
+
+	const uint64_t subscriptionId = m_nextSubscriptionId++;
+	m_subscribers.emplace(subscriptionId, Subscriber{ std::move(filter), std::move(deliver), std::move(ping) });
+
+	return subscriptionId;
+}
+
+void ChangeFeed::unsubscribe(uint64_t subscriptionId)
+{
+	const std::lock_guard lock(m_mutex);
+	m_subscribers.erase(subscriptionId);
+}
+
+void ChangeFeed::publish(const ChangeEvent& event)
+{
+	const std::lock_guard lock(m_mutex);
+
+	m_published++;
+
+	for (auto subscriber = m_subscribers.begin(); subscriber != m_subscribers.end();)
+	{
+		if (!subscriber->second.filter.matches(event) || subscriber->second.deliver(event))
+		{
+			++subscriber;
+			continue;
+		}
+
+		subscriber = m_subscribers.erase(subscriber);
+		m_dropped++;
+	}
+}
+
+ChangeFeed::Stats ChangeFeed::getStats() const
+{
+	const std::lock_guard lock(m_mutex);
+
+	return { m_subscribers.size(), m_published, m_dropped };
+}
+
+
+// helper functions //
+// a ping must not block either, it is sent under the lock so it never interleaves with an event
+void ChangeFeed::heartbeatLoop()
+{
+	std::unique_lock lock(m_mutex);
+
+	while (m_isRunning)
+	{
+		m_heartbeatWake.wait_for(lock, m_heartbeatInterval);
+
+		if (!m_isRunning)
+			break;
+
+		for (auto subscriber = m_subscribers.begin(); subscriber != m_subscribers.end();)
+		{
+			if (subscriber->second.ping())
+			{
+				++subscriber;
+				continue;
+			}
+
+			subscriber = m_subscribers.erase(subscriber);
+			m_dropped++;
+		}
+	}
+}
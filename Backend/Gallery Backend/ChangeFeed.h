@@ -0,0 +1,125 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+// a committed change of the gallery, the fields that do not apply to its type are left empty
+struct ChangeEvent
+{
+	enum class Type { ALBUM_CREATED, ALBUM_DELETED, PICTURE_ADDED, PICTURE_REMOVED, USER_TAGGED, USER_UNTAGGED, USER_CREATED, USER_DELETED, CLEARED };
+
+	Type type;
+	std::string albumName;
+	int ownerId{ -1 };			// owner of the album
+	int pictureId{ -1 };
+	std::string pictureName;
+	int userId{ -1 };			// the created, deleted, tagged or untagged user
+	std::string userName;
+	uint64_t sequence{ 0 };		// its position in the change log, set once its transaction commits
+
+	static const char* typeName(Type type);
+
+	// the change as a change log entry - the entity it changed ("user", "album", "picture", "tag" or
+	// "gallery"), the id of that entity and what was done to it ("create", "delete" or "clear")
+	static const char* entityName(Type type);
+	static const char* operationName(Type type);
+	std::string entityId() const;
+};
+
+// the changes a subscriber is interested in - all of them, those of an album, or those of a user
+struct ChangeFilter
+{
+	std::optional<int> userId;			// albums owned by the user, and the tags and deletion of the user
+	std::optional<std::string> albumName;
+
+	bool matches(const ChangeEvent& event) const;
+};
+
+// a recorded change, its payload is the change as the feed sends it (JSON)
+struct ChangeLogEntry
+{
+	uint64_t sequence;
+	std::string entity;
+	std::string entityId;
+	std::string operation;
+	std::string payload;
+};
+
+// the changes recorded after a sequence number, at most a page of them.
+// If some of them were dropped by the retention of the log the delta can not be built, the client
+// must load everything again and continue from sequence
+struct ChangeLogDelta
+{
+	bool isResyncRequired{ false };
+	uint64_t sequence{ 0 };			// where the next delta starts
+	bool hasMore{ false };			// more changes follow this page
+	std::vector<ChangeLogEntry> changes;
+};
+
+
+/*
+ * Fans the changes DatabaseAccess commits out to subscribers, each through its own filter.
+ * A subscriber is handed the events it is interested in as they are published, in the order of the
+ * change log, and must not block. It returns false to be unsubscribed, which is how a subscriber that
+ * can not keep up leaves the feed. The number of subscribers is bounded.
+ * The heartbeat thread pings every subscriber once an interval, a subscriber whose ping fails is
+ * unsubscribed the same way - so a client that went away is dropped even while nothing is published.
+ */
+class ChangeFeed
+{
+public:
+	using Deliver = std::function<bool(const ChangeEvent& event)>;
+	using Ping = std::function<bool()>;
+
+	struct Stats
+	{
+		size_t subscribers;
+		uint64_t published;
+		uint64_t dropped;		// subscribers that could not keep up, or whose ping failed
+	};
+
+	ChangeFeed(size_t maxSubscribers, std::chrono::seconds heartbeatInterval);
+	~ChangeFeed();
+
+	ChangeFeed(const ChangeFeed&) = delete;
+	ChangeFeed& operator=(const ChangeFeed&) = delete;
+
+	// the id of the subscription, nothing if the feed is full
+	std::optional<uint64_t> subscribe(ChangeFilter filter, Deliver deliver, Ping ping);
+	void unsubscribe(uint64_t subscriptionId);
+
+	void publish(const ChangeEvent& event);
+
+	Stats getStats() const;
+
+private:
+	struct Subscriber
+	{
+		ChangeFilter filter;
+		Deliver deliver;
+		Ping ping;
+	};
+
+	size_t m_maxSubscribers;
+	std::chrono::seconds m_heartbeatInterval;
+	mutable std::mutex m_mutex;		// held while delivering too, so every subscriber sees one order
+	std::unordered_map<uint64_t, Subscriber> m_subscribers;
+	uint64_t m_nextSubscriptionId{ 1 };
+	uint64_t m_published{ 0 };
+	uint64_t m_dropped{ 0 };
+
+	std::condition_variable m_heartbeatWake;	// notified on stop
+	bool m_isRunning{ true };					// guarded by m_mutex
+	std::thread m_heartbeatThread;
+
+	void heartbeatLoop();
+};
@@ -0,0 +1,145 @@
+#include "CoTagMatrix.h"
+
+#include <algorithm>
+
+
+CoTagMatrix::CoTagMatrix(size_t maxPairs) :
+	m_maxPairs(maxPairs)
+{
+	// Left empty
+}
+
+void CoTagMatrix::increment(int firstUserId, int secondUserId)
+{
+	if (firstUserId == secondUserId)
+		return;
+
+	uint32_t& count = m_rows[firstUserId][secondUserId];
+	if (count++ == 0)
+		m_pairsCount++;
+
+	m_rows[secondUserId][firstUserId] = count;
+
+	if (m_maxPairs != 0 && m_pairsCount > m_maxPairs)
+		prune();
+}
+
+void CoTagMatrix::decrement(int firstUserId, int secondUserId)
+{
+	const auto row = m_rows.find(firstUserId);
+	if (row == m_rows.end())
+		return;
+
+	// the pair may have been pruned
+	const auto cell = row->second.find(secondUserId);
+	if (cell == row->second.end())
+		return;
+
+	if (--cell->second == 0)
+		erasePair(firstUserId, secondUserId);
+	else
+		m_rows[secondUserId][firstUserId] = cell->second;
+}
+
+void CoTagMatrix::removeUser(int userId)
+{
+	const auto row = m_rows.find(userId);
+	if (row == m_rows.end())
+		return;
+
+	for (const auto& [partnerId, count] : row->second)
+	{
+		const auto partnerRow = m_rows.find(partnerId);
+		partnerRow->second.erase(userId);
+
+		if (partnerRow->second.empty())
+			m_rows.erase(partnerRow);
+	}
+
+	m_pairsCount -= row->second.size();
+	m_rows.erase(userId);
+}
+
+void CoTagMatrix::clear()
+{
+	m_rows.clear();
+	m_pairsCount = 0;
+}
+
+uint32_t CoTagMatrix::getCount(int firstUserId, int secondUserId) const
+{
+	const auto row = m_rows.find(firstUserId);
+	if (row == m_rows.end())
+		return 0;
+
+	const auto cell = row->second.find(secondUserId);
+	return cell != row->second.end() ? cell->second : 0;
+}
+
+// the partners with the highest counts, ties broken by the lower user id
+std::vector<std::pair<int, uint32_t>> CoTagMatrix::getTopPartners(int userId, size_t count) const
+{
+	std::vector<std::pair<int, uint32_t>> partners;
+
+	const auto row = m_rows.find(userId);
+	if (row == m_rows.end())
+		return partners;
+
+	partners.assign(row->second.begin(), row->second.end());
+
+	const auto isStronger = [](const auto& a, const auto& b) { return a.second != b.second ? a.second > b.second : a.first < b.first; };
+	const size_t topCount = std::min(count, partners.size());
+
+	std::partial_sort(partners.begin(), partners.begin() + static_cast<std::ptrdiff_t>(topCount), partners.end(), isStronger);
+	partners.resize(topCount);
+
+	return partners;
+}
+
+size_t CoTagMatrix::getPairsCount() const
+{
+	return m_pairsCount;
+}
+
+
+// helper functions //
+void CoTagMatrix::erasePair(int firstUserId, int secondUserId)
+{
+	for (const auto& [userId, partnerId] : { std::make_pair(firstUserId, secondUserId), std::make_pair(secondUserId, firstUserId) })
+	{
+		const auto row = m_rows.find(userId);
+		if (row == m_rows.end())
+			continue;
+
+		row->second.erase(partnerId);
+		if (row->second.empty())
+			m_rows.erase(row);
+	}
+
+	m_pairsCount--;
+}
+
+// drops the weakest pairs until the matrix is back to three quarters of its limit,
+// so pruning does not run again on every new pair
+void CoTagMatrix::prune()
+{
+	const size_t targetPairs = m_maxPairs - m_maxPairs / 4;
+
+	std::vector<std::pair<uint32_t, std::pair<int, int>>> pairs;
+	pairs.reserve(m_pairsCount);
+
+	for (const auto& [userId, row] : m_rows)
+	{
+		for (const auto& [partnerId, count] : row)
+		{
+			if (userId < partnerId)
+				pairs.push_back({ count, { userId, partnerId } });
+		}
+	}
+
+	const size_t removeCount = pairs.size() - std::min(targetPairs, pairs.size());
+	std::nth_element(pairs.begin(), pairs.begin() + static_cast<std::ptrdiff_t>(removeCount), pairs.end());
+
+	for (size_t i = 0; i < removeCount; i++)
+		erasePair(pairs[i].second.first, pairs[i].second.second);
+}
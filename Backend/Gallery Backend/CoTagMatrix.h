@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+/*
+ * Sparse symmetric user x user matrix counting the pictures two users are tagged in together.
+ * Only pairs that were ever tagged together take memory, each pair is stored in the rows of both users
+ * so the partners of a user are a single row lookup.
+ * With a pairs limit the matrix runs in bounded memory mode: once it holds more pairs than the limit,
+ * the pairs with the lowest counts are dropped, so the counts of pairs formed again later are lower bounds.
+ * Not thread safe, the owner (TagIndex) guards it.
+ */
+class CoTagMatrix
+{
+public:
+	explicit CoTagMatrix(size_t maxPairs = 0);	// 0 keeps every pair
+
+	void increment(int firstUserId, int secondUserId);
+	void decrement(int firstUserId, int secondUserId);
+	void removeUser(int userId);
+	void clear();
+
+	uint32_t getCount(int firstUserId, int secondUserId) const;
+	std::vector<std::pair<int, uint32_t>> getTopPartners(int userId, size_t count) const;
+	size_t getPairsCount() const;
+
+	// calls visit(partnerId, count) for every user tagged together with the user, in no particular order
+	template <typename Visitor>
+	void forEachPartner(int userId, Visitor visit) const
+	{
+		const auto row = m_rows.find(userId);
+		if (row == m_rows.end())
+			return;
+
+		for (const auto& [partnerId, count] : row->second)
+			visit(partnerId, count);
+	}
+
+private:
+	size_t m_maxPairs;
+	size_t m_pairsCount{ 0 };
+	std::unordered_map<int, std::unordered_map<int, uint32_t>> m_rows;
+
+	void erasePair(int firstUserId, int secondUserId);
+	void prune();
+};
@@ -0,0 +1,48 @@
+#include "ConsoleLogSink.h"
+#include <iostream>
+
+#include "Colors.h"
+
+
+ConsoleLogSink::ConsoleLogSink(bool isColored) :
+	m_isColored(isColored)
+{
+	// Left empty
+}
+
+void ConsoleLogSink::write(const LogRecord& record)
+{
+	const auto color = [this](const char* code) { return m_isColored ? code : ""; };
+
+	const char* levelColor = GREEN;
+	if (record.level == LogLevel::WARNING)
+		levelColor = YELLOW;
+	else if (record.level == LogLevel::FAILURE)
+		levelColor = RED;
+
+	m_line.clear();
+	m_line += color(MAGENTA);
+	m_line += record.route;
+	m_line += ':';
+	m_line += color(levelColor);
+	m_line += ' ';
+	m_line += record.message;
+
+	for (const LogField& field : record.fields)
+	{
+		m_line += ' ';
+		m_line += field.key;
+		m_line += '=';
+		m_line += field.value;
+	}
+
+	m_line += color(RESET);
+	m_line += '\n';
+
+	(record.level == LogLevel::FAILURE ? std::cerr : std::cout) << m_line;
+}
+
+void ConsoleLogSink::flush()
+{
+	std::cout.flush();
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "Logger.h"
+
+
+/*
+ * Writes the records to the console as the server always did, "route: message", followed by the fields
+ * as key=value. Failures go to std::cerr. The colors are optional, for consoles that show them and not
+ * for output that is redirected to a file.
+ */
+class ConsoleLogSink : public LogSink
+{
+public:
+	explicit ConsoleLogSink(bool isColored);
+
+	void write(const LogRecord& record) override;
+	void flush() override;
+
+private:
+	bool m_isColored;
+	std::string m_line;		// reused, the line is written with a single call
+};
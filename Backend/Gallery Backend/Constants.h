@@ -1,6 +1,97 @@
-#pragma once
+﻿#pragma once
 #include <cpprest/http_msg.h>
 
+// the directory database holds the users and the location of every album,
+// the albums, pictures and tags themselves are partitioned between the shards by owner id
 constexpr const char* DB_NAME = "galleryDB.sqlite";
+constexpr const char* SHARD_DB_PREFIX = "galleryDB.shard";
+constexpr int SHARDS_COUNT = 4;
+
+// the change log has a database of its own, a transaction only locks it to number its changes as it commits
+constexpr const char* CHANGE_LOG_DB_NAME = "galleryDB.changes.sqlite";
+
+// a shard numbers its own pictures - a picture id holds the shard index plus one above these bits, and
+// the count of pictures the shard added below them. Smaller ids were given before the shards numbered them
+constexpr int SHARD_PICTURE_ID_BITS = 26;
 
 constexpr const char* BASE_URI = "http://localhost:8080";
+
+// size of the block every request arena starts with, bigger requests take more blocks from the heap
+constexpr size_t REQUEST_ARENA_INITIAL_SIZE = 16 * 1024;
+
+// bounded memory mode of the tag co-occurrence matrix - once it holds more user pairs than this,
+// the pairs tagged together the least are dropped. 0 keeps every pair
+constexpr size_t CO_TAG_MAX_PAIRS = 0;
+
+// listings are streamed to the client in chunks of this size. The writer waits while this many
+// bytes are still unread by the client, so a listing takes a few chunks of memory whatever its length
+constexpr size_t RESPONSE_CHUNK_SIZE = 16 * 1024;
+constexpr size_t RESPONSE_MAX_BUFFERED = 4 * RESPONSE_CHUNK_SIZE;
+constexpr int RESPONSE_WRITE_TIMEOUT_SECONDS = 30;
+
+// responses are compressed when the client accepts it and they reach this size, smaller ones are not
+// worth the CPU. The level goes from 1 (fastest) to 9 (smallest)
+constexpr size_t RESPONSE_COMPRESSION_THRESHOLD = 1024;
+constexpr int RESPONSE_COMPRESSION_LEVEL = 6;
+
+// a read only batch is run again this many times if writes interleave with it, before it is run on a
+// snapshot of the databases that the writes go on beside. A batch runs at most BATCH_MAX_OPERATIONS operations
+constexpr int READ_TRANSACTION_ATTEMPTS = 3;
+constexpr size_t BATCH_MAX_OPERATIONS = 100;
+
+// a multi-get looks up at most this many items, so a single request can not build an unbounded query
+constexpr size_t MULTI_GET_MAX_KEYS = 1000;
+
+// admission control - at most this many requests of a route class run at once, and at most this many
+// more wait for a slot, for up to ADMISSION_MAX_WAIT_MILLISECONDS. Anything beyond that is answered
+// with 503 right away, telling the client to retry after ADMISSION_RETRY_AFTER_SECONDS
+constexpr size_t ADMISSION_READ_MAX_RUNNING = 32;
+constexpr size_t ADMISSION_READ_MAX_QUEUED = 256;
+constexpr size_t ADMISSION_LISTING_MAX_RUNNING = 4;
+constexpr size_t ADMISSION_LISTING_MAX_QUEUED = 32;
+constexpr size_t ADMISSION_WRITE_MAX_RUNNING = 8;
+constexpr size_t ADMISSION_WRITE_MAX_QUEUED = 64;
+constexpr size_t ADMISSION_ADMIN_MAX_RUNNING = 2;
+constexpr size_t ADMISSION_ADMIN_MAX_QUEUED = 8;
+constexpr int ADMISSION_MAX_WAIT_MILLISECONDS = 2000;
+constexpr int ADMISSION_RETRY_AFTER_SECONDS = 1;
+
+// documents of the read endpoints are cached up to this many bytes in total, the least recently used
+// are evicted first. A document bigger than RESPONSE_CACHE_MAX_DOCUMENT_SIZE is sent but not cached
+constexpr size_t RESPONSE_CACHE_MAX_BYTES = 32 * 1024 * 1024;
+constexpr size_t RESPONSE_CACHE_MAX_DOCUMENT_SIZE = 1024 * 1024;
+
+// a request waits this long for an identical request in flight to build the document they share,
+// before it builds the document on its own
+constexpr int SINGLE_FLIGHT_TIMEOUT_MILLISECONDS = 3000;
+
+// clients subscribed to the change feed at once. A subscriber is dropped once this many bytes of
+// events wait for it, a client that does not keep up must resubscribe and reload what it shows
+constexpr size_t CHANGE_FEED_MAX_SUBSCRIBERS = 256;
+constexpr size_t CHANGE_FEED_MAX_BUFFERED = 64 * 1024;
+
+// every subscriber is sent a comment this often, so the connection of a client that went away without
+// closing it fails and its subscription is dropped, even while nothing changes
+constexpr int CHANGE_FEED_HEARTBEAT_SECONDS = 15;
+
+// the change log keeps the last CHANGE_LOG_RETENTION changes, a client that synced before them must
+// resync. It is compacted every CHANGE_LOG_COMPACTION_INTERVAL changes, a delta holds at most
+// CHANGE_LOG_PAGE_SIZE of them
+constexpr size_t CHANGE_LOG_RETENTION = 100000;
+constexpr size_t CHANGE_LOG_COMPACTION_INTERVAL = 1024;
+constexpr size_t CHANGE_LOG_PAGE_SIZE = 1000;
+
+// the log records wait in a ring of LOG_RING_CAPACITY records for the flush thread, which drains it
+// every LOG_FLUSH_INTERVAL_MILLISECONDS, to the console and to LOG_FILE_NAME as JSON lines.
+// One in LOG_READ_SAMPLING requests of every read route is logged, warnings and failures always are
+constexpr size_t LOG_RING_CAPACITY = 16 * 1024;
+constexpr int LOG_FLUSH_INTERVAL_MILLISECONDS = 20;
+constexpr const char* LOG_FILE_NAME = "galleryLog.jsonl";
+constexpr bool LOG_CONSOLE_COLORS = true;
+constexpr uint32_t LOG_READ_SAMPLING = 10;
+
+// latencies are recorded in microseconds, in histograms of 2^METRICS_SUB_BUCKET_BITS buckets per power of
+// two - a quantile is off by at most one bucket, 12.5%. Latencies from 2^METRICS_MAX_EXPONENT microseconds
+// (about 9 minutes) on are counted in the last bucket
+constexpr int METRICS_SUB_BUCKET_BITS = 3;
+constexpr int METRICS_MAX_EXPONENT = 29;
@@ -0,0 +1,130 @@
+#include "DataVersions.h"
+
+#include <algorithm>
+#include <mutex>
+
+
+// key functions //
+std::string DataVersions::albumKey(const std::string& albumName)
+{
+	return "album:" + albumName;
+}
+
+std::string DataVersions::userKey(int userId)
+{
+	return "user:" + std::to_string(userId);
+}
+
+std::string DataVersions::pictureKey(int pictureId)
+{
+	return "picture:" + std::to_string(pictureId);
+}
+
+
+// maintenance functions //
+void DataVersions::setListener(Listener listener)
+{
+	m_listener = std::move(listener);
+}
+
+void DataVersions::bump(std::initializer_list<Table> tables)
+{
+	const uint64_t version = ++m_clock;
+
+	for (const Table table : tables)
+		m_tables[static_cast<size_t>(table)] = version;
+}
+
+void DataVersions::bumpAlbum(const std::string& albumName)
+{
+	{
+		std::unique_lock lock(m_mutex);
+		m_albums[albumName] = ++m_clock;
+	}
+
+	notify(albumKey(albumName));
+}
+
+void DataVersions::bumpUser(int userId)
+{
+	{
+		std::unique_lock lock(m_mutex);
+		m_users[userId] = ++m_clock;
+	}
+
+	notify(userKey(userId));
+}
+
+void DataVersions::bumpPicture(int pictureId)
+{
+	{
+		std::unique_lock lock(m_mutex);
+		m_pictures[pictureId] = ++m_clock;
+	}
+
+	notify(pictureKey(pictureId));
+}
+
+void DataVersions::bumpAll()
+{
+	{
+		std::unique_lock lock(m_mutex);
+
+		const uint64_t version = ++m_clock;
+
+		for (auto& table : m_tables)
+			table = version;
+
+		m_albums.clear();
+		m_users.clear();
+		m_pictures.clear();
+		m_clearedAt = version;
+	}
+
+	notify({});
+}
+
+
+// query functions //
+uint64_t DataVersions::get(std::initializer_list<Table> tables) const
+{
+	uint64_t version = 0;
+
+	for (const Table table : tables)
+		version = std::max(version, m_tables[static_cast<size_t>(table)].load());
+
+	return version;
+}
+
+uint64_t DataVersions::getAlbum(const std::string& albumName) const
+{
+	std::shared_lock lock(m_mutex);
+
+	const auto album = m_albums.find(albumName);
+	return album != m_albums.end() ? album->second : m_clearedAt;
+}
+
+uint64_t DataVersions::getUser(int userId) const
+{
+	std::shared_lock lock(m_mutex);
+
+	const auto user = m_users.find(userId);
+	return user != m_users.end() ? user->second : m_clearedAt;
+}
+
+uint64_t DataVersions::getPicture(int pictureId) const
+{
+	std::shared_lock lock(m_mutex);
+
+	const auto picture = m_pictures.find(pictureId);
+	return picture != m_pictures.end() ? picture->second : m_clearedAt;
+}
+
+
+// helper functions //
+// the listener is told once the new version is visible, outside the lock
+void DataVersions::notify(const std::string& key) const
+{
+	if (m_listener)
+		m_listener(key);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+
+/*
+ * Versions of the data in the gallery, bumped by DatabaseAccess after every successful write.
+ * All the versions come from a single clock, so a version is never reused and the version of a reply
+ * that depends on several tables is simply the newest of them.
+ * Besides the tables, every album (by name), user (by id) and picture (by id) has its own version, bumped
+ * by the writes that change what the album or the user's listings and statistics show, or the tags of
+ * the picture. A listener is told the key of every album, user and picture bumped.
+ * The versions live in memory only, the ETags built from them carry the start time of the process.
+ */
+class DataVersions
+{
+public:
+	enum class Table { USERS, ALBUMS, PICTURES, TAGS, COUNT };
+
+	// called after every bump with the key of the album, user or picture, and with an empty key after bumpAll
+	using Listener = std::function<void(const std::string& key)>;
+
+	// keys of the albums, users and pictures, distinct from each other
+	static std::string albumKey(const std::string& albumName);
+	static std::string userKey(int userId);
+	static std::string pictureKey(int pictureId);
+
+	// maintenance functions //
+	void setListener(Listener listener);	// before any bump, the listener is not guarded
+	void bump(std::initializer_list<Table> tables);
+	void bumpAlbum(const std::string& albumName);
+	void bumpUser(int userId);
+	void bumpPicture(int pictureId);
+	void bumpAll();		// after the database was cleared, ids and names may be reused from now on
+
+	// query functions //
+	uint64_t get(std::initializer_list<Table> tables) const;	// the newest version of the tables
+	uint64_t getAlbum(const std::string& albumName) const;
+	uint64_t getUser(int userId) const;
+	uint64_t getPicture(int pictureId) const;
+
+private:
+	std::atomic<uint64_t> m_clock{ 0 };
+	std::array<std::atomic<uint64_t>, static_cast<size_t>(Table::COUNT)> m_tables{};
+
+	mutable std::shared_mutex m_mutex;	// guards the maps below
+	std::unordered_map<std::string, uint64_t> m_albums;
+	std::unordered_map<int, uint64_t> m_users;
+	std::unordered_map<int, uint64_t> m_pictures;
+	uint64_t m_clearedAt{ 0 };			// the version of everything not written since the last clear
+	Listener m_listener;
+
+	void notify(const std::string& key) const;
+};
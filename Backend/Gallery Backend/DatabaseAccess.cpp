@@ -1,17 +1,106 @@
 #include "DatabaseAccess.h"
-#include <io.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 
 #include "CallbackFuncs.h"
 #include "Colors.h"
 #include "Constants.h"
 #include "ItemAlreadyExistsException.h"
 #include "ItemNotFoundException.h"
+#include "JsonHelper.h"
+#include "JsonStreamWriter.h"
+#include "Logger.h"
+#include "Metrics.h"
 #include "MyException.h"
 #include "SqlException.h"
 
 
-DatabaseAccess::DatabaseAccess()
+// the databases of the transaction the thread runs, locked exclusively by it - empty while it runs none
+static thread_local std::vector<sqlite3*> transactionDatabases;
+
+// the databases the transaction the thread runs only reads, locked shared by it
+static thread_local std::vector<sqlite3*> transactionReadDatabases;
+
+// a change of the transaction the thread runs, with the payload it is logged with
+struct PendingChange
+{
+	ChangeEvent change;
+	std::string payload;
+};
+
+// the changes of the transaction the thread runs, numbered and published once it commits
+static thread_local std::vector<PendingChange> transactionChanges;
+
+// the read only connection each database is read from while the thread runs reads on a snapshot
+static thread_local std::unordered_map<sqlite3*, sqlite3*> snapshotConnections;
+
+// the callback of a statement, and the data it is called with
+struct RowCounter
+{
+	void* data;
+	int(*callback)(void*, int, char**, char**);
+};
+
+static int countRow(void* counter, int argc, char** argv, char** azColName)
+{
+	const auto* rowCounter = static_cast<RowCounter*>(counter);
+
+	RequestWork::current().rowsRead++;
+	return rowCounter->callback(rowCounter->data, argc, argv, azColName);
+}
+
+// text quoted as an SQL string
+static std::string toSQLString(const std::string& text)
+{
+	std::string quoted = "'";
+	for (const char character : text)
+		quoted += character == '\'' ? std::string("''") : std::string(1, character);
+
+	return quoted + '\'';
+}
+
+static bool isInTransaction()
+{
+	return !transactionDatabases.empty();
+}
+
+static bool isHeldByTransaction(sqlite3* database)
+{
+	return std::find(transactionDatabases.begin(), transactionDatabases.end(), database) != transactionDatabases.end();
+}
+
+static bool isReadByTransaction(sqlite3* database)
+{
+	return std::find(transactionReadDatabases.begin(), transactionReadDatabases.end(), database) != transactionReadDatabases.end();
+}
+
+// the keys of a multi-get as the list of an IN clause, names are quoted as SQL strings
+static std::string toSQLList(const std::vector<int>& ids)
+{
+	std::string list;
+	for (const int id : ids)
+		list += (list.empty() ? "" : ", ") + std::to_string(id);
+
+	return list;
+}
+
+static std::string toSQLList(const std::vector<std::string>& names)
+{
+	std::string list;
+	for (const std::string& name : names)
+		list += (list.empty() ? "" : ", ") + toSQLString(name);
+
+	return list;
+}
+
+
+DatabaseAccess::DatabaseAccess() :
+	tagIndex(CO_TAG_MAX_PAIRS),
+	changeFeed(CHANGE_FEED_MAX_SUBSCRIBERS, std::chrono::seconds(CHANGE_FEED_HEARTBEAT_SECONDS))
 {
+	versions.setListener([this](const std::string& key) { responseCache.invalidate(key); });
 	open();
 }
 
@@ -21,77 +110,133 @@ DatabaseAccess::~DatabaseAccess()
 }
 
 // album related functions //
-std::list<Album> DatabaseAccess::getAlbums() const
+std::pmr::list<Album> DatabaseAccess::getAlbums(std::pmr::memory_resource* resource) const
 {
 	const std::string getAllAlbumsSQL = "SELECT * FROM ALBUMS;";
-	std::list<Album> albums;
-	
-	runSQL(getAllAlbumsSQL, &albums, getAlbumsCallback);
+	std::pmr::list<Album> albums(resource);
+
+	// every album lives in exactly one shard, so the global list is the union of the shards
+	for (sqlite3* shard : shards)
+		runSQL(shard, getAllAlbumsSQL, &albums, getAlbumsCallback);
+
+	albums.sort([](const Album& a, const Album& b) { return a.getCreationDate() < b.getCreationDate(); });
 
 	for (auto& album : albums)
-		album = openAlbum(album.getName());
+		loadAlbumContent(album);
 
 	return albums;
 }
 
-std::list<Album> DatabaseAccess::getAlbumsOfUser(const User& user) const
+std::pmr::list<Album> DatabaseAccess::getAlbumsOfUser(const User& user, std::pmr::memory_resource* resource) const
 {
 	if (!doesUserExists(user.getId()))
 		throw ItemNotFoundException("User ", user.getId());
 
 	const std::string query = "SELECT * FROM ALBUMS WHERE USER_ID = " + std::to_string(user.getId()) + ";";
-	std::list<Album> albums;
+	std::pmr::list<Album> albums(resource);
 
-	runSQL(query, &albums, getAlbumsCallback);
+	runSQL(shardOfUser(user.getId()), query, &albums, getAlbumsCallback);
 
 	for (auto& album : albums)
-		album = openAlbum(album.getName());
+		loadAlbumContent(album);
 
 	return albums;
 }
 
 void DatabaseAccess::createAlbum(const Album& album) const
 {
-	if (doesAlbumExists(album.getName()))
-		throw ItemAlreadyExistsException("Album", album.getName());
+	const auto databasesOf = [&] { return std::vector<sqlite3*>{ shardOfUser(album.getOwnerId()), db }; };
+
+	runInTransaction(databasesOf, [&]
+	{
+		if (doesAlbumExists(album.getName()))
+			throw ItemAlreadyExistsException("Album", album.getName());
+
+		if (!doesUserExists(album.getOwnerId()))
+			throw ItemNotFoundException("User", album.getOwnerId());
+
+		// allocate a global album id in the directory, the insert and the id lookup run in one sqlite3_exec call
+		const std::string registerAlbumSQL =
+			"INSERT INTO ALBUMS_DIRECTORY(NAME, USER_ID) "
+			"VALUES ('" + album.getName() + "', " + std::to_string(album.getOwnerId()) + "); "
+			"SELECT last_insert_rowid();";
 
-	if (!doesUserExists(album.getOwnerId()))
-		throw ItemNotFoundException("User", album.getOwnerId());
+		int albumID = -1;
+		runSQL(db, registerAlbumSQL, &albumID, getIDCallback);
 
-	const std::string createAlbumSQL =
-		"INSERT INTO ALBUMS(NAME, USER_ID, CREATION_DATE) "
-		"VALUES ('" + album.getName() + "', '" + std::to_string(album.getOwnerId()) + "', '" + album.getCreationDate() + "');";
+		const std::string createAlbumSQL =
+			"INSERT INTO ALBUMS(ID, NAME, USER_ID, CREATION_DATE) "
+			"VALUES (" + std::to_string(albumID) + ", '" + album.getName() + "', " + std::to_string(album.getOwnerId()) + ", '" + album.getCreationDate() + "');";
 
-	runSQL(createAlbumSQL);
+		try {
+			runSQL(shardOfUser(album.getOwnerId()), createAlbumSQL);
+		}
+		catch (const SqlException&) {
+			runSQL(db, "DELETE FROM ALBUMS_DIRECTORY WHERE ID = " + std::to_string(albumID) + ";");
+			throw;
+		}
+
+		versions.bump({ DataVersions::Table::ALBUMS });
+		versions.bumpAlbum(album.getName());
+		versions.bumpUser(album.getOwnerId());
+
+		recordChange({ ChangeEvent::Type::ALBUM_CREATED, album.getName(), album.getOwnerId() });
+	});
 }
 
 void DatabaseAccess::deleteAlbum(const std::string& albumName, int userId) const
 {
-	if (!doesAlbumExists(albumName, userId))
-		throw ItemNotFoundException("Album", albumName);
+	const auto databasesOf = [&] { return std::vector<sqlite3*>{ shardOfUser(userId), db }; };
 
-	const int albumID = getAlbumID(albumName);
+	runInTransaction(databasesOf, [&]
+	{
+		if (!doesAlbumExists(albumName, userId))
+			throw ItemNotFoundException("Album", albumName);
+
+		const int albumID = getAlbumID(albumName);
+		sqlite3* shard = shardOfUser(userId);
+
+		const RoaringBitmap pictures = tagIndex.evaluate({ TagQuery::Type::ALBUM, albumID });
+		const RoaringBitmap taggedUsers = getUsersTaggedIn(pictures);
+
+		const std::string deleteAlbumTagsSql = "DELETE FROM TAGS WHERE PICTURE_ID IN (SELECT ID FROM PICTURES WHERE ALBUM_ID = " + std::to_string(albumID) + ");";
+		runSQL(shard, deleteAlbumTagsSql);
 
-	const std::string deleteAlbumTagsSql = "DELETE FROM TAGS WHERE PICTURE_ID IN (SELECT ID FROM PICTURES WHERE ALBUM_ID = " + std::to_string(albumID) + ");";
-	runSQL(deleteAlbumTagsSql);
+		const std::string deleteAlbumPicturesSql = "DELETE FROM PICTURES WHERE ALBUM_ID = " + std::to_string(albumID) + ";";
+		runSQL(shard, deleteAlbumPicturesSql);
 
-	const std::string deleteAlbumPicturesSql = "DELETE FROM PICTURES WHERE ALBUM_ID = " + std::to_string(albumID) + ";";
-	runSQL(deleteAlbumPicturesSql);
+		const std::string deleteAlbumSql = "DELETE FROM ALBUMS WHERE NAME = '" + albumName + "' AND USER_ID = " + std::to_string(userId) + ";";
+		runSQL(shard, deleteAlbumSql);
 
-	const std::string deleteAlbumSql = "DELETE FROM ALBUMS WHERE NAME = '" + albumName + "' AND USER_ID = " + std::to_string(userId) + ";";
-	runSQL(deleteAlbumSql);
+		// remove the album from the directory
+		const std::string unregisterAlbumSql = "DELETE FROM ALBUMS_DIRECTORY WHERE ID = " + std::to_string(albumID) + ";";
+		runSQL(db, unregisterAlbumSql);
 
-	const  std::string vacuumSql = "VACUUM;";
-	runSQL(vacuumSql);
+		tagIndex.removeAlbum(albumID);
+
+		versions.bump({ DataVersions::Table::ALBUMS, DataVersions::Table::PICTURES, DataVersions::Table::TAGS });
+		versions.bumpAlbum(albumName);
+		versions.bumpUser(userId);
+		bumpTags(pictures, taggedUsers);
+
+		recordChange({ ChangeEvent::Type::ALBUM_DELETED, albumName, userId });
+	});
+
+	// sqlite can not vacuum inside a transaction, a batch leaves the space to the next vacuum
+	if (!isInTransaction())
+	{
+		const std::string vacuumSql = "VACUUM;";
+		runSQL(shardOfUser(userId), vacuumSql);
+	}
 }
 
 bool DatabaseAccess::doesAlbumExists(const std::string& albumName, int userId) const
 {
-	const std::string sqlStatement = "SELECT 1 FROM ALBUMS WHERE NAME = '" + albumName + "' AND USER_ID = " + std::to_string(userId) + " LIMIT 1;";
+	const std::string sqlStatement = "SELECT 1 FROM ALBUMS_DIRECTORY WHERE NAME = '" + albumName + "' AND USER_ID = " + std::to_string(userId) + " LIMIT 1;";
 	bool doesAlbumExist = false;
 
 	// run the sql and pass the albumExistsCallback as the callback, which will set the doesAlbumExist flag to true.
-	runSQL(sqlStatement, &doesAlbumExist, existenceCallback);
+	runSQL(db, sqlStatement, &doesAlbumExist, existenceCallback);
 
 	return doesAlbumExist;
 }
@@ -109,20 +254,7 @@ Album DatabaseAccess::openAlbum(const std::string& albumName) const
 		return { -1, "" };
 	}
 
-	const User owner = getUser(album.getOwnerId());
-	album.setOwnerName(owner.getName());
-
-	std::list<Picture> pictures = getAlbumPictures(album);
-
-	for (Picture& picture : pictures)
-	{
-		std::set<User> users_tagged = getPictureTags(album.getName(), picture);
-
-		for (const auto& user : users_tagged)
-			picture.tagUser(user);
-
-		album.addPicture(picture);
-	}
+	loadAlbumContent(album);
 
 	return album;
 
@@ -131,7 +263,7 @@ Album DatabaseAccess::openAlbum(const std::string& albumName) const
 
 void DatabaseAccess::printAlbums() const
 {
-	const std::list<Album> albums = getAlbums();
+	const auto albums = getAlbums();
 
 	if (albums.empty())
 		throw MyException("There are no existing albums.");
@@ -148,69 +280,127 @@ void DatabaseAccess::printAlbums() const
 // picture related functions //
 void DatabaseAccess::addPictureToAlbumByName(const std::string& albumName, const Picture& picture) const
 {
-	const int albumID = getAlbumID(albumName);
+	runInTransaction([&] { return databasesOfAlbum(albumName); }, [&]
+	{
+		const int albumID = getAlbumID(albumName);
+
+		if (doesPictureExistsInAlbum(albumName, picture.getName()))
+			throw ItemAlreadyExistsException("Picture", picture.getName());
+
+		const int ownerID = getAlbumOwnerID(albumName);
+		const int pictureID = allocatePictureId(ownerID);
+
+		const std::string addPictureToAlbumSQL =
+			"INSERT INTO PICTURES (ID, NAME, LOCATION, CREATION_DATE, ALBUM_ID) "
+			"VALUES (" + std::to_string(pictureID) + ", '" + picture.getName() + "', '" + picture.getPath() +
+			"', '" + picture.getCreationDate() + "'," + std::to_string(albumID) + ");";
+
+		runSQL(shardOfUser(ownerID), addPictureToAlbumSQL);
 
-	if (doesPictureExistsInAlbum(albumName, picture.getName()))
-		throw ItemAlreadyExistsException("Picture", picture.getName());
+		tagIndex.addPicture(pictureID, albumID, ownerID);
 
-	const std::string addPictureToAlbumSQL =
-		"INSERT INTO PICTURES (NAME, LOCATION, CREATION_DATE, ALBUM_ID) "
-		"VALUES ('" + picture.getName() + "', '" + picture.getPath() +
-		"', '" + picture.getCreationDate() + "'," + std::to_string(albumID) + ");";
+		versions.bump({ DataVersions::Table::PICTURES });
+		versions.bumpAlbum(albumName);
+		versions.bumpUser(ownerID);
 
-	runSQL(addPictureToAlbumSQL);
+		recordChange({ ChangeEvent::Type::PICTURE_ADDED, albumName, ownerID, pictureID, picture.getName() });
+	});
 }
 
 void DatabaseAccess::removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) const
 {
-	const int albumID = getAlbumID(albumName);
+	runInTransaction([&] { return databasesOfAlbum(albumName); }, [&]
+	{
+		if (!doesPictureExistsInAlbum(albumName, pictureName))
+			throw ItemNotFoundException("Picture", pictureName);
 
-	if (!doesPictureExistsInAlbum(albumName, pictureName))
-		throw ItemNotFoundException("Picture", pictureName);
+		const int pictureID = getPictureID(albumName, pictureName);
+		const int ownerID = getAlbumOwnerID(albumName);
+		sqlite3* shard = shardOfUser(ownerID);
+		const RoaringBitmap taggedUsers = tagIndex.getUsersOfPicture(pictureID);
+
+		const std::string removePictureTagsSQL = "DELETE FROM TAGS WHERE PICTURE_ID = " + std::to_string(pictureID) + ";";
+		runSQL(shard, removePictureTagsSQL);
+
+		const std::string removePictureSQL = "DELETE FROM PICTURES WHERE ID = " + std::to_string(pictureID) + ";";
+		runSQL(shard, removePictureSQL);
+
+		tagIndex.removePicture(pictureID);
+
+		versions.bump({ DataVersions::Table::PICTURES, DataVersions::Table::TAGS });
+		versions.bumpAlbum(albumName);
+		versions.bumpUser(ownerID);
+
+		RoaringBitmap picture;
+		picture.add(static_cast<uint32_t>(pictureID));
+		bumpTags(picture, taggedUsers);
 
-	const std::string addPictureToAlbumSQL = "DELETE FROM PICTURES WHERE ALBUM_ID = " + std::to_string(albumID) + " AND NAME = '" + pictureName + "';";
-	runSQL(addPictureToAlbumSQL);
+		recordChange({ ChangeEvent::Type::PICTURE_REMOVED, albumName, ownerID, pictureID, pictureName });
+	});
 }
 
 void DatabaseAccess::tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) const
 {
-	if (!doesAlbumExists(albumName))
-		throw ItemNotFoundException("Album", albumName);
+	runInTransaction([&] { return databasesOfAlbum(albumName); }, [&]
+	{
+		if (!doesAlbumExists(albumName))
+			throw ItemNotFoundException("Album", albumName);
 
-	if (!doesPictureExistsInAlbum(albumName, pictureName))
-		throw ItemNotFoundException("Picture", pictureName);
+		if (!doesPictureExistsInAlbum(albumName, pictureName))
+			throw ItemNotFoundException("Picture", pictureName);
 
-	if (!doesUserExists(userId))
-		throw ItemNotFoundException("User", std::to_string(userId));
+		if (!doesUserExists(userId))
+			throw ItemNotFoundException("User", std::to_string(userId));
 
-	const int pictureID = getPictureID(albumName, pictureName);
+		const int pictureID = getPictureID(albumName, pictureName);
+
+		if (doesUserTaggedPicture(userId, pictureID))
+			throw ItemAlreadyExistsException("User", std::to_string(userId));
+
+		const std::string query = "INSERT INTO TAGS (PICTURE_ID, USER_ID) VALUES (" + std::to_string(pictureID) + ", " + std::to_string(userId) + ");";
+		runSQL(shardOfAlbum(albumName), query);
 
-	if (doesUserTaggedPicture(userId, pictureID))
-		throw ItemAlreadyExistsException("User", std::to_string(userId));
+		tagIndex.tagUser(pictureID, userId);
 
-	const std::string query = "INSERT INTO TAGS (PICTURE_ID, USER_ID) VALUES (" + std::to_string(pictureID) + ", " + std::to_string(userId) + ");";
+		versions.bump({ DataVersions::Table::TAGS });
+		versions.bumpAlbum(albumName);
+		versions.bumpUser(userId);
+		versions.bumpPicture(pictureID);
 
-	runSQL(query);
+		recordChange({ ChangeEvent::Type::USER_TAGGED, albumName, getAlbumOwnerID(albumName), pictureID, pictureName, userId });
+	});
 }
 
 void DatabaseAccess::untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) const
 {
-	if (!doesAlbumExists(albumName))
-		throw ItemNotFoundException("Album", albumName);
+	runInTransaction([&] { return databasesOfAlbum(albumName); }, [&]
+	{
+		if (!doesAlbumExists(albumName))
+			throw ItemNotFoundException("Album", albumName);
 
-	if (!doesPictureExistsInAlbum(albumName, pictureName))
-		throw ItemNotFoundException("Picture", pictureName);
+		if (!doesPictureExistsInAlbum(albumName, pictureName))
+			throw ItemNotFoundException("Picture", pictureName);
 
-	if (!doesUserExists(userId))
-		throw ItemNotFoundException("User", std::to_string(userId));
+		if (!doesUserExists(userId))
+			throw ItemNotFoundException("User", std::to_string(userId));
 
-	const int pictureID = getPictureID(albumName, pictureName);
+		const int pictureID = getPictureID(albumName, pictureName);
+
+		if (!doesUserTaggedPicture(userId, pictureID))
+			throw ItemNotFoundException("Tag", std::to_string(userId));
+
+		const std::string query = "DELETE FROM TAGS WHERE PICTURE_ID = " + std::to_string(pictureID) + " AND USER_ID = " + std::to_string(userId) + ";";
+		runSQL(shardOfAlbum(albumName), query);
 
-	if (!doesUserTaggedPicture(userId, pictureID))
-		throw ItemNotFoundException("Tag", std::to_string(userId));
+		tagIndex.untagUser(pictureID, userId);
 
-	const std::string query = "DELETE FROM TAGS WHERE PICTURE_ID = " + std::to_string(pictureID) + " AND USER_ID = " + std::to_string(userId) + ";";
-	runSQL(query);
+		versions.bump({ DataVersions::Table::TAGS });
+		versions.bumpAlbum(albumName);
+		versions.bumpUser(userId);
+		versions.bumpPicture(pictureID);
+
+		recordChange({ ChangeEvent::Type::USER_UNTAGGED, albumName, getAlbumOwnerID(albumName), pictureID, pictureName, userId });
+	});
 }
 
 int DatabaseAccess::getLastPictureId() const
@@ -218,7 +408,13 @@ int DatabaseAccess::getLastPictureId() const
 	const std::string lastPicIDSql = "SELECT MAX(ID) FROM PICTURES;";
 	int lastPicID = -1;
 
-	runSQL(lastPicIDSql, &lastPicID, getIDCallback);
+	for (sqlite3* shard : shards)
+	{
+		int shardLastPicID = -1;
+		runSQL(shard, lastPicIDSql, &shardLastPicID, getIDCallback);
+
+		lastPicID = std::max(lastPicID, shardLastPicID);
+	}
 
 	if (lastPicID == -1)
 		throw MyException("Failed to get last picture id.");
@@ -230,7 +426,7 @@ int DatabaseAccess::getLastPictureId() const
 // user related functions //
 void DatabaseAccess::printUsers() const
 {
-	const std::list<User> users = getUsers();
+	const auto users = getUsers();
 
 	if (users.empty())
 		throw MyException("There are no existing users.");
@@ -247,7 +443,7 @@ User DatabaseAccess::getUser(int userId) const
 	const std::string getSingleUserSQL = "SELECT * FROM USERS WHERE ID = " + std::to_string(userId) + " LIMIT 1;";
 	User user(-1, "");
 
-	runSQL(getSingleUserSQL, &user, getUserCallback);
+	runSQL(db, getSingleUserSQL, &user, getUserCallback);
 
 	if (user.getId() == -1 || user.getName().empty())
 		throw ItemNotFoundException("User", userId);
@@ -257,31 +453,90 @@ User DatabaseAccess::getUser(int userId) const
 
 void DatabaseAccess::createUser(const User& user) const
 {
-	const std::string query = "INSERT INTO USERS (NAME) VALUES ('" + user.getName() + "');";
-	runSQL(query);
+	runInTransaction([this] { return std::vector<sqlite3*>{ db }; }, [&]
+	{
+		const std::string query =
+			"INSERT INTO USERS (NAME) VALUES ('" + user.getName() + "'); "
+			"SELECT last_insert_rowid();";
+
+		int userID = -1;
+		runSQL(db, query, &userID, getIDCallback);
+
+		versions.bump({ DataVersions::Table::USERS });
+
+		recordChange({ ChangeEvent::Type::USER_CREATED, "", -1, -1, "", userID, user.getName() });
+	});
 }
 
 void DatabaseAccess::deleteUser(const User& user) const
 {
-	if (!doesUserExists(user.getId()))
-		throw ItemNotFoundException("User", user.getId());
+	// the tags of the user may be in any shard, the albums are in the user's own
+	const auto databasesOf = [&]
+	{
+		std::vector<sqlite3*> databases = shardsTaggingUser(user.getId());
+		databases.push_back(shardOfUser(user.getId()));
+		databases.push_back(db);
+
+		return databases;
+	};
+
+	runInTransaction(databasesOf, [&]
+	{
+		if (!doesUserExists(user.getId()))
+			throw ItemNotFoundException("User", user.getId());
+
+		const std::string userID = std::to_string(user.getId());
+
+		// the pictures of the user lose the tags of other users, and the pictures the user is tagged in lose a tag
+		const RoaringBitmap ownedPictures = tagIndex.evaluate({ TagQuery::Type::OWNER, user.getId() });
+		const RoaringBitmap taggedPictures = tagIndex.getPicturesOfUser(user.getId());
+		const RoaringBitmap taggedUsers = getUsersTaggedIn(ownedPictures);
+		const std::vector<PictureLocation> taggedLocations = getPictureLocations(taggedPictures - ownedPictures);
+		const auto albums = getAlbumsOfUser(user);
 
+		// delete all the tags associated with a user, in every shard that holds some
+		const std::string deleteUserTagsSQL = "DELETE FROM TAGS WHERE USER_ID = " + userID + ";";
+		for (sqlite3* shard : shardsTaggingUser(user.getId()))
+			runSQL(shard, deleteUserTagsSQL);
 
-	// delete the user from the users table
-	const std::string deleteUserSQL = "DELETE FROM USERS WHERE ID = " + std::to_string(user.getId()) + ";";
-	runSQL(deleteUserSQL);
+		// the albums of the user, their pictures and the tags on them all live in the user's shard
+		sqlite3* shard = shardOfUser(user.getId());
 
-	// delete all the tags associated with a user
-	const std::string deleteUserTagsSQL = "DELETE FROM TAGS WHERE USER_ID = " + std::to_string(user.getId()) + ";";
-	runSQL(deleteUserTagsSQL);
+		const std::string deletePicturesTagsSQL = "DELETE FROM TAGS WHERE PICTURE_ID IN (SELECT PICTURES.ID FROM PICTURES INNER JOIN ALBUMS ON PICTURES.ALBUM_ID = ALBUMS.ID WHERE ALBUMS.USER_ID = " + userID + ");";
+		runSQL(shard, deletePicturesTagsSQL);
 
-	// delete all the pictures associated with a user albums
-	const std::string  deletePictureSQL = "DELETE FROM PICTURES WHERE ALBUM_ID IN (SELECT ID FROM ALBUMS WHERE USER_ID = " + std::to_string(user.getId()) + ");";
-	runSQL(deletePictureSQL);
+		// delete all the pictures associated with a user albums
+		const std::string  deletePictureSQL = "DELETE FROM PICTURES WHERE ALBUM_ID IN (SELECT ID FROM ALBUMS WHERE USER_ID = " + userID + ");";
+		runSQL(shard, deletePictureSQL);
 
-	// delete all the albums associated with a user
-	const std::string deleteAlbumSQL = "DELETE FROM ALBUMS WHERE USER_ID = " + std::to_string(user.getId()) + ";";
-	runSQL(deleteAlbumSQL);
+		// delete all the albums associated with a user
+		const std::string deleteAlbumSQL = "DELETE FROM ALBUMS WHERE USER_ID = " + userID + ";";
+		runSQL(shard, deleteAlbumSQL);
+
+		// delete the user and its albums from the directory
+		const std::string unregisterUserSQL =
+			"DELETE FROM ALBUMS_DIRECTORY WHERE USER_ID = " + userID + "; "
+			"DELETE FROM USERS WHERE ID = " + userID + ";";
+		runSQL(db, unregisterUserSQL);
+
+		tagIndex.removeUser(user.getId());
+
+		// the albums of the user are gone too, their versions include the version of their owner
+		versions.bump({ DataVersions::Table::USERS, DataVersions::Table::ALBUMS, DataVersions::Table::PICTURES, DataVersions::Table::TAGS });
+		versions.bumpUser(user.getId());
+		bumpTags(ownedPictures | taggedPictures, taggedUsers);
+
+		for (const auto& location : taggedLocations)
+			versions.bumpAlbum(location.albumName);
+
+		for (const auto& location : taggedLocations)
+			recordChange({ ChangeEvent::Type::USER_UNTAGGED, location.albumName, location.ownerId, location.pictureId, "", user.getId() });
+
+		for (const Album& album : albums)
+			recordChange({ ChangeEvent::Type::ALBUM_DELETED, album.getName(), user.getId() });
+
+		recordChange({ ChangeEvent::Type::USER_DELETED, "", -1, -1, "", user.getId() });
+	});
 }
 
 bool DatabaseAccess::doesUserExists(int userId) const
@@ -289,7 +544,7 @@ bool DatabaseAccess::doesUserExists(int userId) const
 	const std::string doesUserExistsSQL = "SELECT 1 FROM USERS WHERE ID = " + std::to_string(userId) + " LIMIT 1;";
 	bool doesUserExists = false;
 
-	runSQL(doesUserExistsSQL, &doesUserExists, existenceCallback);
+	runSQL(db, doesUserExistsSQL, &doesUserExists, existenceCallback);
 
 	return doesUserExists;
 }
@@ -299,7 +554,7 @@ int DatabaseAccess::getLastUserId() const
 	const std::string lastUserIdSQL = "SELECT MAX(ID) FROM USERS;";
 	int lastUserId = -1;
 
-	runSQL(lastUserIdSQL, &lastUserId, getIDCallback);
+	runSQL(db, lastUserIdSQL, &lastUserId, getIDCallback);
 
 	if (lastUserId == -1)
 		throw MyException("Failed to get last user id.");
@@ -317,7 +572,7 @@ int DatabaseAccess::countAlbumsOwnedOfUser(const User& user) const
 	const std::string countAlbumsSQL = "SELECT COUNT(USER_ID) FROM ALBUMS WHERE USER_ID = " + std::to_string(user.getId()) + ";";
 	int countAlbums = -1;
 
-	runSQL(countAlbumsSQL, &countAlbums, countCallback);
+	runSQL(shardOfUser(user.getId()), countAlbumsSQL, &countAlbums, countCallback);
 
 	if (countAlbums == -1)
 		throw MyException("Could not count albums of user " + std::to_string(user.getId()) + "!");
@@ -338,12 +593,19 @@ int DatabaseAccess::countAlbumsTaggedOfUser(const User& user) const
 		"INNER JOIN TAGS ON PICTURES.ID = TAGS.PICTURE_ID "
 		"WHERE TAGS.USER_ID = " + std::to_string(user.getId()) + ";";
 
-	int countAlbums = -1;
+	int countAlbums = 0;
 
-	runSQL(countAlbumsSQL, &countAlbums, countCallback);
+	// an album lives in a single shard, so the per shard counts never overlap
+	for (sqlite3* shard : shardsTaggingUser(user.getId()))
+	{
+		int shardCount = -1;
+		runSQL(shard, countAlbumsSQL, &shardCount, countCallback);
 
-	if (countAlbums == -1)
-		throw MyException("Could not count albums of user " + std::to_string(user.getId()) + "!");
+		if (shardCount == -1)
+			throw MyException("Could not count albums of user " + std::to_string(user.getId()) + "!");
+
+		countAlbums += shardCount;
+	}
 
 	return countAlbums;
 }
@@ -355,13 +617,18 @@ int DatabaseAccess::countTagsOfUser(const User& user) const
 
 
 	const std::string countTagsSQL = "SELECT COUNT(PICTURE_ID) FROM TAGS WHERE USER_ID = " + std::to_string(user.getId()) + ";";
-	int countTags = -1;
+	int countTags = 0;
 
-	runSQL(countTagsSQL, &countTags, countCallback);
+	for (sqlite3* shard : shardsTaggingUser(user.getId()))
+	{
+		int shardCount = -1;
+		runSQL(shard, countTagsSQL, &shardCount, countCallback);
 
-	if (countTags == -1)
-		throw MyException("Could not count tags of user " + std::to_string(user.getId()) + "!");
+		if (shardCount == -1)
+			throw MyException("Could not count tags of user " + std::to_string(user.getId()) + "!");
 
+		countTags += shardCount;
+	}
 
 	return countTags;
 }
@@ -383,37 +650,62 @@ float DatabaseAccess::averageTagsPerAlbumOfUser(const User& user) const
 // tags related statistics functions //
 User DatabaseAccess::getTopTaggedUser() const
 {
-	const std::string getTopUserSQL =
-		"SELECT USERS.ID, USERS.NAME, COUNT(TAGS.USER_ID) AS TagCount FROM USERS "
-		"INNER JOIN TAGS ON USERS.ID = TAGS.USER_ID "
-		"GROUP BY USERS.ID, USERS.NAME "
-		"ORDER BY TagCount DESC "
-		"LIMIT 1;";
+	const std::string countTagsPerUserSQL = "SELECT USER_ID, COUNT(PICTURE_ID) FROM TAGS GROUP BY USER_ID;";
 
-	User user(-1, "");
+	// a user can be tagged in several shards, so the counts are merged before picking the top one
+	std::map<int, int> tagsPerUser;
+	for (sqlite3* shard : shards)
+		runSQL(shard, countTagsPerUserSQL, &tagsPerUser, countPerIDCallback);
 
-	runSQL(getTopUserSQL, &user, getUserCallback);
+	int topUserId = -1;
+	int topTagsCount = 0;
+	for (const auto& [userId, tagsCount] : tagsPerUser)
+	{
+		if (tagsCount > topTagsCount)
+		{
+			topUserId = userId;
+			topTagsCount = tagsCount;
+		}
+	}
 
-	if (user.getId() == -1)
+	if (topUserId == -1)
 		throw MyException("Could not get top tagged user!");
 
-	return user;
+	return getUser(topUserId);
 }
 
 Picture DatabaseAccess::getTopTaggedPicture() const
 {
-	// Construct the SQL query to find the picture that has been tagged the most
+	// the tags of a picture all live in the picture's shard, so each shard only reports its own top picture
 	const std::string query =
-		"SELECT PICTURES.ID, PICTURES.NAME, PICTURES.LOCATION, PICTURES.CREATION_DATE, COUNT(TAGS.PICTURE_ID) AS TagCount "
-		"FROM PICTURES "
-		"INNER JOIN TAGS ON PICTURES.ID = TAGS.PICTURE_ID "
-		"GROUP BY PICTURES.ID, PICTURES.NAME, PICTURES.LOCATION, PICTURES.CREATION_DATE "
+		"SELECT PICTURE_ID, COUNT(USER_ID) AS TagCount "
+		"FROM TAGS "
+		"GROUP BY PICTURE_ID "
 		"ORDER BY TagCount DESC "
 		"LIMIT 1;";
 
+	std::map<int, int> tagsPerPicture;
+	for (sqlite3* shard : shards)
+		runSQL(shard, query, &tagsPerPicture, countPerIDCallback);
+
+	int topPictureId = -1;
+	int topTagsCount = 0;
+	for (const auto& [pictureId, tagsCount] : tagsPerPicture)
+	{
+		if (tagsCount > topTagsCount)
+		{
+			topPictureId = pictureId;
+			topTagsCount = tagsCount;
+		}
+	}
+
+	if (topPictureId == -1)
+		throw MyException("Could not found top tagged picture!");
+
+	const std::string getPictureSQL = "SELECT * FROM PICTURES WHERE ID = " + std::to_string(topPictureId) + ";";
 	Picture picture(-1, "");
 
-	runSQL(query, &picture, getPictureCallback);
+	runSQL(shardOfPicture(topPictureId), getPictureSQL, &picture, getPictureCallback);
 
 	if (picture.getId() == -1 || picture.getName().empty() || picture.getPath().empty() || picture.getCreationDate().empty())
 		throw MyException("Could not found top tagged picture!");
@@ -421,7 +713,7 @@ Picture DatabaseAccess::getTopTaggedPicture() const
 	return picture;
 }
 
-std::list<Picture> DatabaseAccess::getTaggedPicturesOfUser(const User& user) const
+std::pmr::list<Picture> DatabaseAccess::getTaggedPicturesOfUser(const User& user, std::pmr::memory_resource* resource) const
 {
 	if (!doesUserExists(user.getId()))
 		throw MyException("User " + std::to_string(user.getId()) + " does not exist!");
@@ -432,15 +724,17 @@ std::list<Picture> DatabaseAccess::getTaggedPicturesOfUser(const User& user) con
 		"INNER JOIN TAGS ON PICTURES.ID = TAGS.PICTURE_ID "
 		"WHERE TAGS.USER_ID = " + std::to_string(user.getId()) + ";";
 
-	std::list<Picture> pictures;
+	std::pmr::list<Picture> pictures(resource);
 
-	runSQL(getPicturesOfUserSQL, &pictures, getPicturesCallback);
+	for (sqlite3* shard : shardsTaggingUser(user.getId()))
+	{
+		std::pmr::list<Picture> shardPictures(resource);
+		runSQL(shard, getPicturesOfUserSQL, &shardPictures, getPicturesCallback);
 
-	for (Picture& picture : pictures) {
-		std::set<User> users_tagged = getPictureTags(picture);
+		for (Picture& picture : shardPictures)
+			loadPictureTags(shard, picture);
 
-		for (const auto& user_tagged : users_tagged)
-			picture.tagUser(user_tagged);
+		pictures.splice(pictures.end(), shardPictures);
 	}
 
 	return pictures;
@@ -449,183 +743,683 @@ std::list<Picture> DatabaseAccess::getTaggedPicturesOfUser(const User& user) con
 
 
 
-// db access related functions //
-bool DatabaseAccess::open()
+// data versions related functions //
+const DataVersions& DatabaseAccess::getVersions() const
 {
-	if (db != nullptr)
-		return true;
-
-	const int file_exist = _access(DB_NAME, 0);
-	const int connection_successful = sqlite3_open(DB_NAME, &db);
-
-	if (connection_successful != SQLITE_OK)
-	{
-		db = nullptr;
-		std::cerr << "Error opening database\n";
-		return false;
-	}
-
-	if (file_exist != 0)
-	{
-		// create schema, return false if failed
-		try {
-			constexpr const char* createUsersTable = "CREATE TABLE IF NOT EXISTS USERS ( ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL, NAME TEXT NOT NULL );";
-			runSQL(createUsersTable);
-
-			constexpr const char* createAlbumsTable = "CREATE TABLE IF NOT EXISTS ALBUMS ( ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL, NAME TEXT NOT NULL, USER_ID INTEGER NOT NULL, CREATION_DATE TEXT NOT NULL, FOREIGN KEY(USER_ID) REFERENCES USERS(ID) );";
-			runSQL(createAlbumsTable);
-
-			constexpr const char* createPicturesTable = "CREATE TABLE IF NOT EXISTS PICTURES  ( ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL, NAME TEXT NOT NULL, LOCATION TEXT NOT NULL, CREATION_DATE TEXT NOT NULL, ALBUM_ID INTEGER NOT NULL, FOREIGN KEY(ALBUM_ID) REFERENCES ALBUMS(ID) );";
-			runSQL(createPicturesTable);
-
-			constexpr const char* createTagsTable = "CREATE TABLE IF NOT EXISTS TAGS ( PICTURE_ID INTEGER NOT NULL, USER_ID INTEGER NOT NULL, PRIMARY KEY(PICTURE_ID, USER_ID), FOREIGN KEY(PICTURE_ID) REFERENCES PICTURES(ID), FOREIGN KEY(USER_ID) REFERENCES USERS(ID) );";
-			runSQL(createTagsTable);
-		}
-		catch (SqlException& e) {
-			std::cerr << e.what() << '\n';
-			sqlite3_close(db);
-			return false;
-		}
-	}
-
-	return true;
+	return versions;
 }
 
-void DatabaseAccess::close()
+ResponseCache& DatabaseAccess::getResponseCache() const
 {
-	if (db == nullptr)
-		return;
-	sqlite3_close(db);
-	db = nullptr;
+	return responseCache;
 }
 
-void DatabaseAccess::clear() const
+ChangeFeed& DatabaseAccess::getChangeFeed() const
 {
-	constexpr const char* clearDB = "DELETE FROM USERS; DELETE FROM ALBUMS; DELETE FROM PICTURES; DELETE FROM TAGS; DELETE FROM SQLITE_SEQUENCE;";
-	runSQL(clearDB);
-
-	constexpr const char* vacuumDatabase = "VACUUM;";
-	runSQL(vacuumDatabase);
+	return changeFeed;
 }
 
+// change log related functions //
+// a change is made by a transaction, which keeps it until it commits - it is numbered and published only
+// then, so the change log is not held while the transaction runs
+void DatabaseAccess::recordChange(ChangeEvent change) const
+{
+	if (!isInTransaction())
+		throw SqlException("A change can only be recorded by a transaction");
 
+	std::string payload;
+	JsonStreamWriter writer([&payload](const char* data, size_t size) { payload.append(data, size); });
+	JsonHelper::writeChangeEvent(writer, change);
+	writer.flush();
 
+	transactionChanges.push_back({ std::move(change), std::move(payload) });
+}
 
-// helper functions //
-bool DatabaseAccess::doesPictureExistsInAlbum(const std::string& albumName, const std::string& pictureName) const
+// appends the changes of the transaction to the change log, which numbers them. The transaction holds the log
+void DatabaseAccess::appendChanges() const
 {
-	const std::string doesPictureExistsSQL =
-		"SELECT 1 FROM PICTURES "
-		"INNER JOIN ALBUMS ON PICTURES.ALBUM_ID = ALBUMS.ID "
-		"WHERE PICTURES.NAME = '" + pictureName + "' "
-		"AND ALBUMS.NAME = '" + albumName + "' LIMIT 1;";
+	for (PendingChange& pending : transactionChanges)
+	{
+		ChangeEvent& change = pending.change;
 
-	bool doesPictureExists = false;
+		const std::string appendChangeSQL =
+			"INSERT INTO CHANGES (ENTITY, ENTITY_ID, OP, PAYLOAD) "
+			"VALUES ('" + std::string(ChangeEvent::entityName(change.type)) + "', " + toSQLString(change.entityId()) + ", '" +
+			ChangeEvent::operationName(change.type) + "', " + toSQLString(pending.payload) + "); "
+			"SELECT last_insert_rowid();";
 
-	runSQL(doesPictureExistsSQL, &doesPictureExists, existenceCallback);
+		runSQL(changeLog, appendChangeSQL, &change.sequence, getSequenceCallback);
 
-	return doesPictureExists;
+		if (change.sequence % CHANGE_LOG_COMPACTION_INTERVAL == 0)
+			compactChangeLog(change.sequence);
+	}
 }
 
-bool DatabaseAccess::doesAlbumExists(const std::string& albumName) const
+// the changes of a user, picture or tag are replaced by the last one - their ids are never reused, so
+// it tells all there is to know. Every change of an album is kept, its name may be reused once it was
+// deleted along with its pictures. The changes past the retention are dropped, and the retention floor
+// is raised to them
+void DatabaseAccess::compactChangeLog(uint64_t sequence) const
 {
-	const std::string doesAlbumExistsSQL = "SELECT 1 FROM ALBUMS WHERE NAME = '" + albumName + "' LIMIT 1;";
-	bool doesAlbumExist = false;
+	std::string compactSQL =
+		"DELETE FROM CHANGES WHERE ENTITY <> 'album' AND SEQUENCE NOT IN "
+		"(SELECT MAX(SEQUENCE) FROM CHANGES WHERE ENTITY <> 'album' GROUP BY ENTITY, ENTITY_ID);";
 
-	runSQL(doesAlbumExistsSQL, &doesAlbumExist, existenceCallback);
+	if (sequence > CHANGE_LOG_RETENTION)
+	{
+		const std::string floor = std::to_string(sequence - CHANGE_LOG_RETENTION);
 
-	return doesAlbumExist;
+		compactSQL +=
+			" UPDATE CHANGES_RETENTION SET FLOOR = MAX(FLOOR, " + floor + ");"
+			" DELETE FROM CHANGES WHERE SEQUENCE <= " + floor + ";";
+	}
+
+	runSQL(changeLog, compactSQL);
 }
 
-bool DatabaseAccess::doesPictureExists(const std::string& pictureName, int pic_id) const
+// the delta is compacted the way the log is, a user, picture or tag changed several times since the
+// client synced appears once, at its last change
+ChangeLogDelta DatabaseAccess::getChangesSince(uint64_t since, size_t limit) const
 {
-	const std::string doesPictureExistsSQL =
-		"SELECT 1 FROM PICTURES "
-		"WHERE PICTURES.NAME = '" + pictureName + "' "
-		"AND PICTURES.ID = " + std::to_string(pic_id) +
-		" LIMIT 1;";
+	ChangeLogDelta delta;
 
-	bool doesPictureExists = false;
+	runReadTransaction([&]
+	{
+		delta = ChangeLogDelta();
 
-	runSQL(doesPictureExistsSQL, &doesPictureExists, existenceCallback);
+		uint64_t floor = 0;
+		runSQL(changeLog, "SELECT FLOOR FROM CHANGES_RETENTION;", &floor, getSequenceCallback);
 
-	return doesPictureExists;
-}
+		uint64_t last = 0;
+		runSQL(changeLog, "SELECT seq FROM SQLITE_SEQUENCE WHERE NAME = 'CHANGES';", &last, getSequenceCallback);
 
-std::list<User> DatabaseAccess::getUsers() const
-{
-	const std::string getAllUsersSQL = "SELECT * FROM USERS;";
-	std::list<User> users;
+		delta.sequence = last;
 
-	runSQL(getAllUsersSQL, &users, getUsersCallback);
+		// a sequence past the last one comes from a log that is gone, the database was replaced
+		if (since < floor || since > last)
+		{
+			delta.isResyncRequired = true;
+			return;
+		}
 
-	return users;
-}
+		const std::string sinceSQL = std::to_string(since);
+		const std::string getChangesSQL =
+			"SELECT SEQUENCE, ENTITY, ENTITY_ID, OP, PAYLOAD FROM CHANGES "
+			"WHERE SEQUENCE > " + sinceSQL + " AND (ENTITY = 'album' OR SEQUENCE IN "
+			"(SELECT MAX(SEQUENCE) FROM CHANGES WHERE SEQUENCE > " + sinceSQL + " AND ENTITY <> 'album' GROUP BY ENTITY, ENTITY_ID)) "
+			"ORDER BY SEQUENCE LIMIT " + std::to_string(limit + 1) + ";";
 
-int DatabaseAccess::getAlbumID(const std::string& albumName) const
-{
-	const std::string getAlbumID = "SELECT ID FROM ALBUMS WHERE NAME = '" + albumName + "' LIMIT 1;";
-	int albumID = -1;
+		runSQL(changeLog, getChangesSQL, &delta.changes, getChangeLogCallback);
 
-	runSQL(getAlbumID, &albumID, getIDCallback);
+		if (delta.changes.size() > limit)
+		{
+			delta.changes.pop_back();
+			delta.hasMore = true;
+			delta.sequence = delta.changes.back().sequence;
+		}
+	});
 
-	if (albumID == -1)
-		throw ItemNotFoundException("Album", albumName);
+	return delta;
+}
 
-	return albumID;
+
+// transaction related functions //
+void DatabaseAccess::runInTransaction(const std::function<void()>& operations) const
+{
+	runInTransaction([this] { return allDatabases(); }, operations);
 }
 
-// this function gets only the album itself, not the pictures inside it
-Album DatabaseAccess::getAlbum(const std::string& albumName, std::optional<int> userId) const
+// the databases are resolved before they are locked, which a concurrent write may have changed (an album
+// deleted and created again by another user), so they are resolved again under the locks until they agree.
+// A transaction takes its locks in the same order as every other one, so none waits for another in a cycle.
+// A transaction that does not write the directory still reads it, to find its albums, so it holds it shared -
+// the transactions on different shards run side by side, and an album can not move while one runs on it
+void DatabaseAccess::runInTransaction(const std::function<std::vector<sqlite3*>()>& databasesOf, const std::function<void()>& operations) const
 {
-	Album album(-1, "");
+	// a transaction inside a transaction is simply a part of it, and can only use what the outer one holds
+	if (isInTransaction())
+	{
+		for (sqlite3* database : databasesOf())
+		{
+			if (!isHeldByTransaction(database))
+				throw SqlException("A nested transaction needs a database the outer one does not hold");
+		}
 
-	if (userId.has_value())
+		operations();
+		return;
+	}
+
+	std::vector<sqlite3*> databases = inLockOrder(databasesOf());
+	std::shared_lock<std::shared_mutex> directoryLock;
+	std::vector<std::unique_lock<std::shared_mutex>> locks;
+
+	while (true)
 	{
-		if (!doesAlbumExists(albumName, userId.value()))
-			throw ItemNotFoundException("Album", albumName);
+		// the directory is first in the lock order, held shared or exclusively
+		if (std::find(databases.begin(), databases.end(), db) == databases.end())
+		{
+			directoryLock = std::shared_lock(mutexOf(db));
+			transactionReadDatabases = { db };
+		}
 
+		for (sqlite3* database : databases)
+			locks.emplace_back(mutexOf(database));
 
-		const std::string getAlbumSQL = "SELECT * FROM ALBUMS WHERE NAME = '" + albumName + "' AND USER_ID = " + std::to_string(userId.value()) + " LIMIT 1;";
+		transactionDatabases = databases;
+		std::vector<sqlite3*> lockedDatabases;
 
-		runSQL(getAlbumSQL, &album, getAlbumCallback);
+		try
+		{
+			lockedDatabases = inLockOrder(databasesOf());
+		}
+		catch (...)
+		{
+			transactionDatabases.clear();
+			transactionReadDatabases.clear();
+			throw;
+		}
 
-		if (album.getOwnerId() == -1 || album.getName().empty() || album.getCreationDate().empty())
-			throw ItemNotFoundException("Album", userId.value());
+		if (lockedDatabases == databases)
+			break;
 
-		return album;
+		transactionDatabases.clear();
+		transactionReadDatabases.clear();
+		locks.clear();
+		directoryLock = {};
+		databases = std::move(lockedDatabases);
 	}
 
-	const std::string getAlbumSQL = "SELECT * FROM ALBUMS WHERE NAME = '" + albumName + "' LIMIT 1;";
+	size_t begunCount = 0;
+	bool isChangeLogBegun = false;
+	const long long changesBefore = countChanges(databases);
 
-	runSQL(getAlbumSQL, &album, getAlbumCallback);
+	try
+	{
+		for (sqlite3* database : databases)
+		{
+			runSQL(database, "BEGIN IMMEDIATE;");
+			begunCount++;
+		}
 
-	if (album.getOwnerId() == -1 || album.getName().empty() || album.getCreationDate().empty())
-		throw ItemNotFoundException("Album", albumName);
+		operations();
 
-	return album;
-}
+		// the change log is last in the lock order, so it is taken only now, and held from numbering the
+		// changes until they are published - the transactions number their changes one at a time, in the
+		// order they commit, while the rest of their writes ran side by side
+		if (!transactionChanges.empty() && !isHeldByTransaction(changeLog))
+		{
+			locks.emplace_back(mutexOf(changeLog));
+			transactionDatabases.push_back(changeLog);
 
-std::list<Picture> DatabaseAccess::getAlbumPictures(const Album& album) const
-{
-	if (!doesAlbumExists(album.getName(), album.getOwnerId()))
-		throw ItemNotFoundException("Album", album.getName());
+			runSQL(changeLog, "BEGIN IMMEDIATE;");
+			isChangeLogBegun = true;
+		}
 
-	const int album_id = getAlbumID(album.getName());
-	const std::string getAlbumPicturesSQL = "SELECT * FROM PICTURES WHERE ALBUM_ID = " + std::to_string(album_id) + ";";
-	std::list<Picture> pictures;
+		appendChanges();
 
-	runSQL(getAlbumPicturesSQL, &pictures, getPicturesCallback);
+		// sqlite can not commit several files as one, so a commit failing on its own (a full disk)
+		// may leave the databases committed before it. The changes are committed after the writes they log
+		for (sqlite3* database : databases)
+			runSQL(database, "COMMIT;");
 
-	for (auto& pic : pictures)
+		if (isChangeLogBegun)
+			runSQL(changeLog, "COMMIT;");
+	}
+	catch (...)
 	{
-		const auto picTags = getPictureTags(pic);
-		for (const auto& tag : picTags)
-			pic.tagUser(tag);
+		// a failed statement may have ended the transaction already, so the result is not checked
+		for (size_t i = 0; i < begunCount; i++)
+			sqlite3_exec(databases[i], "ROLLBACK;", nullptr, nullptr, nullptr);
+
+		if (isChangeLogBegun)
+			sqlite3_exec(changeLog, "ROLLBACK;", nullptr, nullptr, nullptr);
+
+		const bool hasWritten = countChanges(databases) != changesBefore;
+
+		transactionChanges.clear();
+		transactionDatabases.clear();
+		transactionReadDatabases.clear();
+		locks.clear();
+		directoryLock = {};
+
+		// the tag index and the versions followed the writes that were just rolled back, a transaction
+		// that failed before writing anything (a missing item) left them as they are. The index is read
+		// from every database, so it is reloaded once no other write is open
+		if (hasWritten)
+		{
+			try
+			{
+				runInTransaction([this] { loadTagIndex(); });
+			}
+			catch (const SqlException& e)
+			{
+				Logger::failure("database", std::string("Failed to reload the tag index after a rollback: ") + e.what());
+			}
+
+			versions.bumpAll();
+		}
+
+		throw;
 	}
 
-	return pictures;
-}
+	transactionDatabases.clear();
+	transactionReadDatabases.clear();
+
+	// the change log is still held, so the feed gets the changes in the order of the log
+	std::vector<PendingChange> changes;
+	changes.swap(transactionChanges);
+
+	for (const PendingChange& pending : changes)
+		changeFeed.publish(pending.change);
+}
+
+void DatabaseAccess::runReadTransaction(const std::function<void()>& reads) const
+{
+	// reads inside a transaction or a snapshot are simply a part of it
+	if (isInTransaction() || !snapshotConnections.empty())
+	{
+		reads();
+		return;
+	}
+
+	for (int attempt = 0; attempt < READ_TRANSACTION_ATTEMPTS; attempt++)
+	{
+		// every write statement is counted by its connection once it completes, so equal counts
+		// before and after the reads mean they all saw the same data
+		const long long changesBefore = countChanges(allDatabases());
+		reads();
+
+		if (countChanges(allDatabases()) == changesBefore)
+			return;
+	}
+
+	// the writes keep interleaving, so the reads run on a snapshot - a read only connection per database,
+	// whose read transactions all begin while no write is open, so they all see the same writes. The write
+	// ahead log keeps them apart from the writes that go on meanwhile. The tag index is not a part of it
+	const std::vector<sqlite3*> databases = allDatabases();
+	std::vector<sqlite3*> snapshot = takeSnapshot();
+
+	for (size_t i = 0; i < databases.size(); i++)
+		snapshotConnections.emplace(databases[i], snapshot[i]);
+
+	size_t begunCount = 0;
+
+	try
+	{
+		{
+			std::vector<std::shared_lock<std::shared_mutex>> locks;
+			for (sqlite3* database : databases)
+				locks.emplace_back(mutexOf(database));
+
+			// a deferred transaction takes its snapshot at its first read
+			for (sqlite3* database : databases)
+			{
+				runSQL(database, "BEGIN; SELECT COUNT(*) FROM SQLITE_MASTER;");
+				begunCount++;
+			}
+		}
+
+		reads();
+
+		for (sqlite3* database : databases)
+			runSQL(database, "COMMIT;");
+	}
+	catch (...)
+	{
+		for (size_t i = 0; i < begunCount; i++)
+			sqlite3_exec(snapshot[i], "ROLLBACK;", nullptr, nullptr, nullptr);
+
+		snapshotConnections.clear();
+		returnSnapshot(std::move(snapshot));
+		throw;
+	}
+
+	snapshotConnections.clear();
+	returnSnapshot(std::move(snapshot));
+}
+
+long long DatabaseAccess::countChanges(const std::vector<sqlite3*>& databases) const
+{
+	long long changes = 0;
+
+	for (sqlite3* database : databases)
+		changes += sqlite3_total_changes(database);
+
+	return changes;
+}
+
+// the directory first, then the shards by their index, then the change log
+std::vector<sqlite3*> DatabaseAccess::inLockOrder(std::vector<sqlite3*> databases) const
+{
+	std::sort(databases.begin(), databases.end(), [this](sqlite3* a, sqlite3* b) { return lockIndexOf(a) < lockIndexOf(b); });
+	databases.erase(std::unique(databases.begin(), databases.end()), databases.end());
+
+	return databases;
+}
+
+// read only connections to every database, in the order of allDatabases - an idle set, or a new one
+std::vector<sqlite3*> DatabaseAccess::takeSnapshot() const
+{
+	{
+		const std::lock_guard lock(snapshotsMutex);
+
+		if (!idleSnapshots.empty())
+		{
+			std::vector<sqlite3*> snapshot = std::move(idleSnapshots.back());
+			idleSnapshots.pop_back();
+
+			return snapshot;
+		}
+	}
+
+	std::vector<sqlite3*> snapshot;
+	for (sqlite3* database : allDatabases())
+	{
+		sqlite3* connection = nullptr;
+
+		if (sqlite3_open_v2(sqlite3_db_filename(database, "main"), &connection, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+		{
+			sqlite3_close(connection);
+			for (sqlite3* opened : snapshot)
+				sqlite3_close(opened);
+
+			throw SqlException("Failed to open a snapshot of the database");
+		}
+
+		snapshot.push_back(connection);
+	}
+
+	return snapshot;
+}
+
+void DatabaseAccess::returnSnapshot(std::vector<sqlite3*> snapshot) const
+{
+	const std::lock_guard lock(snapshotsMutex);
+	idleSnapshots.push_back(std::move(snapshot));
+}
+
+std::vector<sqlite3*> DatabaseAccess::allDatabases() const
+{
+	std::vector<sqlite3*> databases = { db };
+	databases.insert(databases.end(), shards.begin(), shards.end());
+	databases.push_back(changeLog);
+
+	return databases;
+}
+
+// the pictures and tags of an album are all in its shard, the directory is only read to find it
+std::vector<sqlite3*> DatabaseAccess::databasesOfAlbum(const std::string& albumName) const
+{
+	return { shardOfAlbum(albumName) };
+}
+
+// the directory is 0, a shard is its index after it and the change log is last. A database that is not
+// open yet is only used by open, before any other thread, and shares the lock of the directory
+size_t DatabaseAccess::lockIndexOf(sqlite3* database) const
+{
+	if (database != nullptr && database == changeLog)
+		return shards.size() + 1;
+
+	const auto shard = std::find(shards.begin(), shards.end(), database);
+
+	return shard != shards.end() ? static_cast<size_t>(shard - shards.begin()) + 1 : 0;
+}
+
+std::shared_mutex& DatabaseAccess::mutexOf(sqlite3* database) const
+{
+	return databaseMutexes[lockIndexOf(database)];
+}
+
+
+// db access related functions //
+bool DatabaseAccess::open()
+{
+	if (db != nullptr)
+		return true;
+
+	// the directory - users and the location of every album
+	const std::vector<const char*> directorySchema = {
+		"CREATE TABLE IF NOT EXISTS USERS ( ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL, NAME TEXT NOT NULL );",
+		"CREATE TABLE IF NOT EXISTS ALBUMS_DIRECTORY ( ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL, NAME TEXT NOT NULL UNIQUE, USER_ID INTEGER NOT NULL, FOREIGN KEY(USER_ID) REFERENCES USERS(ID) );"
+	};
+
+	// the change log - every committed change by its sequence, and the sequence it was compacted up to
+	const std::vector<const char*> changeLogSchema = {
+		"CREATE TABLE IF NOT EXISTS CHANGES ( SEQUENCE INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL, ENTITY TEXT NOT NULL, ENTITY_ID TEXT NOT NULL, OP TEXT NOT NULL, PAYLOAD TEXT NOT NULL );",
+		"CREATE TABLE IF NOT EXISTS CHANGES_RETENTION ( FLOOR INTEGER NOT NULL );",
+		"INSERT INTO CHANGES_RETENTION (FLOOR) SELECT 0 WHERE NOT EXISTS (SELECT 1 FROM CHANGES_RETENTION);"
+	};
+
+	// a shard - the albums of the users mapped to it, their pictures and the tags on them, and the count
+	// of pictures it added, their ids are numbered from
+	const std::vector<const char*> shardSchema = {
+		"CREATE TABLE IF NOT EXISTS ALBUMS ( ID INTEGER PRIMARY KEY NOT NULL, NAME TEXT NOT NULL, USER_ID INTEGER NOT NULL, CREATION_DATE TEXT NOT NULL );",
+		"CREATE TABLE IF NOT EXISTS PICTURES  ( ID INTEGER PRIMARY KEY NOT NULL, NAME TEXT NOT NULL, LOCATION TEXT NOT NULL, CREATION_DATE TEXT NOT NULL, ALBUM_ID INTEGER NOT NULL, FOREIGN KEY(ALBUM_ID) REFERENCES ALBUMS(ID) );",
+		"CREATE TABLE IF NOT EXISTS TAGS ( PICTURE_ID INTEGER NOT NULL, USER_ID INTEGER NOT NULL, PRIMARY KEY(PICTURE_ID, USER_ID), FOREIGN KEY(PICTURE_ID) REFERENCES PICTURES(ID) );",
+		"CREATE INDEX IF NOT EXISTS TAGS_USER_ID ON TAGS(USER_ID);",
+		"CREATE TABLE IF NOT EXISTS PICTURE_IDS ( LAST INTEGER NOT NULL );",
+		"INSERT INTO PICTURE_IDS (LAST) SELECT 0 WHERE NOT EXISTS (SELECT 1 FROM PICTURE_IDS);"
+	};
+
+	sqlite3* directory = nullptr;
+	if (!openDatabase(DB_NAME, directory, directorySchema))
+		return false;
+
+	std::vector<sqlite3*> openedShards;
+	for (int i = 0; i < SHARDS_COUNT; i++)
+	{
+		sqlite3* shard = nullptr;
+
+		if (!openDatabase(SHARD_DB_PREFIX + std::to_string(i) + ".sqlite", shard, shardSchema))
+		{
+			for (sqlite3* openedShard : openedShards)
+				sqlite3_close(openedShard);
+			sqlite3_close(directory);
+			return false;
+		}
+
+		openedShards.push_back(shard);
+	}
+
+	sqlite3* openedChangeLog = nullptr;
+	if (!openDatabase(CHANGE_LOG_DB_NAME, openedChangeLog, changeLogSchema))
+	{
+		for (sqlite3* openedShard : openedShards)
+			sqlite3_close(openedShard);
+		sqlite3_close(directory);
+		return false;
+	}
+
+	db = directory;
+	shards = std::move(openedShards);
+	changeLog = openedChangeLog;
+
+	try {
+		migrateLegacyTables();
+		migrateChangeLog();
+		loadTagIndex();
+	}
+	catch (const SqlException& e) {
+		std::cerr << e.what() << '\n';
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void DatabaseAccess::close()
+{
+	if (db == nullptr)
+		return;
+
+	for (const auto& snapshot : idleSnapshots)
+	{
+		for (sqlite3* connection : snapshot)
+			sqlite3_close(connection);
+	}
+	idleSnapshots.clear();
+
+	for (sqlite3* shard : shards)
+		sqlite3_close(shard);
+	shards.clear();
+
+	sqlite3_close(changeLog);
+	changeLog = nullptr;
+
+	sqlite3_close(db);
+	db = nullptr;
+}
+
+// the deletes and the clear change are committed together, so the change is numbered and published
+// in the order of the writes around it. Sqlite can not vacuum inside a transaction, so it runs after
+void DatabaseAccess::clear() const
+{
+	runInTransaction([this]
+	{
+		constexpr const char* clearShard = "DELETE FROM ALBUMS; DELETE FROM PICTURES; DELETE FROM TAGS; UPDATE PICTURE_IDS SET LAST = 0;";
+		for (sqlite3* shard : shards)
+			runSQL(shard, clearShard);
+
+		// the change log keeps numbering where it was, the clear change recorded below supersedes every change
+		// before it, so a client of any sequence since the retention floor just drops everything it has
+		runSQL(db, "DELETE FROM USERS; DELETE FROM ALBUMS_DIRECTORY; DELETE FROM SQLITE_SEQUENCE;");
+		runSQL(changeLog, "DELETE FROM CHANGES;");
+
+		tagIndex.clear();
+		versions.bumpAll();
+
+		recordChange({ ChangeEvent::Type::CLEARED });
+	});
+
+	constexpr const char* vacuumDatabase = "VACUUM;";
+	for (sqlite3* database : allDatabases())
+		runSQL(database, vacuumDatabase);
+}
+
+
+
+
+// helper functions //
+bool DatabaseAccess::doesPictureExistsInAlbum(const std::string& albumName, const std::string& pictureName) const
+{
+	if (!doesAlbumExists(albumName))
+		return false;
+
+	const std::string doesPictureExistsSQL =
+		"SELECT 1 FROM PICTURES "
+		"INNER JOIN ALBUMS ON PICTURES.ALBUM_ID = ALBUMS.ID "
+		"WHERE PICTURES.NAME = '" + pictureName + "' "
+		"AND ALBUMS.NAME = '" + albumName + "' LIMIT 1;";
+
+	bool doesPictureExists = false;
+
+	runSQL(shardOfAlbum(albumName), doesPictureExistsSQL, &doesPictureExists, existenceCallback);
+
+	return doesPictureExists;
+}
+
+bool DatabaseAccess::doesAlbumExists(const std::string& albumName) const
+{
+	const std::string doesAlbumExistsSQL = "SELECT 1 FROM ALBUMS_DIRECTORY WHERE NAME = '" + albumName + "' LIMIT 1;";
+	bool doesAlbumExist = false;
+
+	runSQL(db, doesAlbumExistsSQL, &doesAlbumExist, existenceCallback);
+
+	return doesAlbumExist;
+}
+
+bool DatabaseAccess::doesPictureExists(const std::string& pictureName, int pic_id) const
+{
+	const std::string doesPictureExistsSQL =
+		"SELECT 1 FROM PICTURES "
+		"WHERE PICTURES.NAME = '" + pictureName + "' "
+		"AND PICTURES.ID = " + std::to_string(pic_id) +
+		" LIMIT 1;";
+
+	bool doesPictureExists = false;
+
+	try {
+		runSQL(shardOfPicture(pic_id), doesPictureExistsSQL, &doesPictureExists, existenceCallback);
+	}
+	catch (const ItemNotFoundException&) {
+		return false;
+	}
+
+	return doesPictureExists;
+}
+
+std::pmr::list<User> DatabaseAccess::getUsers(std::pmr::memory_resource* resource) const
+{
+	const std::string getAllUsersSQL = "SELECT * FROM USERS;";
+	std::pmr::list<User> users(resource);
+
+	runSQL(db, getAllUsersSQL, &users, getUsersCallback);
+
+	return users;
+}
+
+int DatabaseAccess::getAlbumID(const std::string& albumName) const
+{
+	const std::string getAlbumID = "SELECT ID FROM ALBUMS_DIRECTORY WHERE NAME = '" + albumName + "' LIMIT 1;";
+	int albumID = -1;
+
+	runSQL(db, getAlbumID, &albumID, getIDCallback);
+
+	if (albumID == -1)
+		throw ItemNotFoundException("Album", albumName);
+
+	return albumID;
+}
+
+// this function gets only the album itself, not the pictures inside it
+Album DatabaseAccess::getAlbum(const std::string& albumName, std::optional<int> userId) const
+{
+	Album album(-1, "");
+
+	if (userId.has_value())
+	{
+		if (!doesAlbumExists(albumName, userId.value()))
+			throw ItemNotFoundException("Album", albumName);
+
+
+		const std::string getAlbumSQL = "SELECT * FROM ALBUMS WHERE NAME = '" + albumName + "' AND USER_ID = " + std::to_string(userId.value()) + " LIMIT 1;";
+
+		runSQL(shardOfUser(userId.value()), getAlbumSQL, &album, getAlbumCallback);
+
+		if (album.getOwnerId() == -1 || album.getName().empty() || album.getCreationDate().empty())
+			throw ItemNotFoundException("Album", userId.value());
+
+		return album;
+	}
+
+	const std::string getAlbumSQL = "SELECT * FROM ALBUMS WHERE NAME = '" + albumName + "' LIMIT 1;";
+
+	runSQL(shardOfAlbum(albumName), getAlbumSQL, &album, getAlbumCallback);
+
+	if (album.getOwnerId() == -1 || album.getName().empty() || album.getCreationDate().empty())
+		throw ItemNotFoundException("Album", albumName);
+
+	return album;
+}
+
+std::pmr::list<Picture> DatabaseAccess::getAlbumPictures(const Album& album, std::pmr::memory_resource* resource) const
+{
+	if (!doesAlbumExists(album.getName(), album.getOwnerId()))
+		throw ItemNotFoundException("Album", album.getName());
+
+	const int album_id = getAlbumID(album.getName());
+	const std::string getAlbumPicturesSQL = "SELECT * FROM PICTURES WHERE ALBUM_ID = " + std::to_string(album_id) + ";";
+	std::pmr::list<Picture> pictures(resource);
+
+	sqlite3* shard = shardOfUser(album.getOwnerId());
+	runSQL(shard, getAlbumPicturesSQL, &pictures, getPicturesCallback);
+
+	for (auto& pic : pictures)
+		loadPictureTags(shard, pic);
+
+	return pictures;
+}
 
 int DatabaseAccess::getPictureID(const std::string& albumName, const std::string& pictureName) const
 {
@@ -637,7 +1431,7 @@ int DatabaseAccess::getPictureID(const std::string& albumName, const std::string
 
 	int pictureID = -1;
 
-	runSQL(getPicIdSQL, &pictureID, getIDCallback);
+	runSQL(shardOfAlbum(albumName), getPicIdSQL, &pictureID, getIDCallback);
 
 	if (pictureID == -1)
 		throw ItemNotFoundException("Picture", pictureName);
@@ -645,39 +1439,26 @@ int DatabaseAccess::getPictureID(const std::string& albumName, const std::string
 	return pictureID;
 }
 
-std::set<User> DatabaseAccess::getPictureTags(const std::string& albumName, const Picture& picture) const
+std::pmr::set<User> DatabaseAccess::getPictureTags(const std::string& albumName, const Picture& picture, std::pmr::memory_resource* resource) const
 {
 	if (!doesPictureExistsInAlbum(albumName, picture.getName()))
 		throw ItemNotFoundException("Picture", picture.getName());
 
-	const std::string getPicTagsSQL = "SELECT USER_ID FROM TAGS WHERE PICTURE_ID = " + std::to_string(picture.getId()) + ";";
-	std::set<int> picTags;
-	runSQL(getPicTagsSQL, &picTags, getTagsCallback);
+	Picture taggedPicture(picture.getId(), picture.getName());
+	loadPictureTags(shardOfAlbum(albumName), taggedPicture);
 
-	std::set<User> usersTagged;
-
-	for (const int user_id : picTags)
-		usersTagged.insert(getUser(user_id));
-
-	return usersTagged;
+	return getUsersByIDs(taggedPicture.getUsersTagged(), resource);
 }
 
-std::set<User> DatabaseAccess::getPictureTags(const Picture& picture) const
+std::pmr::set<User> DatabaseAccess::getPictureTags(const Picture& picture, std::pmr::memory_resource* resource) const
 {
 	if (!doesPictureExists(picture.getName(), picture.getId()))
 		throw ItemNotFoundException("Picture", picture.getName());
 
-	const std::string getPicTagsSQL = "SELECT USER_ID FROM TAGS WHERE PICTURE_ID = " + std::to_string(picture.getId()) + ";";
-	std::set<int> picTags;
-
-	runSQL(getPicTagsSQL, &picTags, getTagsCallback);
-
-	std::set<User> usersTagged;
+	Picture taggedPicture(picture.getId(), picture.getName());
+	loadPictureTags(shardOfPicture(picture.getId()), taggedPicture);
 
-	for (const int user_id : picTags)
-		usersTagged.insert(getUser(user_id));
-
-	return usersTagged;
+	return getUsersByIDs(taggedPicture.getUsersTagged(), resource);
 }
 
 bool DatabaseAccess::doesUserTaggedPicture(const int user_id, const int& pic_id) const
@@ -685,33 +1466,635 @@ bool DatabaseAccess::doesUserTaggedPicture(const int user_id, const int& pic_id)
 	const std::string doesUserTaggedPicSQL = "SELECT 1 FROM TAGS WHERE USER_ID = " + std::to_string(user_id) + " AND PICTURE_ID = " + std::to_string(pic_id) + " LIMIT 1;";
 	bool doesUserTaggedPic = false;
 
-	runSQL(doesUserTaggedPicSQL, &doesUserTaggedPic, existenceCallback);
+	runSQL(shardOfPicture(pic_id), doesUserTaggedPicSQL, &doesUserTaggedPic, existenceCallback);
 
 	return doesUserTaggedPic;
 }
 
+// loads only the ids of the tagged users, the users themselves are resolved when needed
+void DatabaseAccess::loadPictureTags(sqlite3* shard, Picture& picture) const
+{
+	const std::string getPicTagsSQL = "SELECT USER_ID FROM TAGS WHERE PICTURE_ID = " + std::to_string(picture.getId()) + " ORDER BY USER_ID;";
+
+	runSQL(shard, getPicTagsSQL, &picture, tagUserCallback);
+}
+
+template <typename IDs>
+std::pmr::set<User> DatabaseAccess::getUsersByIDs(const IDs& userIDs, std::pmr::memory_resource* resource) const
+{
+	std::pmr::set<User> users(resource);
+
+	if (userIDs.empty())
+		return users;
+
+	std::string ids;
+	for (const int userId : userIDs)
+		ids += (ids.empty() ? "" : ", ") + std::to_string(userId);
+
+	const std::string getUsersSQL = "SELECT * FROM USERS WHERE ID IN (" + ids + ");";
+	std::pmr::list<User> usersList(resource);
+
+	runSQL(db, getUsersSQL, &usersList, getUsersCallback);
+	users.insert(usersList.begin(), usersList.end());
+
+	return users;
+}
+
+// resolves the users of a ranking in a single query, keeping the order of the ranking
+template <typename Score>
+std::vector<std::pair<User, Score>> DatabaseAccess::getRankedUsers(const std::vector<std::pair<int, Score>>& rankedIDs) const
+{
+	std::vector<int> userIDs;
+	userIDs.reserve(rankedIDs.size());
+	for (const auto& [userId, score] : rankedIDs)
+		userIDs.push_back(userId);
+
+	const std::pmr::set<User> users = getUsersByIDs(userIDs, std::pmr::get_default_resource());
+
+	std::vector<std::pair<User, Score>> rankedUsers;
+	rankedUsers.reserve(rankedIDs.size());
+
+	for (const auto& [userId, score] : rankedIDs)
+	{
+		const auto user = std::find_if(users.begin(), users.end(), [userId = userId](const User& u) { return u.getId() == userId; });
+		if (user != users.end())
+			rankedUsers.emplace_back(*user, score);
+	}
+
+	return rankedUsers;
+}
+
+
+// album related functions //
+// fills an album read from its shard with the name of its owner and its pictures
+void DatabaseAccess::loadAlbumContent(Album& album) const
+{
+	const User owner = getUser(album.getOwnerId());
+	album.setOwnerName(owner.getName());
+
+	// the pictures already carry their tagged user ids
+	for (const Picture& picture : getAlbumPictures(album, album.get_allocator().resource()))
+		album.addPicture(picture);
+}
+
+
+// fills the owner names of album rows read with their pictures count and visits them,
+// the owners are read once each however many albums they have
+void DatabaseAccess::visitAlbumSummaries(std::vector<std::pair<Album, int>>& albums, const std::function<void(const Album&, int picturesCount)>& visit) const
+{
+	std::map<int, std::string> ownerNames;
+
+	for (auto& [album, picturesCount] : albums)
+	{
+		auto ownerName = ownerNames.find(album.getOwnerId());
+		if (ownerName == ownerNames.end())
+			ownerName = ownerNames.emplace(album.getOwnerId(), getUser(album.getOwnerId()).getName()).first;
+
+		album.setOwnerName(ownerName->second);
+		visit(album, picturesCount);
+	}
+}
+
+
+// streamed listing functions //
+void DatabaseAccess::forEachUser(const std::function<void(const User&)>& visit) const
+{
+	for (const User& user : getUsers(std::pmr::get_default_resource()))
+		visit(user);
+}
+
+// the albums are ordered by creation date across the shards, so their rows are read before the first
+// visit - but only the rows, the pictures of an album are counted by the query and never read
+void DatabaseAccess::forEachAlbum(const std::function<void(const Album&, int picturesCount)>& visit) const
+{
+	const std::string getAlbumSummariesSQL =
+		"SELECT ALBUMS.NAME AS NAME, ALBUMS.USER_ID AS USER_ID, ALBUMS.CREATION_DATE AS CREATION_DATE, COUNT(PICTURES.ID) AS PICTURES_COUNT FROM ALBUMS "
+		"LEFT JOIN PICTURES ON PICTURES.ALBUM_ID = ALBUMS.ID GROUP BY ALBUMS.ID;";
+	std::vector<AlbumSummary> albums;
+
+	for (sqlite3* shard : shards)
+		runSQL(shard, getAlbumSummariesSQL, &albums, getAlbumSummariesCallback);
+
+	std::stable_sort(albums.begin(), albums.end(), [](const AlbumSummary& a, const AlbumSummary& b) { return a.first.getCreationDate() < b.first.getCreationDate(); });
+
+	visitAlbumSummaries(albums, visit);
+}
+
+void DatabaseAccess::forEachAlbumOfUser(const User& user, const std::function<void(const Album&, int picturesCount)>& visit) const
+{
+	if (!doesUserExists(user.getId()))
+		throw ItemNotFoundException("User ", user.getId());
+
+	const std::string getAlbumSummariesSQL =
+		"SELECT ALBUMS.NAME AS NAME, ALBUMS.USER_ID AS USER_ID, ALBUMS.CREATION_DATE AS CREATION_DATE, COUNT(PICTURES.ID) AS PICTURES_COUNT FROM ALBUMS "
+		"LEFT JOIN PICTURES ON PICTURES.ALBUM_ID = ALBUMS.ID WHERE ALBUMS.USER_ID = " + std::to_string(user.getId()) + " GROUP BY ALBUMS.ID;";
+	std::vector<AlbumSummary> albums;
+
+	runSQL(shardOfUser(user.getId()), getAlbumSummariesSQL, &albums, getAlbumSummariesCallback);
+
+	visitAlbumSummaries(albums, visit);
+}
+
+// a single query reads the pictures with their tags, one row per tag, and the pictures are visited once
+// all their rows were read
+void DatabaseAccess::forEachAlbumPicture(const Album& album, const std::function<void(const Picture&)>& visit) const
+{
+	if (!doesAlbumExists(album.getName(), album.getOwnerId()))
+		throw ItemNotFoundException("Album", album.getName());
+
+	const int albumID = getAlbumID(album.getName());
+	const std::string getAlbumPicturesSQL =
+		"SELECT PICTURES.ID AS ID, PICTURES.NAME AS NAME, PICTURES.LOCATION AS LOCATION, PICTURES.CREATION_DATE AS CREATION_DATE, TAGS.USER_ID AS TAGGED_USER_ID FROM PICTURES "
+		"LEFT JOIN TAGS ON TAGS.PICTURE_ID = PICTURES.ID WHERE PICTURES.ALBUM_ID = " + std::to_string(albumID) + " ORDER BY PICTURES.ID, TAGS.USER_ID;";
+
+	std::vector<Picture> pictures;
+	PictureCursor cursor{ [&pictures](const Picture& picture) { pictures.push_back(picture); } };
+	runSQL(shardOfUser(album.getOwnerId()), getAlbumPicturesSQL, &cursor, visitPicturesCallback);
+
+	// the last picture has no next picture to end its rows
+	if (cursor.current.getId() != -1)
+		pictures.push_back(std::move(cursor.current));
+
+	for (const Picture& picture : pictures)
+		visit(picture);
+}
+
+
+// multi-get related functions //
+std::vector<std::optional<User>> DatabaseAccess::lookupUsers(const std::vector<int>& userIDs) const
+{
+	std::vector<std::optional<User>> users(userIDs.size());
+
+	const std::pmr::set<User> foundUsers = getUsersByIDs(userIDs, std::pmr::get_default_resource());
+
+	std::unordered_map<int, const User*> usersByID;
+	for (const User& user : foundUsers)
+		usersByID.emplace(user.getId(), &user);
+
+	for (size_t i = 0; i < userIDs.size(); i++)
+	{
+		const auto user = usersByID.find(userIDs[i]);
+		if (user != usersByID.end())
+			users[i] = *user->second;
+	}
+
+	return users;
+}
+
+// the shard of an album is only known from its owner, so every shard is asked - a single query each
+std::vector<std::optional<std::pair<Album, int>>> DatabaseAccess::lookupAlbums(const std::vector<std::string>& albumNames) const
+{
+	std::vector<std::optional<std::pair<Album, int>>> albums(albumNames.size());
+
+	if (albumNames.empty())
+		return albums;
+
+	const std::string getAlbumSummariesSQL =
+		"SELECT ALBUMS.NAME AS NAME, ALBUMS.USER_ID AS USER_ID, ALBUMS.CREATION_DATE AS CREATION_DATE, COUNT(PICTURES.ID) AS PICTURES_COUNT FROM ALBUMS "
+		"LEFT JOIN PICTURES ON PICTURES.ALBUM_ID = ALBUMS.ID WHERE ALBUMS.NAME IN (" + toSQLList(albumNames) + ") GROUP BY ALBUMS.ID;";
+	std::vector<AlbumSummary> foundAlbums;
+
+	for (sqlite3* shard : shards)
+		runSQL(shard, getAlbumSummariesSQL, &foundAlbums, getAlbumSummariesCallback);
+
+	// the owners are read in a single query as well
+	std::vector<int> ownerIDs;
+	for (const auto& [album, picturesCount] : foundAlbums)
+		ownerIDs.push_back(album.getOwnerId());
+
+	std::unordered_map<int, std::string> ownerNames;
+	for (const User& owner : getUsersByIDs(ownerIDs, std::pmr::get_default_resource()))
+		ownerNames.emplace(owner.getId(), owner.getName());
+
+	std::unordered_map<std::string, const AlbumSummary*> albumsByName;
+	for (auto& summary : foundAlbums)
+	{
+		summary.first.setOwnerName(ownerNames[summary.first.getOwnerId()]);
+		albumsByName.emplace(summary.first.getName(), &summary);
+	}
+
+	for (size_t i = 0; i < albumNames.size(); i++)
+	{
+		const auto album = albumsByName.find(albumNames[i]);
+		if (album != albumsByName.end())
+			albums[i] = *album->second;
+	}
+
+	return albums;
+}
+
+// the pictures are read with their tags, one row per tag, as in forEachAlbumPicture
+std::vector<std::optional<Picture>> DatabaseAccess::lookupPictures(const std::vector<int>& pictureIDs) const
+{
+	std::vector<std::optional<Picture>> pictures(pictureIDs.size());
+
+	if (pictureIDs.empty())
+		return pictures;
+
+	const std::string getPicturesSQL =
+		"SELECT PICTURES.ID AS ID, PICTURES.NAME AS NAME, PICTURES.LOCATION AS LOCATION, PICTURES.CREATION_DATE AS CREATION_DATE, TAGS.USER_ID AS TAGGED_USER_ID FROM PICTURES "
+		"LEFT JOIN TAGS ON TAGS.PICTURE_ID = PICTURES.ID WHERE PICTURES.ID IN (" + toSQLList(pictureIDs) + ") ORDER BY PICTURES.ID, TAGS.USER_ID;";
+
+	std::unordered_map<int, Picture> picturesByID;
+	PictureCursor cursor{ [&picturesByID](const Picture& picture) { picturesByID.emplace(picture.getId(), picture); } };
+
+	for (sqlite3* shard : shards)
+	{
+		runSQL(shard, getPicturesSQL, &cursor, visitPicturesCallback);
+
+		// the last picture of the shard has no next picture to end its rows
+		if (cursor.current.getId() != -1)
+			cursor.visit(cursor.current);
+
+		cursor.current = Picture(-1, "");
+	}
+
+	for (size_t i = 0; i < pictureIDs.size(); i++)
+	{
+		const auto picture = picturesByID.find(pictureIDs[i]);
+		if (picture != picturesByID.end())
+			pictures[i] = picture->second;
+	}
+
+	return pictures;
+}
+
+// tag index related functions //
+std::vector<int> DatabaseAccess::queryTaggedPictures(const TagQuery& query) const
+{
+	TagQuery resolvedQuery = query;
+	resolveTagQuery(resolvedQuery);
+
+	const RoaringBitmap pictures = tagIndex.evaluate(resolvedQuery);
+
+	std::vector<int> pictureIDs;
+	pictureIDs.reserve(pictures.cardinality());
+
+	for (const uint32_t pictureID : pictures.toVector())
+		pictureIDs.push_back(static_cast<int>(pictureID));
+
+	return pictureIDs;
+}
+
+// the users tagged together with the user the most, with the number of pictures they share
+std::vector<std::pair<User, int>> DatabaseAccess::getTopCoTaggedUsers(const User& user, int count) const
+{
+	if (!doesUserExists(user.getId()))
+		throw ItemNotFoundException("User", user.getId());
+
+	const auto partners = tagIndex.getTopCoTaggedUsers(user.getId(), static_cast<size_t>(std::max(count, 0)));
+
+	std::vector<std::pair<User, int>> coTaggedUsers;
+	coTaggedUsers.reserve(partners.size());
+
+	for (const auto& [partner, sharedCount] : getRankedUsers(partners))
+		coTaggedUsers.emplace_back(partner, static_cast<int>(sharedCount));
+
+	return coTaggedUsers;
+}
+
+int DatabaseAccess::countCoTags(const User& firstUser, const User& secondUser) const
+{
+	if (!doesUserExists(firstUser.getId()))
+		throw ItemNotFoundException("User", firstUser.getId());
+
+	if (!doesUserExists(secondUser.getId()))
+		throw ItemNotFoundException("User", secondUser.getId());
+
+	return static_cast<int>(tagIndex.countCoTags(firstUser.getId(), secondUser.getId()));
+}
+
+// the users most likely to be in the picture, with their score, computed from the tag index aggregates
+std::vector<std::pair<User, double>> DatabaseAccess::suggestTags(const std::string& albumName, const std::string& pictureName, int count) const
+{
+	const int pictureID = getPictureID(albumName, pictureName);
+
+	return getRankedUsers(tagIndex.suggestTags(pictureID, static_cast<size_t>(std::max(count, 0))));
+}
+
+// replaces the album names in the query with album ids
+void DatabaseAccess::resolveTagQuery(TagQuery& query) const
+{
+	if (query.type == TagQuery::Type::ALBUM)
+		query.id = getAlbumID(query.albumName);
+
+	for (TagQuery& operand : query.operands)
+		resolveTagQuery(operand);
+}
+
+// read before the pictures or their tags are deleted, the index forgets them with the tags
+RoaringBitmap DatabaseAccess::getUsersTaggedIn(const RoaringBitmap& pictures) const
+{
+	RoaringBitmap users;
+
+	for (const uint32_t pictureID : pictures.toVector())
+		users = users | tagIndex.getUsersOfPicture(static_cast<int>(pictureID));
+
+	return users;
+}
+
+std::vector<PictureLocation> DatabaseAccess::getPictureLocations(const RoaringBitmap& pictures) const
+{
+	std::vector<PictureLocation> locations;
+	if (pictures.empty())
+		return locations;
+
+	std::vector<int> pictureIDs;
+	for (const uint32_t pictureID : pictures.toVector())
+		pictureIDs.push_back(static_cast<int>(pictureID));
+
+	// only the shards of the pictures are read, those a write already holds
+	std::map<sqlite3*, std::vector<int>> pictureIDsByShard;
+	for (const uint32_t pictureID : pictures.toVector())
+		pictureIDsByShard[shardOfPicture(static_cast<int>(pictureID))].push_back(static_cast<int>(pictureID));
+
+	for (const auto& [shard, pictureIDs] : pictureIDsByShard)
+	{
+		const std::string getLocationsSQL =
+			"SELECT PICTURES.ID, ALBUMS.NAME, ALBUMS.USER_ID FROM PICTURES "
+			"INNER JOIN ALBUMS ON PICTURES.ALBUM_ID = ALBUMS.ID "
+			"WHERE PICTURES.ID IN (" + toSQLList(pictureIDs) + ");";
+		runSQL(shard, getLocationsSQL, &locations, getPictureLocationsCallback);
+	}
+
+	return locations;
+}
+
+// after a write changed the tags of the pictures, and so what the statistics of the users tagged in them show
+void DatabaseAccess::bumpTags(const RoaringBitmap& pictures, const RoaringBitmap& users) const
+{
+	for (const uint32_t pictureID : pictures.toVector())
+		versions.bumpPicture(static_cast<int>(pictureID));
+
+	for (const uint32_t userID : users.toVector())
+		versions.bumpUser(static_cast<int>(userID));
+}
+
+// builds the tag index from the shards, called once the databases are open
+void DatabaseAccess::loadTagIndex() const
+{
+	tagIndex.clear();
+
+	const std::string getPicturesSQL =
+		"SELECT PICTURES.ID, PICTURES.ALBUM_ID, ALBUMS.USER_ID FROM PICTURES "
+		"INNER JOIN ALBUMS ON PICTURES.ALBUM_ID = ALBUMS.ID;";
+	for (sqlite3* shard : shards)
+		runSQL(shard, getPicturesSQL, &tagIndex, indexPictureCallback);
+
+	const std::string getTagsSQL = "SELECT PICTURE_ID, USER_ID FROM TAGS;";
+	for (sqlite3* shard : shards)
+		runSQL(shard, getTagsSQL, &tagIndex, indexTagCallback);
+}
+
+
+// sharding related functions //
+sqlite3* DatabaseAccess::shardOfUser(int userId) const
+{
+	if (shards.empty())
+		throw SqlException("Database is not open");
+
+	// user ids are positive, so the owner id alone decides the shard of an album
+	return shards[userId % shards.size()];
+}
+
+sqlite3* DatabaseAccess::shardOfAlbum(const std::string& albumName) const
+{
+	return shardOfUser(getAlbumOwnerID(albumName));
+}
+
+int DatabaseAccess::getAlbumOwnerID(const std::string& albumName) const
+{
+	const std::string getOwnerSQL = "SELECT USER_ID FROM ALBUMS_DIRECTORY WHERE NAME = '" + albumName + "' LIMIT 1;";
+	int ownerId = -1;
+
+	runSQL(db, getOwnerSQL, &ownerId, getIDCallback);
+
+	if (ownerId == -1)
+		throw ItemNotFoundException("Album", albumName);
+
+	return ownerId;
+}
+
+// the id of a picture tells its shard. A picture numbered before the shards numbered their own is
+// found by its owner in the tag index, which holds every picture
+sqlite3* DatabaseAccess::shardOfPicture(int pictureId) const
+{
+	if (shards.empty())
+		throw SqlException("Database is not open");
+
+	const int shardIndex = (pictureId >> SHARD_PICTURE_ID_BITS) - 1;
+
+	if (shardIndex >= static_cast<int>(shards.size()))
+		throw ItemNotFoundException("Picture", pictureId);
+
+	if (shardIndex >= 0)
+		return shards[shardIndex];
+
+	const int ownerId = tagIndex.getOwnerOfPicture(pictureId);
+
+	if (ownerId == -1)
+		throw ItemNotFoundException("Picture", pictureId);
+
+	return shardOfUser(ownerId);
+}
+
+// the tags of a user are in the shards of the pictures the user is tagged in
+std::vector<sqlite3*> DatabaseAccess::shardsTaggingUser(int userId) const
+{
+	std::set<sqlite3*> taggingShards;
+
+	for (const uint32_t pictureID : tagIndex.getPicturesOfUser(userId).toVector())
+		taggingShards.insert(shardOfPicture(static_cast<int>(pictureID)));
+
+	return std::vector<sqlite3*>(taggingShards.begin(), taggingShards.end());
+}
+
+// called in a transaction that holds the shard of the owner, the count rolls back with the picture
+int DatabaseAccess::allocatePictureId(int ownerId) const
+{
+	const std::string allocatePictureIdSQL = "UPDATE PICTURE_IDS SET LAST = LAST + 1; SELECT LAST FROM PICTURE_IDS;";
+	int localID = -1;
+
+	runSQL(shardOfUser(ownerId), allocatePictureIdSQL, &localID, getIDCallback);
+
+	if (localID <= 0 || localID >= (1 << SHARD_PICTURE_ID_BITS))
+		throw MyException("The shard of user " + std::to_string(ownerId) + " has no picture ids left.");
+
+	const int shardIndex = static_cast<int>(ownerId % shards.size());
+
+	return ((shardIndex + 1) << SHARD_PICTURE_ID_BITS) | localID;
+}
+
+bool DatabaseAccess::openDatabase(const std::string& path, sqlite3*& database, const std::vector<const char*>& schema) const
+{
+	const int connection_successful = sqlite3_open(path.c_str(), &database);
+
+	if (connection_successful != SQLITE_OK)
+	{
+		sqlite3_close(database);
+		database = nullptr;
+		std::cerr << "Error opening database " << path << '\n';
+		return false;
+	}
+
+	// create schema, return false if failed. The write ahead log lets snapshot reads run beside the writes
+	try {
+		runSQL(database, "PRAGMA journal_mode=WAL;");
+
+		for (const char* createTable : schema)
+			runSQL(database, createTable);
+	}
+	catch (SqlException& e) {
+		std::cerr << e.what() << '\n';
+		sqlite3_close(database);
+		database = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+
+// the gallery kept its albums, pictures and tags in the directory before it was sharded. They are moved
+// to the shards of their owners once, keeping their ids, and the tables the directory kept to find them
+// are dropped. The rows keep their ids and a row already moved is skipped, so a move cut short by a crash
+// is finished on the next open
+void DatabaseAccess::migrateLegacyTables() const
+{
+	runSQL(db, "DROP TABLE IF EXISTS PICTURES_DIRECTORY; DROP TABLE IF EXISTS TAGGED_SHARDS;");
+
+	bool hasLegacyTables = false;
+	runSQL(db, "SELECT 1 FROM SQLITE_MASTER WHERE TYPE = 'table' AND NAME = 'ALBUMS' LIMIT 1;", &hasLegacyTables, existenceCallback);
+
+	if (!hasLegacyTables)
+		return;
+
+	std::string attachSQL;
+	std::string detachSQL;
+	std::string moveSQL;
+
+	for (size_t i = 0; i < shards.size(); i++)
+	{
+		const std::string shard = "SHARD" + std::to_string(i);
+		const std::string ofShard = " % " + std::to_string(shards.size()) + " = " + std::to_string(i);
+
+		attachSQL += "ATTACH DATABASE " + toSQLString(sqlite3_db_filename(shards[i], "main")) + " AS " + shard + "; ";
+		detachSQL += "DETACH DATABASE " + shard + "; ";
+
+		// tags on pictures that no longer exist are left behind
+		moveSQL +=
+			"INSERT OR IGNORE INTO " + shard + ".ALBUMS (ID, NAME, USER_ID, CREATION_DATE) "
+			"SELECT ID, NAME, USER_ID, CREATION_DATE FROM main.ALBUMS WHERE USER_ID" + ofShard + "; "
+			"INSERT OR IGNORE INTO " + shard + ".PICTURES (ID, NAME, LOCATION, CREATION_DATE, ALBUM_ID) "
+			"SELECT P.ID, P.NAME, P.LOCATION, P.CREATION_DATE, P.ALBUM_ID FROM main.PICTURES P "
+			"INNER JOIN main.ALBUMS A ON P.ALBUM_ID = A.ID WHERE A.USER_ID" + ofShard + "; "
+			"INSERT OR IGNORE INTO " + shard + ".TAGS (PICTURE_ID, USER_ID) "
+			"SELECT T.PICTURE_ID, T.USER_ID FROM main.TAGS T INNER JOIN main.PICTURES P ON T.PICTURE_ID = P.ID "
+			"INNER JOIN main.ALBUMS A ON P.ALBUM_ID = A.ID WHERE A.USER_ID" + ofShard + "; ";
+	}
+
+	moveSQL +=
+		"INSERT OR IGNORE INTO main.ALBUMS_DIRECTORY (ID, NAME, USER_ID) SELECT ID, NAME, USER_ID FROM main.ALBUMS; "
+		"DROP TABLE main.TAGS; DROP TABLE main.PICTURES; DROP TABLE main.ALBUMS;";
+
+	runSQL(db, attachSQL);
+
+	try {
+		runSQL(db, "BEGIN; " + moveSQL + " COMMIT;");
+	}
+	catch (const SqlException&) {
+		sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		sqlite3_exec(db, detachSQL.c_str(), nullptr, nullptr, nullptr);
+		throw;
+	}
+
+	runSQL(db, detachSQL);
+}
+
+// the change log was kept in the directory before it had a database of its own. Its changes, the floor
+// it was compacted up to and the last sequence it gave are moved to the change log database once, and the
+// tables are dropped from the directory. A change already moved is skipped, as in migrateLegacyTables
+void DatabaseAccess::migrateChangeLog() const
+{
+	bool hasLegacyChangeLog = false;
+	runSQL(db, "SELECT 1 FROM SQLITE_MASTER WHERE TYPE = 'table' AND NAME = 'CHANGES' LIMIT 1;", &hasLegacyChangeLog, existenceCallback);
+
+	if (!hasLegacyChangeLog)
+		return;
+
+	constexpr const char* moveSQL =
+		"INSERT OR IGNORE INTO LOG.CHANGES (SEQUENCE, ENTITY, ENTITY_ID, OP, PAYLOAD) "
+		"SELECT SEQUENCE, ENTITY, ENTITY_ID, OP, PAYLOAD FROM main.CHANGES; "
+		"UPDATE LOG.CHANGES_RETENTION SET FLOOR = MAX(FLOOR, (SELECT IFNULL(MAX(FLOOR), 0) FROM main.CHANGES_RETENTION)); "
+		"INSERT INTO LOG.SQLITE_SEQUENCE (NAME, seq) SELECT 'CHANGES', 0 "
+		"WHERE NOT EXISTS (SELECT 1 FROM LOG.SQLITE_SEQUENCE WHERE NAME = 'CHANGES'); "
+		"UPDATE LOG.SQLITE_SEQUENCE SET seq = MAX(seq, (SELECT IFNULL(MAX(seq), 0) FROM main.SQLITE_SEQUENCE WHERE NAME = 'CHANGES')) "
+		"WHERE NAME = 'CHANGES'; "
+		"DELETE FROM main.SQLITE_SEQUENCE WHERE NAME = 'CHANGES'; "
+		"DROP TABLE main.CHANGES; DROP TABLE main.CHANGES_RETENTION;";
+
+	runSQL(db, "ATTACH DATABASE " + toSQLString(sqlite3_db_filename(changeLog, "main")) + " AS LOG;");
+
+	try {
+		runSQL(db, std::string("BEGIN; ") + moveSQL + " COMMIT;");
+	}
+	catch (const SqlException&) {
+		sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		sqlite3_exec(db, "DETACH DATABASE LOG;", nullptr, nullptr, nullptr);
+		throw;
+	}
+
+	runSQL(db, "DETACH DATABASE LOG;");
+}
+
 
 // Wrapper functions for sqlite3_exec //
-void DatabaseAccess::runSQL(const std::string& sql_statement) const
+void DatabaseAccess::runSQL(sqlite3* database, const std::string& sql_statement) const
 {
-	if (db == nullptr)
+	if (database == nullptr)
 		throw SqlException("Database is not open");
 
+	// statements wait for an open transaction of another thread on their database, so they never become a
+	// part of it. A transaction can not wait for a database it does not hold, another one may wait for it.
+	// Snapshot reads run on connections no write uses, and wait for nothing
+	std::shared_lock lock(mutexOf(database), std::defer_lock);
+	if (const auto snapshot = snapshotConnections.find(database); snapshot != snapshotConnections.end())
+		database = snapshot->second;
+	else if (!isInTransaction())
+		lock.lock();
+	else if (!isHeldByTransaction(database) && !isReadByTransaction(database))
+		throw SqlException("A transaction can only run statements on the databases it holds");
+
+	RequestWork::current().statements++;
+
 	char* errMessage = nullptr;
-	const int res = sqlite3_exec(db, sql_statement.c_str(), nullptr, nullptr, &errMessage);
+	const int res = sqlite3_exec(database, sql_statement.c_str(), nullptr, nullptr, &errMessage);
 
 	if (res != SQLITE_OK)
 		throw SqlException(errMessage);
 
 }
 
-void DatabaseAccess::runSQL(const std::string& sql_statement, void* data, int(*callback)(void*, int, char**, char**)) const
+void DatabaseAccess::runSQL(sqlite3* database, const std::string& sql_statement, void* data, int(*callback)(void*, int, char**, char**)) const
 {
-	if (db == nullptr)
+	if (database == nullptr)
 		throw SqlException("Database is not open");
 
+	std::shared_lock lock(mutexOf(database), std::defer_lock);
+	if (const auto snapshot = snapshotConnections.find(database); snapshot != snapshotConnections.end())
+		database = snapshot->second;
+	else if (!isInTransaction())
+		lock.lock();
+	else if (!isHeldByTransaction(database) && !isReadByTransaction(database))
+		throw SqlException("A transaction can only run statements on the databases it holds");
+
+	RequestWork::current().statements++;
+
+	// the rows are counted on their way to the callback, which is called once per row
+	RowCounter counter{ data, callback };
+
 	char* errMessage = nullptr;
-	const int res = sqlite3_exec(db, sql_statement.c_str(), callback, data, &errMessage);
+	const int res = sqlite3_exec(database, sql_statement.c_str(), countRow, &counter, &errMessage);
 
 	if (res != SQLITE_OK)
 		throw SqlException(errMessage);
@@ -1,9 +1,23 @@
 #pragma once
 
+#include <array>
+#include <functional>
 #include <list>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
+#include <set>
+#include <shared_mutex>
 #include <sqlite3.h>
+#include <utility>
+#include <vector>
 #include "Album.h"
+#include "CallbackFuncs.h"
+#include "ChangeFeed.h"
+#include "Constants.h"
+#include "DataVersions.h"
+#include "ResponseCache.h"
+#include "TagIndex.h"
 
 
 class DatabaseAccess
@@ -13,8 +27,9 @@ public:
 	~DatabaseAccess();
 
 	// album related functions //
-	std::list<Album> getAlbums() const;
-	std::list<Album> getAlbumsOfUser(const User& user) const;
+	// the functions returning containers allocate them, and the models inside them, from the given resource
+	std::pmr::list<Album> getAlbums(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+	std::pmr::list<Album> getAlbumsOfUser(const User& user, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
 	void createAlbum(const Album& album) const;
 	void deleteAlbum(const std::string& albumName, int userId) const;
 	bool doesAlbumExists(const std::string& albumName, int userId) const;
@@ -45,7 +60,51 @@ public:
 	// tags related statistics functions //
 	User getTopTaggedUser() const;
 	Picture getTopTaggedPicture() const;
-	std::list<Picture> getTaggedPicturesOfUser(const User& user) const;
+	std::pmr::list<Picture> getTaggedPicturesOfUser(const User& user, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+	// tag index related functions //
+	std::vector<int> queryTaggedPictures(const TagQuery& query) const;
+	std::vector<std::pair<User, int>> getTopCoTaggedUsers(const User& user, int count) const;
+	int countCoTags(const User& firstUser, const User& secondUser) const;
+	std::vector<std::pair<User, double>> suggestTags(const std::string& albumName, const std::string& pictureName, int count) const;
+
+	// streamed listing functions //
+	// visit every row of a listing, for replies streamed to the client. The rows are read before the first
+	// visit, so a slow client never keeps a statement or a lock of the database
+	void forEachUser(const std::function<void(const User&)>& visit) const;
+	void forEachAlbum(const std::function<void(const Album&, int picturesCount)>& visit) const;
+	void forEachAlbumOfUser(const User& user, const std::function<void(const Album&, int picturesCount)>& visit) const;
+	void forEachAlbumPicture(const Album& album, const std::function<void(const Picture&)>& visit) const;
+
+	// multi-get related functions //
+	// one entry per requested key, in the order of the keys and empty for the keys that do not exist.
+	// Every database is asked a single IN query however many keys there are. Albums come with their
+	// pictures count, as in the listings
+	std::vector<std::optional<User>> lookupUsers(const std::vector<int>& userIDs) const;
+	std::vector<std::optional<std::pair<Album, int>>> lookupAlbums(const std::vector<std::string>& albumNames) const;
+	std::vector<std::optional<Picture>> lookupPictures(const std::vector<int>& pictureIDs) const;
+
+	// data versions related functions //
+	const DataVersions& getVersions() const;
+	ResponseCache& getResponseCache() const;
+	ChangeFeed& getChangeFeed() const;
+
+	// change log related functions //
+	// the changes committed after since, see ChangeLogDelta
+	ChangeLogDelta getChangesSince(uint64_t since, size_t limit = CHANGE_LOG_PAGE_SIZE) const;
+
+	// transaction related functions //
+	// runs the operations as a single transaction over every database - their writes are
+	// committed together, or rolled back together if one of them throws. No statement of another thread
+	// runs while the transaction is open
+	void runInTransaction(const std::function<void()>& operations) const;
+	// the same over the databases the operations touch only, given by databasesOf. The statements of other
+	// threads on the other databases run meanwhile, and the operations can not run any on them but reads of
+	// the directory, which is held shared when it is not given
+	void runInTransaction(const std::function<std::vector<sqlite3*>()>& databasesOf, const std::function<void()>& operations) const;
+	// runs read only operations as if they were a single transaction without blocking anyone - they are
+	// run again if a write completed meanwhile, and on a snapshot of the databases if writes keep interleaving
+	void runReadTransaction(const std::function<void()>& reads) const;
 
 	// db access related functions //
 	bool open();
@@ -57,20 +116,71 @@ public:
 	bool doesPictureExistsInAlbum(const std::string& albumName, const std::string& pictureName) const;
 	bool doesAlbumExists(const std::string& albumName) const;
 	bool doesPictureExists(const std::string& pictureName, int pic_id) const;
-	std::list<User> getUsers() const;
+	std::pmr::list<User> getUsers(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
 	int getAlbumID(const std::string& albumName) const;
 	Album getAlbum(const std::string& albumName, std::optional<int> userId = std::nullopt) const;
-	std::list<Picture> getAlbumPictures(const Album& album) const;
+	std::pmr::list<Picture> getAlbumPictures(const Album& album, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
 	int getPictureID(const std::string& albumName, const std::string& pictureName) const;
-	std::set<User> getPictureTags(const std::string& albumName, const Picture& picture) const;
-	std::set<User> getPictureTags(const Picture& picture) const;
+	std::pmr::set<User> getPictureTags(const std::string& albumName, const Picture& picture, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+	std::pmr::set<User> getPictureTags(const Picture& picture, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
 	bool doesUserTaggedPicture(const int user_id, const int& pic_id) const;
 
 private:
-	sqlite3* db = nullptr; // pointer to the database
+	sqlite3* db = nullptr; // pointer to the directory database (users, albums and pictures locations)
+	std::vector<sqlite3*> shards; // pointers to the shard databases (albums, pictures and tags)
+	sqlite3* changeLog = nullptr; // pointer to the change log database, numbered by the transactions as they commit
+	mutable TagIndex tagIndex; // in-memory index of the tags, updated after every successful write
+	mutable DataVersions versions; // versions of the data, bumped after every successful write
+	mutable ResponseCache responseCache; // documents of the read endpoints, dropped by the bumps of their data
+	mutable ChangeFeed changeFeed; // the committed changes, pushed to the subscribed clients
+	mutable std::array<std::shared_mutex, SHARDS_COUNT + 2> databaseMutexes; // one per database, held shared by its statements and exclusively by a transaction on it
+	mutable std::mutex snapshotsMutex;
+	mutable std::vector<std::vector<sqlite3*>> idleSnapshots; // read only connections to every database, for the snapshot reads
+
+	// transaction related functions //
+	long long countChanges(const std::vector<sqlite3*>& databases) const;
+	std::vector<sqlite3*> inLockOrder(std::vector<sqlite3*> databases) const;
+	std::vector<sqlite3*> allDatabases() const;
+	std::vector<sqlite3*> takeSnapshot() const;
+	void returnSnapshot(std::vector<sqlite3*> snapshot) const;
+	std::vector<sqlite3*> databasesOfAlbum(const std::string& albumName) const;
+	size_t lockIndexOf(sqlite3* database) const;
+	std::shared_mutex& mutexOf(sqlite3* database) const;
+
+	// change log related functions //
+	void recordChange(ChangeEvent change) const;
+	void appendChanges() const;
+	void compactChangeLog(uint64_t sequence) const;
+
+	// sharding related functions //
+	sqlite3* shardOfUser(int userId) const;
+	sqlite3* shardOfAlbum(const std::string& albumName) const;
+	int getAlbumOwnerID(const std::string& albumName) const;
+	sqlite3* shardOfPicture(int pictureId) const;
+	std::vector<sqlite3*> shardsTaggingUser(int userId) const;
+	int allocatePictureId(int ownerId) const;
+
+	// tags related functions //
+	void resolveTagQuery(TagQuery& query) const;
+	RoaringBitmap getUsersTaggedIn(const RoaringBitmap& pictures) const;
+	std::vector<PictureLocation> getPictureLocations(const RoaringBitmap& pictures) const;
+	void bumpTags(const RoaringBitmap& pictures, const RoaringBitmap& users) const;
+	void loadTagIndex() const;
+	void loadPictureTags(sqlite3* shard, Picture& picture) const;
+	template <typename IDs>
+	std::pmr::set<User> getUsersByIDs(const IDs& userIDs, std::pmr::memory_resource* resource) const;
+	template <typename Score>
+	std::vector<std::pair<User, Score>> getRankedUsers(const std::vector<std::pair<int, Score>>& rankedIDs) const;
+
+	// album related functions //
+	void loadAlbumContent(Album& album) const;
+	void visitAlbumSummaries(std::vector<std::pair<Album, int>>& albums, const std::function<void(const Album&, int picturesCount)>& visit) const;
+	bool openDatabase(const std::string& path, sqlite3*& database, const std::vector<const char*>& schema) const;
+	void migrateLegacyTables() const;
+	void migrateChangeLog() const;
 
 	// Wrapper functions for sqlite3_exec //
-	void runSQL(const std::string& sql_statement) const;
-	void runSQL(const std::string& sql_statement, void* data, int(*callback)(void*, int, char**, char**)) const;
+	void runSQL(sqlite3* database, const std::string& sql_statement) const;
+	void runSQL(sqlite3* database, const std::string& sql_statement, void* data, int(*callback)(void*, int, char**, char**)) const;
 
 };
@@ -1,12 +1,23 @@
 #include "GalleryAPI.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
 
-#include "Colors.h"
+#include "Constants.h"
+#include "InvalidRequestException.h"
 #include "ItemAlreadyExistsException.h"
 #include "ItemNotFoundException.h"
 #include "JsonHelper.h"
+#include "Logger.h"
+#include "RequestArena.h"
+#include "Requests.h"
+#include "ResponseCompressor.h"
+#include "Router.h"
+#include "StreamedResponse.h"
 
 
-GalleryAPI::GalleryAPI(const std::string& uri)
+GalleryAPI::GalleryAPI(const std::string& uri) :
+	batch_(db_)
 {
 	// construct the Gallery API URI
 	const utility::string_t utilityUri = utility::conversions::to_string_t(uri);
@@ -20,6 +31,8 @@ GalleryAPI::GalleryAPI(const std::string& uri)
 	listener_.support(methods::POST, [this](auto&& PH1) { handle_request(std::forward<decltype(PH1)>(PH1)); });
 	listener_.support(methods::DEL, [this](auto&& PH1) { handle_request(std::forward<decltype(PH1)>(PH1)); });
 	listener_.support(methods::GET, [this](auto&& PH1) { handle_request(std::forward<decltype(PH1)>(PH1)); });
+
+	register_routes();
 }
 
 const uri& GalleryAPI::listener_uri() const
@@ -32,918 +45,1501 @@ void GalleryAPI::start()
 	// start listening
 	try {
 		listener_.open().then([&]() {
-			std::wcout << YELLOW << "Listening for requests at: " << listener_.uri().to_string() << RESET << '\n';
+			Logger::info("server", "Listening for requests at: " + utility::conversions::to_utf8string(listener_.uri().to_string()));
 			}).wait();
 	}
 	catch (const std::exception& e) {
-		std::cerr << RED << "Error: " << e.what() << RESET << '\n';
+		Logger::failure("server", std::string("Error: ") + e.what());
 	}
 }
 
 void GalleryAPI::handle_request(const http_request& request) const
 {
-	const auto path = request.relative_uri().path();
-	const auto method = request.method();
+	RouteParams params;
+	const Router::Route* route = router_.match(request.method(), request.relative_uri().path(), params);
 
-	if (method == methods::POST)
+	// unknown paths and methods are answered by the router, they cost nothing to admit
+	if (route == nullptr)
 	{
-		if (path == U("/create_album"))
-		{
-			create_album(request);
-		}
-		else if (path == U("/create_user"))
-		{
-			create_user(request);
-		}
-		else if (path == U("/add_picture_to_album"))
-		{
-			add_picture_to_album(request);
-		}
-		else if (path == U("/tag_user_in_picture"))
-		{
-			tag_user_in_picture(request);
-		}
-		else if (path == U("/get_albums_of_user"))
-		{
-			get_albums_of_user(request);
-		}
-		else if (path == U("/get_user"))
-		{
-			get_user(request);
-		}
-		else if (path == U("/get_user_albums_count"))
-		{
-			get_user_albums_count(request);
-		}
-		else if (path == U("/get_albums_tagged_user_count"))
-		{
-			get_albums_tagged_user_count(request);
-		}
-		else if (path == U("/get_count_tags_of_user"))
-		{
-			get_count_tags_of_user(request);
-		}
-		else if (path == U("/get_average_tags_of_user_per_album"))
-		{
-			get_average_tags_of_user_per_album(request);
-		}
-		else if (path == U("/get_album_pictures"))
-		{
-			get_album_pictures(request);
-		}
-		else if (path == U("/get_picture_tags"))
-		{
-			get_picture_tags(request);
-		}
-		else
-		{
-			request.reply(status_codes::NotFound);
-		}
+		router_.dispatch(request);
+		return;
 	}
-	else if (method == methods::DEL)
+
+	// a record per request once it is replied to, shed or not - its status, and the time from its arrival
+	// to its reply, queueing included. The metrics count it too, along with the bytes of its bodies
+	const auto arrival = std::chrono::steady_clock::now();
+	const size_t metricsRoute = *metrics_.findRoute(route->info.name);	// every route was added to the metrics
+	const uint64_t bytesIn = request.headers().content_length();
+
+	request.get_response().then([this, route, metricsRoute, arrival, bytesIn](const pplx::task<http_response>& response)
 	{
-		if (path == U("/clear_db"))
-		{
-			clear_db(request);
-		}
-		if (path == U("/delete_user"))
-		{
-			delete_user(request);
-		}
-		else if (path == U("/delete_album"))
-		{
-			delete_album(request);
-		}
-		else if (path == U("/remove_picture_from_album"))
-		{
-			remove_picture_from_album(request);
-		}
-		else if (path == U("/untag_user_in_picture"))
+		try
 		{
-			untag_user_in_picture(request);
+			const http_response reply = response.get();
+			const auto status = reply.status_code();
+			const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - arrival);
+
+			Logger::instance().log(log_level_of(status), route->info.name.c_str(), "Replied.",
+				{ { "class", routeClassName(route->info.routeClass) }, { "status", status }, { "latency_ms", static_cast<double>(latency.count()) / 1000.0 } });
+
+			// a streamed body has no length, its bytes are counted as they are written
+			metrics_.recordRequest(metricsRoute, status, latency, bytesIn, reply.headers().content_length());
 		}
-		else
+		catch (...)
 		{
-			request.reply(status_codes::NotFound);
+			// the request was dropped without a reply, the handler logged why
 		}
-	}
-	else if (method == methods::GET)
+	});
+
+	admission_.submit(route->info.routeClass,
+		[route, request, params]() { return route->handler(request, params); },
+		[route, request]() { reply_busy(request, route->info.name.c_str()); },
+		[request]() { request.reply(status_codes::InternalError, "Internal server error occurred."); });
+}
+
+// the route table of the API - every route is a method, a path and the handler it is dispatched to,
+// along with the name it is logged under and whether it reads or writes the gallery
+void GalleryAPI::register_routes()
+{
+	// db related routes
+	add_route(methods::DEL, U("/clear_db"), { "clear_db", RouteClass::ADMIN }, &GalleryAPI::clear_db);
+	add_route(methods::GET, U("/admission_stats"), { "admission_stats", RouteClass::ADMIN }, &GalleryAPI::admission_stats);
+	add_route(methods::GET, U("/response_cache_stats"), { "response_cache_stats", RouteClass::ADMIN }, &GalleryAPI::response_cache_stats);
+	add_route(methods::GET, U("/metrics"), { "metrics", RouteClass::ADMIN }, &GalleryAPI::get_metrics);
+
+	// creation routes
+	add_route(methods::POST, U("/create_album"), { "create_album", RouteClass::WRITE }, &GalleryAPI::create_album);
+	add_route(methods::POST, U("/create_user"), { "create_user", RouteClass::WRITE }, &GalleryAPI::create_user);
+	add_route(methods::POST, U("/add_picture_to_album"), { "add_picture_to_album", RouteClass::WRITE }, &GalleryAPI::add_picture_to_album);
+	add_route(methods::POST, U("/tag_user_in_picture"), { "tag_user_in_picture", RouteClass::WRITE }, &GalleryAPI::tag_user_in_picture);
+
+	// deletion routes
+	add_route(methods::DEL, U("/delete_user"), { "delete_user", RouteClass::WRITE }, &GalleryAPI::delete_user);
+	add_route(methods::DEL, U("/delete_album"), { "delete_album", RouteClass::WRITE }, &GalleryAPI::delete_album);
+	add_route(methods::DEL, U("/remove_picture_from_album"), { "remove_picture_from_album", RouteClass::WRITE }, &GalleryAPI::remove_picture_from_album);
+	add_route(methods::DEL, U("/untag_user_in_picture"), { "untag_user_in_picture", RouteClass::WRITE }, &GalleryAPI::untag_user_in_picture);
+
+	// retrieval routes
+	add_route(methods::GET, U("/get_albums"), { "get_albums", RouteClass::LISTING }, &GalleryAPI::get_albums);
+	add_route(methods::GET, U("/get_users"), { "get_users", RouteClass::LISTING }, &GalleryAPI::get_users);
+	add_route(methods::POST, U("/get_albums_of_user"), { "get_albums_of_user", RouteClass::LISTING }, &GalleryAPI::get_albums_of_user);
+	add_route(methods::POST, U("/get_user"), { "get_user", RouteClass::READ }, &GalleryAPI::get_user);
+	add_route(methods::POST, U("/get_user_albums_count"), { "get_user_albums_count", RouteClass::READ }, &GalleryAPI::get_user_albums_count);
+	add_route(methods::POST, U("/get_albums_tagged_user_count"), { "get_albums_tagged_user_count", RouteClass::READ }, &GalleryAPI::get_albums_tagged_user_count);
+	add_route(methods::POST, U("/get_count_tags_of_user"), { "get_count_tags_of_user", RouteClass::READ }, &GalleryAPI::get_count_tags_of_user);
+	add_route(methods::POST, U("/get_average_tags_of_user_per_album"), { "get_average_tags_of_user_per_album", RouteClass::READ }, &GalleryAPI::get_average_tags_of_user_per_album);
+	add_route(methods::POST, U("/get_album_pictures"), { "get_album_pictures", RouteClass::LISTING }, &GalleryAPI::get_album_pictures);
+	add_route(methods::POST, U("/get_picture_tags"), { "get_picture_tags", RouteClass::READ }, &GalleryAPI::get_picture_tags);
+
+	// multi-get routes
+	add_route(methods::POST, U("/get_users_by_ids"), { "get_users_by_ids", RouteClass::LISTING }, &GalleryAPI::get_users_by_ids);
+	add_route(methods::POST, U("/get_albums_by_names"), { "get_albums_by_names", RouteClass::LISTING }, &GalleryAPI::get_albums_by_names);
+	add_route(methods::POST, U("/get_pictures_by_ids"), { "get_pictures_by_ids", RouteClass::LISTING }, &GalleryAPI::get_pictures_by_ids);
+
+	// resource routes, the same retrievals addressed by the path so they can be plain GET requests
+	add_route(methods::GET, U("/users/{id:int}"), { "get_user_by_path", RouteClass::READ }, &GalleryAPI::get_user_by_path);
+	add_route(methods::GET, U("/users/{id:int}/albums"), { "get_albums_of_user_by_path", RouteClass::LISTING }, &GalleryAPI::get_albums_of_user_by_path);
+	add_route(methods::GET, U("/users/{id:int}/albums/{album_name}/pictures"), { "get_album_pictures_by_path", RouteClass::LISTING }, &GalleryAPI::get_album_pictures_by_path);
+
+	// change feed routes, a subscription replies right away and stays open without holding an admission slot
+	add_route(methods::GET, U("/feed"), { "subscribe_changes", RouteClass::READ }, &GalleryAPI::subscribe_changes);
+	add_route(methods::GET, U("/users/{id:int}/feed"), { "subscribe_user_changes", RouteClass::READ }, &GalleryAPI::subscribe_user_changes);
+	add_route(methods::GET, U("/users/{id:int}/albums/{album_name}/feed"), { "subscribe_album_changes", RouteClass::READ }, &GalleryAPI::subscribe_album_changes);
+
+	// change log routes, the changes since a sequence number, for clients that reconnect or sync offline data
+	add_route(methods::GET, U("/changes"), { "get_changes", RouteClass::LISTING }, &GalleryAPI::get_changes);
+
+	// query routes
+	add_route(methods::POST, U("/query_tagged_pictures"), { "query_tagged_pictures", RouteClass::READ }, &GalleryAPI::query_tagged_pictures);
+	add_route(methods::POST, U("/get_co_tagged_users"), { "get_co_tagged_users", RouteClass::READ }, &GalleryAPI::get_co_tagged_users);
+	add_route(methods::POST, U("/get_co_tag_strength"), { "get_co_tag_strength", RouteClass::READ }, &GalleryAPI::get_co_tag_strength);
+	add_route(methods::POST, U("/suggest_tags"), { "suggest_tags", RouteClass::READ }, &GalleryAPI::suggest_tags);
+
+	// batch routes, many of the routes above in a single request. A batch is admitted as a read while its
+	// body is decoded, and then once more in the class of its operations
+	add_route(methods::POST, U("/batch"), { "batch", RouteClass::READ }, &GalleryAPI::batch);
+}
+
+// the database work a handler does before it returns is metered here, the work of its continuations is
+// metered by the continuations themselves
+void GalleryAPI::add_route(const method& method, const utility::string_t& pattern, RouteInfo info, Handler handler)
+{
+	set_log_sampling(info);
+	const size_t metricsRoute = metrics_.addRoute(info);
+
+	router_.add(method, pattern, std::move(info), [this, handler, metricsRoute](const http_request& request, const RouteParams&)
 	{
-		if (path == U("/get_albums"))
-		{
-			get_albums(request);
-		}
-		else if (path == U("/get_users"))
-		{
-			get_users(request);
-		}
-		else
-		{
-			request.reply(status_codes::NotFound);
-		}
-	}
-	else
+		const RequestMeter meter(metrics_, metricsRoute);
+		return (this->*handler)(request);
+	});
+}
+
+void GalleryAPI::add_route(const method& method, const utility::string_t& pattern, RouteInfo info, ParamsHandler handler)
+{
+	set_log_sampling(info);
+	const size_t metricsRoute = metrics_.addRoute(info);
+
+	router_.add(method, pattern, std::move(info), [this, handler, metricsRoute](const http_request& request, const RouteParams& params)
 	{
-		request.reply(status_codes::MethodNotAllowed);
-	}
+		const RequestMeter meter(metrics_, metricsRoute);
+		return (this->*handler)(request, params);
+	});
+}
+
+// reads are the bulk of the requests, only a sample of them is logged
+void GalleryAPI::set_log_sampling(const RouteInfo& info)
+{
+	if (info.routeClass == RouteClass::READ)
+		Logger::instance().setSampling(info.name, LOG_READ_SAMPLING);
 }
 
-void GalleryAPI::clear_db(const http_request& request) const
+pplx::task<void> GalleryAPI::clear_db(const http_request& request) const
 {
 	try
 	{
-		std::cout << MAGENTA << "clear_db:" << GREEN << " Clearing database..." << RESET << '\n';
+		Logger::debug("clear_db", "Clearing database...");
 		db_.clear();
-		std::cout << MAGENTA << "clear_db:" << GREEN << " Cleared Successfully!" << RESET << '\n';
+		Logger::debug("clear_db", "Cleared Successfully!");
 		request.reply(status_codes::OK, "Database cleared successfully.");
 	}
 	catch (const std::exception& e)
 	{
-		std::cerr << MAGENTA << "clear_db:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
+		Logger::failure("clear_db", std::string("Internal server error occurred: ") + e.what());
 		request.reply(status_codes::InternalError, "Internal server error occurred.");
 	}
+
+	return pplx::task_from_result();
 }
 
-void GalleryAPI::create_album(const http_request& request) const
+// the load of every route class, as seen by admission control
+pplx::task<void> GalleryAPI::admission_stats(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	json::value stats = json::value::object();
+
+	for (const RouteClass routeClass : { RouteClass::READ, RouteClass::LISTING, RouteClass::WRITE, RouteClass::ADMIN })
 	{
-		// Check if the JSON object contains the "name" field
-		if (!requestBody.has_field(U("name")) || !requestBody.has_field(U("user_id")))
-		{
-			std::cout << MAGENTA << "create_album:" << RED << " Missing 'name' or 'user_id' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'name' or 'user_id' field in the request body.");
-			return pplx::task_from_result();
-		}
+		const auto classStats = admission_.getStats(routeClass);
+		json::value classJson = json::value::object();
+
+		classJson[U("running")] = json::value::number(classStats.running);
+		classJson[U("queued")] = json::value::number(classStats.queued);
+		classJson[U("admitted")] = json::value::number(classStats.admitted);
+		classJson[U("rejected")] = json::value::number(classStats.rejected);
+		classJson[U("expired")] = json::value::number(classStats.expired);
+
+		stats[utility::conversions::to_string_t(routeClassName(routeClass))] = classJson;
+	}
+
+	Logger::debug("admission_stats", "Admission stats retrieved successfully.");
+	return reply_document(request, stats);
+}
 
-		const auto userId = requestBody.at(U("user_id")).as_integer();
-		const auto albumName = utility::conversions::to_utf8string(requestBody.at(U("name")).as_string());
+pplx::task<void> GalleryAPI::response_cache_stats(const http_request& request) const
+{
+	const auto stats = db_.getResponseCache().getStats();
+	const auto lookups = stats.hits + stats.misses;
+
+	json::value statsJson = json::value::object();
+	statsJson[U("hits")] = json::value::number(stats.hits);
+	statsJson[U("misses")] = json::value::number(stats.misses);
+	statsJson[U("hit_ratio")] = json::value::number(lookups != 0 ? static_cast<double>(stats.hits) / static_cast<double>(lookups) : 0.0);
+	statsJson[U("evictions")] = json::value::number(stats.evictions);
+	statsJson[U("invalidations")] = json::value::number(stats.invalidations);
+	statsJson[U("entries")] = json::value::number(stats.entries);
+	statsJson[U("bytes")] = json::value::number(stats.bytes);
+	statsJson[U("max_bytes")] = json::value::number(stats.maxBytes);
+
+	// requests that shared the document of an identical request in flight, instead of building their own
+	const auto flightStats = flights_.getStats();
+	statsJson[U("coalesced")] = json::value::number(flightStats.followed);
+	statsJson[U("coalesce_timeouts")] = json::value::number(flightStats.timedOut);
+
+	Logger::debug("response_cache_stats", "Response cache stats retrieved successfully.");
+	return reply_document(request, statsJson);
+}
+
+// the request metrics and the counters of the other components, in the Prometheus text format
+pplx::task<void> GalleryAPI::get_metrics(const http_request& request) const
+{
+	std::string text;
+	metrics_.write(text);
+
+	const auto writeMetric = [&text](const char* name, const char* type, const char* help, uint64_t value)
+	{
+		Metrics::writeFamily(text, name, type, help);
+		Metrics::writeSample(text, name, "", value);
+	};
+
+	// a sample per route class, of a member of its admission stats
+	const auto writeAdmission = [&](const char* name, const char* type, const char* help, auto value)
+	{
+		Metrics::writeFamily(text, name, type, help);
+
+		for (const RouteClass routeClass : { RouteClass::READ, RouteClass::LISTING, RouteClass::WRITE, RouteClass::ADMIN })
+			Metrics::writeSample(text, name, Metrics::label("class", routeClassName(routeClass)), static_cast<uint64_t>(admission_.getStats(routeClass).*value));
+	};
+
+	writeAdmission("gallery_admission_running", "gauge", "Requests of the route class running.", &AdmissionController::Stats::running);
+	writeAdmission("gallery_admission_queued", "gauge", "Requests of the route class waiting to run.", &AdmissionController::Stats::queued);
+	writeAdmission("gallery_admission_admitted_total", "counter", "Requests admitted to run.", &AdmissionController::Stats::admitted);
+	writeAdmission("gallery_admission_rejected_total", "counter", "Requests shed, the queue of their route class was full.", &AdmissionController::Stats::rejected);
+	writeAdmission("gallery_admission_expired_total", "counter", "Requests shed, they waited in the queue for too long.", &AdmissionController::Stats::expired);
+
+	const auto cacheStats = db_.getResponseCache().getStats();
+	writeMetric("gallery_response_cache_hits_total", "counter", "Documents replied from the response cache.", cacheStats.hits);
+	writeMetric("gallery_response_cache_misses_total", "counter", "Documents not found in the response cache.", cacheStats.misses);
+	writeMetric("gallery_response_cache_evictions_total", "counter", "Documents evicted from the response cache to make room.", cacheStats.evictions);
+	writeMetric("gallery_response_cache_invalidations_total", "counter", "Documents dropped from the response cache by writes.", cacheStats.invalidations);
+	writeMetric("gallery_response_cache_entries", "gauge", "Documents in the response cache.", cacheStats.entries);
+	writeMetric("gallery_response_cache_bytes", "gauge", "Bytes of the documents in the response cache.", cacheStats.bytes);
+
+	const auto flightStats = flights_.getStats();
+	writeMetric("gallery_single_flight_led_total", "counter", "Documents built while identical requests could wait for them.", flightStats.led);
+	writeMetric("gallery_single_flight_followed_total", "counter", "Requests that shared the document of an identical request in flight.", flightStats.followed);
+	writeMetric("gallery_single_flight_timeouts_total", "counter", "Requests that gave up waiting for an identical request in flight.", flightStats.timedOut);
+
+	const auto feedStats = db_.getChangeFeed().getStats();
+	writeMetric("gallery_change_feed_subscribers", "gauge", "Clients subscribed to the change feed.", feedStats.subscribers);
+	writeMetric("gallery_change_feed_published_total", "counter", "Changes published to the change feed.", feedStats.published);
+	writeMetric("gallery_change_feed_dropped_total", "counter", "Subscribers dropped, they did not keep up with the change feed.", feedStats.dropped);
+
+	writeMetric("gallery_log_dropped_total", "counter", "Log records dropped, the log ring was full.", Logger::instance().getDropped());
+
+	http_response response(status_codes::OK);
+	response.set_body(std::move(text), std::string("text/plain; version=0.0.4; charset=utf-8"));
+	response.headers().add(header_names::cache_control, U("no-store"));
+
+	Logger::debug("metrics", "Metrics retrieved successfully.");
+	return request.reply(response);
+}
+
+pplx::task<void> GalleryAPI::create_album(const http_request& request) const
+{
+	return extract_body(request).then([request, this](RequestBody body)
+	{
+		const RequestMeter meter(metrics_, "create_album");
 
-		const Album newAlbum(userId, albumName);
+		const auto input = decodeRequest<AlbumRequest>(body);
+
+		const Album newAlbum(input.userId, input.name);
 
 		db_.createAlbum(newAlbum);
 
-		std::cout << MAGENTA << "create_album:" << GREEN << " Album created successfully." << RESET << '\n';
+		Logger::debug("create_album", "Album created successfully.");
 		return request.reply(status_codes::OK, "Album created successfully.");
 
 	}).then([=](const pplx::task<void>& t)
 	{
-		try
-		{
-			t.get();
-		}
-		catch (const ItemAlreadyExistsException& e)
-		{
-			std::cout << MAGENTA << "create_album:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
-		}
-		catch (const ItemNotFoundException& e)
-		{
-			std::cout << MAGENTA << "create_album:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
-		{
-			std::cout << MAGENTA << "create_album:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
-		}
+		reply_on_failure(request, "create_album", t);
 	});
 }
 
-void GalleryAPI::create_user(const http_request& request) const
+pplx::task<void> GalleryAPI::create_user(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	return extract_body(request).then([request, this](RequestBody body)
 	{
-		// Check if the JSON object contains the "name" field
-		if (!requestBody.has_field(U("name")))
-		{
-			std::cout << MAGENTA << "create_user:" << RED << " Missing 'name' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'name' field in the request body.");
-			return pplx::task_from_result();
-		}
+		const RequestMeter meter(metrics_, "create_user");
+
+		const auto input = decodeRequest<CreateUserRequest>(body);
 
-		// parse the JSON object
-		const auto userName = utility::conversions::to_utf8string(requestBody.at(U("name")).as_string());
-		const User newUser(-1, userName);
+		const User newUser(-1, input.name);
 
 		db_.createUser(newUser);
 
-		std::cout << MAGENTA << "create_user:" << GREEN << " User created successfully." << RESET << '\n';
+		Logger::debug("create_user", "User created successfully.");
 		return request.reply(status_codes::OK, "User created successfully.");
 
 	}).then([=](const pplx::task<void>& t)
 	{
-		try
-		{
-			t.get();
-		}
-		catch (const ItemAlreadyExistsException& e)
-		{
-			std::cout << MAGENTA << "create_user:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
-		}
-		catch (const ItemNotFoundException& e)
-		{
-			std::cout << MAGENTA << "create_user:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
-		{
-			std::cout << MAGENTA << "create_user:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
-		}
+		reply_on_failure(request, "create_user", t);
 	});
 }
 
-void GalleryAPI::add_picture_to_album(const http_request& request) const
+pplx::task<void> GalleryAPI::add_picture_to_album(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	return extract_body(request).then([request, this](RequestBody body)
 	{
-		if (!requestBody.has_field(U("album_name")) || !requestBody.has_field(U("picture_name")) ||
-			!requestBody.has_field(U("path")))
-		{
-			std::cout << MAGENTA << "add_picture_to_album:" << RED << " Missing 'album_name', 'picture_name', or 'path' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'album_name', 'picture_name', or 'path' field in the request body.");
-			return pplx::task_from_result();
-		}
+		const RequestMeter meter(metrics_, "add_picture_to_album");
 
-		const auto albumName = utility::conversions::to_utf8string(requestBody.at(U("album_name")).as_string());
-		const auto pictureName = utility::conversions::to_utf8string(requestBody.at(U("picture_name")).as_string());
-		const auto picturePath = utility::conversions::to_utf8string(requestBody.at(U("path")).as_string());
+		const auto input = decodeRequest<AddPictureRequest>(body);
 
-		Picture new_picture(-1, pictureName);
-		new_picture.setPath(picturePath);
+		Picture new_picture(-1, input.pictureName);
+		new_picture.setPath(input.path);
 
-		db_.addPictureToAlbumByName(albumName, new_picture);
+		db_.addPictureToAlbumByName(input.albumName, new_picture);
 
-		std::cout << MAGENTA << "add_picture_to_album:" << GREEN << " Picture added to album successfully." << RESET << '\n';
+		Logger::debug("add_picture_to_album", "Picture added to album successfully.");
 		return request.reply(status_codes::OK, "Picture added to album successfully.");
 	}).then([=](const pplx::task<void>& t)
 	{
-		try
-		{
-			t.get();
-		}
-		catch (const ItemAlreadyExistsException& e)
-		{
-			std::cout << MAGENTA << "add_picture_to_album:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
-		}
-		catch (const ItemNotFoundException& e)
-		{
-			std::cout << MAGENTA << "add_picture_to_album:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
-		{
-			std::cout << MAGENTA << "add_picture_to_album:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
-		}
+		reply_on_failure(request, "add_picture_to_album", t);
 	});
 }
 
-void GalleryAPI::tag_user_in_picture(const http_request& request) const
+pplx::task<void> GalleryAPI::tag_user_in_picture(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	return extract_body(request).then([request, this](RequestBody body)
 	{
-		if (!requestBody.has_field(U("album_name")) || !requestBody.has_field(U("picture_name")) || !requestBody.has_field(U("user_id")))
-		{
-			std::cout << MAGENTA << "tag_user_in_picture:" << RED << " Missing 'album_name', 'picture_name', or 'user_id' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'album_name', 'picture_name', or 'user_id' field in the request body.");
-			return pplx::task_from_result();
-		}
+		const RequestMeter meter(metrics_, "tag_user_in_picture");
 
-		const auto albumName = utility::conversions::to_utf8string(requestBody.at(U("album_name")).as_string());
-		const auto pictureName = utility::conversions::to_utf8string(requestBody.at(U("picture_name")).as_string());
-		const auto userId = requestBody.at(U("user_id")).as_integer();
+		const auto input = decodeRequest<TagRequest>(body);
 
 		// Call a function to tag the user in the picture
-		db_.tagUserInPicture(albumName, pictureName, userId);
+		db_.tagUserInPicture(input.albumName, input.pictureName, input.userId);
 
-		std::cout << MAGENTA << "tag_user_in_picture:" << GREEN << " User tagged in picture successfully." << RESET << '\n';
+		Logger::debug("tag_user_in_picture", "User tagged in picture successfully.");
 		return request.reply(status_codes::OK, "User tagged in picture successfully.");
 	}).then([=](const pplx::task<void>& t)
 	{
-		try
-		{
-			t.get();
-		}
-		catch (const ItemAlreadyExistsException& e)
-		{
-			std::cout << MAGENTA << "tag_user_in_picture:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
-		}
-		catch (const ItemNotFoundException& e)
-		{
-			std::cout << MAGENTA << "tag_user_in_picture:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
-		{
-			std::cout << MAGENTA << "tag_user_in_picture:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
-		}
+		reply_on_failure(request, "tag_user_in_picture", t);
 	});
 }
 
-void GalleryAPI::delete_user(const http_request& request) const
+pplx::task<void> GalleryAPI::delete_user(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	return extract_body(request).then([request, this](RequestBody body)
 	{
-		// Check if the JSON object contains the "name" field
-		if (!requestBody.has_field(U("id")))
-		{
-			std::cout << MAGENTA << "delete_user:" << RED << " Missing 'id' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'id' field in the request body.");
-			return pplx::task_from_result();
-		}
+		const RequestMeter meter(metrics_, "delete_user");
 
-		// parse the JSON object
-		const auto userId = requestBody.at(U("id")).as_integer();
+		const auto input = decodeRequest<UserRequest>(body);
 
-		const User userToDelete(userId, "");
+		const User userToDelete(input.id, "");
 
 		db_.deleteUser(userToDelete);
 
-		std::cout << MAGENTA << "delete_user:" << GREEN << " User deleted successfully." << RESET << '\n';
+		Logger::debug("delete_user", "User deleted successfully.");
 		return request.reply(status_codes::OK, "User deleted successfully.");
 
 	}).then([=](const pplx::task<void>& t)
 	{
-		try
-		{
-			t.get();
-		}
-		catch (const ItemAlreadyExistsException& e)
-		{
-			std::cout << MAGENTA << "delete_user:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
-		}
-		catch (const ItemNotFoundException& e)
-		{
-			std::cout << MAGENTA << "delete_user:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
-		{
-			std::cout << MAGENTA << "delete_user:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
-		}
+		reply_on_failure(request, "delete_user", t);
 	});
 }
 
-void GalleryAPI::delete_album(const http_request& request) const
+pplx::task<void> GalleryAPI::delete_album(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	return extract_body(request).then([request, this](RequestBody body)
 	{
-		// Check if the JSON object contains the "name" field
-		if (!requestBody.has_field(U("name")) || !requestBody.has_field(U("user_id")))
-		{
-			std::cout << MAGENTA << "delete_album:" << RED << " Missing 'name' or 'user_id' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'name' or 'user_id' field in the request body.");
-			return pplx::task_from_result();
-		}
+		const RequestMeter meter(metrics_, "delete_album");
 
-		const auto userId = requestBody.at(U("user_id")).as_integer();
-		const auto albumName = utility::conversions::to_utf8string(requestBody.at(U("name")).as_string());
+		const auto input = decodeRequest<AlbumRequest>(body);
 
-		db_.deleteAlbum(albumName, userId);
+		db_.deleteAlbum(input.name, input.userId);
 
-		std::cout << MAGENTA << "delete_album:" << GREEN << " Album deleted successfully." << RESET << '\n';
+		Logger::debug("delete_album", "Album deleted successfully.");
 		return request.reply(status_codes::OK, "Album deleted successfully.");
 
 	}).then([=](const pplx::task<void>& t)
 	{
-		try
-		{
-			t.get();
-		}
-		catch (const ItemAlreadyExistsException& e)
-		{
-			std::cout << MAGENTA << "delete_album:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
-		}
-		catch (const ItemNotFoundException& e)
-		{
-			std::cout << MAGENTA << "delete_album:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
-		{
-			std::cout << MAGENTA << "delete_album:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
-		}
+		reply_on_failure(request, "delete_album", t);
 	});
 }
 
-void GalleryAPI::remove_picture_from_album(const http_request& request) const
+pplx::task<void> GalleryAPI::remove_picture_from_album(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	return extract_body(request).then([request, this](RequestBody body)
 	{
-		if (!requestBody.has_field(U("album_name")) || !requestBody.has_field(U("picture_name")))
-		{
-			std::cout << MAGENTA << "remove_picture_from_album:" << RED << " Missing 'album_name' or 'picture_name' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'album_name' or 'picture_name' field in the request body.");
-			return pplx::task_from_result();
-		}
+		const RequestMeter meter(metrics_, "remove_picture_from_album");
 
-		const auto albumName = utility::conversions::to_utf8string(requestBody.at(U("album_name")).as_string());
-		const auto pictureName = utility::conversions::to_utf8string(requestBody.at(U("picture_name")).as_string());
+		const auto input = decodeRequest<PictureRequest>(body);
 
 		// Call a function to remove the picture from the album
-		db_.removePictureFromAlbumByName(albumName, pictureName);
+		db_.removePictureFromAlbumByName(input.albumName, input.pictureName);
 
-		std::cout << MAGENTA << "remove_picture_from_album:" << GREEN << " Picture removed from album successfully." << RESET << '\n';
+		Logger::debug("remove_picture_from_album", "Picture removed from album successfully.");
 		return request.reply(status_codes::OK, "Picture removed from album successfully.");
 	}).then([=](const pplx::task<void>& t)
 	{
-		try
-		{
-			t.get();
-		}
-		catch (const ItemAlreadyExistsException& e)
-		{
-			std::cout << MAGENTA << "remove_picture_from_album:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
-		}
-		catch (const ItemNotFoundException& e)
-		{
-			std::cout << MAGENTA << "remove_picture_from_album:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
-		{
-			std::cout << MAGENTA << "remove_picture_from_album:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
-		}
+		reply_on_failure(request, "remove_picture_from_album", t);
 	});
 }
 
-void GalleryAPI::untag_user_in_picture(const http_request& request) const
+pplx::task<void> GalleryAPI::untag_user_in_picture(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	return extract_body(request).then([request, this](RequestBody body)
 	{
-		if (!requestBody.has_field(U("album_name")) || !requestBody.has_field(U("picture_name")) || !requestBody.has_field(U("user_id")))
-		{
-			std::cout << MAGENTA << "untag_user_in_picture:" << RED << " Missing 'album_name', 'picture_name', or 'user_id' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'album_name', 'picture_name', or 'user_id' field in the request body.");
-			return pplx::task_from_result();
-		}
+		const RequestMeter meter(metrics_, "untag_user_in_picture");
 
-		const auto albumName = utility::conversions::to_utf8string(requestBody.at(U("album_name")).as_string());
-		const auto pictureName = utility::conversions::to_utf8string(requestBody.at(U("picture_name")).as_string());
-		const auto userId = requestBody.at(U("user_id")).as_integer();
+		const auto input = decodeRequest<TagRequest>(body);
 
 		// Call a function to untag the user from the picture
-		db_.untagUserInPicture(albumName, pictureName, userId);
+		db_.untagUserInPicture(input.albumName, input.pictureName, input.userId);
 
-		std::cout << MAGENTA << "untag_user_in_picture:" << GREEN << " User untagged from picture successfully." << RESET << '\n';
+		Logger::debug("untag_user_in_picture", "User untagged from picture successfully.");
 		return request.reply(status_codes::OK, "User untagged from picture successfully.");
 	}).then([=](const pplx::task<void>& t)
 	{
-		try
-		{
-			t.get();
-		}
-		catch (const ItemAlreadyExistsException& e)
-		{
-			std::cout << MAGENTA << "untag_user_in_picture:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
-		}
-		catch (const ItemNotFoundException& e)
-		{
-			std::cout << MAGENTA << "untag_user_in_picture:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
-		{
-			std::cout << MAGENTA << "untag_user_in_picture:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
-		}
+		reply_on_failure(request, "untag_user_in_picture", t);
 	});
 }
 
-void GalleryAPI::get_albums(const http_request& request) const
+pplx::task<void> GalleryAPI::get_albums(const http_request& request) const
 {
-	try
+	// the listing is streamed by a pool thread, never by the listener or a continuation of another request
+	return pplx::create_task([request, this]
 	{
-		// Retrieve albums from the database
-		const std::list<Album> albums = db_.getAlbums();
+		const RequestMeter meter(metrics_, "get_albums");
 
-		const auto albumsJson = JsonHelper::albumsToJson(albums);
+		// the albums show their pictures count and the names of their owners
+		const auto etag = make_etag(request, db_.getVersions().get({ DataVersions::Table::ALBUMS, DataVersions::Table::PICTURES, DataVersions::Table::USERS }));
 
-		std::cout << MAGENTA << "get_albums:" << GREEN << " Albums retrieved successfully and parsed to JSON." << RESET << '\n';
-		request.reply(status_codes::OK, albumsJson);
-	}
-	catch (const ItemAlreadyExistsException& e)
-	{
-		std::cout << MAGENTA << "get_albums:" << RED << e.what() << RESET << '\n';
-		request.reply(status_codes::Conflict, e.what());
-	}
-	catch (const ItemNotFoundException& e)
-	{
-		std::cout << MAGENTA << "get_albums:" << RED << e.what() << RESET << '\n';
-		request.reply(status_codes::NotFound, e.what());
-	}
-	catch (const std::exception& e)
+		if (reply_if_not_modified(request, etag))
+		{
+			Logger::debug("get_albums", "Albums not modified.");
+			return pplx::task_from_result();
+		}
+
+		// stream the albums to the client as they are read from the database
+		const auto replied = reply_streamed(request, [this](StreamWriter& writer)
+		{
+			writer.beginArray();
+			db_.forEachAlbum([&writer](const Album& album, int picturesCount) { JsonHelper::writeAlbum(writer, album, picturesCount); });
+			writer.endArray();
+		}, etag);
+
+		Logger::debug("get_albums", "Albums retrieved successfully and streamed as JSON.");
+		return replied;
+	}).then([=](const pplx::task<void>& t)
 	{
-		std::cerr << MAGENTA << "get_albums:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-		request.reply(status_codes::InternalError, "Internal server error occurred.");
-	}
+		reply_on_failure(request, "get_albums", t);
+	});
 }
 
-void GalleryAPI::get_albums_of_user(const http_request& request) const
+pplx::task<void> GalleryAPI::get_albums_of_user(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	return extract_body(request).then([request, this](RequestBody body)
 	{
-		// Check if the JSON object contains the "name" field
-		if (!requestBody.has_field(U("id")))
-		{
-			std::cout << MAGENTA << "get_albums_of_user:" << RED << " Missing 'id' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'id' field in the request body.");
-			return pplx::task_from_result();
-		}
+		const RequestMeter meter(metrics_, "get_albums_of_user");
+
+		const auto input = decodeRequest<UserRequest>(body);
 
-		const auto userId = requestBody.at(U("id")).as_integer();
-		const User user(userId, "");
+		return reply_albums_of_user(request, input.id);
 
-		const std::list<Album> albums = db_.getAlbumsOfUser(user);
+	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "get_albums_of_user", t);
+	});
+}
 
-		const auto userAlbumsJson = JsonHelper::albumsToJson(albums);
+pplx::task<void> GalleryAPI::get_albums_of_user_by_path(const http_request& request, const RouteParams& params) const
+{
+	const auto userId = params.getInteger(U("id"));
 
-		std::cout << MAGENTA << "get_albums_of_user:" << GREEN << " Albums of user retrieved successfully and parsed to JSON." << RESET << '\n';
-		return request.reply(status_codes::OK, userAlbumsJson);
+	return pplx::create_task([request, userId, this]
+	{
+		const RequestMeter meter(metrics_, "get_albums_of_user_by_path");
 
+		return reply_albums_of_user(request, userId);
 	}).then([=](const pplx::task<void>& t)
 	{
-		try
-		{
-			t.get();
-		}
-		catch (const ItemAlreadyExistsException& e)
-		{
-			std::cout << MAGENTA << "get_albums_of_user:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
-		}
-		catch (const ItemNotFoundException& e)
-		{
-			std::cout << MAGENTA << "get_albums_of_user:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
-		{
-			std::cout << MAGENTA << "get_albums_of_user:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
-		}
+		reply_on_failure(request, "get_albums_of_user", t);
 	});
 }
 
-void GalleryAPI::get_users(const http_request& request) const
+pplx::task<void> GalleryAPI::reply_albums_of_user(const http_request& request, int userId) const
 {
-	try
-	{
-		// Retrieve albums from the database
-		const std::list<User> users = db_.getUsers();
+	const User user(userId, "");
 
-		const auto usersJson = JsonHelper::usersToJson(users);
+	const auto etag = make_etag(request, db_.getVersions().getUser(userId));
 
-		std::cout << MAGENTA << "get_users:" << GREEN << " Users retrieved successfully and parsed to JSON." << RESET << '\n';
-		request.reply(status_codes::OK, usersJson);
-	}
-	catch (const ItemAlreadyExistsException& e)
-	{
-		std::cout << MAGENTA << "get_users:" << RED << e.what() << RESET << '\n';
-		request.reply(status_codes::Conflict, e.what());
-	}
-	catch (const ItemNotFoundException& e)
+	if (reply_if_not_modified(request, etag))
 	{
-		std::cout << MAGENTA << "get_users:" << RED << e.what() << RESET << '\n';
-		request.reply(status_codes::NotFound, e.what());
+		Logger::debug("get_albums_of_user", "Albums of user not modified.");
+		return pplx::task_from_result();
 	}
-	catch (const std::exception& e)
+
+	// a missing user must be reported before the streamed reply starts
+	if (!db_.doesUserExists(userId))
+		throw ItemNotFoundException("User", userId);
+
+	const auto replied = reply_streamed(request, [this, &user](StreamWriter& writer)
 	{
-		std::cerr << MAGENTA << "get_users:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-		request.reply(status_codes::InternalError, "Internal server error occurred.");
-	}
+		writer.beginArray();
+		db_.forEachAlbumOfUser(user, [&writer](const Album& album, int picturesCount) { JsonHelper::writeAlbum(writer, album, picturesCount); });
+		writer.endArray();
+	}, etag);
+
+	Logger::debug("get_albums_of_user", "Albums of user retrieved successfully and streamed as JSON.");
+	return replied;
 }
 
-void GalleryAPI::get_user(const http_request& request) const
+pplx::task<void> GalleryAPI::get_users(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	return pplx::create_task([request, this]
 	{
-		// Check if the JSON object contains the "name" field
-		if (!requestBody.has_field(U("id")))
+		const RequestMeter meter(metrics_, "get_users");
+
+		const auto etag = make_etag(request, db_.getVersions().get({ DataVersions::Table::USERS }));
+
+		if (reply_if_not_modified(request, etag))
 		{
-			std::cout << MAGENTA << "get_user:" << RED << " Missing 'id' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'id' field in the request body.");
+			Logger::debug("get_users", "Users not modified.");
 			return pplx::task_from_result();
 		}
 
-		const auto userId = requestBody.at(U("id")).as_integer();
+		// stream the users to the client as they are read from the database
+		const auto replied = reply_streamed(request, [this](StreamWriter& writer)
+		{
+			writer.beginArray();
+			db_.forEachUser([&writer](const User& user) { JsonHelper::writeUser(writer, user); });
+			writer.endArray();
+		}, etag);
+
+		Logger::debug("get_users", "Users retrieved successfully and streamed as JSON.");
+		return replied;
+	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "get_users", t);
+	});
+}
 
-		const User user = db_.getUser(userId);
+pplx::task<void> GalleryAPI::get_user(const http_request& request) const
+{
+	return extract_body(request).then([request, this](RequestBody body)
+	{
+		const RequestMeter meter(metrics_, "get_user");
 
-		const auto userJson = JsonHelper::userToJson(user);
+		const auto input = decodeRequest<UserRequest>(body);
 
-		std::cout << MAGENTA << "get_user:" << GREEN << " User retrieved successfully and parsed to JSON." << RESET << '\n';
-		return request.reply(status_codes::OK, userJson);
+		return reply_user(request, input.id);
 
 	}).then([=](const pplx::task<void>& t)
 	{
-		try
-		{
-			t.get();
-		}
-		catch (const ItemAlreadyExistsException& e)
-		{
-			std::cout << MAGENTA << "get_user:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
-		}
-		catch (const ItemNotFoundException& e)
-		{
-			std::cout << MAGENTA << "get_user:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
-		{
-			std::cout << MAGENTA << "get_user:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
-		}
+		reply_on_failure(request, "get_user", t);
 	});
 }
 
-void GalleryAPI::get_user_albums_count(const http_request& request) const
+pplx::task<void> GalleryAPI::get_user_by_path(const http_request& request, const RouteParams& params) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	const auto userId = params.getInteger(U("id"));
+
+	return pplx::create_task([request, userId, this]
 	{
-		// Check if the JSON object contains the "name" field
-		if (!requestBody.has_field(U("id")))
-		{
-			std::cout << MAGENTA << "get_user_albums_count:" << RED << " Missing 'id' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'id' field in the request body.");
-			return pplx::task_from_result();
-		}
+		const RequestMeter meter(metrics_, "get_user_by_path");
+
+		return reply_user(request, userId);
+	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "get_user", t);
+	});
+}
 
-		const auto userId = requestBody.at(U("id")).as_integer();
-		const User user(userId, "");
-		const int count = db_.countAlbumsOwnedOfUser(user);
+pplx::task<void> GalleryAPI::reply_user(const http_request& request, int userId) const
+{
+	const User user = db_.getUser(userId);
 
-		const auto countJson = json::value::number(count);
+	const auto userJson = JsonHelper::userToJson(user);
 
-		std::cout << MAGENTA << "get_user_albums_count:" << GREEN << " User albums count retrieved successfully and parsed to JSON." << RESET << '\n';
-		return request.reply(status_codes::OK, countJson);
+	Logger::debug("get_user", "User retrieved successfully and parsed to JSON.");
+	return reply_document(request, userJson);
+}
 
-	}).then([=](const pplx::task<void>& t)
+pplx::task<void> GalleryAPI::get_user_albums_count(const http_request& request) const
+{
+	return extract_body(request).then([request, this](RequestBody body)
 	{
-		try
-		{
-			t.get();
-		}
-		catch (const ItemAlreadyExistsException& e)
+		const RequestMeter meter(metrics_, "get_user_albums_count");
+
+		const auto input = decodeRequest<UserRequest>(body);
+
+		const User user(input.id, "");
+		const auto replied = reply_user_statistic(request, "get_user_albums_count", input.id, [this, &user](StreamWriter& writer)
 		{
-			std::cout << MAGENTA << "get_user_albums_count:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
-		}
-		catch (const ItemNotFoundException& e)
+			writer.value(db_.countAlbumsOwnedOfUser(user));
+		});
+
+		Logger::debug("get_user_albums_count", "User albums count retrieved successfully.");
+		return replied;
+
+	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "get_user_albums_count", t);
+	});
+}
+
+pplx::task<void> GalleryAPI::get_albums_tagged_user_count(const http_request& request) const
+{
+	return extract_body(request).then([request, this](RequestBody body)
+	{
+		const RequestMeter meter(metrics_, "get_albums_tagged_user_count");
+
+		const auto input = decodeRequest<UserRequest>(body);
+
+		const User user(input.id, "");
+		const auto replied = reply_user_statistic(request, "get_albums_tagged_user_count", input.id, [this, &user](StreamWriter& writer)
 		{
-			std::cout << MAGENTA << "get_user_albums_count:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
+			writer.value(db_.countAlbumsTaggedOfUser(user));
+		});
+
+		Logger::debug("get_albums_tagged_user_count", "Albums tagged user count retrieved successfully.");
+		return replied;
+
+	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "get_albums_tagged_user_count", t);
+	});
+}
+
+pplx::task<void> GalleryAPI::get_count_tags_of_user(const http_request& request) const
+{
+	return extract_body(request).then([request, this](RequestBody body)
+	{
+		const RequestMeter meter(metrics_, "get_count_tags_of_user");
+
+		const auto input = decodeRequest<UserRequest>(body);
+
+		const User user(input.id, "");
+		const auto replied = reply_user_statistic(request, "get_count_tags_of_user", input.id, [this, &user](StreamWriter& writer)
 		{
-			std::cout << MAGENTA << "get_user_albums_count:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
-		}
+			writer.value(db_.countTagsOfUser(user));
+		});
+
+		Logger::debug("get_count_tags_of_user", "Count tags of user retrieved successfully.");
+		return replied;
+
+	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "get_count_tags_of_user", t);
 	});
 }
 
-void GalleryAPI::get_albums_tagged_user_count(const http_request& request) const
+pplx::task<void> GalleryAPI::get_average_tags_of_user_per_album(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	return extract_body(request).then([request, this](RequestBody body)
 	{
-		// Check if the JSON object contains the "name" field
-		if (!requestBody.has_field(U("id")))
+		const RequestMeter meter(metrics_, "get_average_tags_of_user_per_album");
+
+		const auto input = decodeRequest<UserRequest>(body);
+
+		const User user(input.id, "");
+		const auto replied = reply_user_statistic(request, "get_average_tags_of_user_per_album", input.id, [this, &user](StreamWriter& writer)
 		{
-			std::cout << MAGENTA << "get_albums_tagged_user_count:" << RED << " Missing 'id' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'id' field in the request body.");
-			return pplx::task_from_result();
-		}
+			writer.value(static_cast<double>(db_.averageTagsPerAlbumOfUser(user)));
+		});
+
+		Logger::debug("get_average_tags_of_user_per_album", "Average tags of user per album retrieved successfully.");
+		return replied;
+
+	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "get_average_tags_of_user_per_album", t);
+	});
+}
+
+pplx::task<void> GalleryAPI::get_album_pictures(const http_request& request) const
+{
+	return extract_body(request).then([request, this](RequestBody body)
+	{
+		const RequestMeter meter(metrics_, "get_album_pictures");
+
+		const auto input = decodeRequest<AlbumPicturesRequest>(body);
 
-		const auto userId = requestBody.at(U("id")).as_integer();
-		const User user(userId, "");
-		const int count = db_.countAlbumsTaggedOfUser(user);
+		return reply_album_pictures(request, input.ownerId, input.albumName);
+	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "get_album_pictures", t);
+	});
+}
 
-		const auto countJson = json::value::number(count);
+pplx::task<void> GalleryAPI::get_album_pictures_by_path(const http_request& request, const RouteParams& params) const
+{
+	const auto ownerId = params.getInteger(U("id"));
+	const auto albumName = utility::conversions::to_utf8string(params.get(U("album_name")));
 
-		std::cout << MAGENTA << "get_albums_tagged_user_count:" << GREEN << " Albums tagged user count retrieved successfully and parsed to JSON." << RESET << '\n';																
-		return request.reply(status_codes::OK, countJson);
+	return pplx::create_task([request, ownerId, albumName, this]
+	{
+		const RequestMeter meter(metrics_, "get_album_pictures_by_path");
 
+		return reply_album_pictures(request, ownerId, albumName);
 	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "get_album_pictures", t);
+	});
+}
+
+pplx::task<void> GalleryAPI::reply_album_pictures(const http_request& request, int ownerId, const std::string& albumName) const
+{
+	const Album album(ownerId, albumName);
+
+	// deleting the owner deletes the album, so the version of the owner counts too
+	const auto& versions = db_.getVersions();
+	const auto version = std::max(versions.getAlbum(albumName), versions.getUser(ownerId));
+	const auto etag = make_etag(request, version);
+
+	if (reply_if_not_modified(request, etag))
+	{
+		Logger::debug("get_album_pictures", "Album pictures not modified.");
+		return pplx::task_from_result();
+	}
+
+	const auto key = make_cache_key(request, "get_album_pictures", { std::to_string(ownerId), albumName });
+	const auto replied = reply_cached(request, key, { DataVersions::albumKey(albumName), DataVersions::userKey(ownerId) }, etag, version, [this, &album](StreamWriter& writer)
+	{
+		// a missing album must be reported before the streamed reply starts
+		if (!db_.doesAlbumExists(album.getName(), album.getOwnerId()))
+			throw ItemNotFoundException("Album", album.getName());
+
+		writer.beginArray();
+		db_.forEachAlbumPicture(album, [&writer](const Picture& picture) { JsonHelper::writePicture(writer, picture); });
+		writer.endArray();
+	});
+
+	Logger::debug("get_album_pictures", "Album pictures retrieved successfully and streamed as JSON.");
+	return replied;
+}
+
+pplx::task<void> GalleryAPI::subscribe_changes(const http_request& request) const
+{
+	return reply_change_stream(request, "subscribe_changes", {});
+}
+
+// the albums the user owns, and the pictures the user is tagged in or untagged from
+pplx::task<void> GalleryAPI::subscribe_user_changes(const http_request& request, const RouteParams& params) const
+{
+	ChangeFilter filter;
+	filter.userId = params.getInteger(U("id"));
+
+	return reply_change_stream(request, "subscribe_user_changes", std::move(filter));
+}
+
+pplx::task<void> GalleryAPI::subscribe_album_changes(const http_request& request, const RouteParams& params) const
+{
+	ChangeFilter filter;
+	filter.userId = params.getInteger(U("id"));
+	filter.albumName = utility::conversions::to_utf8string(params.get(U("album_name")));
+
+	return reply_change_stream(request, "subscribe_album_changes", std::move(filter));
+}
+
+// replies with a text/event-stream that gets an event per change the filter matches, until the client
+// goes away. Events are never waited for - a client that lets CHANGE_FEED_MAX_BUFFERED bytes of them pile
+// up is dropped from the feed and its stream is broken, so it knows to resubscribe and reload
+pplx::task<void> GalleryAPI::reply_change_stream(const http_request& request, const char* endpoint, ChangeFilter filter) const
+{
+	const auto stream = std::make_shared<StreamedResponse>();
+
+	// a comment, so the client sees the subscription before the first change
+	const std::string subscribed = ": subscribed\n\n";
+	stream->write(subscribed.data(), subscribed.size());
+
+	auto& feed = db_.getChangeFeed();
+	const auto subscriptionId = feed.subscribe(std::move(filter), [stream](const ChangeEvent& event)
+	{
+		std::string frame = "id: " + std::to_string(event.sequence) + "\nevent: " + ChangeEvent::typeName(event.type) + "\ndata: ";
+
+		const auto writer = StreamWriter::create(StreamWriter::Format::JSON, [&frame](const char* data, size_t size) { frame.append(data, size); });
+		JsonHelper::writeChangeEvent(*writer, event);
+		writer->flush();
+		frame += "\n\n";
+
+		if (stream->tryWrite(frame.data(), frame.size(), CHANGE_FEED_MAX_BUFFERED))
+			return true;
+
+		stream->abort(std::make_exception_ptr(MyException("The client does not keep up with the change feed.")));
+		return false;
+	},
+	[stream]()
+	{
+		// sending the comment is what fails the connection of a client that went away
+		const std::string ping = ": ping\n\n";
+
+		if (stream->tryWrite(ping.data(), ping.size(), CHANGE_FEED_MAX_BUFFERED))
+			return true;
+
+		stream->abort(std::make_exception_ptr(MyException("The client does not read the change feed.")));
+		return false;
+	});
+
+	if (!subscriptionId)
+	{
+		Logger::warning(endpoint, "Rejected, the change feed is full.");
+
+		http_response response(status_codes::ServiceUnavailable);
+		response.headers().add(header_names::retry_after, utility::conversions::to_string_t(std::to_string(ADMISSION_RETRY_AFTER_SECONDS)));
+		response.set_body("The change feed is full, retry later.");
+		return request.reply(response);
+	}
+
+	http_response response(status_codes::OK);
+	response.set_body(stream->body(), U("text/event-stream"));
+	response.headers().add(header_names::cache_control, U("no-cache"));
+
+	// the reply is done once the stream ends, however it ends, and only then the subscription goes away.
+	// It is not returned, so the admission slot of the request is released right away
+	request.reply(response).then([&feed, id = *subscriptionId](const pplx::task<void>& replied)
 	{
 		try
 		{
-			t.get();
-		}
-		catch (const ItemAlreadyExistsException& e)
-		{
-			std::cout << MAGENTA << "get_albums_tagged_user_count:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
-		}
-		catch (const ItemNotFoundException& e)
-		{
-			std::cout << MAGENTA << "get_albums_tagged_user_count:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
+			replied.wait();
 		}
-		catch (const std::exception& e)
+		catch (...)
 		{
-			std::cout << MAGENTA << "get_albums_tagged_user_count:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
+			// the client went away, nothing to tell it
 		}
+
+		feed.unsubscribe(id);
 	});
+
+	Logger::debug(endpoint, "Subscribed to the change feed.", { { "subscription", *subscriptionId } });
+	return pplx::task_from_result();
 }
 
-void GalleryAPI::get_count_tags_of_user(const http_request& request) const
+// GET /changes?since=<sequence> - the changes after the sequence, a page at a time. A client keeps the
+// sequence of the reply and asks from it the next time, the ids of the change feed events are the same
+// sequence numbers. A client with nothing yet, or told to do a full resync, loads everything through the
+// listings and continues from the sequence of the reply
+pplx::task<void> GalleryAPI::get_changes(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	return pplx::create_task([request, this]
 	{
-		// Check if the JSON object contains the "name" field
-		if (!requestBody.has_field(U("id")))
+		const RequestMeter meter(metrics_, "get_changes");
+
+		uint64_t since = 0;
+
+		const auto query = uri::split_query(request.relative_uri().query());
+		const auto sinceParameter = query.find(U("since"));
+
+		if (sinceParameter != query.end())
 		{
-			std::cout << MAGENTA << "get_count_tags_of_user:" << RED << " Missing 'id' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'id' field in the request body.");
-			return pplx::task_from_result();
-		}
+			const std::string sinceText = utility::conversions::to_utf8string(sinceParameter->second);
+
+			if (sinceText.empty() || sinceText.find_first_not_of("0123456789") != std::string::npos)
+				throw InvalidRequestException("The since parameter must be a sequence number.");
 
-		const auto userId = requestBody.at(U("id")).as_integer();
-		const User user(userId, "");
-		const int count = db_.countTagsOfUser(user);
+			try
+			{
+				since = std::stoull(sinceText);
+			}
+			catch (const std::out_of_range&)
+			{
+				throw InvalidRequestException("The since parameter must be a sequence number.");
+			}
+		}
 
-		const auto countJson = json::value::number(count);
+		const ChangeLogDelta delta = db_.getChangesSince(since);
 
-		std::cout << MAGENTA << "get_count_tags_of_user:" << GREEN << " Count tags of user retrieved successfully and parsed to JSON." << RESET << '\n';																																
-		return request.reply(status_codes::OK, countJson);
+		if (delta.isResyncRequired)
+			Logger::warning("get_changes", "The sequence is out of the change log retention, full resync required.", { { "since", since } });
+		else
+			Logger::debug("get_changes", "Changes retrieved successfully.", { { "since", since }, { "rows", delta.changes.size() } });
 
+		return reply_streamed(request, [&delta](StreamWriter& writer) { JsonHelper::writeChangeLogDelta(writer, delta); });
 	}).then([=](const pplx::task<void>& t)
 	{
-		try
+		reply_on_failure(request, "get_changes", t);
+	});
+}
+
+pplx::task<void> GalleryAPI::get_picture_tags(const http_request& request) const
+{
+	return extract_body(request).then([request, this](RequestBody body)
+	{
+		const RequestMeter meter(metrics_, "get_picture_tags");
+
+		const auto input = decodeRequest<PictureTagsRequest>(body);
+
+		const auto version = db_.getVersions().getPicture(input.id);
+		const auto etag = make_etag(request, version);
+
+		if (reply_if_not_modified(request, etag))
 		{
-			t.get();
+			Logger::debug("get_picture_tags", "Picture tags not modified.");
+			return pplx::task_from_result();
 		}
-		catch (const ItemAlreadyExistsException& e)
+
+		auto& cache = db_.getResponseCache();
+		const auto key = make_cache_key(request, "get_picture_tags", { std::to_string(input.id), input.name });
+
+		if (const auto document = cache.get(key, version))
 		{
-			std::cout << MAGENTA << "get_count_tags_of_user:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
+			Logger::debug("get_picture_tags", "Picture tags served from the response cache.");
+			return reply_built(request, document, etag);
 		}
-		catch (const ItemNotFoundException& e)
+
+		pplx::task<void> replied;
+
+		flights_.run(key + '@' + std::to_string(version), [&]()
 		{
-			std::cout << MAGENTA << "get_count_tags_of_user:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
+			const Picture pic(input.id, input.name);
+
+			RequestArena arena;
+			const auto picTags = db_.getPictureTags(pic, arena.resource());
+
+			const auto picTagsJson = JsonHelper::usersToJson(picTags);
+			const auto document = std::make_shared<const std::string>(encode_document(request, picTagsJson));
+			replied = reply_with_arena_stats(request, *document, etag, arena);
+
+			cache.put(key, { DataVersions::pictureKey(input.id) }, version, document);
+
+			Logger::debug("get_picture_tags", "Picture tags retrieved successfully and parsed to JSON.");
+			return document;
+		}, [&](const SingleFlight::Document& document)
 		{
-			std::cout << MAGENTA << "get_count_tags_of_user:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
-		}
+			Logger::debug("get_picture_tags", "Picture tags shared by an identical request in flight.");
+			replied = reply_built(request, document, etag);
+		});
+
+		return replied;
+
+	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "get_picture_tags", t);
 	});
 }
 
-void GalleryAPI::get_average_tags_of_user_per_album(const http_request& request) const
+pplx::task<void> GalleryAPI::get_users_by_ids(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	return extract_body(request).then([request, this](RequestBody body)
 	{
-		// Check if the JSON object contains the "name" field
-		if (!requestBody.has_field(U("id")))
-		{
-			std::cout << MAGENTA << "get_average_tags_of_user_per_album:" << RED << " Missing 'id' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'id' field in the request body.");
-			return pplx::task_from_result();
-		}
+		const RequestMeter meter(metrics_, "get_users_by_ids");
 
-		const auto userId = requestBody.at(U("id")).as_integer();
-		const User user(userId, "");
-		const float average = db_.averageTagsPerAlbumOfUser(user);
+		const auto input = decodeRequest<IDsRequest>(body);
+		checkLookupSize(input.ids);
 
-		const auto averageJson = json::value::number(average);
+		const auto users = db_.lookupUsers(input.ids);
 
-		std::cout << MAGENTA << "get_average_tags_of_user_per_album:" << GREEN << " Average tags of user per album retrieved successfully and parsed to JSON." << RESET << '\n';
-		return request.reply(status_codes::OK, averageJson);
+		Logger::debug("get_users_by_ids", "Users retrieved successfully and streamed as JSON.", { { "rows", users.size() } });
+		return reply_streamed(request, [&](StreamWriter& writer) { JsonHelper::writeUsersLookup(writer, input.ids, users); });
 
 	}).then([=](const pplx::task<void>& t)
 	{
-		try
-		{
-			t.get();
-		}
-		catch (const ItemAlreadyExistsException& e)
-		{
-			std::cout << MAGENTA << "get_average_tags_of_user_per_album:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
-		}
-		catch (const ItemNotFoundException& e)
-		{
-			std::cout << MAGENTA << "get_average_tags_of_user_per_album:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
-		{
-			std::cout << MAGENTA << "get_average_tags_of_user_per_album:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
-		}
+		reply_on_failure(request, "get_users_by_ids", t);
 	});
 }
 
-void GalleryAPI::get_album_pictures(const http_request& request) const
+pplx::task<void> GalleryAPI::get_albums_by_names(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	return extract_body(request).then([request, this](RequestBody body)
 	{
-		// Check if the JSON object contains the "name" field
-		if (!requestBody.has_field(U("owner_id")) || !requestBody.has_field(U("album_name")))
-		{
-			std::cout << MAGENTA << "get_album_pictures:" << RED << " Missing 'owner_id' or 'album_name' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'owner_id' or 'album_name' field in the request body.");
-			return pplx::task_from_result();
-		}
+		const RequestMeter meter(metrics_, "get_albums_by_names");
+
+		const auto input = decodeRequest<NamesRequest>(body);
+		checkLookupSize(input.names);
+
+		const auto albums = db_.lookupAlbums(input.names);
 
+		Logger::debug("get_albums_by_names", "Albums retrieved successfully and streamed as JSON.", { { "rows", albums.size() } });
+		return reply_streamed(request, [&](StreamWriter& writer) { JsonHelper::writeAlbumsLookup(writer, input.names, albums); });
+
+	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "get_albums_by_names", t);
+	});
+}
 
-		const auto ownerId = requestBody.at(U("owner_id")).as_integer();
-		const auto albumName = utility::conversions::to_utf8string(requestBody.at(U("album_name")).as_string());
+pplx::task<void> GalleryAPI::get_pictures_by_ids(const http_request& request) const
+{
+	return extract_body(request).then([request, this](RequestBody body)
+	{
+		const RequestMeter meter(metrics_, "get_pictures_by_ids");
 
-		const Album album(ownerId, albumName);
-		const std::list<Picture> album_pictures = db_.getAlbumPictures(album);
+		const auto input = decodeRequest<IDsRequest>(body);
+		checkLookupSize(input.ids);
 
-		const auto picturesJson = JsonHelper::picturesToJson(album_pictures);
+		const auto pictures = db_.lookupPictures(input.ids);
 
-		std::cout << MAGENTA << "get_album_pictures:" << GREEN << " Album pictures retrieved successfully and parsed to JSON." << RESET << '\n';
-		return request.reply(status_codes::OK, picturesJson);
+		Logger::debug("get_pictures_by_ids", "Pictures retrieved successfully and streamed as JSON.", { { "rows", pictures.size() } });
+		return reply_streamed(request, [&](StreamWriter& writer) { JsonHelper::writePicturesLookup(writer, input.ids, pictures); });
 
 	}).then([=](const pplx::task<void>& t)
 	{
-		try
-		{
-			t.get();
-		}
-		catch (const ItemAlreadyExistsException& e)
-		{
-			std::cout << MAGENTA << "get_album_pictures:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
-		}
-		catch (const ItemNotFoundException& e)
-		{
-			std::cout << MAGENTA << "get_album_pictures:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
-		{
-			std::cout << MAGENTA << "get_album_pictures:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
-		}
+		reply_on_failure(request, "get_pictures_by_ids", t);
 	});
 }
 
-void GalleryAPI::get_picture_tags(const http_request& request) const
+
+pplx::task<void> GalleryAPI::query_tagged_pictures(const http_request& request) const
 {
-	request.extract_json().then([request, this](json::value requestBody)
+	return extract_body(request).then([request, this](RequestBody body)
 	{
-		// Check if the JSON object contains the "name" field
-		if (!requestBody.has_field(U("id")) || !requestBody.has_field(U("name")))
-		{
-			std::cout << MAGENTA << "get_picture_tags:" << RED << " Missing 'id' or 'name' field in the request body." << RESET << '\n';
-			request.reply(status_codes::BadRequest, "Missing 'id' or 'name' field in the request body.");
-			return pplx::task_from_result();
-		}
+		const RequestMeter meter(metrics_, "query_tagged_pictures");
+
+		const TagQuery query = decodeTagQuery(body);
+		const std::vector<int> pictureIDs = db_.queryTaggedPictures(query);
 
+		const auto resultJson = JsonHelper::pictureIDsToJson(pictureIDs);
 
-		const auto picID = requestBody.at(U("id")).as_integer();
-		const auto picName = utility::conversions::to_utf8string(requestBody.at(U("name")).as_string());
+		Logger::debug("query_tagged_pictures", "Query evaluated successfully and parsed to JSON.");
+		return reply_document(request, resultJson);
 
-		const Picture pic(picID, picName);
-		const auto picTags = db_.getPictureTags(pic);
+	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "query_tagged_pictures", t);
+	});
+}
+
+pplx::task<void> GalleryAPI::get_co_tagged_users(const http_request& request) const
+{
+	return extract_body(request).then([request, this](RequestBody body)
+	{
+		const RequestMeter meter(metrics_, "get_co_tagged_users");
+
+		const auto input = decodeRequest<CoTaggedUsersRequest>(body);
+
+		const User user(input.id, "");
 
-		const auto picTagsJson = JsonHelper::usersToJson(picTags);
+		const auto coTaggedUsers = db_.getTopCoTaggedUsers(user, input.count);
 
-		std::cout << MAGENTA << "get_picture_tags:" << GREEN << " Picture tags retrieved successfully and parsed to JSON." << RESET << '\n';
-		return request.reply(status_codes::OK, picTagsJson);
+		const auto coTaggedUsersJson = JsonHelper::coTaggedUsersToJson(coTaggedUsers);
+
+		Logger::debug("get_co_tagged_users", "Co-tagged users retrieved successfully and parsed to JSON.");
+		return reply_document(request, coTaggedUsersJson);
 
 	}).then([=](const pplx::task<void>& t)
 	{
-		try
+		reply_on_failure(request, "get_co_tagged_users", t);
+	});
+}
+
+pplx::task<void> GalleryAPI::get_co_tag_strength(const http_request& request) const
+{
+	return extract_body(request).then([request, this](RequestBody body)
+	{
+		const RequestMeter meter(metrics_, "get_co_tag_strength");
+
+		const auto input = decodeRequest<CoTagStrengthRequest>(body);
+
+		const User firstUser(input.firstId, "");
+		const User secondUser(input.secondId, "");
+
+		const int sharedPictures = db_.countCoTags(firstUser, secondUser);
+
+		const auto countJson = json::value::number(sharedPictures);
+
+		Logger::debug("get_co_tag_strength", "Co-tag strength retrieved successfully and parsed to JSON.");
+		return reply_document(request, countJson);
+
+	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "get_co_tag_strength", t);
+	});
+}
+
+pplx::task<void> GalleryAPI::suggest_tags(const http_request& request) const
+{
+	return extract_body(request).then([request, this](RequestBody body)
+	{
+		const RequestMeter meter(metrics_, "suggest_tags");
+
+		const auto input = decodeRequest<SuggestTagsRequest>(body);
+
+		const auto suggestions = db_.suggestTags(input.albumName, input.pictureName, input.count);
+
+		const auto suggestionsJson = JsonHelper::tagSuggestionsToJson(suggestions);
+
+		Logger::debug("suggest_tags", "Tag suggestions computed successfully and parsed to JSON.");
+		return reply_document(request, suggestionsJson);
+
+	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "suggest_tags", t);
+	});
+}
+
+pplx::task<void> GalleryAPI::batch(const http_request& request) const
+{
+	return extract_body(request).then([request, this](RequestBody body)
+	{
+		// the operations keep views into the body, both live until the batch ran
+		const auto document = std::make_shared<const RequestBody>(std::move(body));
+		const auto input = std::make_shared<const BatchRequest>(decodeRequest<BatchRequest>(*document));
+
+		// a batch of reads must not wait behind the writes, nor take their slots. The batch is not
+		// returned, so the slot it was decoded in is released once it is queued
+		admission_.submit(batch_.classify(*input),
+			[request, this, document, input]()
+			{
+				return pplx::create_task([request, this, document, input]
+				{
+					const RequestMeter meter(metrics_, "batch");
+
+					// the results are encoded in the format of the reply already
+					const std::string results = batch_.execute(*input, negotiate_format(request));
+
+					Logger::debug("batch", "Batch ran successfully.", { { "rows", input->operations.size() } });
+					return reply_streamed(request, [&results](StreamWriter& writer) { writer.raw(results); });
+
+				}).then([=](const pplx::task<void>& t)
+				{
+					reply_on_failure(request, "batch", t);
+				});
+			},
+			[request]() { reply_busy(request, "batch"); },
+			[request]() { request.reply(status_codes::InternalError, "Internal server error occurred."); });
+
+	}).then([=](const pplx::task<void>& t)
+	{
+		reply_on_failure(request, "batch", t);
+	});
+}
+
+// helper functions //
+// sheds a request admission control had no room for, fast and without touching the database
+void GalleryAPI::reply_busy(const http_request& request, const char* endpoint)
+{
+	Logger::debug(endpoint, "Rejected, the server is busy.");
+
+	http_response response(status_codes::ServiceUnavailable);
+	response.headers().add(header_names::retry_after, utility::conversions::to_string_t(std::to_string(ADMISSION_RETRY_AFTER_SECONDS)));
+	response.set_body("The server is busy, retry later.");
+	request.reply(response);
+}
+
+// client errors and shed requests are warnings, the server failed on the other 5xx statuses
+LogLevel GalleryAPI::log_level_of(status_code status)
+{
+	if (status == status_codes::ServiceUnavailable || (status >= 400 && status < 500))
+		return LogLevel::WARNING;
+
+	return status >= 500 ? LogLevel::FAILURE : LogLevel::INFO;
+}
+
+// replies to a failed request with the status its exception stands for
+void GalleryAPI::reply_on_failure(const http_request& request, const char* endpoint, const pplx::task<void>& task)
+{
+	try
+	{
+		task.get();
+	}
+	catch (const InvalidRequestException& e)
+	{
+		Logger::warning(endpoint, e.what());
+		request.reply(status_codes::BadRequest, e.what());
+	}
+	catch (const ItemAlreadyExistsException& e)
+	{
+		Logger::warning(endpoint, e.what());
+		request.reply(status_codes::Conflict, e.what());
+	}
+	catch (const ItemNotFoundException& e)
+	{
+		Logger::warning(endpoint, e.what());
+		request.reply(status_codes::NotFound, e.what());
+	}
+	catch (const std::exception& e)
+	{
+		Logger::failure(endpoint, std::string("Internal server error occurred: ") + e.what());
+		request.reply(status_codes::InternalError, "Internal server error occurred.");
+	}
+}
+
+// replies with the body and reports how much the request arena allocated in the response headers
+pplx::task<void> GalleryAPI::reply_with_arena_stats(const http_request& request, const std::string& document, const utility::string_t& etag, const RequestArena& arena)
+{
+	http_response response(status_codes::OK);
+	set_document_body(request, response, document);
+	response.headers().add(header_names::etag, etag);
+
+	response.headers().add(U("X-Arena-Allocations"), utility::conversions::to_string_t(std::to_string(arena.getAllocationsCount())));
+	response.headers().add(U("X-Arena-Bytes"), utility::conversions::to_string_t(std::to_string(arena.getBytesAllocated())));
+	response.headers().add(U("X-Arena-Heap-Blocks"), utility::conversions::to_string_t(std::to_string(arena.getHeapBlocksCount())));
+
+	return request.reply(response);
+}
+
+// replies with a document written by write while it is sent, instead of building it first. The
+// document is JSON, or CBOR for clients that prefer it.
+// The reply starts once RESPONSE_COMPRESSION_THRESHOLD bytes were written - smaller documents are sent
+// as they are, bigger ones are compressed on the way if the client accepts it. A failure before that
+// is thrown to the handler, after it the status can not change anymore and the transfer is cut short,
+// so handlers check for missing items before calling this.
+// A given document is filled with the document as it was written, before compression - or left empty
+// if the reply failed or the document outgrew RESPONSE_CACHE_MAX_DOCUMENT_SIZE
+pplx::task<void> GalleryAPI::reply_streamed(const http_request& request, const std::function<void(StreamWriter&)>& write, const utility::string_t& etag, std::string* document)
+{
+	const auto encoding = negotiate_encoding(request);
+	const auto format = negotiate_format(request);
+
+	std::shared_ptr<StreamedResponse> stream;
+	std::unique_ptr<ResponseCompressor> compressor;
+	pplx::task<void> replied;
+	std::string pending;	// the start of the document, until it is big enough to decide on compression
+
+	const auto start = [&](bool isCompressed)
+	{
+		stream = std::make_shared<StreamedResponse>();
+
+		http_response response(status_codes::OK);
+		response.set_body(stream->body(), utility::conversions::to_string_t(StreamWriter::contentType(format)));
+
+		if (!etag.empty())
+			response.headers().add(header_names::etag, etag);
+
+		if (isCompressed)
 		{
-			t.get();
+			response.headers().add(header_names::content_encoding, utility::conversions::to_string_t(ResponseCompressor::name(encoding)));
+			compressor = std::make_unique<ResponseCompressor>(encoding, RESPONSE_COMPRESSION_LEVEL, [&stream](const char* data, size_t size) { stream->write(data, size); });
 		}
-		catch (const ItemAlreadyExistsException& e)
+
+		response.headers().add(header_names::vary, U("Accept, Accept-Encoding"));
+		replied = request.reply(response);
+	};
+
+	const auto send = [&](const char* data, size_t size)
+	{
+		if (compressor)
+			compressor->write(data, size);
+		else
+			stream->write(data, size);
+	};
+
+	const auto keep = [&document](const char* data, size_t size)
+	{
+		if (document == nullptr)
+			return;
+
+		if (document->size() + size > RESPONSE_CACHE_MAX_DOCUMENT_SIZE)
 		{
-			std::cout << MAGENTA << "get_picture_tags:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::Conflict, e.what());
+			std::string().swap(*document);
+			document = nullptr;
+			return;
 		}
-		catch (const ItemNotFoundException& e)
+
+		document->append(data, size);
+	};
+
+	try
+	{
+		const auto writer = StreamWriter::create(format, [&](const char* data, size_t size)
 		{
-			std::cout << MAGENTA << "get_picture_tags:" << RED << e.what() << RESET << '\n';
-			request.reply(status_codes::NotFound, e.what());
-		}
-		catch (const std::exception& e)
+			keep(data, size);
+
+			if (stream)
+			{
+				send(data, size);
+				return;
+			}
+
+			pending.append(data, size);
+
+			if (pending.size() >= RESPONSE_COMPRESSION_THRESHOLD)
+			{
+				start(encoding != ResponseCompressor::Encoding::IDENTITY);
+				send(pending.data(), pending.size());
+				std::string().swap(pending);
+			}
+		});
+
+		write(*writer);
+		writer->flush();
+
+		if (!stream)
 		{
-			std::cout << MAGENTA << "get_picture_tags:" << RED << " Internal server error occurred: " << e.what() << RESET << '\n';
-			request.reply(status_codes::InternalError, "Internal server error occurred.");
+			start(false);
+			send(pending.data(), pending.size());
 		}
+
+		if (compressor)
+			compressor->finish();
+
+		stream->close();
+	}
+	catch (const std::exception& e)
+	{
+		if (document != nullptr)
+			std::string().swap(*document);
+
+		if (!stream)
+			throw;
+
+		Logger::failure("reply_streamed", std::string("Streaming the response failed: ") + e.what());
+		stream->abort(std::current_exception());
+	}
+
+	return replied;
+}
+
+// replies with the cached document of key if it was built at version, and otherwise with the document
+// written by write, which is cached for the next requests as long as it is not too big. Identical
+// requests arriving while it is written wait for it, instead of running the same queries again
+pplx::task<void> GalleryAPI::reply_cached(const http_request& request, const std::string& key, std::vector<std::string> dependencies, const utility::string_t& etag, uint64_t version, const std::function<void(StreamWriter&)>& write) const
+{
+	auto& cache = db_.getResponseCache();
+
+	if (const auto document = cache.get(key, version))
+	{
+		Logger::debug("reply_cached", "Served from the response cache.");
+		return reply_built(request, document, etag);
+	}
+
+	pplx::task<void> replied;
+
+	// a request of a newer version must not wait for a document of an older one
+	flights_.run(key + '@' + std::to_string(version), [&]() -> SingleFlight::Document
+	{
+		std::string written;
+		replied = reply_streamed(request, write, etag, &written);
+
+		if (written.empty())
+			return nullptr;
+
+		const auto document = std::make_shared<const std::string>(std::move(written));
+		cache.put(key, std::move(dependencies), version, document);
+
+		return document;
+	}, [&](const SingleFlight::Document& document)
+	{
+		Logger::debug("reply_cached", "Shared by an identical request in flight.");
+		replied = reply_built(request, document, etag);
+	});
+
+	return replied;
+}
+
+// replies with a document that was already written, in the format of the request
+pplx::task<void> GalleryAPI::reply_built(const http_request& request, const SingleFlight::Document& document, const utility::string_t& etag)
+{
+	return reply_streamed(request, [&document](StreamWriter& writer) { writer.raw(*document); }, etag);
+}
+
+// replies with a statistic of a user, which only changes along with the version of the user
+pplx::task<void> GalleryAPI::reply_user_statistic(const http_request& request, const char* endpoint, int userId, const std::function<void(StreamWriter&)>& write) const
+{
+	const auto version = db_.getVersions().getUser(userId);
+	const auto etag = make_etag(request, version);
+
+	if (reply_if_not_modified(request, etag))
+	{
+		Logger::debug(endpoint, "Not modified.");
+		return pplx::task_from_result();
+	}
+
+	const auto key = make_cache_key(request, endpoint, { std::to_string(userId) });
+	return reply_cached(request, key, { DataVersions::userKey(userId) }, etag, version, write);
+}
+
+// the endpoint, the negotiated format and the normalized request - the fields of the decoded request in
+// a fixed order, each prefixed by its length so no two requests share a key
+std::string GalleryAPI::make_cache_key(const http_request& request, const char* endpoint, std::initializer_list<std::string> fields)
+{
+	std::string key = endpoint;
+	key += negotiate_format(request) == StreamWriter::Format::CBOR ? "/cbor" : "/json";
+
+	for (const auto& field : fields)
+		key += '/' + std::to_string(field.size()) + ':' + field;
+
+	return key;
+}
+
+// a strong ETag for a data version. The versions start over with every run of the server, so the
+// ETag carries the time the server started as well. A compressed or CBOR reply is another
+// representation of the same data, so the negotiated encoding and format are part of the ETag too
+utility::string_t GalleryAPI::make_etag(const http_request& request, uint64_t version)
+{
+	static const auto startTime = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+	std::string etag = "\"" + std::to_string(startTime) + "-" + std::to_string(version);
+
+	if (negotiate_format(request) == StreamWriter::Format::CBOR)
+		etag += "-cbor";
+
+	const auto encoding = negotiate_encoding(request);
+	if (encoding != ResponseCompressor::Encoding::IDENTITY)
+		etag += std::string("-") + ResponseCompressor::name(encoding);
+
+	return utility::conversions::to_string_t(etag + "\"");
+}
+
+// replies with 304 Not Modified if the request already holds the current version of the reply.
+// The version must be read before the data it covers, so a write racing the reply can only make
+// the reply carry an older ETag than its data, never a newer one
+bool GalleryAPI::reply_if_not_modified(const http_request& request, const utility::string_t& etag)
+{
+	const auto ifNoneMatch = request.headers().find(header_names::if_none_match);
+	if (ifNoneMatch == request.headers().end())
+		return false;
+
+	// a list of ETags, "*" matches any, and If-None-Match compares weak ETags as if they were strong
+	bool isMatching = false;
+	std::stringstream candidates(utility::conversions::to_utf8string(ifNoneMatch->second));
+	std::string candidate;
+
+	while (!isMatching && std::getline(candidates, candidate, ','))
+	{
+		const size_t start = candidate.find_first_not_of(" \t");
+		const size_t end = candidate.find_last_not_of(" \t");
+
+		if (start == std::string::npos)
+			continue;
+
+		candidate = candidate.substr(start, end - start + 1);
+		if (candidate.rfind("W/", 0) == 0)
+			candidate.erase(0, 2);
+
+		isMatching = candidate == "*" || utility::conversions::to_string_t(candidate) == etag;
+	}
+
+	if (!isMatching)
+		return false;
+
+	http_response response(status_codes::NotModified);
+	response.headers().add(header_names::etag, etag);
+	request.reply(response);
+
+	return true;
+}
+
+ResponseCompressor::Encoding GalleryAPI::negotiate_encoding(const http_request& request)
+{
+	const auto acceptEncoding = request.headers().find(header_names::accept_encoding);
+	if (acceptEncoding == request.headers().end())
+		return ResponseCompressor::Encoding::IDENTITY;
+
+	return ResponseCompressor::negotiate(utility::conversions::to_utf8string(acceptEncoding->second));
+}
+
+StreamWriter::Format GalleryAPI::negotiate_format(const http_request& request)
+{
+	const auto accept = request.headers().find(header_names::accept);
+	if (accept == request.headers().end())
+		return StreamWriter::Format::JSON;
+
+	return StreamWriter::negotiate(utility::conversions::to_utf8string(accept->second));
+}
+
+// the body of a request along with its format, the handlers decode a CBOR body as it is
+pplx::task<RequestBody> GalleryAPI::extract_body(const http_request& request)
+{
+	const std::string contentType = utility::conversions::to_utf8string(request.headers().content_type());
+
+	if (contentType.rfind(StreamWriter::contentType(StreamWriter::Format::CBOR), 0) != 0)
+	{
+		return request.extract_utf8string(true).then([](std::string body)
+		{
+			return RequestBody{ std::move(body), RequestFormat::JSON };
+		});
+	}
+
+	return request.extract_vector().then([](const std::vector<unsigned char>& body)
+	{
+		return RequestBody{ std::string(body.begin(), body.end()), RequestFormat::CBOR };
 	});
 }
+
+// replies with a document built as a json::value, in the negotiated format
+pplx::task<void> GalleryAPI::reply_document(const http_request& request, const json::value& body)
+{
+	http_response response(status_codes::OK);
+	set_document_body(request, response, encode_document(request, body));
+
+	return request.reply(response);
+}
+
+// a document built as a json::value, written in the negotiated format
+std::string GalleryAPI::encode_document(const http_request& request, const json::value& body)
+{
+	std::string document;
+
+	const auto writer = StreamWriter::create(negotiate_format(request), [&document](const char* data, size_t size) { document.append(data, size); });
+	JsonHelper::writeValue(*writer, body);
+	writer->flush();
+
+	return document;
+}
+
+void GalleryAPI::set_document_body(const http_request& request, http_response& response, const std::string& document)
+{
+	response.set_body(std::vector<unsigned char>(document.begin(), document.end()));
+	response.headers().set_content_type(utility::conversions::to_string_t(StreamWriter::contentType(negotiate_format(request))));
+	response.headers().add(header_names::vary, U("Accept"));
+}
@@ -1,6 +1,16 @@
 #pragma once
 #include <cpprest/http_listener.h>
+#include "AdmissionController.h"
+#include "BatchExecutor.h"
+#include "ChangeFeed.h"
 #include "DatabaseAccess.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "StreamWriter.h"
+#include "RequestArena.h"
+#include "ResponseCompressor.h"
+#include "Router.h"
+#include "SingleFlight.h"
 
 using namespace web;
 using namespace web::http;
@@ -15,33 +25,110 @@ public:
     void handle_request(const http_request& request) const;
 
 private:
+    using Handler = pplx::task<void> (GalleryAPI::*)(const http_request&) const;
+    using ParamsHandler = pplx::task<void> (GalleryAPI::*)(const http_request&, const RouteParams&) const;
+
     http_listener listener_;
     DatabaseAccess db_;
+    BatchExecutor batch_;
+    Router router_;
+    mutable AdmissionController admission_;
+    mutable SingleFlight flights_;
+    mutable Metrics metrics_;
+
+    // routing functions
+    void register_routes();
+    void add_route(const method& method, const utility::string_t& pattern, RouteInfo info, Handler handler);
+    void add_route(const method& method, const utility::string_t& pattern, RouteInfo info, ParamsHandler handler);
+    static void set_log_sampling(const RouteInfo& info);
 
     // db related functions
-    void clear_db(const http_request& request) const;
+    pplx::task<void> clear_db(const http_request& request) const;
+    pplx::task<void> admission_stats(const http_request& request) const;
+    pplx::task<void> response_cache_stats(const http_request& request) const;
+    pplx::task<void> get_metrics(const http_request& request) const;
 
     // creation endpoints
-    void create_album(const http_request& request) const;
-    void create_user(const http_request& request) const;
-    void add_picture_to_album(const http_request& request) const;
-    void tag_user_in_picture(const http_request& request) const;
+    pplx::task<void> create_album(const http_request& request) const;
+    pplx::task<void> create_user(const http_request& request) const;
+    pplx::task<void> add_picture_to_album(const http_request& request) const;
+    pplx::task<void> tag_user_in_picture(const http_request& request) const;
 
     // deletion endpoints
-    void delete_user(const http_request& request) const;
-    void delete_album(const http_request& request) const;
-    void remove_picture_from_album(const http_request& request) const;
-    void untag_user_in_picture(const http_request& request) const;
+    pplx::task<void> delete_user(const http_request& request) const;
+    pplx::task<void> delete_album(const http_request& request) const;
+    pplx::task<void> remove_picture_from_album(const http_request& request) const;
+    pplx::task<void> untag_user_in_picture(const http_request& request) const;
 
     // retrieval endpoints
-    void get_albums(const http_request& request) const;
-    void get_albums_of_user(const http_request& request) const;
-    void get_users(const http_request& request) const;
-    auto get_user(const http_request& request) const -> void;
-    void get_user_albums_count(const http_request& request) const;
-    void get_albums_tagged_user_count(const http_request& request) const;
-    void get_count_tags_of_user(const http_request& request) const;
-    void get_average_tags_of_user_per_album(const http_request& request) const;
-    void get_album_pictures(const http_request& request) const;
-    void get_picture_tags(const http_request& request) const;
+    pplx::task<void> get_albums(const http_request& request) const;
+    pplx::task<void> get_albums_of_user(const http_request& request) const;
+    pplx::task<void> get_users(const http_request& request) const;
+    pplx::task<void> get_user(const http_request& request) const;
+    pplx::task<void> get_user_albums_count(const http_request& request) const;
+    pplx::task<void> get_albums_tagged_user_count(const http_request& request) const;
+    pplx::task<void> get_count_tags_of_user(const http_request& request) const;
+    pplx::task<void> get_average_tags_of_user_per_album(const http_request& request) const;
+    pplx::task<void> get_album_pictures(const http_request& request) const;
+    pplx::task<void> get_picture_tags(const http_request& request) const;
+
+    // multi-get endpoints, many of the retrievals above in a single query
+    pplx::task<void> get_users_by_ids(const http_request& request) const;
+    pplx::task<void> get_albums_by_names(const http_request& request) const;
+    pplx::task<void> get_pictures_by_ids(const http_request& request) const;
+
+    // resource endpoints, the retrievals above addressed by the path
+    pplx::task<void> get_user_by_path(const http_request& request, const RouteParams& params) const;
+    pplx::task<void> get_albums_of_user_by_path(const http_request& request, const RouteParams& params) const;
+    pplx::task<void> get_album_pictures_by_path(const http_request& request, const RouteParams& params) const;
+
+    // retrievals shared by the body and the path addressed endpoints
+    pplx::task<void> reply_user(const http_request& request, int userId) const;
+    pplx::task<void> reply_albums_of_user(const http_request& request, int userId) const;
+    pplx::task<void> reply_album_pictures(const http_request& request, int ownerId, const std::string& albumName) const;
+
+    // change feed endpoints, server-sent events of the changes as they are committed
+    pplx::task<void> subscribe_changes(const http_request& request) const;
+    pplx::task<void> subscribe_user_changes(const http_request& request, const RouteParams& params) const;
+    pplx::task<void> subscribe_album_changes(const http_request& request, const RouteParams& params) const;
+    pplx::task<void> reply_change_stream(const http_request& request, const char* endpoint, ChangeFilter filter) const;
+
+    // change log endpoints, what changed since a client last synced
+    pplx::task<void> get_changes(const http_request& request) const;
+
+    // query endpoints
+    pplx::task<void> query_tagged_pictures(const http_request& request) const;
+    pplx::task<void> get_co_tagged_users(const http_request& request) const;
+    pplx::task<void> get_co_tag_strength(const http_request& request) const;
+    pplx::task<void> suggest_tags(const http_request& request) const;
+
+    // batch endpoints
+    pplx::task<void> batch(const http_request& request) const;
+
+    // helper functions
+    static LogLevel log_level_of(status_code status);
+    static void reply_busy(const http_request& request, const char* endpoint);
+    static void reply_on_failure(const http_request& request, const char* endpoint, const pplx::task<void>& task);
+    static pplx::task<void> reply_with_arena_stats(const http_request& request, const std::string& document, const utility::string_t& etag, const RequestArena& arena);
+    static pplx::task<void> reply_streamed(const http_request& request, const std::function<void(StreamWriter&)>& write, const utility::string_t& etag = {}, std::string* document = nullptr);
+
+    // response cache helpers
+    pplx::task<void> reply_cached(const http_request& request, const std::string& key, std::vector<std::string> dependencies, const utility::string_t& etag, uint64_t version, const std::function<void(StreamWriter&)>& write) const;
+    static pplx::task<void> reply_built(const http_request& request, const SingleFlight::Document& document, const utility::string_t& etag);
+    pplx::task<void> reply_user_statistic(const http_request& request, const char* endpoint, int userId, const std::function<void(StreamWriter&)>& write) const;
+    static std::string make_cache_key(const http_request& request, const char* endpoint, std::initializer_list<std::string> fields);
+
+    // conditional request helpers
+    static utility::string_t make_etag(const http_request& request, uint64_t version);
+    static bool reply_if_not_modified(const http_request& request, const utility::string_t& etag);
+
+    // compression helpers
+    static ResponseCompressor::Encoding negotiate_encoding(const http_request& request);
+
+    // wire format helpers
+    static StreamWriter::Format negotiate_format(const http_request& request);
+    static pplx::task<RequestBody> extract_body(const http_request& request);
+    static pplx::task<void> reply_document(const http_request& request, const json::value& body);
+    static std::string encode_document(const http_request& request, const json::value& body);
+    static void set_document_body(const http_request& request, http_response& response, const std::string& document);
 };
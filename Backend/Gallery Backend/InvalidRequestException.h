@@ -0,0 +1,11 @@
+#pragma once
+
+#include "MyException.h"
+
+class InvalidRequestException : public MyException {
+public:
+	InvalidRequestException(const std::string& message) : MyException(message)
+	{
+		// Left empty
+	}
+};
@@ -1,6 +1,35 @@
 #include "JsonHelper.h"
 
-json::value JsonHelper::usersToJson(const std::list<User>& users)
+
+// writes the items of a multi-get in the order of their keys, and then the keys of the missing ones
+template <typename Key, typename Item, typename WriteItem>
+static void writeLookup(StreamWriter& writer, const std::vector<Key>& keys, const std::vector<std::optional<Item>>& items, WriteItem writeItem)
+{
+	writer.beginObject();
+
+	writer.key("items").beginArray();
+	for (const auto& item : items)
+	{
+		if (item.has_value())
+			writeItem(*item);
+		else
+			writer.null();
+	}
+	writer.endArray();
+
+	writer.key("missing").beginArray();
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		if (!items[i].has_value())
+			writer.value(keys[i]);
+	}
+	writer.endArray();
+
+	writer.endObject();
+}
+
+
+json::value JsonHelper::usersToJson(const std::pmr::list<User>& users)
 {
 	json::value usersJson;
 	int user_index = 0;
@@ -12,7 +41,7 @@ json::value JsonHelper::usersToJson(const std::list<User>& users)
 }
 
 
-json::value JsonHelper::usersToJson(const std::set<User>& users)
+json::value JsonHelper::usersToJson(const std::pmr::set<User>& users)
 {
 	json::value usersJson;
 	int user_index = 0;
@@ -23,7 +52,7 @@ json::value JsonHelper::usersToJson(const std::set<User>& users)
 	return usersJson;
 }
 
-json::value JsonHelper::albumsToJson(const std::list<Album>& albums)
+json::value JsonHelper::albumsToJson(const std::pmr::list<Album>& albums)
 {
 	json::value albumsJson;
 	int album_index = 0;
@@ -34,7 +63,7 @@ json::value JsonHelper::albumsToJson(const std::list<Album>& albums)
 	return albumsJson;
 }
 
-json::value JsonHelper::picturesToJson(const std::list<Picture>& pictures)
+json::value JsonHelper::picturesToJson(const std::pmr::list<Picture>& pictures)
 {
 	json::value picturesJson;
 	int picture_index = 0;
@@ -75,7 +104,182 @@ json::value JsonHelper::pictureToJson(const Picture& picture)
 	jsonPicture[U("name")] = json::value::string(utility::conversions::to_string_t(picture.getName()));
 	jsonPicture[U("path")] = json::value::string(utility::conversions::to_string_t(picture.getPath()));
 	jsonPicture[U("creation_date")] = json::value::string(utility::conversions::to_string_t(picture.getCreationDate()));
-	jsonPicture[U("tag_count")] = json::value::number(picture.getUsersTagged().size());
+	jsonPicture[U("tag_count")] = json::value::number(picture.getTagsCount());
 
 	return jsonPicture;
 }
+
+
+void JsonHelper::writeUser(StreamWriter& writer, const User& user)
+{
+	writer.beginObject();
+	writer.key("id").value(user.getId());
+	writer.key("name").value(user.getName());
+	writer.endObject();
+}
+
+void JsonHelper::writeAlbum(StreamWriter& writer, const Album& album, int picturesCount)
+{
+	writer.beginObject();
+	writer.key("owner_id").value(album.getOwnerId());
+	writer.key("owner_name").value(album.getOwnerName());
+	writer.key("name").value(album.getName());
+	writer.key("creation_date").value(album.getCreationDate());
+	writer.key("pictures_count").value(picturesCount);
+	writer.endObject();
+}
+
+void JsonHelper::writePicture(StreamWriter& writer, const Picture& picture)
+{
+	writer.beginObject();
+	writer.key("id").value(picture.getId());
+	writer.key("name").value(picture.getName());
+	writer.key("path").value(picture.getPath());
+	writer.key("creation_date").value(picture.getCreationDate());
+	writer.key("tag_count").value(picture.getTagsCount());
+	writer.endObject();
+}
+
+void JsonHelper::writeValue(StreamWriter& writer, const json::value& value)
+{
+	switch (value.type())
+	{
+	case json::value::Boolean:
+		writer.value(value.as_bool());
+		break;
+	case json::value::Number:
+		if (value.is_integer())
+			writer.value(value.as_integer());
+		else
+			writer.value(value.as_double());
+		break;
+	case json::value::String:
+		writer.value(utility::conversions::to_utf8string(value.as_string()));
+		break;
+	case json::value::Array:
+		writer.beginArray();
+		for (const auto& element : value.as_array())
+			writeValue(writer, element);
+		writer.endArray();
+		break;
+	case json::value::Object:
+		writer.beginObject();
+		for (const auto& [name, member] : value.as_object())
+		{
+			writer.key(utility::conversions::to_utf8string(name));
+			writeValue(writer, member);
+		}
+		writer.endObject();
+		break;
+	default:
+		writer.null();
+	}
+}
+
+void JsonHelper::writeUsersLookup(StreamWriter& writer, const std::vector<int>& userIDs, const std::vector<std::optional<User>>& users)
+{
+	writeLookup(writer, userIDs, users, [&writer](const User& user) { writeUser(writer, user); });
+}
+
+void JsonHelper::writeAlbumsLookup(StreamWriter& writer, const std::vector<std::string>& albumNames, const std::vector<std::optional<std::pair<Album, int>>>& albums)
+{
+	writeLookup(writer, albumNames, albums, [&writer](const std::pair<Album, int>& album) { writeAlbum(writer, album.first, album.second); });
+}
+
+void JsonHelper::writePicturesLookup(StreamWriter& writer, const std::vector<int>& pictureIDs, const std::vector<std::optional<Picture>>& pictures)
+{
+	writeLookup(writer, pictureIDs, pictures, [&writer](const Picture& picture) { writePicture(writer, picture); });
+}
+
+void JsonHelper::writeChangeEvent(StreamWriter& writer, const ChangeEvent& event)
+{
+	writer.beginObject();
+	writer.key("type").value(ChangeEvent::typeName(event.type));
+
+	if (!event.albumName.empty())
+		writer.key("album").value(event.albumName);
+	if (event.ownerId != -1)
+		writer.key("owner_id").value(event.ownerId);
+	if (event.pictureId != -1)
+		writer.key("picture_id").value(event.pictureId);
+	if (!event.pictureName.empty())
+		writer.key("picture_name").value(event.pictureName);
+	if (event.userId != -1)
+		writer.key("user_id").value(event.userId);
+	if (!event.userName.empty())
+		writer.key("user_name").value(event.userName);
+
+	writer.endObject();
+}
+
+// the payloads are stored as JSON text, they are parsed so a delta can be written in any format
+void JsonHelper::writeChangeLogDelta(StreamWriter& writer, const ChangeLogDelta& delta)
+{
+	writer.beginObject();
+	writer.key("sequence").value(static_cast<size_t>(delta.sequence));
+	writer.key("full_resync").value(delta.isResyncRequired);
+	writer.key("has_more").value(delta.hasMore);
+
+	writer.key("changes").beginArray();
+	for (const ChangeLogEntry& change : delta.changes)
+	{
+		writer.beginObject();
+		writer.key("sequence").value(static_cast<size_t>(change.sequence));
+		writer.key("entity").value(change.entity);
+		writer.key("id").value(change.entityId);
+		writer.key("op").value(change.operation);
+		writer.key("payload");
+		writeValue(writer, json::value::parse(utility::conversions::to_string_t(change.payload)));
+		writer.endObject();
+	}
+	writer.endArray();
+
+	writer.endObject();
+}
+
+json::value JsonHelper::pictureIDsToJson(const std::vector<int>& pictureIDs)
+{
+	json::value resultJson;
+	json::value idsJson = json::value::array(pictureIDs.size());
+	int id_index = 0;
+
+	for (const int pictureID : pictureIDs)
+		idsJson[id_index++] = json::value::number(pictureID);
+
+	resultJson[U("count")] = json::value::number(static_cast<int>(pictureIDs.size()));
+	resultJson[U("picture_ids")] = idsJson;
+
+	return resultJson;
+}
+
+json::value JsonHelper::coTaggedUsersToJson(const std::vector<std::pair<User, int>>& coTaggedUsers)
+{
+	json::value usersJson = json::value::array(coTaggedUsers.size());
+	int user_index = 0;
+
+	for (const auto& [user, sharedPictures] : coTaggedUsers)
+	{
+		json::value userJson = userToJson(user);
+		userJson[U("shared_pictures")] = json::value::number(sharedPictures);
+
+		usersJson[user_index++] = userJson;
+	}
+
+	return usersJson;
+}
+
+json::value JsonHelper::tagSuggestionsToJson(const std::vector<std::pair<User, double>>& suggestions)
+{
+	json::value suggestionsJson = json::value::array(suggestions.size());
+	int suggestion_index = 0;
+
+	for (const auto& [user, score] : suggestions)
+	{
+		json::value suggestionJson = userToJson(user);
+		suggestionJson[U("score")] = json::value::number(score);
+
+		suggestionsJson[suggestion_index++] = suggestionJson;
+	}
+
+	return suggestionsJson;
+}
@@ -1,7 +1,13 @@
 #pragma once
 #include <cpprest/json.h>
+#include <list>
+#include <memory_resource>
+#include <optional>
+#include <set>
 
 #include "Album.h"
+#include "ChangeFeed.h"
+#include "StreamWriter.h"
 
 using namespace web;
 
@@ -9,14 +15,44 @@ class JsonHelper
 {
 public:
 	// multiple objects to JSON array
-	static json::value usersToJson(const std::list<User>& users);
-	static json::value usersToJson(const std::set<User>& users);
-	static json::value albumsToJson(const std::list<Album>& albums);
-	static json::value picturesToJson(const std::list<Picture>& pictures);
+	static json::value usersToJson(const std::pmr::list<User>& users);
+	static json::value usersToJson(const std::pmr::set<User>& users);
+	static json::value albumsToJson(const std::pmr::list<Album>& albums);
+	static json::value picturesToJson(const std::pmr::list<Picture>& pictures);
 
 
 	// single object to JSON
 	static json::value userToJson(const User& user);
 	static json::value albumToJson(const Album& album);
 	static json::value pictureToJson(const Picture& picture);
+
+
+	// single object to a streamed JSON document, the same fields as the functions above
+	static void writeUser(StreamWriter& writer, const User& user);
+	static void writeAlbum(StreamWriter& writer, const Album& album, int picturesCount);
+	static void writePicture(StreamWriter& writer, const Picture& picture);
+	// a json::value built by the functions above, for replies in a format other than JSON
+	static void writeValue(StreamWriter& writer, const json::value& value);
+
+
+	// multi-get results - {"items": [...], "missing": [...]}, an item per key in the order of the keys,
+	// null where the key was not found, and the keys that were not found
+	static void writeUsersLookup(StreamWriter& writer, const std::vector<int>& userIDs, const std::vector<std::optional<User>>& users);
+	static void writeAlbumsLookup(StreamWriter& writer, const std::vector<std::string>& albumNames, const std::vector<std::optional<std::pair<Album, int>>>& albums);
+	static void writePicturesLookup(StreamWriter& writer, const std::vector<int>& pictureIDs, const std::vector<std::optional<Picture>>& pictures);
+
+
+	// change feed event, only the fields its type sets
+	static void writeChangeEvent(StreamWriter& writer, const ChangeEvent& event);
+	// {"sequence": n, "full_resync": bool, "has_more": bool, "changes": [{"sequence", "entity", "id", "op", "payload"}]}
+	static void writeChangeLogDelta(StreamWriter& writer, const ChangeLogDelta& delta);
+
+
+	// tag queries
+	static json::value pictureIDsToJson(const std::vector<int>& pictureIDs);
+
+
+	// tag co-occurrence
+	static json::value coTaggedUsersToJson(const std::vector<std::pair<User, int>>& coTaggedUsers);
+	static json::value tagSuggestionsToJson(const std::vector<std::pair<User, double>>& suggestions);
 };
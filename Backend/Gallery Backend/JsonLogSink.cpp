@@ -0,0 +1,72 @@
+#include "JsonLogSink.h"
+#include <cstdio>
+#include <ctime>
+
+#include "JsonStreamWriter.h"
+
+
+// a record is a line of a few hundred bytes, it does not need the chunk of a response
+constexpr size_t LINE_CHUNK_SIZE = 1024;
+
+// the time of a record in UTC, with milliseconds - 2024-01-01T12:00:00.000Z
+static std::string formatTime(std::chrono::system_clock::time_point time)
+{
+	using namespace std::chrono;
+
+	const time_t seconds = system_clock::to_time_t(time);
+	const auto milliseconds = duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000;
+
+	std::tm utc{};
+	gmtime_s(&utc, &seconds);
+
+	char formatted[32];
+	const size_t length = std::strftime(formatted, sizeof(formatted), "%Y-%m-%dT%H:%M:%S", &utc);
+	std::snprintf(formatted + length, sizeof(formatted) - length, ".%03dZ", static_cast<int>(milliseconds));
+
+	return formatted;
+}
+
+
+JsonLogSink::JsonLogSink(const std::string& path) :
+	m_file(path, std::ios::app)
+{
+	// Left empty
+}
+
+bool JsonLogSink::isOpen() const
+{
+	return m_file.is_open();
+}
+
+void JsonLogSink::write(const LogRecord& record)
+{
+	m_line.clear();
+
+	JsonStreamWriter writer([this](const char* data, size_t size) { m_line.append(data, size); }, LINE_CHUNK_SIZE);
+	writer.beginObject();
+	writer.key("time").value(formatTime(record.time));
+	writer.key("level").value(logLevelName(record.level));
+	writer.key("route").value(record.route);
+	writer.key("message").value(record.message);
+
+	for (const LogField& field : record.fields)
+	{
+		writer.key(field.key);
+
+		if (field.isNumber)
+			writer.raw(field.value);
+		else
+			writer.value(field.value);
+	}
+
+	writer.endObject();
+	writer.flush();
+
+	m_line += '\n';
+	m_file << m_line;
+}
+
+void JsonLogSink::flush()
+{
+	m_file.flush();
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <fstream>
+#include <string>
+
+#include "Logger.h"
+
+
+/*
+ * Appends the records to a file as JSON lines, one object per record:
+ * {"time": "2024-01-01T12:00:00.000Z", "level": "info", "route": "get_user", "message": "...", <fields>}
+ * Numeric fields are written as numbers, so the file can be loaded and queried as is.
+ */
+class JsonLogSink : public LogSink
+{
+public:
+	explicit JsonLogSink(const std::string& path);
+
+	bool isOpen() const;
+
+	void write(const LogRecord& record) override;
+	void flush() override;
+
+private:
+	std::ofstream m_file;
+	std::string m_line;		// reused, the line is written with a single call
+};
@@ -0,0 +1,439 @@
+#include "JsonReader.h"
+
+#include <climits>
+#include <cstdint>
+
+#include "InvalidRequestException.h"
+
+
+// nesting limit of skipped values, so a hostile body can not exhaust the stack
+constexpr int MAX_SKIPPED_DEPTH = 64;
+
+
+JsonReader::JsonReader(std::string_view text) :
+	m_text(text)
+{
+	// Left empty
+}
+
+
+// container related functions //
+void JsonReader::beginObject()
+{
+	skipWhitespace();
+
+	if (m_position == m_text.size() || m_text[m_position] != '{')
+		throw InvalidRequestException("The request body must be a JSON object.");
+
+	m_position++;
+	m_isFirstMember = true;
+}
+
+bool JsonReader::nextKey(std::string& key)
+{
+	if (!nextMember('}'))
+		return false;
+
+	readString(key);
+	skipWhitespace();
+	expect(':');
+
+	return true;
+}
+
+void JsonReader::beginArray()
+{
+	skipWhitespace();
+	expect('[');
+	m_isFirstMember = true;
+}
+
+bool JsonReader::nextElement()
+{
+	return nextMember(']');
+}
+
+void JsonReader::end()
+{
+	skipWhitespace();
+
+	if (m_position != m_text.size())
+		fail("unexpected text after the object");
+}
+
+
+// value related functions //
+JsonReader::Type JsonReader::peekType()
+{
+	skipWhitespace();
+
+	if (m_position == m_text.size())
+		fail("unexpected end of the body");
+
+	switch (m_text[m_position])
+	{
+	case '{':
+		return Type::OBJECT;
+	case '[':
+		return Type::ARRAY;
+	case '"':
+		return Type::STRING;
+	case 't':
+	case 'f':
+		return Type::BOOLEAN;
+	case 'n':
+		return Type::NULL_VALUE;
+	default:
+		return Type::NUMBER;
+	}
+}
+
+void JsonReader::readString(std::string& value)
+{
+	skipWhitespace();
+	expect('"');
+	value.clear();
+
+	while (true)
+	{
+		// copy the run of plain characters at once, most strings have no escapes at all
+		size_t runEnd = m_position;
+		while (runEnd < m_text.size() && m_text[runEnd] != '"' && m_text[runEnd] != '\\' && static_cast<unsigned char>(m_text[runEnd]) >= 0x20)
+			runEnd++;
+
+		value.append(m_text.data() + m_position, runEnd - m_position);
+		m_position = runEnd;
+
+		if (m_position == m_text.size())
+			fail("unterminated string");
+
+		const char character = m_text[m_position++];
+
+		if (character == '"')
+			return;
+
+		if (character != '\\')
+			fail("control character in a string");
+
+		if (m_position == m_text.size())
+			fail("unterminated string");
+
+		switch (m_text[m_position++])
+		{
+		case '"': value += '"'; break;
+		case '\\': value += '\\'; break;
+		case '/': value += '/'; break;
+		case 'b': value += '\b'; break;
+		case 'f': value += '\f'; break;
+		case 'n': value += '\n'; break;
+		case 'r': value += '\r'; break;
+		case 't': value += '\t'; break;
+		case 'u':
+		{
+			uint32_t codePoint = readHexQuad();
+
+			// a character outside the basic plane comes as a surrogate pair
+			if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+			{
+				if (m_text.substr(m_position, 2) != "\\u")
+					fail("unpaired surrogate");
+
+				m_position += 2;
+				const uint32_t low = readHexQuad();
+				if (low < 0xDC00 || low > 0xDFFF)
+					fail("unpaired surrogate");
+
+				codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+			}
+			else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF)
+				fail("unpaired surrogate");
+
+			appendCodePoint(value, codePoint);
+			break;
+		}
+		default:
+			fail("unknown escape sequence");
+		}
+	}
+}
+
+bool JsonReader::readBoolean()
+{
+	skipWhitespace();
+
+	if (m_position < m_text.size() && m_text[m_position] == 't')
+	{
+		skipLiteral("true");
+		return true;
+	}
+
+	skipLiteral("false");
+	return false;
+}
+
+std::string_view JsonReader::readRaw()
+{
+	skipWhitespace();
+	const size_t start = m_position;
+	skipValue();
+
+	return m_text.substr(start, m_position - start);
+}
+
+bool JsonReader::readInteger(int& value)
+{
+	skipWhitespace();
+	const size_t start = m_position;
+	skipNumber();
+
+	const std::string_view number = m_text.substr(start, m_position - start);
+	if (number.find_first_of(".eE") != std::string_view::npos)
+		return false;
+
+	const bool isNegative = number.front() == '-';
+	long long magnitude = 0;
+
+	for (size_t i = isNegative ? 1 : 0; i < number.size(); i++)
+	{
+		magnitude = magnitude * 10 + (number[i] - '0');
+		if (magnitude > static_cast<long long>(INT_MAX) + 1)
+			return false;
+	}
+
+	const long long result = isNegative ? -magnitude : magnitude;
+	if (result > INT_MAX)
+		return false;
+
+	value = static_cast<int>(result);
+	return true;
+}
+
+void JsonReader::skipValue()
+{
+	skipValue(0);
+}
+
+
+// helper functions //
+void JsonReader::skipWhitespace()
+{
+	while (m_position < m_text.size() && (m_text[m_position] == ' ' || m_text[m_position] == '\t' || m_text[m_position] == '\n' || m_text[m_position] == '\r'))
+		m_position++;
+}
+
+void JsonReader::expect(char character)
+{
+	if (m_position == m_text.size() || m_text[m_position] != character)
+		fail(std::string("expected '") + character + "'");
+
+	m_position++;
+}
+
+// moves to the next member of the innermost object or array, or past its end
+bool JsonReader::nextMember(char closing)
+{
+	skipWhitespace();
+
+	if (m_position < m_text.size() && m_text[m_position] == closing)
+	{
+		// the object or array that contained this one had a member already - this one
+		m_position++;
+		m_isFirstMember = false;
+		return false;
+	}
+
+	if (!m_isFirstMember)
+	{
+		expect(',');
+		skipWhitespace();
+	}
+
+	m_isFirstMember = false;
+	return true;
+}
+
+void JsonReader::skipValue(int depth)
+{
+	if (depth > MAX_SKIPPED_DEPTH)
+		fail("too deeply nested");
+
+	switch (peekType())
+	{
+	case Type::OBJECT:
+	case Type::ARRAY:
+	{
+		const bool isObject = m_text[m_position++] == '{';
+		const char closing = isObject ? '}' : ']';
+
+		skipWhitespace();
+		if (m_position < m_text.size() && m_text[m_position] == closing)
+		{
+			m_position++;
+			return;
+		}
+
+		while (true)
+		{
+			if (isObject)
+			{
+				skipWhitespace();
+				skipString();
+				skipWhitespace();
+				expect(':');
+			}
+
+			skipValue(depth + 1);
+			skipWhitespace();
+
+			if (m_position < m_text.size() && m_text[m_position] == closing)
+			{
+				m_position++;
+				return;
+			}
+
+			expect(',');
+		}
+	}
+	case Type::STRING:
+		skipString();
+		break;
+	case Type::BOOLEAN:
+		skipLiteral(m_text[m_position] == 't' ? "true" : "false");
+		break;
+	case Type::NULL_VALUE:
+		skipLiteral("null");
+		break;
+	case Type::NUMBER:
+		skipNumber();
+		break;
+	}
+}
+
+// skips a string without decoding it, the escapes are only checked to find where it ends
+void JsonReader::skipString()
+{
+	expect('"');
+
+	while (m_position < m_text.size())
+	{
+		const char character = m_text[m_position++];
+
+		if (character == '"')
+			return;
+
+		if (static_cast<unsigned char>(character) < 0x20)
+			fail("control character in a string");
+
+		if (character == '\\')
+			m_position++;
+	}
+
+	fail("unterminated string");
+}
+
+void JsonReader::skipLiteral(std::string_view literal)
+{
+	if (m_text.substr(m_position, literal.size()) != literal)
+		fail("invalid literal");
+
+	m_position += literal.size();
+}
+
+void JsonReader::skipNumber()
+{
+	const auto isDigit = [this](size_t position) { return position < m_text.size() && m_text[position] >= '0' && m_text[position] <= '9'; };
+	const size_t start = m_position;
+
+	if (m_position < m_text.size() && m_text[m_position] == '-')
+		m_position++;
+
+	if (!isDigit(m_position))
+		fail("invalid value");
+
+	// a leading zero is the whole integer part
+	if (m_text[m_position] == '0')
+		m_position++;
+	else
+		while (isDigit(m_position))
+			m_position++;
+
+	if (m_position < m_text.size() && m_text[m_position] == '.')
+	{
+		m_position++;
+		if (!isDigit(m_position))
+			fail("invalid number");
+
+		while (isDigit(m_position))
+			m_position++;
+	}
+
+	if (m_position < m_text.size() && (m_text[m_position] == 'e' || m_text[m_position] == 'E'))
+	{
+		m_position++;
+		if (m_position < m_text.size() && (m_text[m_position] == '+' || m_text[m_position] == '-'))
+			m_position++;
+
+		if (!isDigit(m_position))
+			fail("invalid number");
+
+		while (isDigit(m_position))
+			m_position++;
+	}
+
+	if (m_position == start)
+		fail("invalid value");
+}
+
+void JsonReader::appendCodePoint(std::string& value, uint32_t codePoint) const
+{
+	if (codePoint < 0x80)
+		value += static_cast<char>(codePoint);
+	else if (codePoint < 0x800)
+	{
+		value += static_cast<char>(0xC0 | (codePoint >> 6));
+		value += static_cast<char>(0x80 | (codePoint & 0x3F));
+	}
+	else if (codePoint < 0x10000)
+	{
+		value += static_cast<char>(0xE0 | (codePoint >> 12));
+		value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+		value += static_cast<char>(0x80 | (codePoint & 0x3F));
+	}
+	else
+	{
+		value += static_cast<char>(0xF0 | (codePoint >> 18));
+		value += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+		value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+		value += static_cast<char>(0x80 | (codePoint & 0x3F));
+	}
+}
+
+uint32_t JsonReader::readHexQuad()
+{
+	if (m_text.size() - m_position < 4)
+		fail("invalid unicode escape");
+
+	uint32_t codePoint = 0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		const char digit = m_text[m_position++];
+		codePoint <<= 4;
+
+		if (digit >= '0' && digit <= '9')
+			codePoint |= digit - '0';
+		else if (digit >= 'a' && digit <= 'f')
+			codePoint |= digit - 'a' + 10;
+		else if (digit >= 'A' && digit <= 'F')
+			codePoint |= digit - 'A' + 10;
+		else
+			fail("invalid unicode escape");
+	}
+
+	return codePoint;
+}
+
+void JsonReader::fail(const std::string& reason) const
+{
+	throw InvalidRequestException("The request body is not valid JSON: " + reason + " at offset " + std::to_string(m_position) + ".");
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+
+/*
+ * Pull parser that reads the members of a JSON object straight from the text of a request body,
+ * without building a json::value for it. The caller asks for the value it expects under every key,
+ * and skips the values it has no use for. Malformed text throws InvalidRequestException.
+ */
+class JsonReader
+{
+public:
+	enum class Type { OBJECT, ARRAY, STRING, NUMBER, BOOLEAN, NULL_VALUE };
+
+	explicit JsonReader(std::string_view text);
+
+	void beginObject();
+	bool nextKey(std::string& key);		// false once the object ended
+	void beginArray();
+	bool nextElement();					// false once the array ended
+	void end();							// only whitespace may follow the object
+
+	Type peekType();
+	void readString(std::string& value);
+	bool readInteger(int& value);		// false if the number has a fraction or does not fit an int
+	bool readBoolean();
+	std::string_view readRaw();			// the text of the next value as it is, for decoding it later
+	void skipValue();
+
+private:
+	std::string_view m_text;
+	size_t m_position{ 0 };
+	bool m_isFirstMember{ true };		// of the innermost open object or array
+
+	void skipWhitespace();
+	void expect(char character);
+	bool nextMember(char closing);
+	void skipValue(int depth);
+	void skipString();
+	void skipLiteral(std::string_view literal);
+	void skipNumber();
+	void appendCodePoint(std::string& value, uint32_t codePoint) const;
+	uint32_t readHexQuad();
+	[[noreturn]] void fail(const std::string& reason) const;
+};
@@ -0,0 +1,232 @@
+#include "JsonStreamWriter.h"
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+
+#include "MyException.h"
+
+
+// whether any byte of the word is a control character, a quote or a backslash - the only bytes JSON
+// strings escape. Checks 8 bytes at a time, the usual "has a byte less than n" bit trick
+static bool needsEscaping(uint64_t word)
+{
+	constexpr uint64_t ONES = 0x0101010101010101ULL;
+	constexpr uint64_t HIGHS = 0x8080808080808080ULL;
+
+	const uint64_t quotes = word ^ (ONES * '"');
+	const uint64_t backslashes = word ^ (ONES * '\\');
+
+	const uint64_t isControl = (word - ONES * 0x20) & ~word;
+	const uint64_t isQuote = (quotes - ONES) & ~quotes;
+	const uint64_t isBackslash = (backslashes - ONES) & ~backslashes;
+
+	return ((isControl | isQuote | isBackslash) & HIGHS) != 0;
+}
+
+static bool needsEscaping(char character)
+{
+	return static_cast<unsigned char>(character) < 0x20 || character == '"' || character == '\\';
+}
+
+// length of the prefix of text that can be copied as is
+static size_t plainPrefixLength(std::string_view text)
+{
+	size_t length = 0;
+
+	for (; length + sizeof(uint64_t) <= text.size(); length += sizeof(uint64_t))
+	{
+		uint64_t word;
+		std::memcpy(&word, text.data() + length, sizeof(word));
+
+		if (needsEscaping(word))
+			break;
+	}
+
+	while (length < text.size() && !needsEscaping(text[length]))
+		length++;
+
+	return length;
+}
+
+
+JsonStreamWriter::JsonStreamWriter(Sink sink, size_t chunkSize) :
+	StreamWriter(std::move(sink), chunkSize)
+{
+	// Left empty
+}
+
+
+// structure functions //
+StreamWriter& JsonStreamWriter::beginObject()
+{
+	beginValue();
+	append('{');
+	m_hasElements.push_back(false);
+
+	return *this;
+}
+
+StreamWriter& JsonStreamWriter::endObject()
+{
+	if (m_hasElements.empty() || m_afterKey)
+		throw MyException("JSON object closed without being opened, or right after a key.");
+
+	m_hasElements.pop_back();
+	append('}');
+
+	return *this;
+}
+
+StreamWriter& JsonStreamWriter::beginArray()
+{
+	beginValue();
+	append('[');
+	m_hasElements.push_back(false);
+
+	return *this;
+}
+
+StreamWriter& JsonStreamWriter::endArray()
+{
+	if (m_hasElements.empty())
+		throw MyException("JSON array closed without being opened.");
+
+	m_hasElements.pop_back();
+	append(']');
+
+	return *this;
+}
+
+StreamWriter& JsonStreamWriter::key(std::string_view name)
+{
+	beginValue();
+	writeString(name);
+	append(':');
+	m_afterKey = true;
+
+	return *this;
+}
+
+
+// value functions //
+StreamWriter& JsonStreamWriter::value(std::string_view text)
+{
+	beginValue();
+	writeString(text);
+
+	return *this;
+}
+
+StreamWriter& JsonStreamWriter::value(int number)
+{
+	char digits[16];
+	const auto result = std::to_chars(digits, digits + sizeof(digits), number);
+
+	beginValue();
+	append(std::string_view(digits, result.ptr - digits));
+
+	return *this;
+}
+
+StreamWriter& JsonStreamWriter::value(size_t number)
+{
+	char digits[24];
+	const auto result = std::to_chars(digits, digits + sizeof(digits), number);
+
+	beginValue();
+	append(std::string_view(digits, result.ptr - digits));
+
+	return *this;
+}
+
+StreamWriter& JsonStreamWriter::value(double number)
+{
+	char digits[32];
+	const auto result = std::to_chars(digits, digits + sizeof(digits), number);
+
+	beginValue();
+	append(std::string_view(digits, result.ptr - digits));
+
+	return *this;
+}
+
+StreamWriter& JsonStreamWriter::value(bool boolean)
+{
+	beginValue();
+	append(boolean ? "true" : "false");
+
+	return *this;
+}
+
+StreamWriter& JsonStreamWriter::null()
+{
+	beginValue();
+	append("null");
+
+	return *this;
+}
+
+StreamWriter& JsonStreamWriter::raw(std::string_view json)
+{
+	beginValue();
+	append(json);
+
+	return *this;
+}
+
+
+// helper functions //
+// writes the comma between the elements of an object or an array
+void JsonStreamWriter::beginValue()
+{
+	if (m_afterKey)
+	{
+		m_afterKey = false;
+		return;
+	}
+
+	if (m_hasElements.empty())
+		return;
+
+	if (m_hasElements.back())
+		append(',');
+
+	m_hasElements.back() = true;
+}
+
+void JsonStreamWriter::writeString(std::string_view text)
+{
+	constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+	append('"');
+
+	while (!text.empty())
+	{
+		const size_t plainLength = plainPrefixLength(text);
+		append(text.substr(0, plainLength));
+
+		if (plainLength == text.size())
+			break;
+
+		const char character = text[plainLength];
+		switch (character)
+		{
+		case '"': append("\\\""); break;
+		case '\\': append("\\\\"); break;
+		case '\b': append("\\b"); break;
+		case '\f': append("\\f"); break;
+		case '\n': append("\\n"); break;
+		case '\r': append("\\r"); break;
+		case '\t': append("\\t"); break;
+		default:
+			append("\\u00");
+			append(HEX_DIGITS[(character >> 4) & 0xF]);
+			append(HEX_DIGITS[character & 0xF]);
+		}
+
+		text.remove_prefix(plainLength + 1);
+	}
+
+	append('"');
+}
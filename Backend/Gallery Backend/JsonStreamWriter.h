@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "StreamWriter.h"
+
+
+/*
+ * Writes JSON text straight to a sink, without building a json::value first.
+ * Strings are expected in UTF-8, runs without characters that need escaping are copied as a whole.
+ */
+class JsonStreamWriter : public StreamWriter
+{
+public:
+	explicit JsonStreamWriter(Sink sink, size_t chunkSize = RESPONSE_CHUNK_SIZE);
+
+	StreamWriter& beginObject() override;
+	StreamWriter& endObject() override;
+	StreamWriter& beginArray() override;
+	StreamWriter& endArray() override;
+
+	StreamWriter& key(std::string_view name) override;
+
+	using StreamWriter::value;
+	StreamWriter& value(std::string_view text) override;
+	StreamWriter& value(int number) override;
+	StreamWriter& value(size_t number) override;
+	StreamWriter& value(double number) override;
+	StreamWriter& value(bool boolean) override;
+	StreamWriter& null() override;
+	StreamWriter& raw(std::string_view json) override;
+
+private:
+	std::vector<bool> m_hasElements;	// per open object / array, whether it needs a comma before the next element
+	bool m_afterKey{ false };
+
+	void beginValue();
+	void writeString(std::string_view text);
+};
@@ -0,0 +1,76 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+
+// latency histogram related functions //
+void LatencyHistogram::record(uint64_t microseconds)
+{
+	addToOwnCounter(m_counts[bucketOf(microseconds)], 1);
+	addToOwnCounter(m_count, 1);
+	addToOwnCounter(m_sum, microseconds);
+}
+
+// latencies below SUB_BUCKETS_COUNT have a bucket each, a longer one is placed by its power of two and
+// by the bits that follow its highest one
+size_t LatencyHistogram::bucketOf(uint64_t microseconds)
+{
+	if (microseconds < SUB_BUCKETS_COUNT)
+		return static_cast<size_t>(microseconds);
+
+	if (microseconds >= uint64_t(1) << METRICS_MAX_EXPONENT)
+		return BUCKETS_COUNT - 1;
+
+	int exponent = METRICS_SUB_BUCKET_BITS;
+	while (microseconds >> (exponent + 1) != 0)
+		exponent++;
+
+	const uint64_t subBucket = (microseconds >> (exponent - METRICS_SUB_BUCKET_BITS)) - SUB_BUCKETS_COUNT;
+	return SUB_BUCKETS_COUNT * (exponent - METRICS_SUB_BUCKET_BITS + 1) + static_cast<size_t>(subBucket);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t bucket)
+{
+	if (bucket < SUB_BUCKETS_COUNT)
+		return bucket;
+
+	const int shift = static_cast<int>(bucket / SUB_BUCKETS_COUNT) - 1;
+	const uint64_t lowerBound = (SUB_BUCKETS_COUNT + bucket % SUB_BUCKETS_COUNT) << shift;
+
+	return lowerBound + (uint64_t(1) << shift) - 1;
+}
+
+
+// snapshot related functions //
+// the counts are read one by one while the owner may be recording, the snapshot is off by a latency or two
+void LatencyHistogram::Snapshot::add(const LatencyHistogram& histogram)
+{
+	for (size_t i = 0; i < BUCKETS_COUNT; i++)
+		counts[i] += histogram.m_counts[i].load(std::memory_order_relaxed);
+
+	count += histogram.m_count.load(std::memory_order_relaxed);
+	sum += histogram.m_sum.load(std::memory_order_relaxed);
+}
+
+// the quantile is ranked among the bucket counts and not count, which may have been read at another moment
+uint64_t LatencyHistogram::Snapshot::quantile(double quantile) const
+{
+	uint64_t total = 0;
+	for (const uint64_t bucketCount : counts)
+		total += bucketCount;
+
+	if (total == 0)
+		return 0;
+
+	const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(total))));
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BUCKETS_COUNT; i++)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+			return bucketUpperBound(i);
+	}
+
+	return bucketUpperBound(BUCKETS_COUNT - 1);
+}
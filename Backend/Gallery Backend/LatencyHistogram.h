@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "Constants.h"
+
+
+// adds to a counter that a single thread writes - a plain load and store, without the locked add of fetch_add.
+// Other threads may read it at any time
+inline void addToOwnCounter(std::atomic<uint64_t>& counter, uint64_t value)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+
+/*
+ * Log-linear histogram of latencies in microseconds, in the manner of HdrHistogram.
+ * Every power of two is split into 2^METRICS_SUB_BUCKET_BITS equal buckets, so the buckets are as fine as
+ * the latencies they count are short, and a quantile is off by at most one bucket whatever its magnitude.
+ * A histogram is written by a single thread and read by any, the reads are merged into a Snapshot.
+ */
+class LatencyHistogram
+{
+public:
+	static constexpr size_t SUB_BUCKETS_COUNT = size_t(1) << METRICS_SUB_BUCKET_BITS;
+	static constexpr size_t BUCKETS_COUNT = SUB_BUCKETS_COUNT * (METRICS_MAX_EXPONENT - METRICS_SUB_BUCKET_BITS + 1);
+
+	// the histograms of many threads added together
+	struct Snapshot
+	{
+		std::array<uint64_t, BUCKETS_COUNT> counts{};
+		uint64_t count{ 0 };
+		uint64_t sum{ 0 };
+
+		void add(const LatencyHistogram& histogram);
+
+		// the highest latency of the bucket the quantile falls in, 0 if nothing was recorded
+		uint64_t quantile(double quantile) const;
+	};
+
+	void record(uint64_t microseconds);		// by the thread that owns the histogram only
+
+	static size_t bucketOf(uint64_t microseconds);
+	static uint64_t bucketUpperBound(size_t bucket);
+
+private:
+	std::array<std::atomic<uint64_t>, BUCKETS_COUNT> m_counts{};
+	std::atomic<uint64_t> m_count{ 0 };
+	std::atomic<uint64_t> m_sum{ 0 };
+};
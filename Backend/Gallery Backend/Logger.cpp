@@ -0,0 +1,249 @@
+#include "Logger.h"
+#include <cstdio>
+
+
+const char* logLevelName(LogLevel level)
+{
+	switch (level)
+	{
+	case LogLevel::DEBUG:
+		return "debug";
+	case LogLevel::INFO:
+		return "info";
+	case LogLevel::WARNING:
+		return "warning";
+	default:
+		return "failure";
+	}
+}
+
+
+// log field related functions //
+LogField::LogField(const char* key, const char* text) :
+	key(key), value(text), isNumber(false)
+{
+	// Left empty
+}
+
+LogField::LogField(const char* key, std::string text) :
+	key(key), value(std::move(text)), isNumber(false)
+{
+	// Left empty
+}
+
+// latencies are logged in milliseconds, microseconds are precise enough
+LogField::LogField(const char* key, double number) :
+	key(key), isNumber(true)
+{
+	char formatted[32];
+	std::snprintf(formatted, sizeof(formatted), "%.3f", number);
+	value = formatted;
+}
+
+
+// logger related functions //
+Logger::Sampler::Sampler(uint32_t everyN) :
+	everyN(everyN)
+{
+	// Left empty
+}
+
+// the capacity is rounded up to a power of two, so a position maps to its slot with a mask
+Logger::Logger(size_t capacity) :
+	m_capacity(1)
+{
+	while (m_capacity < capacity)
+		m_capacity <<= 1;
+
+	m_slots = std::make_unique<Slot[]>(m_capacity);
+	for (size_t i = 0; i < m_capacity; i++)
+		m_slots[i].sequence.store(i, std::memory_order_relaxed);
+
+	m_flushThread = std::thread([this] { flushLoop(); });
+}
+
+Logger::~Logger()
+{
+	m_isRunning = false;
+
+	if (m_flushThread.joinable())
+		m_flushThread.join();
+}
+
+Logger& Logger::instance()
+{
+	static Logger logger(LOG_RING_CAPACITY);
+	return logger;
+}
+
+void Logger::debug(const char* route, std::string message, std::initializer_list<LogField> fields)
+{
+	instance().log(LogLevel::DEBUG, route, std::move(message), fields);
+}
+
+void Logger::info(const char* route, std::string message, std::initializer_list<LogField> fields)
+{
+	instance().log(LogLevel::INFO, route, std::move(message), fields);
+}
+
+void Logger::warning(const char* route, std::string message, std::initializer_list<LogField> fields)
+{
+	instance().log(LogLevel::WARNING, route, std::move(message), fields);
+}
+
+void Logger::failure(const char* route, std::string message, std::initializer_list<LogField> fields)
+{
+	instance().log(LogLevel::FAILURE, route, std::move(message), fields);
+}
+
+void Logger::log(LogLevel level, const char* route, std::string message, std::initializer_list<LogField> fields)
+{
+	if (level < m_level.load(std::memory_order_relaxed) || isSampledOut(level, route))
+		return;
+
+	LogRecord record;
+	record.level = level;
+	record.time = std::chrono::system_clock::now();
+	record.route = route;
+	record.message = std::move(message);
+	record.fields.assign(fields.begin(), fields.end());
+
+	if (!tryPush(std::move(record)))
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Logger::addSink(std::unique_ptr<LogSink> sink)
+{
+	const std::lock_guard lock(m_sinksMutex);
+	m_sinks.push_back(std::move(sink));
+}
+
+void Logger::setLevel(LogLevel level)
+{
+	m_level = level;
+}
+
+void Logger::setSampling(const std::string& route, uint32_t everyN)
+{
+	m_samplers.erase(route);
+
+	const std::string& name = m_sampledRoutes.emplace_back(route);
+	m_samplers.try_emplace(name, everyN == 0 ? 1 : everyN);
+}
+
+uint64_t Logger::getDropped() const
+{
+	return m_dropped.load(std::memory_order_relaxed);
+}
+
+
+// helper functions //
+// warnings and failures are always kept
+bool Logger::isSampledOut(LogLevel level, const char* route)
+{
+	if (level >= LogLevel::WARNING || m_samplers.empty())
+		return false;
+
+	const auto sampler = m_samplers.find(route);
+	if (sampler == m_samplers.end() || sampler->second.everyN == 1)
+		return false;
+
+	return sampler->second.count.fetch_add(1, std::memory_order_relaxed) % sampler->second.everyN != 0;
+}
+
+// a bounded multi-producer ring - a writer claims a position by moving the head, and publishes its
+// record by moving the sequence of the slot past the position. A slot the flush thread did not free yet
+// means the ring is full
+bool Logger::tryPush(LogRecord&& record)
+{
+	size_t position = m_head.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		Slot& slot = m_slots[position & (m_capacity - 1)];
+		const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+
+		if (difference == 0)
+		{
+			if (m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				slot.record = std::move(record);
+				slot.sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+			return false;
+		else
+			position = m_head.load(std::memory_order_relaxed);
+	}
+}
+
+bool Logger::tryPop(LogRecord& record)
+{
+	Slot& slot = m_slots[m_tail & (m_capacity - 1)];
+
+	if (slot.sequence.load(std::memory_order_acquire) != m_tail + 1)
+		return false;
+
+	record = std::move(slot.record);
+	slot.sequence.store(m_tail + m_capacity, std::memory_order_release);
+	m_tail++;
+
+	return true;
+}
+
+void Logger::flushLoop()
+{
+	while (m_isRunning.load())
+	{
+		if (drain() == 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MILLISECONDS));
+	}
+
+	// the records logged until the logger was destroyed
+	drain();
+}
+
+// hands every record in the ring to the sinks and flushes them, the number of records drained
+size_t Logger::drain()
+{
+	const std::lock_guard lock(m_sinksMutex);
+
+	size_t drained = 0;
+	LogRecord record;
+
+	while (tryPop(record))
+	{
+		for (const auto& sink : m_sinks)
+			sink->write(record);
+
+		drained++;
+	}
+
+	const uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+	if (dropped != m_reportedDropped)
+	{
+		LogRecord report;
+		report.level = LogLevel::WARNING;
+		report.time = std::chrono::system_clock::now();
+		report.route = "logger";
+		report.message = "Log records were dropped, the ring was full.";
+		report.fields.emplace_back("dropped", dropped - m_reportedDropped);
+
+		for (const auto& sink : m_sinks)
+			sink->write(report);
+
+		m_reportedDropped = dropped;
+		drained++;
+	}
+
+	if (drained != 0)
+	{
+		for (const auto& sink : m_sinks)
+			sink->flush();
+	}
+
+	return drained;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "Constants.h"
+
+
+// FAILURE and not ERROR, which is a macro of windows.h
+enum class LogLevel { DEBUG, INFO, WARNING, FAILURE };
+
+const char* logLevelName(LogLevel level);
+
+// a key/value of a log record - a route, a status, a latency, a count of rows...
+struct LogField
+{
+	const char* key;		// a literal, it outlives the record
+	std::string value;
+	bool isNumber;
+
+	LogField(const char* key, const char* text);
+	LogField(const char* key, std::string text);
+	LogField(const char* key, double number);
+
+	template <typename Integer, std::enable_if_t<std::is_integral_v<Integer>, int> = 0>
+	LogField(const char* key, Integer number) :
+		key(key), value(std::to_string(number)), isNumber(true)
+	{
+		// Left empty
+	}
+};
+
+struct LogRecord
+{
+	LogLevel level{ LogLevel::INFO };
+	std::chrono::system_clock::time_point time;
+	const char* route{ "" };	// the route names live as long as the router
+	std::string message;
+	std::vector<LogField> fields;
+};
+
+// where the records end up, written from the flush thread only
+class LogSink
+{
+public:
+	virtual ~LogSink() = default;
+
+	virtual void write(const LogRecord& record) = 0;
+	virtual void flush() = 0;
+};
+
+
+/*
+ * Asynchronous logger. A thread that logs only formats its record and pushes it to a bounded lock-free
+ * ring, the flush thread drains the ring every LOG_FLUSH_INTERVAL_MILLISECONDS and hands the records to
+ * the sinks, so no request thread ever waits for a console or a file, and records of different threads
+ * never interleave. A record that finds the ring full is dropped and counted instead of waiting, the
+ * drops are reported by the flush thread.
+ * Records below the level are skipped, and the records of a route below WARNING can be sampled, one in
+ * every N kept. Sinks and sampling are set up before the server starts, their lookups take no lock.
+ */
+class Logger
+{
+public:
+	static Logger& instance();
+
+	static void debug(const char* route, std::string message, std::initializer_list<LogField> fields = {});
+	static void info(const char* route, std::string message, std::initializer_list<LogField> fields = {});
+	static void warning(const char* route, std::string message, std::initializer_list<LogField> fields = {});
+	static void failure(const char* route, std::string message, std::initializer_list<LogField> fields = {});
+
+	Logger(const Logger&) = delete;
+	Logger& operator=(const Logger&) = delete;
+	~Logger();
+
+	void log(LogLevel level, const char* route, std::string message, std::initializer_list<LogField> fields);
+
+	void addSink(std::unique_ptr<LogSink> sink);
+	void setLevel(LogLevel level);
+	void setSampling(const std::string& route, uint32_t everyN);
+
+	uint64_t getDropped() const;
+
+private:
+	struct Slot
+	{
+		std::atomic<size_t> sequence;	// the position the slot is free for, or that position + 1 once written
+		LogRecord record;
+	};
+
+	struct Sampler
+	{
+		explicit Sampler(uint32_t everyN);
+
+		uint32_t everyN;
+		std::atomic<uint32_t> count{ 0 };
+	};
+
+	std::unique_ptr<Slot[]> m_slots;
+	size_t m_capacity;
+	alignas(64) std::atomic<size_t> m_head{ 0 };	// the next position to write, shared by the logging threads
+	alignas(64) size_t m_tail{ 0 };				// the next position to read, the flush thread's alone
+	std::atomic<uint64_t> m_dropped{ 0 };
+	uint64_t m_reportedDropped{ 0 };
+
+	std::atomic<LogLevel> m_level{ LogLevel::INFO };
+	std::list<std::string> m_sampledRoutes;		// the names the samplers are keyed by views of
+	std::unordered_map<std::string_view, Sampler> m_samplers;	// looked up without building a string
+
+	std::mutex m_sinksMutex;	// taken by the flush thread and addSink, never by a logging thread
+	std::vector<std::unique_ptr<LogSink>> m_sinks;
+
+	std::atomic<bool> m_isRunning{ true };
+	std::thread m_flushThread;
+
+	explicit Logger(size_t capacity);
+
+	bool isSampledOut(LogLevel level, const char* route);
+	bool tryPush(LogRecord&& record);
+	bool tryPop(LogRecord& record);
+	void flushLoop();
+	size_t drain();
+};
@@ -0,0 +1,276 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <cstdio>
+
+
+// the quantiles every latency histogram is summarized by
+static constexpr std::array<double, 4> LATENCY_QUANTILES = { 0.5, 0.9, 0.99, 0.999 };
+static constexpr std::array<const char*, 4> LATENCY_QUANTILE_LABELS = { "0.5", "0.9", "0.99", "0.999" };
+
+static constexpr std::array<const char*, Metrics::STATUS_CLASSES_COUNT> STATUS_CLASS_LABELS = { "1xx", "2xx", "3xx", "4xx", "5xx" };
+
+static std::atomic<uint64_t> nextMetricsId{ 1 };
+
+
+RequestWork& RequestWork::current()
+{
+	static thread_local RequestWork work;
+	return work;
+}
+
+
+// metrics related functions //
+Metrics::Metrics() :
+	m_id(nextMetricsId.fetch_add(1))
+{
+	// Left empty
+}
+
+Metrics::~Metrics() = default;
+
+size_t Metrics::addRoute(const RouteInfo& info)
+{
+	const RouteInfo& route = m_routes.emplace_back(info);
+	m_routeLabels.push_back(label("route", route.name) + ',' + label("class", routeClassName(route.routeClass)));
+	m_routeIndexes[route.name] = m_routes.size() - 1;
+
+	return m_routes.size() - 1;
+}
+
+std::optional<size_t> Metrics::findRoute(std::string_view name) const
+{
+	const auto index = m_routeIndexes.find(name);
+	if (index == m_routeIndexes.end())
+		return std::nullopt;
+
+	return index->second;
+}
+
+void Metrics::recordRequest(size_t route, unsigned status, std::chrono::microseconds latency, uint64_t bytesIn, uint64_t bytesOut)
+{
+	RouteShard& shard = localShard().routes[route];
+	std::atomic<LatencyHistogram*>& latencies = shard.latencies[statusClassOf(status)];
+
+	LatencyHistogram* histogram = latencies.load(std::memory_order_relaxed);
+	if (histogram == nullptr)
+	{
+		histogram = new LatencyHistogram();
+		latencies.store(histogram, std::memory_order_release);
+	}
+
+	histogram->record(static_cast<uint64_t>(std::max<std::chrono::microseconds::rep>(latency.count(), 0)));
+	addToOwnCounter(shard.bytesIn, bytesIn);
+	addToOwnCounter(shard.bytesOut, bytesOut);
+}
+
+void Metrics::recordWork(size_t route, const RequestWork& work)
+{
+	RouteShard& shard = localShard().routes[route];
+
+	addToOwnCounter(shard.statements, work.statements);
+	addToOwnCounter(shard.rowsRead, work.rowsRead);
+	addToOwnCounter(shard.bytesOut, work.bytesOut);
+}
+
+void Metrics::write(std::string& text) const
+{
+	const std::lock_guard lock(m_shardsMutex);
+
+	std::vector<uint64_t> requests(m_routes.size() * STATUS_CLASSES_COUNT, 0);
+
+	writeFamily(text, "gallery_request_duration_seconds", "summary", "Time from the arrival of a request to its reply, queueing included.");
+	for (size_t route = 0; route < m_routes.size(); route++)
+	{
+		for (size_t statusClass = 0; statusClass < STATUS_CLASSES_COUNT; statusClass++)
+		{
+			LatencyHistogram::Snapshot snapshot;
+			for (const auto& shard : m_shards)
+			{
+				if (const LatencyHistogram* histogram = shard->routes[route].latencies[statusClass].load(std::memory_order_acquire))
+					snapshot.add(*histogram);
+			}
+
+			if (snapshot.count == 0)
+				continue;
+
+			requests[route * STATUS_CLASSES_COUNT + statusClass] = snapshot.count;
+			const std::string labels = m_routeLabels[route] + ',' + label("status", STATUS_CLASS_LABELS[statusClass]);
+
+			for (size_t i = 0; i < LATENCY_QUANTILES.size(); i++)
+			{
+				const double seconds = static_cast<double>(snapshot.quantile(LATENCY_QUANTILES[i])) / 1e6;
+				writeSample(text, "gallery_request_duration_seconds", labels + ',' + label("quantile", LATENCY_QUANTILE_LABELS[i]), seconds);
+			}
+
+			writeSample(text, "gallery_request_duration_seconds_sum", labels, static_cast<double>(snapshot.sum) / 1e6);
+			writeSample(text, "gallery_request_duration_seconds_count", labels, snapshot.count);
+		}
+	}
+
+	writeFamily(text, "gallery_requests_total", "counter", "Requests replied to, shed requests included.");
+	for (size_t route = 0; route < m_routes.size(); route++)
+	{
+		for (size_t statusClass = 0; statusClass < STATUS_CLASSES_COUNT; statusClass++)
+		{
+			if (requests[route * STATUS_CLASSES_COUNT + statusClass] != 0)
+				writeSample(text, "gallery_requests_total", m_routeLabels[route] + ',' + label("status", STATUS_CLASS_LABELS[statusClass]), requests[route * STATUS_CLASSES_COUNT + statusClass]);
+		}
+	}
+
+	// the counters of a route, summed over the shards
+	const auto writeCounter = [&](const char* name, const char* help, std::atomic<uint64_t> RouteShard::* counter)
+	{
+		writeFamily(text, name, "counter", help);
+
+		for (size_t route = 0; route < m_routes.size(); route++)
+		{
+			uint64_t total = 0;
+			for (const auto& shard : m_shards)
+				total += (shard->routes[route].*counter).load(std::memory_order_relaxed);
+
+			writeSample(text, name, m_routeLabels[route], total);
+		}
+	};
+
+	writeCounter("gallery_request_bytes_total", "Bytes of the request bodies, as declared by their Content-Length.", &RouteShard::bytesIn);
+	writeCounter("gallery_response_bytes_total", "Bytes of the response bodies, after compression.", &RouteShard::bytesOut);
+	writeCounter("gallery_db_statements_total", "SQL statements executed for the requests.", &RouteShard::statements);
+	writeCounter("gallery_db_rows_read_total", "Rows read by the SQL statements executed for the requests.", &RouteShard::rowsRead);
+}
+
+void Metrics::writeFamily(std::string& text, const char* name, const char* type, const char* help)
+{
+	text += "# HELP ";
+	text += name;
+	text += ' ';
+	text += help;
+	text += "\n# TYPE ";
+	text += name;
+	text += ' ';
+	text += type;
+	text += '\n';
+}
+
+void Metrics::writeSample(std::string& text, const char* name, const std::string& labels, uint64_t value)
+{
+	text += name;
+
+	if (!labels.empty())
+		text += '{' + labels + '}';
+
+	text += ' ';
+	text += std::to_string(value);
+	text += '\n';
+}
+
+void Metrics::writeSample(std::string& text, const char* name, const std::string& labels, double value)
+{
+	char formatted[32];
+	std::snprintf(formatted, sizeof(formatted), "%.9g", value);
+
+	text += name;
+
+	if (!labels.empty())
+		text += '{' + labels + '}';
+
+	text += ' ';
+	text += formatted;
+	text += '\n';
+}
+
+// a label with its value escaped, as the text format requires
+std::string Metrics::label(const char* name, const std::string& value)
+{
+	std::string labelText = name;
+	labelText += "=\"";
+
+	for (const char character : value)
+	{
+		if (character == '\\' || character == '"')
+			labelText += '\\';
+
+		if (character == '\n')
+			labelText += "\\n";
+		else
+			labelText += character;
+	}
+
+	labelText += '"';
+	return labelText;
+}
+
+
+// shard related functions //
+Metrics::RouteShard::~RouteShard()
+{
+	for (const auto& histogram : latencies)
+		delete histogram.load();
+}
+
+Metrics::Shard::Shard(size_t routesCount) :
+	routes(std::make_unique<RouteShard[]>(routesCount))
+{
+	// Left empty
+}
+
+
+// helper functions //
+// the shards of a thread are kept by the id of their instance, an id is never reused so the entry of a
+// destroyed instance is never looked up again. The shards outlive their threads, until the instance is gone
+Metrics::Shard& Metrics::localShard()
+{
+	static thread_local uint64_t cachedId = 0;
+	static thread_local Shard* cachedShard = nullptr;
+	static thread_local std::unordered_map<uint64_t, Shard*> shards;
+
+	if (cachedId == m_id)
+		return *cachedShard;
+
+	Shard*& shard = shards[m_id];
+	if (shard == nullptr)
+	{
+		auto newShard = std::make_unique<Shard>(m_routes.size());
+		shard = newShard.get();
+
+		const std::lock_guard lock(m_shardsMutex);
+		m_shards.push_back(std::move(newShard));
+	}
+
+	cachedId = m_id;
+	cachedShard = shard;
+
+	return *shard;
+}
+
+size_t Metrics::statusClassOf(unsigned status)
+{
+	if (status < 100 || status >= 600)
+		return STATUS_CLASSES_COUNT - 1;
+
+	return status / 100 - 1;
+}
+
+
+// request meter related functions //
+// the work of the thread starts over from zero, and the work of the outer meter is restored once this one ends
+RequestMeter::RequestMeter(Metrics& metrics, size_t route) :
+	m_metrics(metrics), m_route(route), m_outer(RequestWork::current())
+{
+	RequestWork::current() = RequestWork();
+}
+
+RequestMeter::RequestMeter(Metrics& metrics, std::string_view route) :
+	m_metrics(metrics), m_route(metrics.findRoute(route)), m_outer(RequestWork::current())
+{
+	RequestWork::current() = RequestWork();
+}
+
+RequestMeter::~RequestMeter()
+{
+	RequestWork& work = RequestWork::current();
+
+	if (m_route && (work.statements != 0 || work.rowsRead != 0 || work.bytesOut != 0))
+		m_metrics.recordWork(*m_route, work);
+
+	work = m_outer;
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "LatencyHistogram.h"
+#include "Router.h"
+
+
+// the work a thread does for the request it runs, counted where it is done - the statements DatabaseAccess
+// executes and the rows they read, and the bytes of the responses streamed to the client
+struct RequestWork
+{
+	uint64_t statements{ 0 };
+	uint64_t rowsRead{ 0 };
+	uint64_t bytesOut{ 0 };
+
+	static RequestWork& current();		// of the calling thread
+};
+
+
+/*
+ * Request metrics of every route - latency histograms per route and status class, and counters of the
+ * bytes in and out and of the database work of its requests.
+ * Every thread records into its own shard, so recording takes no lock and shares no cache line with
+ * another thread. The shards are only merged when the metrics are scraped, in the Prometheus text format.
+ * The routes are added before the server starts.
+ */
+class Metrics
+{
+public:
+	static constexpr size_t STATUS_CLASSES_COUNT = 5;	// 1xx to 5xx
+
+	Metrics();
+	~Metrics();
+
+	Metrics(const Metrics&) = delete;
+	Metrics& operator=(const Metrics&) = delete;
+
+	// the index the requests of the route are recorded by
+	size_t addRoute(const RouteInfo& info);
+	std::optional<size_t> findRoute(std::string_view name) const;
+
+	void recordRequest(size_t route, unsigned status, std::chrono::microseconds latency, uint64_t bytesIn, uint64_t bytesOut);
+	void recordWork(size_t route, const RequestWork& work);
+
+	// appends every metric, merged from the shards of all the threads
+	void write(std::string& text) const;
+
+	// Prometheus text format helpers, for the metrics of the other components
+	static void writeFamily(std::string& text, const char* name, const char* type, const char* help);
+	static void writeSample(std::string& text, const char* name, const std::string& labels, uint64_t value);
+	static void writeSample(std::string& text, const char* name, const std::string& labels, double value);
+	static std::string label(const char* name, const std::string& value);
+
+private:
+	// the metrics of a route recorded by a thread, a histogram is allocated once a status class occurs
+	struct RouteShard
+	{
+		std::array<std::atomic<LatencyHistogram*>, STATUS_CLASSES_COUNT> latencies{};
+		std::atomic<uint64_t> bytesIn{ 0 };
+		std::atomic<uint64_t> bytesOut{ 0 };
+		std::atomic<uint64_t> statements{ 0 };
+		std::atomic<uint64_t> rowsRead{ 0 };
+
+		~RouteShard();
+	};
+
+	struct Shard
+	{
+		explicit Shard(size_t routesCount);
+
+		std::unique_ptr<RouteShard[]> routes;
+	};
+
+	uint64_t m_id;		// tells the shards of this instance apart from those of another in a thread
+	std::deque<RouteInfo> m_routes;		// never moved, the index keys are views of their names
+	std::vector<std::string> m_routeLabels;
+	std::unordered_map<std::string_view, size_t> m_routeIndexes;
+
+	mutable std::mutex m_shardsMutex;	// taken when a thread records for the first time, and by write
+	std::vector<std::unique_ptr<Shard>> m_shards;
+
+	Shard& localShard();
+	static size_t statusClassOf(unsigned status);
+};
+
+
+/*
+ * Attributes the work the thread does while the meter lives to a route, scoped to the part of a request
+ * that runs on the thread. Meters nest, the work of an inner meter is not counted by the outer one.
+ */
+class RequestMeter
+{
+public:
+	RequestMeter(Metrics& metrics, size_t route);
+	RequestMeter(Metrics& metrics, std::string_view route);
+	~RequestMeter();
+
+	RequestMeter(const RequestMeter&) = delete;
+	RequestMeter& operator=(const RequestMeter&) = delete;
+
+private:
+	Metrics& m_metrics;
+	std::optional<size_t> m_route;
+	RequestWork m_outer;	// the work of the enclosing meter, set aside until this one ends
+};
@@ -5,14 +5,14 @@
 #include <sstream>
 
 
-Picture::Picture(int id, std::string name) :
-	m_pictureId(id), m_name(std::move(name))
+Picture::Picture(int id, std::string_view name) :
+	m_pictureId(id), m_name(name)
 {
 	setCreationDateNow();
 }
 
-Picture::Picture(int id, std::string name, std::string pathOnDisk, std::string creationDate)
-	: m_pictureId(id), m_name(std::move(name)), m_pathOnDisk(std::move(pathOnDisk)), m_creationDate(
+Picture::Picture(int id, std::string_view name, std::string_view pathOnDisk, std::string creationDate)
+	: m_pictureId(id), m_name(name), m_pathOnDisk(pathOnDisk), m_creationDate(
 		std::move(creationDate))
 {}
 
@@ -27,21 +27,26 @@ void Picture::setId(int id)
 }
 
 const std::string& Picture::getName() const
+{
+	return m_name.str();
+}
+
+const InternedString& Picture::getInternedName() const
 {
 	return m_name;
 }
 
-void Picture::setName(const std::string& name)
+void Picture::setName(std::string_view name)
 {
 	m_name = name;
 }
 
 const std::string& Picture::getPath() const
 {
-	return m_pathOnDisk;
+	return m_pathOnDisk.str();
 }
 
-void Picture::setPath(const std::string& location)
+void Picture::setPath(std::string_view location)
 {
 	m_pathOnDisk = location;
 }
@@ -67,30 +72,40 @@ void Picture::setCreationDateNow()
 	m_creationDate = oss.str();
 }
 
-bool Picture::isUserTagged(const User& userToTag) const
+bool Picture::isUserTagged(const User& user) const
 {
-	return std::any_of(m_usersTagged.cbegin(), m_usersTagged.cend(), [&](const User& user) { return user.getId() == userToTag.getId(); });
+	return isUserTagged(user.getId());
 }
 
 bool Picture::isUserTagged(int userId) const
 {
-	return std::any_of(m_usersTagged.cbegin(), m_usersTagged.cend(), [&](const User& user) { return user.getId() == userId; });
+	return std::binary_search(m_usersTagged.cbegin(), m_usersTagged.cend(), userId);
 }
 
 void Picture::tagUser(const User& user)
 {
-	m_usersTagged.insert(user);
+	tagUser(user.getId());
+}
+
+void Picture::tagUser(int userId)
+{
+	const auto position = std::lower_bound(m_usersTagged.cbegin(), m_usersTagged.cend(), userId);
+
+	if (position == m_usersTagged.cend() || *position != userId)
+		m_usersTagged.insert(position, userId);
 }
 
-void Picture::untagUser(const User& userToUntag)
+void Picture::untagUser(const User& user)
 {
-	if (isUserTagged(userToUntag))
-		m_usersTagged.erase(std::find_if(m_usersTagged.cbegin(), m_usersTagged.cend(), [&](const User& user) { return user.getId() == userToUntag.getId(); }));
+	untagUser(user.getId());
 }
 
 void Picture::untagUser(int userId)
 {
-	m_usersTagged.erase(std::find_if(m_usersTagged.cbegin(), m_usersTagged.cend(), [&](const User& user) { return user.getId() == userId; }));
+	const auto position = std::lower_bound(m_usersTagged.cbegin(), m_usersTagged.cend(), userId);
+
+	if (position != m_usersTagged.cend() && *position == userId)
+		m_usersTagged.erase(position);
 }
 
 int Picture::getTagsCount() const
@@ -98,7 +113,7 @@ int Picture::getTagsCount() const
 	return static_cast<int>(m_usersTagged.size());
 }
 
-const std::set<User>& Picture::getUsersTagged() const
+const Picture::TagList& Picture::getUsersTagged() const
 {
 	return m_usersTagged;
 }
@@ -110,11 +125,11 @@ bool Picture::operator==(const Picture& other) const
 
 std::ostream& operator<<(std::ostream& os, const Picture& pic) {
 	os << "Picture@" << pic.m_pictureId << ": ["
-		<< pic.m_name << ", " << pic.m_creationDate << ", " << pic.m_pathOnDisk <<
+		<< pic.m_name.str() << ", " << pic.m_creationDate << ", " << pic.m_pathOnDisk.str() <<
 		"] " << pic.getTagsCount() << " users tagged : ";
 
-	for (const auto& user : pic.m_usersTagged) {
-		os << "(" << user.getId() << ") ";
+	for (const int userId : pic.m_usersTagged) {
+		os << "(" << userId << ") ";
 	}
 	return os;
 }
\ No newline at end of file
@@ -1,23 +1,29 @@
 ﻿#pragma once
+#include "SmallVector.h"
 #include "User.h"
-#include <set>
 #include <string>
+#include <string_view>
+#include "StringPool.h"
 #include <iomanip>
 
 class Picture
 {
 public:
-	Picture(int id, std::string name);
-	Picture(int id, std::string name, std::string pathOnDisk, std::string creationDate);
+	// tagged user ids, kept sorted. Most pictures have only a few tags, which are stored inline
+	using TagList = SmallVector<int, 4>;
+
+	Picture(int id, std::string_view name);
+	Picture(int id, std::string_view name, std::string_view pathOnDisk, std::string creationDate);
 
 	int getId() const;
 	void setId(int id);
 
 	const std::string& getName() const;
-	void setName(const std::string& name);
+	const InternedString& getInternedName() const;
+	void setName(std::string_view name);
 
 	const std::string& getPath() const;
-	void setPath(const std::string& location);
+	void setPath(std::string_view location);
 
 	const std::string& getCreationDate() const;
 	void setCreationDate(const std::string& creationTime);
@@ -26,20 +32,21 @@ public:
 	bool isUserTagged(const User& user) const;
 	bool isUserTagged(int userId) const;
 	void tagUser(const User& user);
+	void tagUser(int userId);
 	void untagUser(const User& user);
 	void untagUser(int userId);
 
 	int getTagsCount() const;
 
-	const std::set<User>& getUsersTagged() const;
+	const TagList& getUsersTagged() const;
 
 	bool operator==(const Picture& other) const;
 	friend std::ostream& operator<<(std::ostream& os, const Picture& pic);
 
 private:
 	int m_pictureId;
-	std::string m_name;
-	std::string m_pathOnDisk;
+	InternedString m_name;
+	InternedString m_pathOnDisk;
 	std::string m_creationDate;
-	std::set<User> m_usersTagged;
+	TagList m_usersTagged;
 };
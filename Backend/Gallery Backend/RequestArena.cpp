@@ -0,0 +1,67 @@
+#include "RequestArena.h"
+
+
+RequestArena::RequestArena() :
+	m_heap(std::pmr::new_delete_resource()),
+	m_buffer(m_initialBlock, sizeof(m_initialBlock), &m_heap),
+	m_arena(&m_buffer)
+{
+	// Left empty
+}
+
+std::pmr::memory_resource* RequestArena::resource()
+{
+	return &m_arena;
+}
+
+size_t RequestArena::getAllocationsCount() const
+{
+	return m_arena.getAllocationsCount();
+}
+
+size_t RequestArena::getBytesAllocated() const
+{
+	return m_arena.getBytesAllocated();
+}
+
+size_t RequestArena::getHeapBlocksCount() const
+{
+	return m_heap.getAllocationsCount();
+}
+
+
+RequestArena::CountingResource::CountingResource(std::pmr::memory_resource* upstream) :
+	m_upstream(upstream)
+{
+	// Left empty
+}
+
+size_t RequestArena::CountingResource::getAllocationsCount() const
+{
+	return m_allocationsCount;
+}
+
+size_t RequestArena::CountingResource::getBytesAllocated() const
+{
+	return m_bytesAllocated;
+}
+
+void* RequestArena::CountingResource::do_allocate(size_t bytes, size_t alignment)
+{
+	void* pointer = m_upstream->allocate(bytes, alignment);
+
+	m_allocationsCount++;
+	m_bytesAllocated += bytes;
+
+	return pointer;
+}
+
+void RequestArena::CountingResource::do_deallocate(void* pointer, size_t bytes, size_t alignment)
+{
+	m_upstream->deallocate(pointer, bytes, alignment);
+}
+
+bool RequestArena::CountingResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
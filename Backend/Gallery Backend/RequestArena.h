@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+
+#include "Constants.h"
+
+
+/*
+ * Memory arena for the objects built while serving a single request.
+ * Result containers and the models inside them allocate from a monotonic buffer - first from a block
+ * inside the arena itself, then from growing blocks taken from the heap - and nothing is freed until
+ * the arena is destroyed, after the reply was sent, which releases everything at once.
+ * The arena is not thread safe, it must only be used by the handler of its request.
+ */
+class RequestArena
+{
+public:
+	RequestArena();
+
+	RequestArena(const RequestArena&) = delete;
+	RequestArena& operator=(const RequestArena&) = delete;
+
+	std::pmr::memory_resource* resource();
+
+	size_t getAllocationsCount() const;		// allocations served by the arena
+	size_t getBytesAllocated() const;		// bytes handed out by the arena
+	size_t getHeapBlocksCount() const;		// blocks the arena took from the heap
+
+private:
+	// forwards to another resource and counts what goes through it
+	class CountingResource : public std::pmr::memory_resource
+	{
+	public:
+		explicit CountingResource(std::pmr::memory_resource* upstream);
+
+		size_t getAllocationsCount() const;
+		size_t getBytesAllocated() const;
+
+	private:
+		std::pmr::memory_resource* m_upstream;
+		size_t m_allocationsCount{ 0 };
+		size_t m_bytesAllocated{ 0 };
+
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+	};
+
+	alignas(std::max_align_t) std::byte m_initialBlock[REQUEST_ARENA_INITIAL_SIZE];
+	CountingResource m_heap;
+	std::pmr::monotonic_buffer_resource m_buffer;
+	CountingResource m_arena;
+};
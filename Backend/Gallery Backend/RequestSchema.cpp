@@ -0,0 +1,70 @@
+#include "RequestSchema.h"
+
+
+// both readers have the same interface, the overloads of every member type share a single body
+template <typename Reader>
+static void readInteger(Reader& reader, const char* name, int& value)
+{
+	if (reader.peekType() != Reader::Type::NUMBER || !reader.readInteger(value))
+		throw InvalidRequestException("Field '" + std::string(name) + "' must be an integer.");
+}
+
+template <typename Reader>
+static void readBoolean(Reader& reader, const char* name, bool& value)
+{
+	if (reader.peekType() != Reader::Type::BOOLEAN)
+		throw InvalidRequestException("Field '" + std::string(name) + "' must be a boolean.");
+
+	value = reader.readBoolean();
+}
+
+template <typename Reader>
+static void readString(Reader& reader, const char* name, std::string& value)
+{
+	if (reader.peekType() != Reader::Type::STRING)
+		throw InvalidRequestException("Field '" + std::string(name) + "' must be a string.");
+
+	reader.readString(value);
+}
+
+
+void readRequestValue(JsonReader& reader, const char* name, int& value)
+{
+	readInteger(reader, name, value);
+}
+
+void readRequestValue(JsonReader& reader, const char* name, bool& value)
+{
+	readBoolean(reader, name, value);
+}
+
+void readRequestValue(JsonReader& reader, const char* name, std::string& value)
+{
+	readString(reader, name, value);
+}
+
+void readRequestValue(JsonReader& reader, const char* name, RawValue& value)
+{
+	value = { reader.readRaw(), RequestFormat::JSON };
+}
+
+void readRequestValue(CborReader& reader, const char* name, int& value)
+{
+	readInteger(reader, name, value);
+}
+
+void readRequestValue(CborReader& reader, const char* name, bool& value)
+{
+	readBoolean(reader, name, value);
+}
+
+void readRequestValue(CborReader& reader, const char* name, std::string& value)
+{
+	readString(reader, name, value);
+}
+
+// the value stays CBOR, it is decoded by the reader of its format once it is known what it holds
+void readRequestValue(CborReader& reader, const char* name, RawValue& value)
+{
+	value = { reader.readRaw(), RequestFormat::CBOR };
+}
@@ -0,0 +1,180 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "CborReader.h"
+#include "InvalidRequestException.h"
+#include "JsonReader.h"
+
+
+/*
+ * Declarative schemas of request bodies.
+ * A request is a plain struct with a static fields() function listing the JSON key of every member:
+ *
+ *     struct UserRequest
+ *     {
+ *         int id;
+ *         int count = 10;
+ *         static constexpr auto fields() { return std::make_tuple(requiredField("id", &UserRequest::id), optionalField("count", &UserRequest::count)); }
+ *     };
+ *
+ * decodeRequest<UserRequest>(body) reads the body once with the reader of its format - a JsonReader or
+ * a CborReader - straight into the members, skipping unknown keys. Optional members keep their default
+ * when the key is missing. A member may be an int, a bool, a string, RawValue, another such struct or a
+ * vector of any of those. Every problem with the body - malformed JSON or CBOR, a missing field or a
+ * value of the wrong type - is thrown as an InvalidRequestException with a message that is safe to show
+ * to the client.
+ */
+template <typename Request, typename Member>
+struct RequestField
+{
+	const char* name;
+	Member Request::* member;
+	bool isRequired;
+};
+
+template <typename Request, typename Member>
+constexpr RequestField<Request, Member> requiredField(const char* name, Member Request::* member)
+{
+	return { name, member, true };
+}
+
+template <typename Request, typename Member>
+constexpr RequestField<Request, Member> optionalField(const char* name, Member Request::* member)
+{
+	return { name, member, false };
+}
+
+
+enum class RequestFormat { JSON, CBOR };
+
+// the encoded value kept as it is, to be decoded once it is known what it holds
+struct RawValue
+{
+	std::string_view data;
+	RequestFormat format{ RequestFormat::JSON };
+};
+
+// a whole request body, in the format it was sent in
+struct RequestBody
+{
+	std::string data;
+	RequestFormat format{ RequestFormat::JSON };
+};
+
+
+// reading of a single value, one overload for every member type a request may have and every reader
+void readRequestValue(JsonReader& reader, const char* name, int& value);
+void readRequestValue(JsonReader& reader, const char* name, bool& value);
+void readRequestValue(JsonReader& reader, const char* name, std::string& value);
+void readRequestValue(JsonReader& reader, const char* name, RawValue& value);
+void readRequestValue(CborReader& reader, const char* name, int& value);
+void readRequestValue(CborReader& reader, const char* name, bool& value);
+void readRequestValue(CborReader& reader, const char* name, std::string& value);
+void readRequestValue(CborReader& reader, const char* name, RawValue& value);
+
+template <typename Reader, typename Request, typename = decltype(Request::fields())>
+void readRequestValue(Reader& reader, const char* name, Request& value);
+
+template <typename Reader, typename Element>
+void readRequestValue(Reader& reader, const char* name, std::vector<Element>& values)
+{
+	if (reader.peekType() != Reader::Type::ARRAY)
+		throw InvalidRequestException("Field '" + std::string(name) + "' must be an array.");
+
+	reader.beginArray();
+
+	while (reader.nextElement())
+		readRequestValue(reader, name, values.emplace_back());
+}
+
+
+namespace RequestSchemaDetails
+{
+	template <typename Reader, typename Request, typename Fields, size_t... Indices>
+	bool readField(Reader& reader, const std::string& key, Request& request, const Fields& fields, std::array<bool, sizeof...(Indices)>& isRead, std::index_sequence<Indices...>)
+	{
+		// requests have a few fields, comparing the key against each of them beats hashing it
+		return ((key == std::get<Indices>(fields).name ?
+			(readRequestValue(reader, std::get<Indices>(fields).name, request.*(std::get<Indices>(fields).member)), isRead[Indices] = true) :
+			false) || ...);
+	}
+
+	template <typename Fields, size_t... Indices>
+	const char* findMissingField(const Fields& fields, const std::array<bool, sizeof...(Indices)>& isRead, std::index_sequence<Indices...>)
+	{
+		const char* missing = nullptr;
+		((missing == nullptr && std::get<Indices>(fields).isRequired && !isRead[Indices] ? (missing = std::get<Indices>(fields).name) : nullptr), ...);
+		return missing;
+	}
+
+	// reads the members of the object the reader is at into request
+	template <typename Reader, typename Request>
+	void readObject(Reader& reader, Request& request)
+	{
+		constexpr auto fields = Request::fields();
+		constexpr size_t fieldsCount = std::tuple_size_v<decltype(fields)>;
+		const auto indices = std::make_index_sequence<fieldsCount>();
+
+		std::array<bool, fieldsCount> isRead{};
+
+		reader.beginObject();
+
+		std::string key;
+		while (reader.nextKey(key))
+		{
+			if (!readField(reader, key, request, fields, isRead, indices))
+				reader.skipValue();
+		}
+
+		if (const char* missing = findMissingField(fields, isRead, indices))
+			throw InvalidRequestException("Missing '" + std::string(missing) + "' field in the request body.");
+	}
+}
+
+
+template <typename Reader, typename Request, typename>
+void readRequestValue(Reader& reader, const char* name, Request& value)
+{
+	if (reader.peekType() != Reader::Type::OBJECT)
+		throw InvalidRequestException("Field '" + std::string(name) + "' must be an object.");
+
+	RequestSchemaDetails::readObject(reader, value);
+}
+
+
+namespace RequestSchemaDetails
+{
+	template <typename Reader, typename Request>
+	void decodeObject(std::string_view data, Request& request)
+	{
+		Reader reader(data);
+		readObject(reader, request);
+		reader.end();
+	}
+}
+
+
+template <typename Request>
+Request decodeRequest(const RawValue& body)
+{
+	Request request{};
+
+	if (body.format == RequestFormat::CBOR)
+		RequestSchemaDetails::decodeObject<CborReader>(body.data, request);
+	else
+		RequestSchemaDetails::decodeObject<JsonReader>(body.data, request);
+
+	return request;
+}
+
+template <typename Request>
+Request decodeRequest(const RequestBody& body)
+{
+	return decodeRequest<Request>(RawValue{ body.data, body.format });
+}
@@ -0,0 +1,99 @@
+#include "Requests.h"
+
+
+// nesting limit of a query, so a hostile body can not exhaust the stack
+constexpr int MAX_QUERY_DEPTH = 32;
+
+
+[[noreturn]] static void failInvalidQuery()
+{
+	throw InvalidRequestException("Invalid query in the request body. Expected one of {\"user\": id}, {\"owner\": id}, {\"album\": name}, {\"not\": query}, {\"and\": [queries]}, {\"or\": [queries]}.");
+}
+
+template <typename Reader>
+static void readTagQuery(Reader& reader, TagQuery& query, int depth)
+{
+	if (depth > MAX_QUERY_DEPTH || reader.peekType() != Reader::Type::OBJECT)
+		failInvalidQuery();
+
+	reader.beginObject();
+
+	std::string key;
+	if (!reader.nextKey(key))
+		failInvalidQuery();
+
+	if (key == "user" || key == "owner")
+	{
+		query.type = key == "user" ? TagQuery::Type::USER : TagQuery::Type::OWNER;
+
+		if (reader.peekType() != Reader::Type::NUMBER || !reader.readInteger(query.id))
+			failInvalidQuery();
+	}
+	else if (key == "album")
+	{
+		if (reader.peekType() != Reader::Type::STRING)
+			failInvalidQuery();
+
+		query.type = TagQuery::Type::ALBUM;
+		reader.readString(query.albumName);
+	}
+	else if (key == "not")
+	{
+		query.type = TagQuery::Type::NOT;
+		readTagQuery(reader, query.operands.emplace_back(), depth + 1);
+	}
+	else if (key == "and" || key == "or")
+	{
+		query.type = key == "and" ? TagQuery::Type::AND : TagQuery::Type::OR;
+
+		if (reader.peekType() != Reader::Type::ARRAY)
+			failInvalidQuery();
+
+		reader.beginArray();
+
+		while (reader.nextElement())
+			readTagQuery(reader, query.operands.emplace_back(), depth + 1);
+
+		if (query.operands.empty())
+			failInvalidQuery();
+	}
+	else
+		failInvalidQuery();
+
+	// the operator is the only field of its object
+	if (reader.nextKey(key))
+		failInvalidQuery();
+}
+
+template <typename Reader>
+static TagQuery decodeTagQueryWith(std::string_view data)
+{
+	TagQuery query;
+
+	Reader reader(data);
+	readTagQuery(reader, query, 0);
+	reader.end();
+
+	return query;
+}
+
+
+void readRequestValue(JsonReader& reader, const char* name, TagQuery& value)
+{
+	readTagQuery(reader, value, 0);
+}
+
+void readRequestValue(CborReader& reader, const char* name, TagQuery& value)
+{
+	readTagQuery(reader, value, 0);
+}
+
+TagQuery decodeTagQuery(const RawValue& body)
+{
+	return body.format == RequestFormat::CBOR ? decodeTagQueryWith<CborReader>(body.data) : decodeTagQueryWith<JsonReader>(body.data);
+}
+
+TagQuery decodeTagQuery(const RequestBody& body)
+{
+	return decodeTagQuery(RawValue{ body.data, body.format });
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "Constants.h"
+#include "RequestSchema.h"
+#include "TagIndex.h"
+
+
+// bodies of the requests the API accepts, see RequestSchema.h //
+
+// an operation that takes no input
+struct EmptyRequest
+{
+	static constexpr auto fields() { return std::make_tuple(); }
+};
+
+// a user, by id
+struct UserRequest
+{
+	int id;
+
+	static constexpr auto fields() { return std::make_tuple(requiredField("id", &UserRequest::id)); }
+};
+
+struct CreateUserRequest
+{
+	std::string name;
+
+	static constexpr auto fields() { return std::make_tuple(requiredField("name", &CreateUserRequest::name)); }
+};
+
+// an album, by its name and owner
+struct AlbumRequest
+{
+	std::string name;
+	int userId;
+
+	static constexpr auto fields() { return std::make_tuple(requiredField("name", &AlbumRequest::name), requiredField("user_id", &AlbumRequest::userId)); }
+};
+
+struct AlbumPicturesRequest
+{
+	int ownerId;
+	std::string albumName;
+
+	static constexpr auto fields() { return std::make_tuple(requiredField("owner_id", &AlbumPicturesRequest::ownerId), requiredField("album_name", &AlbumPicturesRequest::albumName)); }
+};
+
+// a picture, by its name and the name of its album
+struct PictureRequest
+{
+	std::string albumName;
+	std::string pictureName;
+
+	static constexpr auto fields() { return std::make_tuple(requiredField("album_name", &PictureRequest::albumName), requiredField("picture_name", &PictureRequest::pictureName)); }
+};
+
+struct AddPictureRequest
+{
+	std::string albumName;
+	std::string pictureName;
+	std::string path;
+
+	static constexpr auto fields()
+	{
+		return std::make_tuple(requiredField("album_name", &AddPictureRequest::albumName), requiredField("picture_name", &AddPictureRequest::pictureName),
+			requiredField("path", &AddPictureRequest::path));
+	}
+};
+
+// a tag of a user in a picture
+struct TagRequest
+{
+	std::string albumName;
+	std::string pictureName;
+	int userId;
+
+	static constexpr auto fields()
+	{
+		return std::make_tuple(requiredField("album_name", &TagRequest::albumName), requiredField("picture_name", &TagRequest::pictureName),
+			requiredField("user_id", &TagRequest::userId));
+	}
+};
+
+// a picture, by its id and name
+struct PictureTagsRequest
+{
+	int id;
+	std::string name;
+
+	static constexpr auto fields() { return std::make_tuple(requiredField("id", &PictureTagsRequest::id), requiredField("name", &PictureTagsRequest::name)); }
+};
+
+struct CoTaggedUsersRequest
+{
+	int id;
+	int count = 10;		// the 10 users tagged together with the user the most by default
+
+	static constexpr auto fields() { return std::make_tuple(requiredField("id", &CoTaggedUsersRequest::id), optionalField("count", &CoTaggedUsersRequest::count)); }
+};
+
+struct CoTagStrengthRequest
+{
+	int firstId;
+	int secondId;
+
+	static constexpr auto fields() { return std::make_tuple(requiredField("first_id", &CoTagStrengthRequest::firstId), requiredField("second_id", &CoTagStrengthRequest::secondId)); }
+};
+
+struct SuggestTagsRequest
+{
+	std::string albumName;
+	std::string pictureName;
+	int count = 10;		// the 10 likeliest users by default
+
+	static constexpr auto fields()
+	{
+		return std::make_tuple(requiredField("album_name", &SuggestTagsRequest::albumName), requiredField("picture_name", &SuggestTagsRequest::pictureName),
+			optionalField("count", &SuggestTagsRequest::count));
+	}
+};
+
+// users or pictures by their ids, and albums by their names, for the multi-get endpoints
+struct IDsRequest
+{
+	std::vector<int> ids;
+
+	static constexpr auto fields() { return std::make_tuple(requiredField("ids", &IDsRequest::ids)); }
+};
+
+struct NamesRequest
+{
+	std::vector<std::string> names;
+
+	static constexpr auto fields() { return std::make_tuple(requiredField("names", &NamesRequest::names)); }
+};
+
+template <typename Key>
+void checkLookupSize(const std::vector<Key>& keys)
+{
+	if (keys.size() > MULTI_GET_MAX_KEYS)
+		throw InvalidRequestException("At most " + std::to_string(MULTI_GET_MAX_KEYS) + " items can be looked up at once.");
+}
+
+// an operation of a batch, the body is decoded by the operation once it is known which one it is
+struct BatchOperationRequest
+{
+	std::string op;
+	RawValue body{ "{}" };
+
+	static constexpr auto fields() { return std::make_tuple(requiredField("op", &BatchOperationRequest::op), optionalField("body", &BatchOperationRequest::body)); }
+};
+
+struct BatchRequest
+{
+	std::vector<BatchOperationRequest> operations;
+	bool atomic = false;
+
+	static constexpr auto fields() { return std::make_tuple(requiredField("operations", &BatchRequest::operations), optionalField("atomic", &BatchRequest::atomic)); }
+};
+
+// a tag query is the whole body of its request, an object with a single field: {"user": id}, {"owner": id},
+// {"album": name}, {"not": query}, {"and": [queries]} or {"or": [queries]}. It is read straight into the
+// TagQuery, operand by operand, and a query nested too deep is rejected like any other invalid one
+void readRequestValue(JsonReader& reader, const char* name, TagQuery& value);
+void readRequestValue(CborReader& reader, const char* name, TagQuery& value);
+TagQuery decodeTagQuery(const RawValue& body);
+TagQuery decodeTagQuery(const RequestBody& body);
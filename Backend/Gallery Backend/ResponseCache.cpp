@@ -0,0 +1,152 @@
+#include "ResponseCache.h"
+#include <iterator>
+
+
+ResponseCache::ResponseCache(size_t maxBytes) :
+	m_maxBytes(maxBytes)
+{
+	// Left empty
+}
+
+
+// document related functions //
+std::shared_ptr<const std::string> ResponseCache::get(const std::string& key, uint64_t version)
+{
+	const std::lock_guard lock(m_mutex);
+
+	const auto entry = m_index.find(key);
+	if (entry == m_index.end())
+	{
+		m_misses++;
+		return nullptr;
+	}
+
+	// the version only grows, a document of an older one was built before a write it missed. A newer one
+	// was put by a request that started after this reader, it is kept for the requests that follow
+	if (entry->second->version < version)
+	{
+		erase(entry->second);
+		m_invalidations++;
+		m_misses++;
+		return nullptr;
+	}
+
+	if (entry->second->version != version)
+	{
+		m_misses++;
+		return nullptr;
+	}
+
+	m_entries.splice(m_entries.begin(), m_entries, entry->second);
+	m_hits++;
+
+	return entry->second->document;
+}
+
+void ResponseCache::put(const std::string& key, std::vector<std::string> dependencies, uint64_t version, std::shared_ptr<const std::string> document)
+{
+	Entry newEntry{ key, std::move(dependencies), version, std::move(document), 0 };
+	newEntry.size = sizeOf(newEntry);
+
+	if (newEntry.size > m_maxBytes)
+		return;
+
+	const std::lock_guard lock(m_mutex);
+
+	// another request may have built the same document meanwhile, the newer version wins
+	const auto existing = m_index.find(key);
+	if (existing != m_index.end())
+	{
+		if (existing->second->version > version)
+			return;
+
+		erase(existing->second);
+	}
+
+	for (const auto& dependency : newEntry.dependencies)
+		m_dependents[dependency].insert(key);
+
+	m_bytes += newEntry.size;
+	m_entries.push_front(std::move(newEntry));
+	m_index[key] = m_entries.begin();
+
+	while (m_bytes > m_maxBytes)
+	{
+		erase(std::prev(m_entries.end()));
+		m_evictions++;
+	}
+}
+
+void ResponseCache::invalidate(const std::string& dependency)
+{
+	if (dependency.empty())
+	{
+		clear();
+		return;
+	}
+
+	const std::lock_guard lock(m_mutex);
+
+	const auto dependents = m_dependents.find(dependency);
+	if (dependents == m_dependents.end())
+		return;
+
+	// erasing an entry edits the dependents of its dependencies, this one included
+	const std::vector<std::string> keys(dependents->second.begin(), dependents->second.end());
+
+	for (const auto& key : keys)
+	{
+		erase(m_index.at(key));
+		m_invalidations++;
+	}
+}
+
+void ResponseCache::clear()
+{
+	const std::lock_guard lock(m_mutex);
+
+	m_invalidations += m_entries.size();
+	m_entries.clear();
+	m_index.clear();
+	m_dependents.clear();
+	m_bytes = 0;
+}
+
+ResponseCache::Stats ResponseCache::getStats() const
+{
+	const std::lock_guard lock(m_mutex);
+
+	return { m_hits, m_misses, m_evictions, m_invalidations, m_entries.size(), m_bytes, m_maxBytes };
+}
+
+
+// helper functions //
+void ResponseCache::erase(Entries::iterator entry)
+{
+	for (const auto& dependency : entry->dependencies)
+	{
+		const auto dependents = m_dependents.find(dependency);
+		if (dependents == m_dependents.end())
+			continue;	// the entry listed the dependency twice
+
+		dependents->second.erase(entry->key);
+
+		if (dependents->second.empty())
+			m_dependents.erase(dependents);
+	}
+
+	m_bytes -= entry->size;
+	m_index.erase(entry->key);
+	m_entries.erase(entry);
+}
+
+// the document and its bookkeeping - the key is stored in the entry, the index and every dependency
+size_t ResponseCache::sizeOf(const Entry& entry)
+{
+	size_t size = sizeof(Entry) + entry.document->size() + 2 * entry.key.size();
+
+	for (const auto& dependency : entry.dependencies)
+		size += dependency.size() + entry.key.size();
+
+	return size;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Constants.h"
+
+
+/*
+ * Byte bounded LRU cache of the documents the read endpoints reply with, as they were written.
+ * A document is keyed by its endpoint, request and format, and tagged with the DataVersions keys of
+ * the albums, users and pictures it was built from. DatabaseAccess drops the documents of a key as soon
+ * as a write bumps it. A document also remembers the data version it was built at, and is only returned
+ * for that version, so one built from data a write changed meanwhile is never served.
+ * The least recently used documents are evicted once the documents take more than the limit.
+ */
+class ResponseCache
+{
+public:
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		uint64_t invalidations;
+		size_t entries;
+		size_t bytes;
+		size_t maxBytes;
+	};
+
+	explicit ResponseCache(size_t maxBytes = RESPONSE_CACHE_MAX_BYTES);
+
+	ResponseCache(const ResponseCache&) = delete;
+	ResponseCache& operator=(const ResponseCache&) = delete;
+
+	// the document of key if it was built at version, nullptr otherwise
+	std::shared_ptr<const std::string> get(const std::string& key, uint64_t version);
+	void put(const std::string& key, std::vector<std::string> dependencies, uint64_t version, std::shared_ptr<const std::string> document);
+
+	// drops the documents built from dependency, or every document if it is empty
+	void invalidate(const std::string& dependency);
+	void clear();
+
+	Stats getStats() const;
+
+private:
+	struct Entry
+	{
+		std::string key;
+		std::vector<std::string> dependencies;
+		uint64_t version;
+		std::shared_ptr<const std::string> document;	// shared, so it is sent outside the lock
+		size_t size;
+	};
+
+	using Entries = std::list<Entry>;		// the most recently used first
+
+	size_t m_maxBytes;
+	mutable std::mutex m_mutex;
+	Entries m_entries;
+	std::unordered_map<std::string, Entries::iterator> m_index;
+	std::unordered_map<std::string, std::unordered_set<std::string>> m_dependents;	// dependency -> keys
+	size_t m_bytes{ 0 };
+	uint64_t m_hits{ 0 };
+	uint64_t m_misses{ 0 };
+	uint64_t m_evictions{ 0 };
+	uint64_t m_invalidations{ 0 };
+
+	void erase(Entries::iterator entry);
+	static size_t sizeOf(const Entry& entry);
+};
@@ -0,0 +1,124 @@
+#include "ResponseCompressor.h"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+#include "Constants.h"
+#include "MyException.h"
+
+
+// "gzip, deflate;q=0.5, *;q=0" - a missing quality is 1, and a quality of 0 means not acceptable
+ResponseCompressor::Encoding ResponseCompressor::negotiate(const std::string& acceptEncoding)
+{
+	// -1 while a coding is not listed
+	double gzipQuality = -1;
+	double deflateQuality = -1;
+	double anyQuality = -1;
+
+	std::stringstream codings(acceptEncoding);
+	std::string coding;
+
+	while (std::getline(codings, coding, ','))
+	{
+		std::string name = coding.substr(0, coding.find(';'));
+		name.erase(std::remove_if(name.begin(), name.end(), [](unsigned char c) { return std::isspace(c); }), name.end());
+		std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+		double quality = 1;
+		const size_t parameter = coding.find("q=");
+		if (parameter != std::string::npos)
+		{
+			try {
+				quality = std::stod(coding.substr(parameter + 2));
+			}
+			catch (const std::exception&) {
+				quality = 0;
+			}
+		}
+
+		if (name == "gzip" || name == "x-gzip")
+			gzipQuality = quality;
+		else if (name == "deflate")
+			deflateQuality = quality;
+		else if (name == "*")
+			anyQuality = quality;
+	}
+
+	// "*" stands for every coding that is not listed by name
+	if (gzipQuality < 0)
+		gzipQuality = anyQuality;
+	if (deflateQuality < 0)
+		deflateQuality = anyQuality;
+
+	if (gzipQuality <= 0 && deflateQuality <= 0)
+		return Encoding::IDENTITY;
+
+	// gzip wins ties, every client that accepts deflate accepts gzip too
+	return gzipQuality >= deflateQuality ? Encoding::GZIP : Encoding::DEFLATE;
+}
+
+const char* ResponseCompressor::name(Encoding encoding)
+{
+	switch (encoding)
+	{
+	case Encoding::GZIP: return "gzip";
+	case Encoding::DEFLATE: return "deflate";
+	default: return "identity";
+	}
+}
+
+
+ResponseCompressor::ResponseCompressor(Encoding encoding, int level, Sink sink) :
+	m_sink(std::move(sink)), m_output(RESPONSE_CHUNK_SIZE)
+{
+	if (encoding == Encoding::IDENTITY)
+		throw MyException("The identity encoding needs no compressor.");
+
+	// 15 bits of window, +16 wraps the stream with a gzip header instead of a zlib one (HTTP deflate)
+	const int windowBits = encoding == Encoding::GZIP ? 15 + 16 : 15;
+
+	if (deflateInit2(&m_stream, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		throw MyException("Failed to initialize the response compressor.");
+}
+
+ResponseCompressor::~ResponseCompressor()
+{
+	deflateEnd(&m_stream);
+}
+
+void ResponseCompressor::write(const char* data, size_t size)
+{
+	m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+	m_stream.avail_in = static_cast<uInt>(size);
+
+	deflateInput(Z_NO_FLUSH);
+}
+
+void ResponseCompressor::finish()
+{
+	m_stream.next_in = nullptr;
+	m_stream.avail_in = 0;
+
+	deflateInput(Z_FINISH);
+}
+
+
+// helper functions //
+// compresses all the pending input, handing every full output buffer to the sink
+void ResponseCompressor::deflateInput(int flush)
+{
+	do
+	{
+		m_stream.next_out = reinterpret_cast<Bytef*>(m_output.data());
+		m_stream.avail_out = static_cast<uInt>(m_output.size());
+
+		if (deflate(&m_stream, flush) == Z_STREAM_ERROR)
+			throw MyException("Failed to compress the response.");
+
+		const size_t compressedSize = m_output.size() - m_stream.avail_out;
+		if (compressedSize != 0)
+			m_sink(m_output.data(), compressedSize);
+
+	} while (m_stream.avail_out == 0);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+
+/*
+ * Compresses a response body on the fly for the Content-Encoding the client accepts.
+ * Input is compressed as it is written and the compressed output is handed to the sink a chunk at
+ * a time, so compressing a streamed response never holds more than the compressor's window.
+ * gzip and deflate come from zlib, which the C++ REST SDK already depends on.
+ */
+class ResponseCompressor
+{
+public:
+	using Sink = std::function<void(const char* data, size_t size)>;
+
+	enum class Encoding { IDENTITY, GZIP, DEFLATE };
+
+	// the best encoding of an Accept-Encoding header by its quality values, identity if none is supported
+	static Encoding negotiate(const std::string& acceptEncoding);
+	static const char* name(Encoding encoding);
+
+	ResponseCompressor(Encoding encoding, int level, Sink sink);
+	~ResponseCompressor();
+
+	ResponseCompressor(const ResponseCompressor&) = delete;
+	ResponseCompressor& operator=(const ResponseCompressor&) = delete;
+
+	void write(const char* data, size_t size);
+	void finish();		// writes the end of the compressed stream, nothing can be written after it
+
+private:
+	z_stream m_stream{};
+	Sink m_sink;
+	std::vector<char> m_output;
+
+	void deflateInput(int flush);
+};
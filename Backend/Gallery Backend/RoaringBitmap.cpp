@@ -0,0 +1,411 @@
+#include "RoaringBitmap.h"
+
+#include <algorithm>
+#include <iterator>
+
+
+// counts the set bits of a word without relying on compiler specific intrinsics
+static uint32_t popcount(uint64_t word)
+{
+	word = word - ((word >> 1) & 0x5555555555555555ULL);
+	word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+	word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return static_cast<uint32_t>((word * 0x0101010101010101ULL) >> 56);
+}
+
+static uint16_t highBits(uint32_t value)
+{
+	return static_cast<uint16_t>(value >> 16);
+}
+
+static uint16_t lowBits(uint32_t value)
+{
+	return static_cast<uint16_t>(value & 0xFFFF);
+}
+
+
+// container related functions //
+bool RoaringBitmap::Container::contains(uint16_t value) const
+{
+	if (isBitset())
+		return (bitset[value >> 6] >> (value & 63)) & 1;
+
+	return std::binary_search(array.begin(), array.end(), value);
+}
+
+// picks the cheaper representation for the current cardinality
+void RoaringBitmap::Container::normalize()
+{
+	if (isBitset() && cardinality <= ARRAY_MAX_SIZE)
+		toArray(*this);
+	else if (!isBitset() && cardinality > ARRAY_MAX_SIZE)
+		toBitset(*this);
+}
+
+void RoaringBitmap::toBitset(Container& container)
+{
+	container.bitset.assign(BITSET_WORDS, 0);
+
+	for (const uint16_t value : container.array)
+		container.bitset[value >> 6] |= 1ULL << (value & 63);
+
+	container.array.clear();
+	container.array.shrink_to_fit();
+}
+
+void RoaringBitmap::toArray(Container& container)
+{
+	container.array.clear();
+	container.array.reserve(container.cardinality);
+
+	for (uint32_t i = 0; i < BITSET_WORDS; i++)
+	{
+		uint64_t word = container.bitset[i];
+
+		while (word != 0)
+		{
+			const uint64_t lowestBit = word & (~word + 1);
+			container.array.push_back(static_cast<uint16_t>(i * 64 + popcount(lowestBit - 1)));
+			word ^= lowestBit;
+		}
+	}
+
+	container.bitset.clear();
+	container.bitset.shrink_to_fit();
+}
+
+RoaringBitmap::Container RoaringBitmap::intersect(const Container& first, const Container& second)
+{
+	Container result;
+
+	if (first.isBitset() && second.isBitset())
+	{
+		result.bitset.resize(BITSET_WORDS);
+		for (uint32_t i = 0; i < BITSET_WORDS; i++)
+			result.bitset[i] = first.bitset[i] & second.bitset[i];
+
+		for (const uint64_t word : result.bitset)
+			result.cardinality += popcount(word);
+	}
+	else if (first.isBitset() || second.isBitset())
+	{
+		const Container& sparse = first.isBitset() ? second : first;
+		const Container& dense = first.isBitset() ? first : second;
+
+		for (const uint16_t value : sparse.array)
+		{
+			if (dense.contains(value))
+				result.array.push_back(value);
+		}
+
+		result.cardinality = static_cast<uint32_t>(result.array.size());
+	}
+	else
+	{
+		std::set_intersection(first.array.begin(), first.array.end(), second.array.begin(), second.array.end(), std::back_inserter(result.array));
+		result.cardinality = static_cast<uint32_t>(result.array.size());
+	}
+
+	result.normalize();
+	return result;
+}
+
+RoaringBitmap::Container RoaringBitmap::unite(const Container& first, const Container& second)
+{
+	Container result;
+
+	if (first.isBitset() || second.isBitset())
+	{
+		result = first.isBitset() ? first : second;
+		const Container& other = first.isBitset() ? second : first;
+
+		if (other.isBitset())
+		{
+			for (uint32_t i = 0; i < BITSET_WORDS; i++)
+				result.bitset[i] |= other.bitset[i];
+		}
+		else
+		{
+			for (const uint16_t value : other.array)
+				result.bitset[value >> 6] |= 1ULL << (value & 63);
+		}
+
+		result.cardinality = 0;
+		for (const uint64_t word : result.bitset)
+			result.cardinality += popcount(word);
+	}
+	else
+	{
+		std::set_union(first.array.begin(), first.array.end(), second.array.begin(), second.array.end(), std::back_inserter(result.array));
+		result.cardinality = static_cast<uint32_t>(result.array.size());
+	}
+
+	result.normalize();
+	return result;
+}
+
+RoaringBitmap::Container RoaringBitmap::subtract(const Container& first, const Container& second)
+{
+	Container result;
+
+	if (first.isBitset())
+	{
+		result = first;
+
+		if (second.isBitset())
+		{
+			for (uint32_t i = 0; i < BITSET_WORDS; i++)
+				result.bitset[i] &= ~second.bitset[i];
+		}
+		else
+		{
+			for (const uint16_t value : second.array)
+				result.bitset[value >> 6] &= ~(1ULL << (value & 63));
+		}
+
+		result.cardinality = 0;
+		for (const uint64_t word : result.bitset)
+			result.cardinality += popcount(word);
+	}
+	else
+	{
+		for (const uint16_t value : first.array)
+		{
+			if (!second.contains(value))
+				result.array.push_back(value);
+		}
+
+		result.cardinality = static_cast<uint32_t>(result.array.size());
+	}
+
+	result.normalize();
+	return result;
+}
+
+
+// single value functions //
+void RoaringBitmap::add(uint32_t value)
+{
+	const uint16_t key = highBits(value);
+	const uint16_t low = lowBits(value);
+
+	auto position = std::lower_bound(m_containers.begin(), m_containers.end(), key, [](const auto& entry, uint16_t k) { return entry.first < k; });
+	if (position == m_containers.end() || position->first != key)
+		position = m_containers.insert(position, { key, Container() });
+
+	Container& container = position->second;
+
+	if (container.isBitset())
+	{
+		uint64_t& word = container.bitset[low >> 6];
+		const uint64_t bit = 1ULL << (low & 63);
+
+		if ((word & bit) == 0)
+		{
+			word |= bit;
+			container.cardinality++;
+		}
+		return;
+	}
+
+	const auto slot = std::lower_bound(container.array.begin(), container.array.end(), low);
+	if (slot != container.array.end() && *slot == low)
+		return;
+
+	container.array.insert(slot, low);
+	container.cardinality++;
+	container.normalize();
+}
+
+void RoaringBitmap::remove(uint32_t value)
+{
+	const uint16_t key = highBits(value);
+	const uint16_t low = lowBits(value);
+
+	const auto position = std::lower_bound(m_containers.begin(), m_containers.end(), key, [](const auto& entry, uint16_t k) { return entry.first < k; });
+	if (position == m_containers.end() || position->first != key)
+		return;
+
+	Container& container = position->second;
+
+	if (container.isBitset())
+	{
+		uint64_t& word = container.bitset[low >> 6];
+		const uint64_t bit = 1ULL << (low & 63);
+
+		if ((word & bit) == 0)
+			return;
+
+		word &= ~bit;
+	}
+	else
+	{
+		const auto slot = std::lower_bound(container.array.begin(), container.array.end(), low);
+		if (slot == container.array.end() || *slot != low)
+			return;
+
+		container.array.erase(slot);
+	}
+
+	container.cardinality--;
+
+	if (container.cardinality == 0)
+		m_containers.erase(position);
+	else
+		container.normalize();
+}
+
+bool RoaringBitmap::contains(uint32_t value) const
+{
+	const Container* container = findContainer(highBits(value));
+	return container != nullptr && container->contains(lowBits(value));
+}
+
+
+// whole set functions //
+uint64_t RoaringBitmap::cardinality() const
+{
+	uint64_t total = 0;
+
+	for (const auto& [key, container] : m_containers)
+		total += container.cardinality;
+
+	return total;
+}
+
+bool RoaringBitmap::empty() const
+{
+	return m_containers.empty();
+}
+
+void RoaringBitmap::clear()
+{
+	m_containers.clear();
+}
+
+std::vector<uint32_t> RoaringBitmap::toVector() const
+{
+	std::vector<uint32_t> values;
+	values.reserve(cardinality());
+
+	for (const auto& [key, container] : m_containers)
+	{
+		const uint32_t high = static_cast<uint32_t>(key) << 16;
+
+		if (!container.isBitset())
+		{
+			for (const uint16_t low : container.array)
+				values.push_back(high | low);
+			continue;
+		}
+
+		Container sparse = container;
+		toArray(sparse);
+		for (const uint16_t low : sparse.array)
+			values.push_back(high | low);
+	}
+
+	return values;
+}
+
+RoaringBitmap RoaringBitmap::operator&(const RoaringBitmap& other) const
+{
+	RoaringBitmap result;
+	auto first = m_containers.begin();
+	auto second = other.m_containers.begin();
+
+	while (first != m_containers.end() && second != other.m_containers.end())
+	{
+		if (first->first < second->first)
+			++first;
+		else if (second->first < first->first)
+			++second;
+		else
+		{
+			Container container = intersect(first->second, second->second);
+			if (container.cardinality != 0)
+				result.m_containers.emplace_back(first->first, std::move(container));
+
+			++first;
+			++second;
+		}
+	}
+
+	return result;
+}
+
+RoaringBitmap RoaringBitmap::operator|(const RoaringBitmap& other) const
+{
+	RoaringBitmap result;
+	auto first = m_containers.begin();
+	auto second = other.m_containers.begin();
+
+	while (first != m_containers.end() || second != other.m_containers.end())
+	{
+		if (second == other.m_containers.end() || (first != m_containers.end() && first->first < second->first))
+			result.m_containers.push_back(*first++);
+		else if (first == m_containers.end() || second->first < first->first)
+			result.m_containers.push_back(*second++);
+		else
+		{
+			result.m_containers.emplace_back(first->first, unite(first->second, second->second));
+			++first;
+			++second;
+		}
+	}
+
+	return result;
+}
+
+RoaringBitmap RoaringBitmap::operator-(const RoaringBitmap& other) const
+{
+	RoaringBitmap result;
+
+	for (const auto& [key, container] : m_containers)
+	{
+		const Container* subtrahend = other.findContainer(key);
+
+		if (subtrahend == nullptr)
+		{
+			result.m_containers.emplace_back(key, container);
+			continue;
+		}
+
+		Container difference = subtract(container, *subtrahend);
+		if (difference.cardinality != 0)
+			result.m_containers.emplace_back(key, std::move(difference));
+	}
+
+	return result;
+}
+
+bool RoaringBitmap::operator==(const RoaringBitmap& other) const
+{
+	if (m_containers.size() != other.m_containers.size())
+		return false;
+
+	// containers are always normalized, so equal sets have equal representations
+	for (size_t i = 0; i < m_containers.size(); i++)
+	{
+		const auto& [key, container] = m_containers[i];
+		const auto& [otherKey, otherContainer] = other.m_containers[i];
+
+		if (key != otherKey || container.cardinality != otherContainer.cardinality ||
+			container.array != otherContainer.array || container.bitset != otherContainer.bitset)
+			return false;
+	}
+
+	return true;
+}
+
+
+// helper functions //
+const RoaringBitmap::Container* RoaringBitmap::findContainer(uint16_t key) const
+{
+	const auto position = std::lower_bound(m_containers.begin(), m_containers.end(), key, [](const auto& entry, uint16_t k) { return entry.first < k; });
+
+	if (position == m_containers.end() || position->first != key)
+		return nullptr;
+
+	return &position->second;
+}
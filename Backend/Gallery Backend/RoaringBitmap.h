@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+
+/*
+ * Compressed set of 32 bit unsigned integers, in the spirit of Roaring bitmaps.
+ * Values are split by their high 16 bits into containers, each container holds the low 16 bits:
+ *   - as a sorted array while it holds up to ARRAY_MAX_SIZE values (sparse ids cost 2 bytes each)
+ *   - as a 65536 bit bitset above that (dense ids cost 1 bit each)
+ * Set operations between two bitset containers are plain loops over 64 bit words, which the compiler
+ * vectorizes, and operations against array containers only touch the values in the array.
+ */
+class RoaringBitmap
+{
+public:
+	void add(uint32_t value);
+	void remove(uint32_t value);
+	bool contains(uint32_t value) const;
+
+	uint64_t cardinality() const;
+	bool empty() const;
+	void clear();
+
+	std::vector<uint32_t> toVector() const;
+
+	RoaringBitmap operator&(const RoaringBitmap& other) const;	// intersection
+	RoaringBitmap operator|(const RoaringBitmap& other) const;	// union
+	RoaringBitmap operator-(const RoaringBitmap& other) const;	// difference (and not)
+
+	bool operator==(const RoaringBitmap& other) const;
+
+private:
+	static constexpr uint32_t ARRAY_MAX_SIZE = 4096;
+	static constexpr uint32_t BITSET_WORDS = 1024;		// 65536 bits
+
+	struct Container
+	{
+		std::vector<uint16_t> array;		// sorted values while the container is sparse
+		std::vector<uint64_t> bitset;		// BITSET_WORDS words once it is dense, empty otherwise
+		uint32_t cardinality{ 0 };
+
+		bool isBitset() const { return !bitset.empty(); }
+		bool contains(uint16_t value) const;
+		void normalize();
+	};
+
+	std::vector<std::pair<uint16_t, Container>> m_containers;	// sorted by the high 16 bits
+
+	const Container* findContainer(uint16_t key) const;
+
+	static Container intersect(const Container& first, const Container& second);
+	static Container unite(const Container& first, const Container& second);
+	static Container subtract(const Container& first, const Container& second);
+	static void toBitset(Container& container);
+	static void toArray(Container& container);
+};
@@ -0,0 +1,231 @@
+#include "Router.h"
+
+#include "MyException.h"
+
+
+const char* routeClassName(RouteClass routeClass)
+{
+	switch (routeClass)
+	{
+	case RouteClass::READ:
+		return "read";
+	case RouteClass::LISTING:
+		return "listing";
+	case RouteClass::WRITE:
+		return "write";
+	default:
+		return "admin";
+	}
+}
+
+
+// route params related functions //
+const utility::string_t& RouteParams::get(const utility::string_t& name) const
+{
+	for (const auto& [parameter, value] : m_values)
+	{
+		if (parameter == name)
+			return value;
+	}
+
+	throw MyException("Route has no parameter named '" + utility::conversions::to_utf8string(name) + "'");
+}
+
+// only for parameters declared as {name:int}, the router already checked that they fit an int
+int RouteParams::getInteger(const utility::string_t& name) const
+{
+	return std::stoi(get(name));
+}
+
+
+// router related functions //
+Router::Router() :
+	m_root(std::make_unique<Node>())
+{
+	// Left empty
+}
+
+Router::~Router() = default;
+
+void Router::add(const web::http::method& method, const utility::string_t& pattern, RouteInfo info, Handler handler)
+{
+	const Route* route = m_routes.emplace_back(std::make_unique<Route>(Route{ method, pattern, std::move(info), std::move(handler) })).get();
+
+	Node* node = m_root.get();
+
+	for (const auto& segment : splitPath(pattern))
+	{
+		if (segment.size() < 2 || segment.front() != U('{') || segment.back() != U('}'))
+		{
+			auto& child = node->children[segment];
+			if (!child)
+				child = std::make_unique<Node>();
+
+			node = child.get();
+			continue;
+		}
+
+		utility::string_t name = segment.substr(1, segment.size() - 2);
+		bool isInteger = false;
+
+		const auto separator = name.find(U(':'));
+		if (separator != utility::string_t::npos)
+		{
+			if (name.substr(separator + 1) != U("int"))
+				throw MyException("Route " + route->info.name + " has a parameter of an unknown type");
+
+			isInteger = true;
+			name.erase(separator);
+		}
+
+		// every route through a node must agree on its parameter, otherwise the matched values would depend on the method
+		if (!node->parameter)
+		{
+			node->parameter = std::make_unique<Node>();
+			node->parameterName = name;
+			node->isInteger = isInteger;
+		}
+		else if (node->parameterName != name || node->isInteger != isInteger)
+			throw MyException("Route " + route->info.name + " conflicts with the parameters of another route");
+
+		node = node->parameter.get();
+	}
+
+	if (routeFor(node->routes, method) != nullptr)
+		throw MyException("Route " + route->info.name + " is registered twice");
+
+	node->routes.push_back(route);
+
+	// the exact path of a route without parameters is kept aside as well, so it is found with one lookup
+	if (pattern.find(U('{')) == utility::string_t::npos)
+		m_staticRoutes[pattern].push_back(route);
+}
+
+const Router::Route* Router::match(const web::http::method& method, const utility::string_t& path, RouteParams& params) const
+{
+	const MethodRoutes* routes = find(path, params);
+	return routes != nullptr ? routeFor(*routes, method) : nullptr;
+}
+
+void Router::dispatch(const web::http::http_request& request) const
+{
+	RouteParams params;
+	const MethodRoutes* routes = find(request.relative_uri().path(), params);
+
+	if (routes == nullptr)
+	{
+		request.reply(web::http::status_codes::NotFound);
+		return;
+	}
+
+	const Route* route = routeFor(*routes, request.method());
+
+	if (route == nullptr)
+	{
+		web::http::http_response response(web::http::status_codes::MethodNotAllowed);
+		response.headers().add(web::http::header_names::allow, allowedMethods(*routes));
+		request.reply(response);
+		return;
+	}
+
+	route->handler(request, params);
+}
+
+
+// helper functions //
+const Router::MethodRoutes* Router::find(const utility::string_t& path, RouteParams& params) const
+{
+	// most routes have no parameters and are requested by their exact path, those never reach the trie
+	const auto staticRoutes = m_staticRoutes.find(path);
+	if (staticRoutes != m_staticRoutes.end())
+		return &staticRoutes->second;
+
+	params.m_values.clear();
+	return matchNode(*m_root, splitPath(path), 0, params);
+}
+
+const Router::MethodRoutes* Router::matchNode(const Node& node, const std::vector<utility::string_t>& segments, size_t index, RouteParams& params)
+{
+	if (index == segments.size())
+		return node.routes.empty() ? nullptr : &node.routes;
+
+	const auto child = node.children.find(segments[index]);
+	if (child != node.children.end())
+	{
+		if (const MethodRoutes* routes = matchNode(*child->second, segments, index + 1, params))
+			return routes;
+	}
+
+	if (!node.parameter || (node.isInteger && !isInteger(segments[index])))
+		return nullptr;
+
+	params.m_values.emplace_back(node.parameterName, web::uri::decode(segments[index]));
+
+	if (const MethodRoutes* routes = matchNode(*node.parameter, segments, index + 1, params))
+		return routes;
+
+	params.m_values.pop_back();
+	return nullptr;
+}
+
+utility::string_t Router::allowedMethods(const MethodRoutes& routes)
+{
+	utility::string_t allowed;
+
+	for (const Route* route : routes)
+	{
+		if (!allowed.empty())
+			allowed += U(", ");
+
+		allowed += route->method;
+	}
+
+	return allowed;
+}
+
+const Router::Route* Router::routeFor(const MethodRoutes& routes, const web::http::method& method)
+{
+	for (const Route* route : routes)
+	{
+		if (route->method == method)
+			return route;
+	}
+
+	return nullptr;
+}
+
+// splits a path to its segments, ignoring empty ones so /users/1/ matches /users/{id:int} too
+std::vector<utility::string_t> Router::splitPath(const utility::string_t& path)
+{
+	std::vector<utility::string_t> segments;
+	size_t start = 0;
+
+	while (start <= path.size())
+	{
+		size_t end = path.find(U('/'), start);
+		if (end == utility::string_t::npos)
+			end = path.size();
+
+		if (end > start)
+			segments.push_back(path.substr(start, end - start));
+
+		start = end + 1;
+	}
+
+	return segments;
+}
+
+// a non negative number that fits an int, which is what the ids of the gallery are
+bool Router::isInteger(const utility::string_t& segment)
+{
+	if (segment.empty() || segment.size() > 9)
+		return false;
+
+	for (const auto character : segment)
+	{
+		if (character < U('0') || character > U('9'))
+			return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cpprest/http_msg.h>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+// how a route touches the gallery, used to treat reads and writes differently. Listings read
+// more than a handful of rows and are kept apart from the cheap reads, so they can not starve them
+enum class RouteClass { READ, LISTING, WRITE, ADMIN };
+
+constexpr size_t ROUTE_CLASSES_COUNT = 4;
+
+const char* routeClassName(RouteClass routeClass);
+
+// per route metadata, the name doubles as the label of the route in logs and metrics
+struct RouteInfo
+{
+	std::string name;
+	RouteClass routeClass;
+};
+
+
+/*
+ * Values of the parameters in the path of a request, e.g. id in /users/{id:int}.
+ * The values are percent decoded, and a parameter declared as int is only matched by a
+ * non negative number that fits an int.
+ */
+class RouteParams
+{
+public:
+	const utility::string_t& get(const utility::string_t& name) const;
+	int getInteger(const utility::string_t& name) const;
+
+private:
+	friend class Router;
+
+	std::vector<std::pair<utility::string_t, utility::string_t>> m_values;	// routes have a parameter or two
+};
+
+
+/*
+ * Maps a method and a path to the handler of the route.
+ * Paths without parameters are found with a single hash lookup. Paths with parameters are
+ * matched segment by segment against a trie, where a literal segment wins over a parameter.
+ * A path that exists with other methods only is answered with 405 and an Allow header, any
+ * other unknown path with 404.
+ */
+class Router
+{
+public:
+	// the task of a handler completes once the request is fully handled, reply included
+	using Handler = std::function<pplx::task<void>(const web::http::http_request&, const RouteParams&)>;
+
+	struct Route
+	{
+		web::http::method method;
+		utility::string_t pattern;
+		RouteInfo info;
+		Handler handler;
+	};
+
+	Router();
+	~Router();
+
+	Router(const Router&) = delete;
+	Router& operator=(const Router&) = delete;
+
+	// registers a route, the pattern is a path whose segments may be {name} or {name:int}
+	void add(const web::http::method& method, const utility::string_t& pattern, RouteInfo info, Handler handler);
+
+	// returns the route of the request or nullptr, filling params with the values in the path
+	const Route* match(const web::http::method& method, const utility::string_t& path, RouteParams& params) const;
+
+	// calls the handler of the route of the request, or replies 404 / 405 if there is none
+	void dispatch(const web::http::http_request& request) const;
+
+	const std::vector<std::unique_ptr<Route>>& routes() const { return m_routes; }
+
+private:
+	using MethodRoutes = std::vector<const Route*>;		// a path has a route for a method or two
+
+	struct Node
+	{
+		std::unordered_map<utility::string_t, std::unique_ptr<Node>> children;
+		std::unique_ptr<Node> parameter;
+		utility::string_t parameterName;
+		bool isInteger{ false };
+		MethodRoutes routes;
+	};
+
+	std::vector<std::unique_ptr<Route>> m_routes;
+	std::unordered_map<utility::string_t, MethodRoutes> m_staticRoutes;
+	std::unique_ptr<Node> m_root;
+
+	const MethodRoutes* find(const utility::string_t& path, RouteParams& params) const;
+	static const MethodRoutes* matchNode(const Node& node, const std::vector<utility::string_t>& segments, size_t index, RouteParams& params);
+	static utility::string_t allowedMethods(const MethodRoutes& routes);
+	static const Route* routeFor(const MethodRoutes& routes, const web::http::method& method);
+	static std::vector<utility::string_t> splitPath(const utility::string_t& path);
+	static bool isInteger(const utility::string_t& segment);
+};
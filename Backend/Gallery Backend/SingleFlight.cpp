@@ -0,0 +1,85 @@
+#include "SingleFlight.h"
+
+
+SingleFlight::SingleFlight(std::chrono::milliseconds timeout) :
+	m_timeout(timeout)
+{
+	// Left empty
+}
+
+
+// flight related functions //
+void SingleFlight::run(const std::string& key, const Lead& lead, const Follow& follow)
+{
+	std::promise<Document> result;
+	std::shared_future<Document> flight;
+
+	{
+		const std::lock_guard lock(m_mutex);
+
+		const auto existing = m_flights.find(key);
+		if (existing != m_flights.end())
+			flight = existing->second;
+		else
+		{
+			m_flights.emplace(key, result.get_future().share());
+			m_led++;
+		}
+	}
+
+	if (!flight.valid())
+	{
+		// the followers are released whatever happens to the leader, a failure gives them no document
+		try
+		{
+			const Document document = lead();
+			land(key);
+			result.set_value(document);
+		}
+		catch (...)
+		{
+			land(key);
+			result.set_value(nullptr);
+			throw;
+		}
+
+		return;
+	}
+
+	if (flight.wait_for(m_timeout) == std::future_status::ready)
+	{
+		if (const Document document = flight.get())
+		{
+			{
+				const std::lock_guard lock(m_mutex);
+				m_followed++;
+			}
+
+			follow(document);
+			return;
+		}
+	}
+	else
+	{
+		const std::lock_guard lock(m_mutex);
+		m_timedOut++;
+	}
+
+	lead();
+}
+
+SingleFlight::Stats SingleFlight::getStats() const
+{
+	const std::lock_guard lock(m_mutex);
+
+	return { m_led, m_followed, m_timedOut };
+}
+
+
+// helper functions //
+// the flight is removed before its result is set, so a request arriving after the result leads a new one
+void SingleFlight::land(const std::string& key)
+{
+	const std::lock_guard lock(m_mutex);
+	m_flights.erase(key);
+}
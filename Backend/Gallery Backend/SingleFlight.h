@@ -0,0 +1,54 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "Constants.h"
+
+
+/*
+ * Coalesces identical reads running at the same time. The first request of a key leads - it builds its
+ * document and replies with it - while the requests of the same key arriving meanwhile wait for the
+ * leader and reply with the same document, instead of running the same queries again.
+ * A follower waits for a limited time only. If the leader is stuck, fails, or builds a document too big
+ * to be shared, the follower builds the document on its own.
+ */
+class SingleFlight
+{
+public:
+	using Document = std::shared_ptr<const std::string>;
+	using Lead = std::function<Document()>;				// replies, and returns the document or nullptr
+	using Follow = std::function<void(const Document&)>;	// replies with the document of the leader
+
+	struct Stats
+	{
+		uint64_t led;
+		uint64_t followed;
+		uint64_t timedOut;		// followers that gave up waiting and led on their own
+	};
+
+	explicit SingleFlight(std::chrono::milliseconds timeout = std::chrono::milliseconds(SINGLE_FLIGHT_TIMEOUT_MILLISECONDS));
+
+	SingleFlight(const SingleFlight&) = delete;
+	SingleFlight& operator=(const SingleFlight&) = delete;
+
+	// calls lead if no request of key is in flight, and otherwise follow once the one in flight is done
+	void run(const std::string& key, const Lead& lead, const Follow& follow);
+
+	Stats getStats() const;
+
+private:
+	std::chrono::milliseconds m_timeout;
+	mutable std::mutex m_mutex;
+	std::unordered_map<std::string, std::shared_future<Document>> m_flights;
+	uint64_t m_led{ 0 };
+	uint64_t m_followed{ 0 };
+	uint64_t m_timedOut{ 0 };
+
+	void land(const std::string& key);
+};
@@ -0,0 +1,169 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+
+/*
+ * Contiguous vector that keeps up to N elements inline, inside the object itself,
+ * and only allocates from the heap once it grows past that.
+ * Elements are moved around with memcpy, so it is limited to trivially copyable types.
+ */
+template <typename T, size_t N>
+class SmallVector
+{
+	static_assert(std::is_trivially_copyable_v<T>, "SmallVector only holds trivially copyable types");
+	static_assert(N > 0, "SmallVector needs an inline capacity");
+
+public:
+	using value_type = T;
+	using size_type = size_t;
+	using iterator = T*;
+	using const_iterator = const T*;
+
+	SmallVector() = default;
+
+	SmallVector(const SmallVector& other)
+	{
+		copyFrom(other);
+	}
+
+	SmallVector(SmallVector&& other) noexcept
+	{
+		moveFrom(other);
+	}
+
+	~SmallVector()
+	{
+		release();
+	}
+
+	SmallVector& operator=(const SmallVector& other)
+	{
+		if (this != &other)
+		{
+			m_size = 0;
+			copyFrom(other);
+		}
+
+		return *this;
+	}
+
+	SmallVector& operator=(SmallVector&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			moveFrom(other);
+		}
+
+		return *this;
+	}
+
+	iterator begin() { return m_data; }
+	iterator end() { return m_data + m_size; }
+	const_iterator begin() const { return m_data; }
+	const_iterator end() const { return m_data + m_size; }
+	const_iterator cbegin() const { return m_data; }
+	const_iterator cend() const { return m_data + m_size; }
+
+	T& operator[](size_t index) { return m_data[index]; }
+	const T& operator[](size_t index) const { return m_data[index]; }
+
+	T* data() { return m_data; }
+	const T* data() const { return m_data; }
+
+	size_t size() const { return m_size; }
+	size_t capacity() const { return m_capacity; }
+	bool empty() const { return m_size == 0; }
+	bool isInline() const { return m_data == m_inline; }
+
+	void clear() { m_size = 0; }
+
+	void reserve(size_t capacity)
+	{
+		if (capacity <= m_capacity)
+			return;
+
+		T* data = new T[capacity];
+		std::memcpy(data, m_data, m_size * sizeof(T));
+
+		release();
+		m_data = data;
+		m_capacity = capacity;
+	}
+
+	void push_back(const T& value)
+	{
+		insert(cend(), value);
+	}
+
+	iterator insert(const_iterator position, const T& value)
+	{
+		// the position and the value may point into the buffer, so both are saved before growing
+		const size_t index = position - m_data;
+		const T copy = value;
+
+		if (m_size == m_capacity)
+			reserve(m_capacity * 2);
+
+		std::memmove(m_data + index + 1, m_data + index, (m_size - index) * sizeof(T));
+		m_data[index] = copy;
+		m_size++;
+
+		return m_data + index;
+	}
+
+	iterator erase(const_iterator position)
+	{
+		const size_t index = position - m_data;
+
+		std::memmove(m_data + index, m_data + index + 1, (m_size - index - 1) * sizeof(T));
+		m_size--;
+
+		return m_data + index;
+	}
+
+private:
+	T* m_data = m_inline;
+	size_t m_size{ 0 };
+	size_t m_capacity{ N };
+	T m_inline[N];
+
+	void release()
+	{
+		if (!isInline())
+			delete[] m_data;
+
+		m_data = m_inline;
+		m_capacity = N;
+	}
+
+	void copyFrom(const SmallVector& other)
+	{
+		reserve(other.m_size);
+		std::memcpy(m_data, other.m_data, other.m_size * sizeof(T));
+		m_size = other.m_size;
+	}
+
+	void moveFrom(SmallVector& other)
+	{
+		if (other.isInline())
+		{
+			std::memcpy(m_inline, other.m_inline, other.m_size * sizeof(T));
+			m_data = m_inline;
+			m_capacity = N;
+		}
+		else
+		{
+			// steal the heap buffer
+			m_data = other.m_data;
+			m_capacity = other.m_capacity;
+			other.m_data = other.m_inline;
+			other.m_capacity = N;
+		}
+
+		m_size = other.m_size;
+		other.m_size = 0;
+	}
+};
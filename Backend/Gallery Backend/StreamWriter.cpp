@@ -0,0 +1,115 @@
+#include "StreamWriter.h"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+#include "CborStreamWriter.h"
+#include "JsonStreamWriter.h"
+
+
+StreamWriter::StreamWriter(Sink sink, size_t chunkSize) :
+	m_sink(std::move(sink)), m_chunkSize(chunkSize)
+{
+	m_buffer.reserve(m_chunkSize);
+}
+
+
+// format related functions //
+std::unique_ptr<StreamWriter> StreamWriter::create(Format format, Sink sink, size_t chunkSize)
+{
+	if (format == Format::CBOR)
+		return std::make_unique<CborStreamWriter>(std::move(sink), chunkSize);
+
+	return std::make_unique<JsonStreamWriter>(std::move(sink), chunkSize);
+}
+
+const char* StreamWriter::contentType(Format format)
+{
+	return format == Format::CBOR ? "application/cbor" : "application/json";
+}
+
+StreamWriter::Format StreamWriter::negotiate(const std::string& accept)
+{
+	// -1 while a media type is not listed
+	double jsonQuality = -1;
+	double cborQuality = -1;
+	double anyQuality = -1;
+
+	std::stringstream mediaRanges(accept);
+	std::string mediaRange;
+
+	while (std::getline(mediaRanges, mediaRange, ','))
+	{
+		std::string name = mediaRange.substr(0, mediaRange.find(';'));
+		name.erase(std::remove_if(name.begin(), name.end(), [](unsigned char c) { return std::isspace(c); }), name.end());
+		std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+		double quality = 1;
+		const size_t parameter = mediaRange.find("q=");
+		if (parameter != std::string::npos)
+		{
+			try {
+				quality = std::stod(mediaRange.substr(parameter + 2));
+			}
+			catch (const std::exception&) {
+				quality = 0;
+			}
+		}
+
+		if (name == "application/json")
+			jsonQuality = quality;
+		else if (name == "application/cbor")
+			cborQuality = quality;
+		else if (name == "application/*" || name == "*/*")
+			anyQuality = std::max(anyQuality, quality);
+	}
+
+	// a wildcard accepts JSON, but never picks CBOR for a client that did not name it
+	if (jsonQuality < 0)
+		jsonQuality = anyQuality;
+
+	return cborQuality > 0 && cborQuality > jsonQuality ? Format::CBOR : Format::JSON;
+}
+
+
+// value functions //
+StreamWriter& StreamWriter::value(const char* text)
+{
+	return value(std::string_view(text));
+}
+
+void StreamWriter::flush()
+{
+	if (m_buffer.empty())
+		return;
+
+	m_sink(m_buffer.data(), m_buffer.size());
+	m_buffer.clear();
+}
+
+
+// helper functions //
+void StreamWriter::append(std::string_view bytes)
+{
+	// big values go to the sink directly instead of through the buffer
+	if (m_buffer.size() + bytes.size() > m_chunkSize)
+	{
+		flush();
+
+		if (bytes.size() >= m_chunkSize)
+		{
+			m_sink(bytes.data(), bytes.size());
+			return;
+		}
+	}
+
+	m_buffer.append(bytes);
+}
+
+void StreamWriter::append(char byte)
+{
+	if (m_buffer.size() + 1 > m_chunkSize)
+		flush();
+
+	m_buffer.push_back(byte);
+}
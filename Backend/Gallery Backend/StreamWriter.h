@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "Constants.h"
+
+
+/*
+ * Writes a document straight to a sink, value by value, without building it in memory first.
+ * The encoded document is gathered in a buffer of chunkSize bytes, which is handed to the sink whenever
+ * it fills, so a listing of any length only ever takes one chunk of memory in the writer.
+ * JsonStreamWriter and CborStreamWriter encode the same calls as JSON text and as CBOR (RFC 8949),
+ * create() makes the writer of a format negotiated with the client.
+ */
+class StreamWriter
+{
+public:
+	using Sink = std::function<void(const char* data, size_t size)>;
+
+	enum class Format { JSON, CBOR };
+
+	static std::unique_ptr<StreamWriter> create(Format format, Sink sink, size_t chunkSize = RESPONSE_CHUNK_SIZE);
+	static const char* contentType(Format format);
+
+	// the format of an Accept header by its quality values - JSON unless CBOR is asked for by name and preferred
+	static Format negotiate(const std::string& accept);
+
+	StreamWriter(Sink sink, size_t chunkSize);
+	virtual ~StreamWriter() = default;
+
+	StreamWriter(const StreamWriter&) = delete;
+	StreamWriter& operator=(const StreamWriter&) = delete;
+
+	virtual StreamWriter& beginObject() = 0;
+	virtual StreamWriter& endObject() = 0;
+	virtual StreamWriter& beginArray() = 0;
+	virtual StreamWriter& endArray() = 0;
+
+	virtual StreamWriter& key(std::string_view name) = 0;
+
+	virtual StreamWriter& value(std::string_view text) = 0;
+	StreamWriter& value(const char* text);
+	virtual StreamWriter& value(int number) = 0;
+	virtual StreamWriter& value(size_t number) = 0;
+	virtual StreamWriter& value(double number) = 0;
+	virtual StreamWriter& value(bool boolean) = 0;
+	virtual StreamWriter& null() = 0;
+	virtual StreamWriter& raw(std::string_view encoded) = 0;		// a value encoded in the format of the writer already
+
+	// hands whatever is buffered to the sink, must be called once the document is complete
+	void flush();
+
+protected:
+	void append(std::string_view bytes);
+	void append(char byte);
+
+private:
+	Sink m_sink;
+	size_t m_chunkSize;
+	std::string m_buffer;
+};
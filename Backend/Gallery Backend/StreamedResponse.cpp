@@ -0,0 +1,176 @@
+#include "StreamedResponse.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "Constants.h"
+#include "Metrics.h"
+#include "MyException.h"
+
+
+/*
+ * The stream the client is sent, a producer consumer buffer behind it does the buffering. Every read
+ * is passed on to that buffer and wakes the writer once it freed room, and so does the client closing
+ * its side. Nothing is seekable, as with the producer consumer buffer.
+ */
+class StreamedResponse::Buffer : public concurrency::streams::details::streambuf_state_manager<uint8_t>
+{
+public:
+	explicit Buffer(size_t chunkSize) :
+		streambuf_state_manager(std::ios_base::in | std::ios_base::out), m_buffer(chunkSize)
+	{
+		// Left empty
+	}
+
+	// false if the client stopped reading, or did not read enough before the deadline
+	bool waitForRoom(size_t maxBuffered, std::chrono::steady_clock::time_point deadline)
+	{
+		std::unique_lock lock(m_mutex);
+
+		return m_drained.wait_until(lock, deadline, [this, maxBuffered]
+		{
+			return !can_read() || m_buffer.in_avail() <= maxBuffered;
+		}) && can_read();
+	}
+
+	bool can_seek() const override { return false; }
+	bool has_size() const override { return false; }
+	size_t buffer_size(std::ios_base::openmode direction) const override { return m_buffer.buffer_size(direction); }
+	void set_buffer_size(size_t size, std::ios_base::openmode direction) override { m_buffer.set_buffer_size(size, direction); }
+	size_t in_avail() const override { return m_buffer.in_avail(); }
+	pos_type getpos(std::ios_base::openmode direction) const override { return m_buffer.getpos(direction); }
+	utility::size64_t size() const override { return 0; }
+	pos_type seekpos(pos_type, std::ios_base::openmode) override { return pos_type(traits::eof()); }
+	pos_type seekoff(off_type, std::ios_base::seekdir, std::ios_base::openmode) override { return pos_type(traits::eof()); }
+
+	bool acquire(uint8_t*& ptr, size_t& count) override { return m_buffer.acquire(ptr, count); }
+
+	void release(uint8_t* ptr, size_t count) override
+	{
+		m_buffer.release(ptr, count);
+		notifyDrained();
+	}
+
+protected:
+	// the write side, used by the writer only
+	pplx::task<int_type> _putc(uint8_t ch) override { return m_buffer.putc(ch); }
+	pplx::task<size_t> _putn(const uint8_t* ptr, size_t count) override { return m_buffer.putn_nocopy(ptr, count); }
+	uint8_t* _alloc(size_t count) override { return m_buffer.alloc(count); }
+	void _commit(size_t count) override { m_buffer.commit(count); }
+	pplx::task<bool> _sync() override { return m_buffer.sync(); }
+
+	// the read side, used by cpprest to send the response. A read that has to wait for data completes later,
+	// the buffer must outlive it
+	pplx::task<size_t> _getn(uint8_t* ptr, size_t count) override
+	{
+		const auto self = std::static_pointer_cast<Buffer>(shared_from_this());
+
+		return m_buffer.getn(ptr, count).then([self](size_t readCount)
+		{
+			self->notifyDrained();
+			return readCount;
+		});
+	}
+
+	size_t _scopy(uint8_t* ptr, size_t count) override { return m_buffer.scopy(ptr, count); }
+
+	int_type _sbumpc() override
+	{
+		const int_type character = m_buffer.sbumpc();
+		notifyDrained();
+
+		return character;
+	}
+
+	pplx::task<int_type> _bumpc() override
+	{
+		const auto self = std::static_pointer_cast<Buffer>(shared_from_this());
+
+		return m_buffer.bumpc().then([self](int_type character)
+		{
+			self->notifyDrained();
+			return character;
+		});
+	}
+
+	pplx::task<int_type> _getc() override { return m_buffer.getc(); }
+	int_type _sgetc() override { return m_buffer.sgetc(); }
+	pplx::task<int_type> _nextc() override { return m_buffer.nextc(); }
+	pplx::task<int_type> _ungetc() override { return m_buffer.ungetc(); }
+
+	pplx::task<void> close_read() override
+	{
+		streambuf_state_manager::close_read().wait();
+		m_buffer.close(std::ios_base::in).wait();
+		notifyDrained();
+
+		return pplx::task_from_result();
+	}
+
+	// the client reads the error of an aborted response from the inner buffer, where its reads go
+	pplx::task<void> close_write() override
+	{
+		streambuf_state_manager::close_write().wait();
+		return m_buffer.close(std::ios_base::out, exception());
+	}
+
+private:
+	concurrency::streams::producer_consumer_buffer<uint8_t> m_buffer;
+	std::mutex m_mutex;
+	std::condition_variable m_drained;
+
+	// under the mutex, so a writer that just found the buffer full can not miss the wake up
+	void notifyDrained()
+	{
+		const std::lock_guard lock(m_mutex);
+		m_drained.notify_all();
+	}
+};
+
+
+StreamedResponse::StreamedResponse() :
+	m_buffer(std::make_shared<Buffer>(RESPONSE_CHUNK_SIZE))
+{
+	// Left empty
+}
+
+concurrency::streams::istream StreamedResponse::body() const
+{
+	return concurrency::streams::streambuf<uint8_t>(m_buffer).create_istream();
+}
+
+void StreamedResponse::write(const char* data, size_t size)
+{
+	using namespace std::chrono;
+
+	// wait for the client to catch up, giving up on a client that stopped reading
+	const auto deadline = steady_clock::now() + seconds(RESPONSE_WRITE_TIMEOUT_SECONDS);
+
+	if (!m_buffer->waitForRoom(RESPONSE_MAX_BUFFERED, deadline))
+		throw MyException("The client stopped reading the response.");
+
+	m_buffer->putn_nocopy(reinterpret_cast<const uint8_t*>(data), size).wait();
+
+	// the bytes of the request the thread runs. tryWrite is called by the threads of other requests, and is not counted
+	RequestWork::current().bytesOut += size;
+}
+
+bool StreamedResponse::tryWrite(const char* data, size_t size, size_t maxBuffered)
+{
+	if (m_buffer->in_avail() + size > maxBuffered)
+		return false;
+
+	m_buffer->putn_nocopy(reinterpret_cast<const uint8_t*>(data), size).wait();
+	return true;
+}
+
+void StreamedResponse::close()
+{
+	m_buffer->close(std::ios_base::out).wait();
+}
+
+void StreamedResponse::abort(std::exception_ptr error)
+{
+	m_buffer->close(std::ios_base::out, error).wait();
+}
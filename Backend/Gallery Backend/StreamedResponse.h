@@ -0,0 +1,35 @@
+#pragma once
+#include <cpprest/producerconsumerstream.h>
+#include <cstddef>
+#include <exception>
+#include <memory>
+
+
+/*
+ * Body of a response that is written while it is being sent.
+ * The response is replied with body() before anything is written, cpprest then sends it with chunked
+ * transfer encoding as the data arrives. write() blocks while more than RESPONSE_MAX_BUFFERED bytes
+ * wait for the client, so a slow client slows the writer down instead of growing the buffer. The writer
+ * sleeps until the client reads from the buffer, and is woken by the read itself.
+ * tryWrite() is for writers that must not wait for a single client, it refuses to buffer past its limit.
+ */
+class StreamedResponse
+{
+public:
+	StreamedResponse();
+
+	StreamedResponse(const StreamedResponse&) = delete;
+	StreamedResponse& operator=(const StreamedResponse&) = delete;
+
+	concurrency::streams::istream body() const;
+
+	void write(const char* data, size_t size);
+	bool tryWrite(const char* data, size_t size, size_t maxBuffered);	// never waits, false if it would buffer more than maxBuffered
+	void close();
+	void abort(std::exception_ptr error);	// ends the response early, the client sees a broken transfer
+
+private:
+	class Buffer;	// a producer consumer buffer that wakes the writer whenever the client reads from it
+
+	std::shared_ptr<Buffer> m_buffer;
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+
+/*
+ * Process wide pool of interned strings.
+ * Every distinct value is stored once, and two equal values held at the same time always get the same
+ * entry. An entry counts the handles that hold it and is freed with the last one, so the values of
+ * deleted users, albums and pictures do not stay in the pool.
+ * Lookups take a shared lock, only adding or freeing a value takes the exclusive lock.
+ */
+class StringPool
+{
+public:
+	struct Entry
+	{
+		std::string value;
+		std::atomic<size_t> references;
+	};
+
+	static StringPool& instance();
+
+	StringPool(const StringPool&) = delete;
+	StringPool& operator=(const StringPool&) = delete;
+
+	// returns the pooled entry of value with a reference taken, adding it if it is not in the pool yet
+	Entry* intern(std::string_view value);
+
+	// returns the pooled entry of value with a reference taken, or nullptr if no handle holds it
+	Entry* find(std::string_view value);
+
+	void addReference(Entry* entry);
+	void release(Entry* entry);		// frees the entry with its last reference
+
+	size_t size() const;
+
+private:
+	StringPool() = default;
+
+	mutable std::shared_mutex m_mutex;
+	std::unordered_map<std::string_view, Entry*> m_index;	// the keys view the values of their entries
+
+	static bool tryAddReference(Entry* entry);
+};
+
+
+/*
+ * Handle to a string in the StringPool. Copying a handle copies a single pointer and counts the reference,
+ * moving one takes the reference over without touching the count, and comparing two handles compares
+ * the pointers instead of the characters.
+ */
+class InternedString
+{
+public:
+	InternedString();
+	InternedString(std::string_view value);
+	InternedString(const InternedString& other);
+	InternedString(InternedString&& other) noexcept;
+	InternedString& operator=(const InternedString& other);
+	InternedString& operator=(InternedString&& other) noexcept;
+	~InternedString();
+
+	// returns the handle of value only if it is already interned - a value that is not interned
+	// can not be equal to any existing handle
+	static std::optional<InternedString> find(std::string_view value);
+
+	const std::string& str() const { return m_entry->value; }
+	bool empty() const { return m_entry->value.empty(); }
+
+	bool operator==(const InternedString& other) const { return m_entry == other.m_entry; }
+	bool operator!=(const InternedString& other) const { return m_entry != other.m_entry; }
+
+	// equal values share one pooled entry, so hashing the address is enough
+	size_t hash() const { return std::hash<const StringPool::Entry*>()(m_entry); }
+
+private:
+	explicit InternedString(StringPool::Entry* entry);
+
+	StringPool::Entry* m_entry;		// null once moved from, the handle can then only be assigned or destroyed
+};
+
+
+namespace std
+{
+	template <>
+	struct hash<InternedString>
+	{
+		size_t operator()(const InternedString& value) const noexcept { return value.hash(); }
+	};
+}
@@ -0,0 +1,361 @@
+#include "TagIndex.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include "MyException.h"
+
+
+TagIndex::TagIndex(size_t maxCoTagPairs) :
+	m_coTags(maxCoTagPairs)
+{
+	// Left empty
+}
+
+
+// maintenance functions //
+void TagIndex::addPicture(int pictureId, int albumId, int ownerId)
+{
+	std::unique_lock lock(m_mutex);
+
+	m_pictureLocations[pictureId] = { albumId, ownerId };
+	m_picturesOfAlbum[albumId].add(pictureId);
+	m_picturesOfOwner[ownerId].add(pictureId);
+	m_allPictures.add(pictureId);
+}
+
+void TagIndex::removePicture(int pictureId)
+{
+	std::unique_lock lock(m_mutex);
+	removePictureLocked(pictureId);
+}
+
+void TagIndex::removeAlbum(int albumId)
+{
+	std::unique_lock lock(m_mutex);
+
+	const auto album = m_picturesOfAlbum.find(albumId);
+	if (album == m_picturesOfAlbum.end())
+		return;
+
+	for (const uint32_t pictureId : album->second.toVector())
+		removePictureLocked(static_cast<int>(pictureId));
+
+	m_picturesOfAlbum.erase(albumId);
+}
+
+// removes the tags of the user and every picture in the albums the user owns
+void TagIndex::removeUser(int userId)
+{
+	std::unique_lock lock(m_mutex);
+
+	m_coTags.removeUser(userId);
+
+	const auto tagged = m_picturesOfUser.find(userId);
+	if (tagged != m_picturesOfUser.end())
+	{
+		for (const uint32_t pictureId : tagged->second.toVector())
+		{
+			countTag(static_cast<int>(pictureId), userId, false);
+			removeFrom(m_usersOfPicture, static_cast<int>(pictureId), userId);
+		}
+
+		m_picturesOfUser.erase(tagged);
+	}
+
+	const auto owned = m_picturesOfOwner.find(userId);
+	if (owned != m_picturesOfOwner.end())
+	{
+		for (const uint32_t pictureId : owned->second.toVector())
+			removePictureLocked(static_cast<int>(pictureId));
+	}
+}
+
+void TagIndex::tagUser(int pictureId, int userId)
+{
+	std::unique_lock lock(m_mutex);
+
+	RoaringBitmap& users = m_usersOfPicture[pictureId];
+	if (users.contains(userId))
+		return;
+
+	for (const uint32_t otherUserId : users.toVector())
+		m_coTags.increment(static_cast<int>(otherUserId), userId);
+
+	m_picturesOfUser[userId].add(pictureId);
+	users.add(userId);
+	countTag(pictureId, userId, true);
+}
+
+void TagIndex::untagUser(int pictureId, int userId)
+{
+	std::unique_lock lock(m_mutex);
+
+	const auto users = m_usersOfPicture.find(pictureId);
+	if (users == m_usersOfPicture.end() || !users->second.contains(userId))
+		return;
+
+	countTag(pictureId, userId, false);
+	removeFrom(m_picturesOfUser, userId, pictureId);
+	removeFrom(m_usersOfPicture, pictureId, userId);
+
+	for (const uint32_t otherUserId : bitmapOf(m_usersOfPicture, pictureId).toVector())
+		m_coTags.decrement(static_cast<int>(otherUserId), userId);
+}
+
+void TagIndex::clear()
+{
+	std::unique_lock lock(m_mutex);
+
+	m_picturesOfUser.clear();
+	m_usersOfPicture.clear();
+	m_picturesOfAlbum.clear();
+	m_picturesOfOwner.clear();
+	m_pictureLocations.clear();
+	m_allPictures.clear();
+	m_coTags.clear();
+	m_tagsInAlbum.clear();
+	m_tagsInOwnerAlbums.clear();
+}
+
+
+// query functions //
+RoaringBitmap TagIndex::getPicturesOfUser(int userId) const
+{
+	std::shared_lock lock(m_mutex);
+	return bitmapOf(m_picturesOfUser, userId);
+}
+
+RoaringBitmap TagIndex::getUsersOfPicture(int pictureId) const
+{
+	std::shared_lock lock(m_mutex);
+	return bitmapOf(m_usersOfPicture, pictureId);
+}
+
+int TagIndex::getOwnerOfPicture(int pictureId) const
+{
+	std::shared_lock lock(m_mutex);
+
+	const auto location = m_pictureLocations.find(pictureId);
+	return location != m_pictureLocations.end() ? location->second.ownerId : -1;
+}
+
+RoaringBitmap TagIndex::evaluate(const TagQuery& query) const
+{
+	std::shared_lock lock(m_mutex);
+	return evaluateLocked(query);
+}
+
+std::vector<std::pair<int, uint32_t>> TagIndex::getTopCoTaggedUsers(int userId, size_t count) const
+{
+	std::shared_lock lock(m_mutex);
+	return m_coTags.getTopPartners(userId, count);
+}
+
+uint32_t TagIndex::countCoTags(int firstUserId, int secondUserId) const
+{
+	std::shared_lock lock(m_mutex);
+	return m_coTags.getCount(firstUserId, secondUserId);
+}
+
+/*
+ * Ranks the users likely to appear in a picture by three signals, each a fraction between 0 and 1:
+ *   - album:    the share of the pictures in the album of the picture the user is tagged in
+ *   - co-tag:   for every user already tagged in the picture, the share of their pictures the user shares with them
+ *   - owner:    the share of the pictures in the albums of the same owner the user is tagged in
+ * Only the aggregates of the album, of the owner and of the tagged users are read, never the tags themselves.
+ */
+std::vector<std::pair<int, double>> TagIndex::suggestTags(int pictureId, size_t count) const
+{
+	constexpr double ALBUM_WEIGHT = 0.5;
+	constexpr double CO_TAG_WEIGHT = 0.35;
+	constexpr double OWNER_WEIGHT = 0.15;
+
+	std::shared_lock lock(m_mutex);
+
+	const auto location = m_pictureLocations.find(pictureId);
+	if (location == m_pictureLocations.end())
+		throw MyException("Picture " + std::to_string(pictureId) + " is not indexed.");
+
+	const RoaringBitmap& taggedUsers = bitmapOf(m_usersOfPicture, pictureId);
+	std::unordered_map<int, double> scores;
+
+	const auto addSignal = [&](const std::unordered_map<int, TagCounts>& aggregates, int id, double weight, uint64_t picturesCount)
+	{
+		const auto counts = aggregates.find(id);
+		if (counts == aggregates.end() || picturesCount == 0)
+			return;
+
+		for (const auto& [userId, tagsCount] : counts->second)
+			scores[userId] += weight * tagsCount / static_cast<double>(picturesCount);
+	};
+
+	addSignal(m_tagsInAlbum, location->second.albumId, ALBUM_WEIGHT, bitmapOf(m_picturesOfAlbum, location->second.albumId).cardinality());
+	addSignal(m_tagsInOwnerAlbums, location->second.ownerId, OWNER_WEIGHT, bitmapOf(m_picturesOfOwner, location->second.ownerId).cardinality());
+
+	// the co-tag weight is split between the tagged users, so a crowded picture does not outweigh the album
+	const std::vector<uint32_t> taggedIds = taggedUsers.toVector();
+	for (const uint32_t taggedId : taggedIds)
+	{
+		const uint64_t taggedPictures = bitmapOf(m_picturesOfUser, static_cast<int>(taggedId)).cardinality();
+
+		m_coTags.forEachPartner(static_cast<int>(taggedId), [&](int partnerId, uint32_t sharedCount)
+		{
+			scores[partnerId] += CO_TAG_WEIGHT / taggedIds.size() * sharedCount / static_cast<double>(taggedPictures);
+		});
+	}
+
+	std::vector<std::pair<int, double>> suggestions;
+	suggestions.reserve(scores.size());
+
+	for (const auto& [userId, score] : scores)
+	{
+		if (!taggedUsers.contains(userId))
+			suggestions.emplace_back(userId, score);
+	}
+
+	const auto isLikelier = [](const auto& a, const auto& b) { return a.second != b.second ? a.second > b.second : a.first < b.first; };
+	const size_t topCount = std::min(count, suggestions.size());
+
+	std::partial_sort(suggestions.begin(), suggestions.begin() + static_cast<std::ptrdiff_t>(topCount), suggestions.end(), isLikelier);
+	suggestions.resize(topCount);
+
+	return suggestions;
+}
+
+
+// helper functions //
+void TagIndex::removePictureLocked(int pictureId)
+{
+	// the tags go first, the album aggregates are found through the location of the picture
+	const auto users = m_usersOfPicture.find(pictureId);
+	if (users != m_usersOfPicture.end())
+	{
+		const std::vector<uint32_t> userIds = users->second.toVector();
+
+		for (size_t i = 0; i < userIds.size(); i++)
+		{
+			countTag(pictureId, static_cast<int>(userIds[i]), false);
+			removeFrom(m_picturesOfUser, static_cast<int>(userIds[i]), pictureId);
+
+			for (size_t j = i + 1; j < userIds.size(); j++)
+				m_coTags.decrement(static_cast<int>(userIds[i]), static_cast<int>(userIds[j]));
+		}
+
+		m_usersOfPicture.erase(users);
+	}
+
+	const auto location = m_pictureLocations.find(pictureId);
+	if (location != m_pictureLocations.end())
+	{
+		removeFrom(m_picturesOfAlbum, location->second.albumId, pictureId);
+		removeFrom(m_picturesOfOwner, location->second.ownerId, pictureId);
+		m_pictureLocations.erase(location);
+	}
+
+	m_allPictures.remove(pictureId);
+}
+
+// keeps the per album and per owner tag counts in step with a tag added to or removed from a picture
+void TagIndex::countTag(int pictureId, int userId, bool isTagged)
+{
+	const auto location = m_pictureLocations.find(pictureId);
+	if (location == m_pictureLocations.end())
+		return;
+
+	for (auto [aggregates, id] : { std::make_pair(&m_tagsInAlbum, location->second.albumId), std::make_pair(&m_tagsInOwnerAlbums, location->second.ownerId) })
+	{
+		TagCounts& counts = (*aggregates)[id];
+
+		if (isTagged)
+			counts[userId]++;
+		else if (const auto count = counts.find(userId); count != counts.end() && --count->second == 0)
+			counts.erase(count);
+
+		if (counts.empty())
+			aggregates->erase(id);
+	}
+}
+
+RoaringBitmap TagIndex::evaluateLocked(const TagQuery& query) const
+{
+	switch (query.type)
+	{
+	case TagQuery::Type::USER:
+		return bitmapOf(m_picturesOfUser, query.id);
+
+	case TagQuery::Type::ALBUM:
+		return bitmapOf(m_picturesOfAlbum, query.id);
+
+	case TagQuery::Type::OWNER:
+		return bitmapOf(m_picturesOfOwner, query.id);
+
+	case TagQuery::Type::NOT:
+		if (query.operands.size() != 1)
+			throw MyException("NOT takes exactly one operand.");
+
+		return m_allPictures - evaluateLocked(query.operands.front());
+
+	case TagQuery::Type::OR:
+	{
+		RoaringBitmap result;
+		for (const TagQuery& operand : query.operands)
+			result = result | evaluateLocked(operand);
+
+		return result;
+	}
+
+	case TagQuery::Type::AND:
+	{
+		if (query.operands.empty())
+			throw MyException("AND takes at least one operand.");
+
+		// "a AND NOT b" is computed as a - b instead of intersecting with the complement of b
+		std::vector<RoaringBitmap> included;
+		std::vector<RoaringBitmap> excluded;
+
+		for (const TagQuery& operand : query.operands)
+		{
+			if (operand.type == TagQuery::Type::NOT && operand.operands.size() == 1)
+				excluded.push_back(evaluateLocked(operand.operands.front()));
+			else
+				included.push_back(evaluateLocked(operand));
+		}
+
+		// intersect the smallest sets first, the intermediate results only shrink
+		std::sort(included.begin(), included.end(), [](const RoaringBitmap& a, const RoaringBitmap& b) { return a.cardinality() < b.cardinality(); });
+
+		RoaringBitmap result = included.empty() ? m_allPictures : included.front();
+		for (size_t i = 1; i < included.size() && !result.empty(); i++)
+			result = result & included[i];
+
+		for (const RoaringBitmap& bitmap : excluded)
+			result = result - bitmap;
+
+		return result;
+	}
+	}
+
+	throw MyException("Unknown tag query.");
+}
+
+// the bitmap of the id, or an empty one when the id has none - a reference, so reading it copies nothing
+const RoaringBitmap& TagIndex::bitmapOf(const std::unordered_map<int, RoaringBitmap>& bitmaps, int id)
+{
+	static const RoaringBitmap empty;
+
+	const auto bitmap = bitmaps.find(id);
+	return bitmap != bitmaps.end() ? bitmap->second : empty;
+}
+
+void TagIndex::removeFrom(std::unordered_map<int, RoaringBitmap>& bitmaps, int id, int value)
+{
+	const auto bitmap = bitmaps.find(id);
+	if (bitmap == bitmaps.end())
+		return;
+
+	bitmap->second.remove(value);
+
+	if (bitmap->second.empty())
+		bitmaps.erase(bitmap);
+}
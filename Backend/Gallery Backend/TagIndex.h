@@ -0,0 +1,76 @@
+#pragma once
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CoTagMatrix.h"
+#include "RoaringBitmap.h"
+
+
+// a set expression over the pictures of the gallery, evaluated by TagIndex
+struct TagQuery
+{
+	enum class Type { USER, ALBUM, OWNER, AND, OR, NOT };
+
+	Type type{ Type::AND };
+	int id{ -1 };					// user, album or owner id of a leaf
+	std::string albumName;			// the API refers to albums by name, DatabaseAccess resolves it to the id
+	std::vector<TagQuery> operands;	// operands of AND / OR, the single operand of NOT
+};
+
+
+/*
+ * In-memory inverted index of the tags, kept next to the database by DatabaseAccess.
+ * Holds a bitmap of picture ids per tagged user and of user ids per picture, plus the pictures of every
+ * album and of every album owner, so set questions ("pictures where both users are tagged", "pictures of
+ * a user in albums of another user") are answered with bitmap operations instead of joins on TAGS.
+ * It also keeps the co-occurrence counts of every pair of users tagged in the same picture, and how many
+ * times every user is tagged in each album and in the albums of each owner, all updated on every tag change,
+ * so "who is this user photographed with" and the tag suggestions of a picture never scan TAGS.
+ * All functions are thread safe, queries run under a shared lock.
+ */
+class TagIndex
+{
+public:
+	explicit TagIndex(size_t maxCoTagPairs = 0);	// 0 keeps every co-occurring pair
+
+	// maintenance functions //
+	void addPicture(int pictureId, int albumId, int ownerId);
+	void removePicture(int pictureId);
+	void removeAlbum(int albumId);
+	void removeUser(int userId);
+	void tagUser(int pictureId, int userId);
+	void untagUser(int pictureId, int userId);
+	void clear();
+
+	// query functions //
+	RoaringBitmap getPicturesOfUser(int userId) const;
+	RoaringBitmap getUsersOfPicture(int pictureId) const;
+	int getOwnerOfPicture(int pictureId) const;		// -1 if the picture is not indexed
+	RoaringBitmap evaluate(const TagQuery& query) const;
+	std::vector<std::pair<int, uint32_t>> getTopCoTaggedUsers(int userId, size_t count) const;
+	uint32_t countCoTags(int firstUserId, int secondUserId) const;
+	std::vector<std::pair<int, double>> suggestTags(int pictureId, size_t count) const;
+
+private:
+	struct PictureLocation { int albumId; int ownerId; };
+	using TagCounts = std::unordered_map<int, uint32_t>;	// user id -> tags count
+
+	mutable std::shared_mutex m_mutex;
+	std::unordered_map<int, RoaringBitmap> m_picturesOfUser;
+	std::unordered_map<int, RoaringBitmap> m_usersOfPicture;
+	std::unordered_map<int, RoaringBitmap> m_picturesOfAlbum;
+	std::unordered_map<int, RoaringBitmap> m_picturesOfOwner;
+	std::unordered_map<int, PictureLocation> m_pictureLocations;
+	RoaringBitmap m_allPictures;
+	CoTagMatrix m_coTags;
+	std::unordered_map<int, TagCounts> m_tagsInAlbum;
+	std::unordered_map<int, TagCounts> m_tagsInOwnerAlbums;
+
+	void removePictureLocked(int pictureId);
+	void countTag(int pictureId, int userId, bool isTagged);
+	RoaringBitmap evaluateLocked(const TagQuery& query) const;
+	static const RoaringBitmap& bitmapOf(const std::unordered_map<int, RoaringBitmap>& bitmaps, int id);
+	static void removeFrom(std::unordered_map<int, RoaringBitmap>& bitmaps, int id, int value);
+};
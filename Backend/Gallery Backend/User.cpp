@@ -2,8 +2,8 @@
 #include <iomanip>
 
 
-User::User(int id, std::string name) :
-	m_id(id), m_name(std::move(name))
+User::User(int id, std::string_view name) :
+	m_id(id), m_name(name)
 {}
 
 int User::getId() const
@@ -18,10 +18,10 @@ void User::setId(int id)
 
 const std::string& User::getName() const
 {
-	return m_name;
+	return m_name.str();
 }
 
-void User::setName(const std::string& name)
+void User::setName(std::string_view name)
 {
 	m_name = name;
 }
@@ -41,6 +41,6 @@ bool User::operator<(const User& other) const
 }
 
 std::ostream& operator<<(std::ostream& os, const User& user) {
-	os << std::setw(5) << "   + @" << user.m_id << " - " << user.m_name;
+	os << std::setw(5) << "   + @" << user.m_id << " - " << user.m_name.str();
 	return os;
 }
\ No newline at end of file
@@ -1,18 +1,20 @@
 ﻿#pragma once
 #include <string>
+#include <string_view>
+#include "StringPool.h"
 #include <iostream>
 
 class User
 {
 public:
 
-	User(int id, std::string name);
+	User(int id, std::string_view name);
 
 	int getId() const;
 	void setId(int id);
 
 	const std::string& getName() const;
-	void setName(const std::string& name);
+	void setName(std::string_view name);
 
 	bool operator==(const User& other) const;
 	bool operator==(int id) const;
@@ -21,5 +23,5 @@ public:
 
 private:
 	int m_id;
-	std::string m_name;
+	InternedString m_name;
 };
\ No newline at end of file
@@ -2,9 +2,11 @@
 
 #include <cpprest/http_listener.h>
 #include "DatabaseAccess.h"
-#include "Colors.h"
+#include "ConsoleLogSink.h"
 #include "Constants.h"
 #include "GalleryAPI.h"
+#include "JsonLogSink.h"
+#include "Logger.h"
 
 using namespace web;
 using namespace web::http;
@@ -12,6 +14,14 @@ using namespace web::http::experimental::listener;
 
 int main()
 {
+    // log to the console, and to a file of JSON lines if it can be opened
+    Logger& logger = Logger::instance();
+    logger.addSink(std::make_unique<ConsoleLogSink>(LOG_CONSOLE_COLORS));
+
+    auto logFile = std::make_unique<JsonLogSink>(LOG_FILE_NAME);
+    if (logFile->isOpen())
+        logger.addSink(std::move(logFile));
+
     // Create an HTTP listener and bind it to a URI
     GalleryAPI galleryApi(BASE_URI);
 
@@ -26,7 +36,7 @@ int main()
     }
     catch (const std::exception& e)
     {
-        std::cerr << RED << "Error: " << e.what() << RESET << '\n';
+        Logger::failure("server", std::string("Error: ") + e.what());
     }
 
     return 0;
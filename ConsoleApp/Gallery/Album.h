@@ -1,17 +1,37 @@
 ﻿#pragma once
 #include "Picture.h"
 #include <list>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 
 class Album
 {
 public:
+	// read-only view of the pictures of an album, valid until the album is modified
+	class PictureRange
+	{
+	public:
+		PictureRange(const Picture* first, size_t count) : m_first(first), m_count(count) {}
+
+		const Picture* begin() const { return m_first; }
+		const Picture* end() const { return m_first + m_count; }
+		size_t size() const { return m_count; }
+		bool empty() const { return m_count == 0; }
+
+	private:
+		const Picture* m_first;
+		size_t m_count;
+	};
+
 	Album() = default;
-	Album(int ownerId, std::string name);
-	Album(int ownerId, std::string name, std::string creationTime);
+	Album(int ownerId, std::string_view name);
+	Album(int ownerId, std::string_view name, std::string creationTime);
 
 	const std::string& getName() const;
-	void setName(const std::string& name);
+	const InternedString& getInternedName() const;
+	void setName(std::string_view name);
 
 	int getOwnerId() const;
 	void setOwner(int userId);
@@ -24,8 +44,8 @@ public:
 	void addPicture(const Picture& picture);
 	void removePicture(const std::string& pictureName);
 
-	Picture getPicture(const std::string& name) const;
-	std::list<Picture> getPictures() const;
+	const Picture& getPicture(const std::string& name) const;
+	PictureRange getPictures() const;
 
 	void untagUserInAlbum(int userId);
 	void tagUserInAlbum(int userId);
@@ -38,7 +58,11 @@ public:
 
 private:
 	int m_ownerId{ 0 };
-	std::string m_name;
+	InternedString m_name;
 	std::string m_creationDate;
-	std::list<Picture> m_pictures;
+	std::vector<Picture> m_pictures;
+	std::unordered_map<InternedString, size_t> m_pictureIndex;	// picture name -> position in m_pictures
+
+	const Picture* findPicture(const std::string& pictureName) const;
+	Picture* findPicture(const std::string& pictureName);
 };
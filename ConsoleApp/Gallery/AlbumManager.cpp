@@ -191,7 +191,7 @@ void AlbumManager::listPicturesInAlbum()
 {
 	refreshOpenAlbum();
 
-	const std::list<Picture>& albumPictures = m_openAlbum.getPictures();
+	const auto albumPictures = m_openAlbum.getPictures();
 
 	if (albumPictures.empty())
 		throw MyException("Error: There are no pictures in Album [" + m_openAlbum.getName() + "].\n");
@@ -487,6 +487,8 @@ void AlbumManager::picturesTaggedUser()
 // ******************* Help & exit ******************* 
 void AlbumManager::exit()
 {
+	// std::exit skips the destructors, the data access syncs what it has not written yet here
+	m_dataAccess.close();
 	std::exit(EXIT_SUCCESS);
 }
 
@@ -0,0 +1,140 @@
+#include "BinaryStream.h"
+
+#include <array>
+
+#include "MyException.h"
+
+
+static std::array<uint32_t, 256> makeCrcTable()
+{
+	std::array<uint32_t, 256> table{};
+
+	for (uint32_t i = 0; i < table.size(); ++i) {
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; ++bit)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+
+		table[i] = crc;
+	}
+
+	return table;
+}
+
+uint32_t crc32(const char* data, size_t size)
+{
+	static const std::array<uint32_t, 256> table = makeCrcTable();
+
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; ++i)
+		crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+
+	return crc ^ 0xFFFFFFFFu;
+}
+
+
+
+// BinaryWriter //
+void BinaryWriter::writeUInt8(uint8_t value)
+{
+	m_buffer.push_back(static_cast<char>(value));
+}
+
+void BinaryWriter::writeUInt32(uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+		m_buffer.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+}
+
+void BinaryWriter::writeUInt64(uint64_t value)
+{
+	for (int i = 0; i < 8; ++i)
+		m_buffer.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+}
+
+void BinaryWriter::writeInt32(int value)
+{
+	writeUInt32(static_cast<uint32_t>(value));
+}
+
+void BinaryWriter::writeString(const std::string& value)
+{
+	writeUInt32(static_cast<uint32_t>(value.size()));
+	m_buffer.append(value);
+}
+
+const std::string& BinaryWriter::data() const
+{
+	return m_buffer;
+}
+
+size_t BinaryWriter::size() const
+{
+	return m_buffer.size();
+}
+
+void BinaryWriter::clear()
+{
+	m_buffer.clear();
+}
+
+
+
+// BinaryReader //
+BinaryReader::BinaryReader(const char* data, size_t size) :
+	m_data(data), m_size(size)
+{}
+
+uint8_t BinaryReader::readUInt8()
+{
+	ensureAvailable(1);
+	return static_cast<uint8_t>(m_data[m_position++]);
+}
+
+uint32_t BinaryReader::readUInt32()
+{
+	ensureAvailable(4);
+
+	uint32_t value = 0;
+	for (int i = 0; i < 4; ++i)
+		value |= static_cast<uint32_t>(static_cast<uint8_t>(m_data[m_position++])) << (i * 8);
+
+	return value;
+}
+
+uint64_t BinaryReader::readUInt64()
+{
+	ensureAvailable(8);
+
+	uint64_t value = 0;
+	for (int i = 0; i < 8; ++i)
+		value |= static_cast<uint64_t>(static_cast<uint8_t>(m_data[m_position++])) << (i * 8);
+
+	return value;
+}
+
+int BinaryReader::readInt32()
+{
+	return static_cast<int>(readUInt32());
+}
+
+std::string BinaryReader::readString()
+{
+	const uint32_t length = readUInt32();
+	ensureAvailable(length);
+
+	std::string value(m_data + m_position, length);
+	m_position += length;
+
+	return value;
+}
+
+bool BinaryReader::atEnd() const
+{
+	return m_position >= m_size;
+}
+
+void BinaryReader::ensureAvailable(size_t count) const
+{
+	if (count > m_size - m_position)
+		throw MyException("Unexpected end of binary data.");
+}
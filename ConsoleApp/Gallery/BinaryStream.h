@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+
+// computes the CRC-32 (IEEE 802.3) checksum of a buffer
+uint32_t crc32(const char* data, size_t size);
+
+
+// appends little-endian fixed width values and length-prefixed strings into a byte buffer
+class BinaryWriter
+{
+public:
+	void writeUInt8(uint8_t value);
+	void writeUInt32(uint32_t value);
+	void writeUInt64(uint64_t value);
+	void writeInt32(int value);
+	void writeString(const std::string& value);
+
+	const std::string& data() const;
+	size_t size() const;
+	void clear();
+
+private:
+	std::string m_buffer;
+};
+
+
+// reads back values written by BinaryWriter, throws MyException when reading past the end
+class BinaryReader
+{
+public:
+	BinaryReader(const char* data, size_t size);
+
+	uint8_t readUInt8();
+	uint32_t readUInt32();
+	uint64_t readUInt64();
+	int readInt32();
+	std::string readString();
+
+	bool atEnd() const;
+
+private:
+	const char* m_data;
+	size_t m_size;
+	size_t m_position{ 0 };
+
+	void ensureAvailable(size_t count) const;
+};
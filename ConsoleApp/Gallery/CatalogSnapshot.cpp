@@ -0,0 +1,354 @@
+#include "CatalogSnapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <io.h>
+#include <unordered_map>
+#include <vector>
+#include <Windows.h>
+
+#include "BinaryStream.h"
+#include "MyException.h"
+
+
+constexpr uint32_t CATALOG_MAGIC = 0x54414347; // "GCAT"
+constexpr uint32_t CATALOG_VERSION = 1;
+
+struct CatalogHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sequence;			// last operation log sequence number covered by the catalog
+	uint32_t usersCount;
+	uint32_t albumsCount;
+	uint32_t picturesCount;
+	uint32_t tagsCount;
+	uint64_t usersOffset;
+	uint64_t albumsOffset;
+	uint64_t albumNameIndexOffset;
+	uint64_t picturesOffset;
+	uint64_t tagsOffset;
+	uint64_t stringsOffset;
+	uint64_t stringsSize;
+	uint32_t checksum;			// crc32 of everything after the header
+	uint32_t reserved;
+};
+
+static_assert(sizeof(CatalogHeader) == 96, "catalog header layout changed");
+static_assert(sizeof(CatalogSnapshot::UserRecord) == 12, "user record layout changed");
+static_assert(sizeof(CatalogSnapshot::AlbumRecord) == 28, "album record layout changed");
+static_assert(sizeof(CatalogSnapshot::PictureRecord) == 36, "picture record layout changed");
+
+
+// appends the records of a section, padded so the next section stays 8 bytes aligned
+template <typename T>
+static uint64_t appendSection(std::string& file, const std::vector<T>& records)
+{
+	const uint64_t offset = file.size();
+	file.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(T));
+	file.append((8 - file.size() % 8) % 8, '\0');
+
+	return offset;
+}
+
+// adds a string to the string table once, and returns where it is
+static CatalogSnapshot::StringRef internString(std::string& strings, std::unordered_map<std::string, uint32_t>& offsets, const std::string& value)
+{
+	const auto [it, inserted] = offsets.try_emplace(value, static_cast<uint32_t>(strings.size()));
+	if (inserted)
+		strings.append(value);
+
+	return { it->second, static_cast<uint32_t>(value.size()) };
+}
+
+
+CatalogSnapshot::~CatalogSnapshot()
+{
+	close();
+}
+
+void CatalogSnapshot::write(const std::string& path, uint64_t sequence, const std::list<User>& users, const std::list<Album>& albums)
+{
+	std::string strings;
+	std::unordered_map<std::string, uint32_t> stringOffsets;
+
+	std::vector<UserRecord> userRecords;
+	userRecords.reserve(users.size());
+	for (const auto& user : users)
+		userRecords.push_back({ user.getId(), internString(strings, stringOffsets, user.getName()) });
+
+	std::sort(userRecords.begin(), userRecords.end(), [](const UserRecord& a, const UserRecord& b) { return a.id < b.id; });
+
+	std::vector<AlbumRecord> albumRecords;
+	std::vector<PictureRecord> pictureRecords;
+	std::vector<int32_t> tags;
+	albumRecords.reserve(albums.size());
+
+	for (const auto& album : albums)
+	{
+		const auto pictures = album.getPictures();
+
+		albumRecords.push_back({ album.getOwnerId(),
+			internString(strings, stringOffsets, album.getName()),
+			internString(strings, stringOffsets, album.getCreationDate()),
+			static_cast<uint32_t>(pictureRecords.size()), static_cast<uint32_t>(pictures.size()) });
+
+		for (const auto& picture : pictures)
+		{
+			const std::set<int>& pictureTags = picture.getUserTags();
+
+			pictureRecords.push_back({ picture.getId(),
+				internString(strings, stringOffsets, picture.getName()),
+				internString(strings, stringOffsets, picture.getPath()),
+				internString(strings, stringOffsets, picture.getCreationDate()),
+				static_cast<uint32_t>(tags.size()), static_cast<uint32_t>(pictureTags.size()) });
+
+			tags.insert(tags.end(), pictureTags.begin(), pictureTags.end());
+		}
+	}
+
+	std::vector<uint32_t> albumNameIndex(albumRecords.size());
+	for (uint32_t i = 0; i < albumNameIndex.size(); ++i)
+		albumNameIndex[i] = i;
+
+	auto albumName = [&](uint32_t index) {
+		const StringRef& name = albumRecords[index].name;
+		return std::string_view(strings.data() + name.offset, name.length);
+	};
+	std::stable_sort(albumNameIndex.begin(), albumNameIndex.end(), [&](uint32_t a, uint32_t b) { return albumName(a) < albumName(b); });
+
+	// lay out the file
+	CatalogHeader header{};
+	std::string file(sizeof(CatalogHeader), '\0');
+
+	header.magic = CATALOG_MAGIC;
+	header.version = CATALOG_VERSION;
+	header.sequence = sequence;
+	header.usersCount = static_cast<uint32_t>(userRecords.size());
+	header.albumsCount = static_cast<uint32_t>(albumRecords.size());
+	header.picturesCount = static_cast<uint32_t>(pictureRecords.size());
+	header.tagsCount = static_cast<uint32_t>(tags.size());
+	header.usersOffset = appendSection(file, userRecords);
+	header.albumsOffset = appendSection(file, albumRecords);
+	header.albumNameIndexOffset = appendSection(file, albumNameIndex);
+	header.picturesOffset = appendSection(file, pictureRecords);
+	header.tagsOffset = appendSection(file, tags);
+	header.stringsOffset = file.size();
+	header.stringsSize = strings.size();
+	file.append(strings);
+	header.checksum = crc32(file.data() + sizeof(CatalogHeader), file.size() - sizeof(CatalogHeader));
+
+	std::memcpy(file.data(), &header, sizeof(CatalogHeader));
+
+	// write the catalog aside and rename it over the old one, so a crash never leaves a partial catalog
+	const std::string tempPath = path + ".tmp";
+	FILE* tempFile = std::fopen(tempPath.c_str(), "wb");
+	if (tempFile == nullptr)
+		throw MyException("Failed to create catalog file '" + tempPath + "'.");
+
+	const bool written = std::fwrite(file.data(), 1, file.size(), tempFile) == file.size() &&
+		std::fflush(tempFile) == 0 && _commit(_fileno(tempFile)) == 0;
+	std::fclose(tempFile);
+
+	if (!written)
+		throw MyException("Failed to write catalog file '" + tempPath + "'.");
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+		throw MyException("Failed to replace catalog file '" + path + "': " + error.message());
+}
+
+bool CatalogSnapshot::open(const std::string& path, bool verifyChecksum)
+{
+	close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	m_fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(CatalogHeader)))
+	{
+		close();
+		throw MyException("Catalog file '" + path + "' is truncated.");
+	}
+
+	m_mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mappingHandle != nullptr)
+		m_data = static_cast<const char*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+
+	if (m_data == nullptr)
+	{
+		close();
+		throw MyException("Failed to map catalog file '" + path + "'.");
+	}
+
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+
+	try {
+		validate(verifyChecksum);
+	}
+	catch (const MyException&) {
+		close();
+		throw;
+	}
+
+	return true;
+}
+
+void CatalogSnapshot::close()
+{
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mappingHandle != nullptr)
+		CloseHandle(m_mappingHandle);
+	if (m_fileHandle != nullptr)
+		CloseHandle(m_fileHandle);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_mappingHandle = nullptr;
+	m_fileHandle = nullptr;
+	m_usersCount = 0;
+	m_albumsCount = 0;
+}
+
+bool CatalogSnapshot::isOpen() const
+{
+	return m_data != nullptr;
+}
+
+uint64_t CatalogSnapshot::getSequence() const
+{
+	return reinterpret_cast<const CatalogHeader*>(m_data)->sequence;
+}
+
+
+// lookups //
+std::optional<User> CatalogSnapshot::findUser(int userId) const
+{
+	const UserRecord* end = m_users + m_usersCount;
+	const UserRecord* result = std::lower_bound(m_users, end, userId, [](const UserRecord& record, int id) { return record.id < id; });
+
+	if (result == end || result->id != userId)
+		return std::nullopt;
+
+	return User(result->id, std::string(getString(result->name)));
+}
+
+std::optional<Album> CatalogSnapshot::findAlbum(std::string_view albumName) const
+{
+	const uint32_t* end = m_albumNameIndex + m_albumsCount;
+	const uint32_t* result = std::lower_bound(m_albumNameIndex, end, albumName,
+		[&](uint32_t index, std::string_view name) { return getString(getAlbumRecord(index).name) < name; });
+
+	if (result == end || getString(getAlbumRecord(*result).name) != albumName)
+		return std::nullopt;
+
+	return buildAlbum(getAlbumRecord(*result));
+}
+
+std::list<User> CatalogSnapshot::getUsers() const
+{
+	std::list<User> users;
+
+	for (uint32_t i = 0; i < m_usersCount; ++i)
+		users.emplace_back(m_users[i].id, std::string(getString(m_users[i].name)));
+
+	return users;
+}
+
+std::list<Album> CatalogSnapshot::getAlbums() const
+{
+	std::list<Album> albums;
+
+	for (uint32_t i = 0; i < m_albumsCount; ++i)
+		albums.push_back(buildAlbum(m_albums[i]));
+
+	return albums;
+}
+
+
+// helper functions //
+std::string_view CatalogSnapshot::getString(const StringRef& ref) const
+{
+	const auto* header = reinterpret_cast<const CatalogHeader*>(m_data);
+
+	if (static_cast<uint64_t>(ref.offset) + ref.length > header->stringsSize)
+		throw MyException("Catalog string reference is out of bounds.");
+
+	return { m_data + header->stringsOffset + ref.offset, ref.length };
+}
+
+const CatalogSnapshot::AlbumRecord& CatalogSnapshot::getAlbumRecord(uint32_t index) const
+{
+	if (index >= m_albumsCount)
+		throw MyException("Catalog album index is corrupted.");
+
+	return m_albums[index];
+}
+
+Album CatalogSnapshot::buildAlbum(const AlbumRecord& record) const
+{
+	const auto* header = reinterpret_cast<const CatalogHeader*>(m_data);
+
+	if (static_cast<uint64_t>(record.firstPicture) + record.picturesCount > header->picturesCount)
+		throw MyException("Catalog album record is out of bounds.");
+
+	Album album(record.ownerId, std::string(getString(record.name)), std::string(getString(record.creationDate)));
+
+	for (uint32_t i = 0; i < record.picturesCount; ++i)
+	{
+		const PictureRecord& pictureRecord = m_pictures[record.firstPicture + i];
+
+		if (static_cast<uint64_t>(pictureRecord.firstTag) + pictureRecord.tagsCount > header->tagsCount)
+			throw MyException("Catalog picture record is out of bounds.");
+
+		Picture picture(pictureRecord.id, std::string(getString(pictureRecord.name)),
+			std::string(getString(pictureRecord.path)), std::string(getString(pictureRecord.creationDate)));
+
+		for (uint32_t j = 0; j < pictureRecord.tagsCount; ++j)
+			picture.tagUser(m_tags[pictureRecord.firstTag + j]);
+
+		album.addPicture(picture);
+	}
+
+	return album;
+}
+
+void CatalogSnapshot::validate(bool verifyChecksum)
+{
+	const auto* header = reinterpret_cast<const CatalogHeader*>(m_data);
+
+	if (header->magic != CATALOG_MAGIC || header->version != CATALOG_VERSION)
+		throw MyException("Catalog file has an unknown format.");
+
+	auto isSectionValid = [&](uint64_t offset, uint64_t count, size_t recordSize) {
+		return offset % 8 == 0 && offset >= sizeof(CatalogHeader) && offset <= m_size && count <= (m_size - offset) / recordSize;
+	};
+
+	if (!isSectionValid(header->usersOffset, header->usersCount, sizeof(UserRecord)) ||
+		!isSectionValid(header->albumsOffset, header->albumsCount, sizeof(AlbumRecord)) ||
+		!isSectionValid(header->albumNameIndexOffset, header->albumsCount, sizeof(uint32_t)) ||
+		!isSectionValid(header->picturesOffset, header->picturesCount, sizeof(PictureRecord)) ||
+		!isSectionValid(header->tagsOffset, header->tagsCount, sizeof(int32_t)) ||
+		header->stringsOffset > m_size || header->stringsSize > m_size - header->stringsOffset)
+	{
+		throw MyException("Catalog file is corrupted.");
+	}
+
+	if (verifyChecksum && crc32(m_data + sizeof(CatalogHeader), m_size - sizeof(CatalogHeader)) != header->checksum)
+		throw MyException("Catalog file checksum mismatch.");
+
+	m_users = reinterpret_cast<const UserRecord*>(m_data + header->usersOffset);
+	m_albums = reinterpret_cast<const AlbumRecord*>(m_data + header->albumsOffset);
+	m_albumNameIndex = reinterpret_cast<const uint32_t*>(m_data + header->albumNameIndexOffset);
+	m_pictures = reinterpret_cast<const PictureRecord*>(m_data + header->picturesOffset);
+	m_tags = reinterpret_cast<const int32_t*>(m_data + header->tagsOffset);
+	m_usersCount = header->usersCount;
+	m_albumsCount = header->albumsCount;
+}
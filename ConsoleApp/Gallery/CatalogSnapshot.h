@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "Album.h"
+#include "User.h"
+
+
+/*
+ * Versioned binary snapshot of the whole catalog, read through a memory mapping.
+ *
+ * Layout (little-endian, every offset is relative to the start of the file, so the file is
+ * position independent and can be mapped anywhere):
+ *   [CatalogHeader]
+ *   [UserRecord x usersCount]         sorted by id, looked up with a binary search
+ *   [AlbumRecord x albumsCount]       in creation order
+ *   [uint32 x albumsCount]            album indices sorted by album name
+ *   [PictureRecord x picturesCount]   grouped by album
+ *   [int32 x tagsCount]               tagged user ids, grouped by picture
+ *   [string table]                    deduplicated, not null terminated
+ */
+class CatalogSnapshot
+{
+public:
+	struct StringRef { uint32_t offset; uint32_t length; };
+	struct UserRecord { int32_t id; StringRef name; };
+	struct AlbumRecord { int32_t ownerId; StringRef name; StringRef creationDate; uint32_t firstPicture; uint32_t picturesCount; };
+	struct PictureRecord { int32_t id; StringRef name; StringRef path; StringRef creationDate; uint32_t firstTag; uint32_t tagsCount; };
+
+	CatalogSnapshot() = default;
+	~CatalogSnapshot();
+
+	CatalogSnapshot(const CatalogSnapshot&) = delete;
+	CatalogSnapshot& operator=(const CatalogSnapshot&) = delete;
+
+	// writes the catalog to a temporary file and renames it over path
+	static void write(const std::string& path, uint64_t sequence, const std::list<User>& users, const std::list<Album>& albums);
+
+	// maps the file, returns false if it does not exist. The checksum covers the whole file,
+	// so verifying it touches every page - skip it when only a few lookups are needed
+	bool open(const std::string& path, bool verifyChecksum);
+	void close();
+	bool isOpen() const;
+
+	uint64_t getSequence() const;
+
+	// lookups run directly against the mapped file //
+	std::optional<User> findUser(int userId) const;
+	std::optional<Album> findAlbum(std::string_view albumName) const;
+	std::list<User> getUsers() const;
+	std::list<Album> getAlbums() const;
+
+private:
+	const char* m_data = nullptr;
+	size_t m_size{ 0 };
+	void* m_fileHandle = nullptr;
+	void* m_mappingHandle = nullptr;
+
+	const UserRecord* m_users = nullptr;
+	const AlbumRecord* m_albums = nullptr;
+	const uint32_t* m_albumNameIndex = nullptr;
+	const PictureRecord* m_pictures = nullptr;
+	const int32_t* m_tags = nullptr;
+	uint32_t m_usersCount{ 0 };
+	uint32_t m_albumsCount{ 0 };
+
+	std::string_view getString(const StringRef& ref) const;
+	const AlbumRecord& getAlbumRecord(uint32_t index) const;
+	Album buildAlbum(const AlbumRecord& record) const;
+	void validate(bool verifyChecksum);
+};
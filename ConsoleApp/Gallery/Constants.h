@@ -1,4 +1,4 @@
-#pragma once
+﻿#pragma once
 #include <string>
 #include <vector>
 
@@ -56,6 +56,13 @@ constexpr const char* DB_NAME = "galleryDB.sqlite";
 constexpr int FIRST_USER_ID = 200;
 constexpr int FIRST_PICTURE_ID = 100;
 
+// MemoryAccess persistence, the gallery runs on it instead of the database when started with MEMORY_MODE_ARGUMENT
+constexpr const char* MEMORY_MODE_ARGUMENT = "--memory";
+constexpr const char* MEMORY_LOG_NAME = "galleryMemory.log";
+constexpr const char* MEMORY_SNAPSHOT_NAME = "galleryMemory.catalog";
+constexpr int LOG_SYNC_BATCH_SIZE = 32;			// operations appended between two fsyncs of the log
+constexpr int LOG_COMPACTION_THRESHOLD = 4096;	// operations in the log before it is compacted into a catalog snapshot
+
 enum class PhotoViewApp
 {
 	PAINT = 0,
@@ -1,9 +1,16 @@
 #include "DataAccessTest.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <random>
 
+#include "BinaryStream.h"
 #include "Colors.h"
 #include "Constants.h"
+#include "MemoryAccess.h"
 
 void DataAccessTest::createTables()
 {
@@ -134,3 +141,185 @@ void DataAccessTest::deleteData()
 
 	_dbAccess.close();
 }
+
+
+// ******************* MemoryAccess persistence ******************* 
+constexpr const char* TEST_LOG_NAME = "galleryMemoryTest.log";
+constexpr const char* TEST_SNAPSHOT_NAME = "galleryMemoryTest.catalog";
+
+static bool check(bool condition, const std::string& description)
+{
+	if (!condition)
+		std::cerr << RED << "FAILED: " << description << RESET << '\n';
+
+	return condition;
+}
+
+static void removeMemoryFiles()
+{
+	std::remove(TEST_LOG_NAME);
+	std::remove(TEST_SNAPSHOT_NAME);
+}
+
+// a user with an album of two pictures, the user tagged in the first
+static void addMemoryData(MemoryAccess& memory)
+{
+	User user(1, "shahar");
+	memory.createUser(user);
+	memory.createAlbum(Album(1, "holiday"));
+	memory.addPictureToAlbumByName("holiday", Picture(1, "beach"));
+	memory.addPictureToAlbumByName("holiday", Picture(2, "sunset"));
+	memory.tagUserInPicture("holiday", "beach", 1);
+}
+
+static bool hasMemoryData(MemoryAccess& memory)
+{
+	bool passed = check(memory.doesUserExists(1), "the user is restored");
+	passed &= check(memory.doesAlbumExists("holiday", 1), "the album is restored");
+
+	if (passed)
+	{
+		const Album album = memory.openAlbum("holiday");
+		passed &= check(album.getPictures().size() == 2, "both pictures are restored");
+		passed &= check(album.doesPictureExists("beach") && album.getPicture("beach").isUserTagged(1), "the tag is restored");
+	}
+
+	return passed;
+}
+
+static std::string readFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(content.data(), static_cast<std::streamsize>(content.size()));
+}
+
+bool DataAccessTest::testMemoryReplay()
+{
+	removeMemoryFiles();
+	bool passed = true;
+
+	{
+		MemoryAccess memory(TEST_LOG_NAME, TEST_SNAPSHOT_NAME);
+		passed &= check(memory.open(), "an empty log opens");
+		addMemoryData(memory);
+		memory.removePictureFromAlbumByName("holiday", "sunset");
+		memory.addPictureToAlbumByName("holiday", Picture(2, "sunset"));
+		memory.close();
+	}
+
+	// the same state is rebuilt from the log alone, twice in a row
+	for (int i = 0; i < 2; ++i)
+	{
+		MemoryAccess memory(TEST_LOG_NAME, TEST_SNAPSHOT_NAME);
+		passed &= check(memory.open(), "the log replays");
+		passed &= hasMemoryData(memory);
+		memory.close();
+	}
+
+	removeMemoryFiles();
+	return passed;
+}
+
+bool DataAccessTest::testMemoryCompaction()
+{
+	removeMemoryFiles();
+	bool passed = true;
+
+	{
+		MemoryAccess memory(TEST_LOG_NAME, TEST_SNAPSHOT_NAME);
+		memory.open();
+		addMemoryData(memory);
+
+		// enough tag changes to compact the log, ending with the user tagged in the second picture
+		for (int i = 0; i <= LOG_COMPACTION_THRESHOLD; ++i)
+		{
+			if (i % 2 == 0)
+				memory.tagUserInPicture("holiday", "sunset", 1);
+			else
+				memory.untagUserInPicture("holiday", "sunset", 1);
+		}
+
+		User dov(2, "dov");
+		memory.createUser(dov);
+		memory.close();
+	}
+
+	passed &= check(std::filesystem::exists(TEST_SNAPSHOT_NAME), "the log is compacted into a catalog");
+	passed &= check(std::filesystem::file_size(TEST_LOG_NAME) < 1024, "the compacted log is truncated");
+
+	// the catalog and the operations logged after it, through a second compaction-free reopen
+	for (int i = 0; i < 2; ++i)
+	{
+		MemoryAccess memory(TEST_LOG_NAME, TEST_SNAPSHOT_NAME);
+		passed &= check(memory.open(), "the catalog and the log restore");
+		passed &= hasMemoryData(memory);
+		passed &= check(memory.openAlbum("holiday").getPicture("sunset").isUserTagged(1), "the last tag change before the compaction is kept");
+		passed &= check(memory.doesUserExists(2), "the operation after the compaction is replayed");
+		passed &= check(memory.getLastUserId() == std::max(FIRST_USER_ID, 2), "every user of the catalog is loaded");
+		memory.close();
+	}
+
+	removeMemoryFiles();
+	return passed;
+}
+
+bool DataAccessTest::testMemoryTornTail()
+{
+	removeMemoryFiles();
+	bool passed = true;
+
+	{
+		MemoryAccess memory(TEST_LOG_NAME, TEST_SNAPSHOT_NAME);
+		memory.open();
+		addMemoryData(memory);
+		memory.close();
+	}
+
+	const std::string validLog = readFile(TEST_LOG_NAME);
+
+	// a record cut short by a crash - the header promises more payload than the file holds
+	{
+		BinaryWriter tornRecord;
+		tornRecord.writeUInt32(100);
+		tornRecord.writeUInt32(0);
+		writeFile(TEST_LOG_NAME, validLog + tornRecord.data() + "abc");
+
+		MemoryAccess memory(TEST_LOG_NAME, TEST_SNAPSHOT_NAME);
+		passed &= check(memory.open(), "a log with a torn tail opens");
+		passed &= hasMemoryData(memory);
+
+		// the torn tail is dropped, so a new record follows the last valid one
+		User dov(2, "dov");
+		memory.createUser(dov);
+		memory.close();
+	}
+	{
+		MemoryAccess memory(TEST_LOG_NAME, TEST_SNAPSHOT_NAME);
+		passed &= check(memory.open(), "the log written after a torn tail opens");
+		passed &= hasMemoryData(memory);
+		passed &= check(memory.doesUserExists(2), "the record written after a torn tail is replayed");
+		memory.close();
+	}
+
+	// a complete last record whose payload does not match its checksum - the tag, which is logged last
+	{
+		std::string corruptLog = validLog;
+		corruptLog.back() ^= 0x5A;
+		writeFile(TEST_LOG_NAME, corruptLog);
+
+		MemoryAccess memory(TEST_LOG_NAME, TEST_SNAPSHOT_NAME);
+		passed &= check(memory.open(), "a log with a corrupted tail opens");
+		passed &= check(memory.doesAlbumExists("holiday", 1) && memory.openAlbum("holiday").getPictures().size() == 2, "the records before the corrupted one are replayed");
+		passed &= check(!memory.openAlbum("holiday").getPicture("beach").isUserTagged(1), "the corrupted record is not replayed");
+		memory.close();
+	}
+
+	removeMemoryFiles();
+	return passed;
+}
@@ -9,6 +9,11 @@ public:
 	void changeData();
 	void deleteData();
 
+	// MemoryAccess persistence, each returns whether all of its checks passed
+	bool testMemoryReplay();
+	bool testMemoryCompaction();
+	bool testMemoryTornTail();
+
 private:
 	DatabaseAccess _dbAccess;
 };
\ No newline at end of file
@@ -1,9 +1,11 @@
 #include <chrono>
 #include <iostream>
+#include <memory>
 #include <string>
 #include "AlbumManager.h"
 #include "Colors.h"
 #include "DatabaseAccess.h"
+#include "MemoryAccess.h"
 
 
 int getCommandNumberFromUser()
@@ -51,13 +53,17 @@ void PrintSystemInfo()
 	std::cout << std::setfill(' ');	// reset
 }
 
-int main()
+int main(int argc, char* argv[])
 {
-	// initialization data access
-	DatabaseAccess dataAccess;
+	// initialization data access, the memory one keeps its changes in an operation log and a catalog snapshot
+	std::unique_ptr<IDataAccess> dataAccess;
+	if (argc > 1 && std::string(argv[1]) == MEMORY_MODE_ARGUMENT)
+		dataAccess = std::make_unique<MemoryAccess>(MEMORY_LOG_NAME, MEMORY_SNAPSHOT_NAME);
+	else
+		dataAccess = std::make_unique<DatabaseAccess>();
 
 	// initialize album manager
-	AlbumManager albumManager(dataAccess);
+	AlbumManager albumManager(*dataAccess);
 
 
 	std::string albumName;
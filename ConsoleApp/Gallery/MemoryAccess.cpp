@@ -1,5 +1,6 @@
 ﻿#include <map>
 #include <algorithm>
+#include <iterator>
 
 #include "ItemNotFoundException.h"
 #include "MemoryAccess.h"
@@ -10,6 +11,8 @@
 
 void MemoryAccess::printAlbums()
 {
+	loadCatalog();
+
 	if (m_albums.empty()) {
 		throw MyException("There are no existing albums.");
 	}
@@ -21,8 +24,68 @@ void MemoryAccess::printAlbums()
 		std::cout << GREEN << std::setw(5) << "* " << album << RESET;
 }
 
+static void writePicture(BinaryWriter& writer, const Picture& picture)
+{
+	writer.writeInt32(picture.getId());
+	writer.writeString(picture.getName());
+	writer.writeString(picture.getPath());
+	writer.writeString(picture.getCreationDate());
+
+	const std::set<int>& tags = picture.getUserTags();
+	writer.writeUInt32(static_cast<uint32_t>(tags.size()));
+	for (const int userId : tags)
+		writer.writeInt32(userId);
+}
+
+static Picture readPicture(BinaryReader& reader)
+{
+	const int id = reader.readInt32();
+	std::string name = reader.readString();
+	std::string path = reader.readString();
+	std::string creationDate = reader.readString();
+
+	Picture picture(id, std::move(name), std::move(path), std::move(creationDate));
+
+	const uint32_t tagsCount = reader.readUInt32();
+	for (uint32_t i = 0; i < tagsCount; ++i)
+		picture.tagUser(reader.readInt32());
+
+	return picture;
+}
+
+
+MemoryAccess::MemoryAccess(const std::string& logPath, const std::string& snapshotPath) :
+	m_log(std::make_unique<OperationLog>(logPath)), m_snapshotPath(snapshotPath)
+{
+	// Left empty
+}
+
 bool MemoryAccess::open()
 {
+	if (m_log != nullptr)
+	{
+		if (m_log->isOpen())
+			return true;
+
+		// rebuild the state from the last snapshot and the operations logged after it. The snapshot stays
+		// mapped and is read as its users and albums are used, so its checksum is not verified up front
+		try {
+			if (m_catalog.open(m_snapshotPath, false))
+				m_log->setSnapshotSequence(m_catalog.getSequence());
+
+			m_isReplaying = true;
+			m_log->open([this](LogOperation operation, BinaryReader& arguments) { replayOperation(operation, arguments); });
+			m_isReplaying = false;
+		}
+		catch (const MyException& e) {
+			m_isReplaying = false;
+			std::cerr << RED << "Failed to restore memory database: " << e.what() << RESET << '\n';
+			return false;
+		}
+
+		return true;
+	}
+
 	// create some dummy albums
 	for (int i = 0; i < 5; ++i) {
 		// create some dummy users
@@ -37,15 +100,29 @@ bool MemoryAccess::open()
 	return true;
 }
 
+void MemoryAccess::close()
+{
+	if (m_log != nullptr)
+		m_log->close();
+}
+
 void MemoryAccess::clear()
 {
-	m_users.clear();
-	m_albums.clear();
+	applyOperation(LogOperation::CLEAR, BinaryWriter(), [this]
+	{
+		m_users.clear();
+		m_albums.clear();
+
+		// whatever the catalog held is gone too
+		m_catalog.close();
+		m_catalogUserIds.clear();
+		m_catalogAlbumNames.clear();
+	});
 }
 
 auto MemoryAccess::getAlbumIfExists(const std::string& albumName)
 {
-	auto result = std::find_if(std::begin(m_albums), std::end(m_albums), [&](auto& album) { return album.getName() == albumName; });
+	auto result = findAlbum(albumName);
 
 	if (result == std::end(m_albums))
 		throw ItemNotFoundException("Album", albumName);
@@ -87,11 +164,14 @@ void MemoryAccess::cleanUserData(const User& user)
 
 const std::list<Album> MemoryAccess::getAlbums()
 {
+	loadCatalog();
 	return m_albums;
 }
 
 const std::list<Album> MemoryAccess::getAlbumsOfUser(const User& user)
 {
+	loadCatalog();
+
 	std::list<Album> albumsOfUser;
 	for (const auto& album : m_albums) {
 		if (album.getOwnerId() == user.getId())
@@ -102,63 +182,109 @@ const std::list<Album> MemoryAccess::getAlbumsOfUser(const User& user)
 
 void MemoryAccess::createAlbum(const Album& album)
 {
-	m_albums.push_back(album);
+	BinaryWriter arguments;
+	arguments.writeInt32(album.getOwnerId());
+	arguments.writeString(album.getName());
+	arguments.writeString(album.getCreationDate());
+	applyOperation(LogOperation::CREATE_ALBUM, arguments, [&] { m_albums.push_back(album); });
 }
 
 void MemoryAccess::deleteAlbum(const std::string& albumName, int userId)
 {
-	for (auto& album : m_albums)
-	{
-		if (album.getName() == albumName && album.getOwnerId() == userId)
-		{
-			m_albums.remove(album);
-			return;
-		}
-	}
+	const auto album = findAlbum(albumName);
+
+	if (album == m_albums.end() || album->getOwnerId() != userId)
+		return;
+
+	BinaryWriter arguments;
+	arguments.writeString(albumName);
+	arguments.writeInt32(userId);
+	applyOperation(LogOperation::DELETE_ALBUM, arguments, [&] { m_albums.erase(album); });
 }
 
 bool MemoryAccess::doesAlbumExists(const std::string& albumName, int userId)
 {
-	auto isSameAlbum = [&](const Album& album) { return album.getName() == albumName && album.getOwnerId() == userId; };
-	return std::any_of(m_albums.cend(), m_albums.cend(), isSameAlbum);
+	const auto album = findAlbum(albumName);
+
+	return album != m_albums.end() && album->getOwnerId() == userId;
 }
 
 Album MemoryAccess::openAlbum(const std::string& albumName)
 {
-	for (auto& album : m_albums) {
-		if (albumName == album.getName())
-			return album;
-	}
-	throw MyException("No album with name " + albumName + " exists");
+	const auto album = findAlbum(albumName);
+
+	if (album == m_albums.end())
+		throw MyException("No album with name " + albumName + " exists");
+
+	return *album;
 }
 
 void MemoryAccess::addPictureToAlbumByName(const std::string& albumName, const Picture& picture)
 {
 	const auto result = getAlbumIfExists(albumName);
-	result->addPicture(picture);
+
+	if (result->doesPictureExists(picture.getName()))
+		throw MyException("Picture " + picture.getName() + " already exists in album " + albumName + ".");
+
+	BinaryWriter arguments;
+	arguments.writeString(albumName);
+	writePicture(arguments, picture);
+	applyOperation(LogOperation::ADD_PICTURE, arguments, [&] { result->addPicture(picture); });
 }
 
 void MemoryAccess::removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName)
 {
 	const auto result = getAlbumIfExists(albumName);
-	result->removePicture(pictureName);
+
+	if (!result->doesPictureExists(pictureName))
+		throw ItemNotFoundException("Picture", pictureName);
+
+	BinaryWriter arguments;
+	arguments.writeString(albumName);
+	arguments.writeString(pictureName);
+	applyOperation(LogOperation::REMOVE_PICTURE, arguments, [&] { result->removePicture(pictureName); });
 }
 
 void MemoryAccess::tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
 {
 	const auto result = getAlbumIfExists(albumName);
-	result->tagUserInPicture(userId, pictureName);
+
+	if (!result->doesPictureExists(pictureName))
+		throw ItemNotFoundException("Picture", pictureName);
+
+	BinaryWriter arguments;
+	arguments.writeString(albumName);
+	arguments.writeString(pictureName);
+	arguments.writeInt32(userId);
+	applyOperation(LogOperation::TAG_USER, arguments, [&] { result->tagUserInPicture(userId, pictureName); });
 }
 
 void MemoryAccess::untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
 {
 	const auto result = getAlbumIfExists(albumName);
-	result->untagUserInPicture(userId, pictureName);
+
+	if (!result->doesPictureExists(pictureName))
+		throw ItemNotFoundException("Picture", pictureName);
+
+	BinaryWriter arguments;
+	arguments.writeString(albumName);
+	arguments.writeString(pictureName);
+	arguments.writeInt32(userId);
+	applyOperation(LogOperation::UNTAG_USER, arguments, [&] { result->untagUserInPicture(userId, pictureName); });
 }
 
 int MemoryAccess::getLastPictureId()
 {
-	return FIRST_PICTURE_ID;
+	loadCatalog();
+
+	int lastPictureId = FIRST_PICTURE_ID;
+
+	for (const auto& album : m_albums) {
+		for (const auto& picture : album.getPictures())
+			lastPictureId = std::max(lastPictureId, picture.getId());
+	}
+
+	return lastPictureId;
 }
 
 void MemoryAccess::closeAlbum(Album&)
@@ -169,6 +295,8 @@ void MemoryAccess::closeAlbum(Album&)
 // ******************* User ******************* 
 void MemoryAccess::printUsers()
 {
+	loadCatalog();
+
 	std::cout << GREEN << "Users list:" << '\n' << RESET;
 	std::cout << GREEN << "-----------" << '\n' << RESET;
 
@@ -177,58 +305,73 @@ void MemoryAccess::printUsers()
 }
 
 User MemoryAccess::getUser(int userId) {
-	for (const auto& user : m_users) {
-		if (user.getId() == userId)
-			return user;
-	}
+	const auto user = findUser(userId);
+
+	if (user == m_users.end())
+		throw ItemNotFoundException("User", userId);
 
-	throw ItemNotFoundException("User", userId);
+	return *user;
 }
 
 int MemoryAccess::getLastUserId()
 {
-	return FIRST_USER_ID;
+	loadCatalog();
+
+	int lastUserId = FIRST_USER_ID;
+
+	for (const auto& user : m_users)
+		lastUserId = std::max(lastUserId, user.getId());
+
+	return lastUserId;
 }
 
 void MemoryAccess::createUser(User& user)
 {
-	m_users.push_back(user);
+	BinaryWriter arguments;
+	arguments.writeInt32(user.getId());
+	arguments.writeString(user.getName());
+	applyOperation(LogOperation::CREATE_USER, arguments, [&] { m_users.push_back(user); });
 }
 
 void MemoryAccess::deleteUser(const User& user)
 {
-	for (auto& user_to_delete : m_users)
+	const auto user_to_delete = findUser(user.getId());
+
+	if (user_to_delete == m_users.end())
+		return;
+
+	BinaryWriter arguments;
+	arguments.writeInt32(user.getId());
+	applyOperation(LogOperation::DELETE_USER, arguments, [&]
 	{
-		if (user_to_delete == user)
-		{
-			cleanUserData(user_to_delete);
-			m_users.remove(user_to_delete);
-			return;
-		}
-	}
+		cleanUserData(*user_to_delete);
+		m_users.erase(user_to_delete);
+	});
 }
 
 bool MemoryAccess::doesUserExists(int userId)
 {
-	auto isSameUser = [&](const User& user) { return user.getId() == userId; };
-
-	return std::any_of(m_users.cbegin(), m_users.cend(), isSameUser);
+	return findUser(userId) != m_users.end();
 }
 
 
 // user statistics
 int MemoryAccess::countAlbumsOwnedOfUser(const User& user)
 {
+	loadCatalog();
+
 	auto isUserOwner = [&](const Album& album) { return album.getOwnerId() == user.getId(); };
 	return std::count_if(m_albums.cbegin(), m_albums.cend(), isUserOwner);
 }
 
 int MemoryAccess::countAlbumsTaggedOfUser(const User& user)
 {
+	loadCatalog();
+
 	int albumsCount = 0;
 
 	for (const auto& album : m_albums) {
-		const std::list<Picture>& pics = album.getPictures();
+		const auto pics = album.getPictures();
 
 		for (const auto& picture : pics) {
 			if (picture.isUserTagged(user)) {
@@ -243,10 +386,12 @@ int MemoryAccess::countAlbumsTaggedOfUser(const User& user)
 
 int MemoryAccess::countTagsOfUser(const User& user)
 {
+	loadCatalog();
+
 	int tagsCount = 0;
 
 	for (const auto& album : m_albums) {
-		const std::list<Picture>& pics = album.getPictures();
+		const auto pics = album.getPictures();
 
 		for (const auto& picture : pics) {
 			if (picture.isUserTagged(user))
@@ -269,6 +414,8 @@ float MemoryAccess::averageTagsPerAlbumOfUser(const User& user)
 
 User MemoryAccess::getTopTaggedUser()
 {
+	loadCatalog();
+
 	std::map<int, int> userTagsCountMap;
 
 	for (const auto& album : m_albums) {
@@ -305,6 +452,8 @@ User MemoryAccess::getTopTaggedUser()
 
 Picture MemoryAccess::getTopTaggedPicture()
 {
+	loadCatalog();
+
 	int currentMax = -1;
 	const Picture* mostTaggedPic = nullptr;
 	for (const auto& album : m_albums) {
@@ -329,6 +478,8 @@ Picture MemoryAccess::getTopTaggedPicture()
 
 std::list<Picture> MemoryAccess::getTaggedPicturesOfUser(const User& user)
 {
+	loadCatalog();
+
 	std::list<Picture> pictures;
 
 	for (const auto& album : m_albums) {
@@ -340,3 +491,148 @@ std::list<Picture> MemoryAccess::getTaggedPicturesOfUser(const User& user)
 
 	return pictures;
 }
+
+
+
+// ******************* Persistence ******************* 
+// the operation is logged before it is applied, so a change that is seen is never lost. The checks an
+// operation can fail run before it is logged, so every logged operation is applied, and replays the same
+void MemoryAccess::applyOperation(LogOperation operation, const BinaryWriter& arguments, const std::function<void()>& apply)
+{
+	// nothing to log when running in memory only, or when the operation is itself being replayed
+	const bool isLogged = m_log != nullptr && !m_isReplaying;
+
+	if (isLogged)
+		m_log->append(operation, arguments);
+
+	apply();
+
+	if (isLogged && m_log->needsCompaction())
+		compact();
+}
+
+void MemoryAccess::replayOperation(LogOperation operation, BinaryReader& arguments)
+{
+	switch (operation)
+	{
+	case LogOperation::CREATE_USER: {
+		const int userId = arguments.readInt32();
+		User user(userId, arguments.readString());
+		createUser(user);
+		break;
+	}
+	case LogOperation::DELETE_USER:
+		deleteUser(User(arguments.readInt32(), ""));
+		break;
+	case LogOperation::CREATE_ALBUM: {
+		const int ownerId = arguments.readInt32();
+		std::string name = arguments.readString();
+		createAlbum(Album(ownerId, std::move(name), arguments.readString()));
+		break;
+	}
+	case LogOperation::DELETE_ALBUM: {
+		const std::string albumName = arguments.readString();
+		deleteAlbum(albumName, arguments.readInt32());
+		break;
+	}
+	case LogOperation::ADD_PICTURE: {
+		const std::string albumName = arguments.readString();
+		addPictureToAlbumByName(albumName, readPicture(arguments));
+		break;
+	}
+	case LogOperation::REMOVE_PICTURE: {
+		const std::string albumName = arguments.readString();
+		removePictureFromAlbumByName(albumName, arguments.readString());
+		break;
+	}
+	case LogOperation::TAG_USER:
+	case LogOperation::UNTAG_USER: {
+		const std::string albumName = arguments.readString();
+		const std::string pictureName = arguments.readString();
+		const int userId = arguments.readInt32();
+
+		if (operation == LogOperation::TAG_USER)
+			tagUserInPicture(albumName, pictureName, userId);
+		else
+			untagUserInPicture(albumName, pictureName, userId);
+		break;
+	}
+	case LogOperation::CLEAR:
+		clear();
+		break;
+	default:
+		throw MyException("Unknown operation " + std::to_string(static_cast<int>(operation)) + " in operation log.");
+	}
+}
+
+// the catalog is read whole before it is replaced, which also unmaps it so it can be renamed over
+void MemoryAccess::compact()
+{
+	loadCatalog();
+	CatalogSnapshot::write(m_snapshotPath, m_log->getSequence(), m_users, m_albums);
+	m_log->truncate();
+}
+
+// the users and albums of the catalog that were not used yet, the catalog is not needed after
+void MemoryAccess::loadCatalog()
+{
+	if (!m_catalog.isOpen())
+		return;
+
+	std::list<User> users;
+	for (User& user : m_catalog.getUsers()) {
+		if (m_catalogUserIds.count(user.getId()) == 0)
+			users.push_back(std::move(user));
+	}
+
+	std::list<Album> albums;
+	for (Album& album : m_catalog.getAlbums()) {
+		if (m_catalogAlbumNames.count(album.getName()) == 0)
+			albums.push_back(std::move(album));
+	}
+
+	// the catalog holds what was there before anything that was loaded or created since
+	m_users.splice(m_users.begin(), users);
+	m_albums.splice(m_albums.begin(), albums);
+
+	m_catalog.close();
+	m_catalogUserIds.clear();
+	m_catalogAlbumNames.clear();
+}
+
+// the user in memory, read from the catalog the first time it is asked for
+std::list<User>::iterator MemoryAccess::findUser(int userId)
+{
+	const auto result = std::find_if(m_users.begin(), m_users.end(), [userId](const User& user) { return user.getId() == userId; });
+
+	if (result != m_users.end() || !m_catalog.isOpen() || m_catalogUserIds.count(userId) != 0)
+		return result;
+
+	std::optional<User> user = m_catalog.findUser(userId);
+	if (!user)
+		return m_users.end();
+
+	m_catalogUserIds.insert(userId);
+	m_users.push_back(std::move(*user));
+
+	return std::prev(m_users.end());
+}
+
+std::list<Album>::iterator MemoryAccess::findAlbum(const std::string& albumName)
+{
+	// album names are interned, so a name that is not interned can not match any album in memory
+	const auto name = InternedString::find(albumName);
+	const auto result = name ? std::find_if(m_albums.begin(), m_albums.end(), [&](const Album& album) { return album.getInternedName() == *name; }) : m_albums.end();
+
+	if (result != m_albums.end() || !m_catalog.isOpen() || m_catalogAlbumNames.count(albumName) != 0)
+		return result;
+
+	std::optional<Album> album = m_catalog.findAlbum(albumName);
+	if (!album)
+		return m_albums.end();
+
+	m_catalogAlbumNames.insert(albumName);
+	m_albums.push_back(std::move(*album));
+
+	return std::prev(m_albums.end());
+}
@@ -1,14 +1,25 @@
 ﻿#pragma once
+#include <functional>
 #include <list>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_set>
 #include "Album.h"
+#include "CatalogSnapshot.h"
 #include "User.h"
 #include "IDataAccess.h"
+#include "OperationLog.h"
 
 class MemoryAccess : public IDataAccess
 {
 
 public:
 	MemoryAccess() = default;
+	// persistent mode - every change is logged to logPath, which is compacted into a catalog snapshot,
+	// and the state is restored from both on open(). The users and albums of the snapshot are read from
+	// its mapping the first time they are used
+	MemoryAccess(const std::string& logPath, const std::string& snapshotPath);
 
 	// album related
 	const std::list<Album> getAlbums() override;
@@ -47,13 +58,31 @@ public:
 	std::list<Picture> getTaggedPicturesOfUser(const User& user) override;
 
 	bool open() override;
-	void close() override {};
+	void close() override;
 	void clear() override;
 
 private:
 	std::list<Album> m_albums;
 	std::list<User> m_users;
 
+	// persistence, m_log is null when running purely in memory
+	std::unique_ptr<OperationLog> m_log;
+	std::string m_snapshotPath;
+	bool m_isReplaying{ false };
+
+	// the catalog stays mapped until it is read whole. A user or an album read from it lives in the lists
+	// from then on, its id or name is kept so the catalog is not asked again, also once it is deleted
+	CatalogSnapshot m_catalog;
+	std::set<int> m_catalogUserIds;
+	std::unordered_set<std::string> m_catalogAlbumNames;
+
+	void applyOperation(LogOperation operation, const BinaryWriter& arguments, const std::function<void()>& apply);
+	void replayOperation(LogOperation operation, BinaryReader& arguments);
+	void compact();
+	void loadCatalog();
+	std::list<User>::iterator findUser(int userId);
+	std::list<Album>::iterator findAlbum(const std::string& albumName);
+
 	auto getAlbumIfExists(const std::string& albumName);
 
 	static Album createDummyAlbum(const User& user);
@@ -0,0 +1,202 @@
+#include "OperationLog.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <io.h>
+#include <sstream>
+
+#include "Constants.h"
+#include "MyException.h"
+
+
+constexpr size_t RECORD_HEADER_SIZE = 8;		// payload size + crc32
+
+
+static bool readWholeFile(const std::string& path, std::string& content)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	std::ostringstream buffer;
+	buffer << file.rdbuf();
+	content = buffer.str();
+
+	return true;
+}
+
+// flushes the stdio buffer and forces the OS to write the file to disk
+static void syncFile(FILE* file)
+{
+	if (std::fflush(file) != 0 || _commit(_fileno(file)) != 0)
+		throw MyException("Failed to sync file to disk.");
+}
+
+
+OperationLog::OperationLog(std::string logPath) :
+	m_logPath(std::move(logPath))
+{
+	// Left empty
+}
+
+OperationLog::~OperationLog()
+{
+	try {
+		close();
+	}
+	catch (const MyException&) {
+		// destructors must not throw
+	}
+}
+
+
+// snapshot related functions //
+uint64_t OperationLog::getSequence() const
+{
+	return m_sequence;
+}
+
+void OperationLog::setSnapshotSequence(uint64_t sequence)
+{
+	m_snapshotSequence = sequence;
+	m_sequence = std::max(m_sequence, sequence);
+}
+
+// called once a snapshot covering every logged operation was written
+void OperationLog::truncate()
+{
+	sync();
+
+	m_snapshotSequence = m_sequence;
+	openForAppend(true);
+	m_pendingRecords = 0;
+}
+
+bool OperationLog::needsCompaction() const
+{
+	return m_pendingRecords >= LOG_COMPACTION_THRESHOLD;
+}
+
+
+// log related functions //
+void OperationLog::open(const ReplayCallback& replay)
+{
+	if (m_file != nullptr)
+		return;
+
+	replayLog(replay);
+	openForAppend(false);
+}
+
+void OperationLog::close()
+{
+	if (m_file == nullptr)
+		return;
+
+	sync();
+	std::fclose(m_file);
+	m_file = nullptr;
+}
+
+bool OperationLog::isOpen() const
+{
+	return m_file != nullptr;
+}
+
+void OperationLog::append(LogOperation operation, const BinaryWriter& arguments)
+{
+	if (m_file == nullptr)
+		throw MyException("Operation log is not open.");
+
+	BinaryWriter payload;
+	payload.writeUInt64(m_sequence + 1);
+	payload.writeUInt8(static_cast<uint8_t>(operation));
+
+	BinaryWriter record;
+	record.writeUInt32(static_cast<uint32_t>(payload.size() + arguments.size()));
+	record.writeUInt32(0); // checksum placeholder
+
+	std::string bytes = record.data() + payload.data() + arguments.data();
+	const uint32_t checksum = crc32(bytes.data() + RECORD_HEADER_SIZE, bytes.size() - RECORD_HEADER_SIZE);
+	for (int i = 0; i < 4; ++i)
+		bytes[4 + i] = static_cast<char>((checksum >> (i * 8)) & 0xFF);
+
+	if (std::fwrite(bytes.data(), 1, bytes.size(), m_file) != bytes.size() || std::fflush(m_file) != 0)
+		throw MyException("Failed to append to operation log '" + m_logPath + "'.");
+
+	m_sequence++;
+	m_pendingRecords++;
+
+	// fsync in batches, a crash loses at most the last LOG_SYNC_BATCH_SIZE - 1 operations
+	if (++m_unsyncedRecords >= LOG_SYNC_BATCH_SIZE)
+		sync();
+}
+
+void OperationLog::sync()
+{
+	if (m_file == nullptr || m_unsyncedRecords == 0)
+		return;
+
+	syncFile(m_file);
+	m_unsyncedRecords = 0;
+}
+
+
+// helper functions //
+void OperationLog::replayLog(const ReplayCallback& replay)
+{
+	std::string content;
+	if (!readWholeFile(m_logPath, content))
+		return;
+
+	size_t position = 0;
+
+	while (content.size() - position >= RECORD_HEADER_SIZE)
+	{
+		BinaryReader header(content.data() + position, RECORD_HEADER_SIZE);
+		const uint32_t payloadSize = header.readUInt32();
+		const uint32_t checksum = header.readUInt32();
+
+		// a torn or corrupted record marks the end of the valid log
+		if (payloadSize > content.size() - position - RECORD_HEADER_SIZE)
+			break;
+
+		const char* payloadData = content.data() + position + RECORD_HEADER_SIZE;
+		if (crc32(payloadData, payloadSize) != checksum)
+			break;
+
+		BinaryReader payload(payloadData, payloadSize);
+		const uint64_t sequence = payload.readUInt64();
+		const auto operation = static_cast<LogOperation>(payload.readUInt8());
+
+		// records up to the snapshot sequence are already part of the snapshot
+		if (sequence > m_snapshotSequence)
+		{
+			replay(operation, payload);
+			m_sequence = sequence;
+		}
+
+		m_pendingRecords++;
+		position += RECORD_HEADER_SIZE + payloadSize;
+	}
+
+	// drop the invalid tail so new records are appended right after the last valid one
+	if (position != content.size())
+		std::filesystem::resize_file(m_logPath, position);
+}
+
+void OperationLog::openForAppend(bool truncate)
+{
+	if (m_file != nullptr)
+		std::fclose(m_file);
+
+	m_file = std::fopen(m_logPath.c_str(), truncate ? "wb" : "ab");
+	m_unsyncedRecords = 0;
+
+	if (m_file == nullptr)
+		throw MyException("Failed to open operation log '" + m_logPath + "'.");
+
+	if (truncate)
+		syncFile(m_file);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+#include "BinaryStream.h"
+
+
+enum class LogOperation : uint8_t
+{
+	CREATE_USER = 1,
+	DELETE_USER,
+	CREATE_ALBUM,
+	DELETE_ALBUM,
+	ADD_PICTURE,
+	REMOVE_PICTURE,
+	TAG_USER,
+	UNTAG_USER,
+	CLEAR
+};
+
+
+/*
+ * Append-only log of mutating operations, used to make MemoryAccess durable.
+ *
+ * Every record is framed as [payload size][crc32 of payload][payload], where the payload is
+ * [sequence number][operation][operation arguments]. Records are flushed to the OS on every append
+ * and fsync'ed to disk once every LOG_SYNC_BATCH_SIZE records (and on close).
+ * The owner periodically compacts the log by writing a snapshot of the whole state (a CatalogSnapshot)
+ * and truncating the log. The snapshot remembers the sequence number it covers, so a crash between
+ * writing the snapshot and truncating the log never replays an operation twice.
+ */
+class OperationLog
+{
+public:
+	using ReplayCallback = std::function<void(LogOperation, BinaryReader&)>;
+
+	explicit OperationLog(std::string logPath);
+	~OperationLog();
+
+	OperationLog(const OperationLog&) = delete;
+	OperationLog& operator=(const OperationLog&) = delete;
+
+	// snapshot related functions //
+	uint64_t getSequence() const;
+	void setSnapshotSequence(uint64_t sequence);
+	void truncate();
+	bool needsCompaction() const;
+
+	// log related functions //
+	void open(const ReplayCallback& replay);
+	void close();
+	bool isOpen() const;
+	void append(LogOperation operation, const BinaryWriter& arguments);
+	void sync();
+
+private:
+	std::string m_logPath;
+	FILE* m_file = nullptr;
+
+	uint64_t m_sequence{ 0 };			// sequence number of the last record written
+	uint64_t m_snapshotSequence{ 0 };	// sequence number covered by the snapshot
+	int m_pendingRecords{ 0 };			// records in the log since the last compaction
+	int m_unsyncedRecords{ 0 };			// records appended since the last fsync
+
+	void replayLog(const ReplayCallback& replay);
+	void openForAppend(bool truncate);
+};
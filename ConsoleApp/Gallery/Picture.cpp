@@ -3,14 +3,14 @@
 #include <sstream>
 
 
-Picture::Picture(int id, std::string name) :
-	m_pictureId(id), m_name(std::move(name))
+Picture::Picture(int id, std::string_view name) :
+	m_pictureId(id), m_name(name)
 {
 	setCreationDateNow();
 }
 
-Picture::Picture(int id, std::string name, std::string pathOnDisk, std::string creationDate)
-	: m_pictureId(id), m_name(std::move(name)), m_pathOnDisk(std::move(pathOnDisk)), m_creationDate(
+Picture::Picture(int id, std::string_view name, std::string_view pathOnDisk, std::string creationDate)
+	: m_pictureId(id), m_name(name), m_pathOnDisk(pathOnDisk), m_creationDate(
 		std::move(creationDate))
 {}
 
@@ -25,21 +25,26 @@ void Picture::setId(int id)
 }
 
 const std::string& Picture::getName() const
+{
+	return m_name.str();
+}
+
+const InternedString& Picture::getInternedName() const
 {
 	return m_name;
 }
 
-void Picture::setName(const std::string& name)
+void Picture::setName(std::string_view name)
 {
 	m_name = name;
 }
 
 const std::string& Picture::getPath() const
 {
-	return m_pathOnDisk;
+	return m_pathOnDisk.str();
 }
 
-void Picture::setPath(const std::string& location)
+void Picture::setPath(std::string_view location)
 {
 	m_pathOnDisk = location;
 }
@@ -112,7 +117,7 @@ bool Picture::operator==(const Picture& other) const
 
 std::ostream& operator<<(std::ostream& os, const Picture& pic) {
 	os << "Picture@" << pic.m_pictureId << ": ["
-		<< pic.m_name << ", " << pic.m_creationDate << ", " << pic.m_pathOnDisk <<
+		<< pic.m_name.str() << ", " << pic.m_creationDate << ", " << pic.m_pathOnDisk.str() <<
 		"] " << pic.getTagsCount() << " users tagged : ";
 
 	for (const auto user : pic.m_usersTags) {
@@ -2,22 +2,25 @@
 #include "User.h"
 #include <set>
 #include <string>
+#include <string_view>
+#include "StringPool.h"
 #include <iomanip>
 
 class Picture
 {
 public:
-	Picture(int id, std::string name);
-	Picture(int id, std::string name, std::string pathOnDisk, std::string creationDate);
+	Picture(int id, std::string_view name);
+	Picture(int id, std::string_view name, std::string_view pathOnDisk, std::string creationDate);
 
 	int getId() const;
 	void setId(int id);
 
 	const std::string& getName() const;
-	void setName(const std::string& name);
+	const InternedString& getInternedName() const;
+	void setName(std::string_view name);
 
 	const std::string& getPath() const;
-	void setPath(const std::string& location);
+	void setPath(std::string_view location);
 
 	const std::string& getCreationDate() const;
 	void setCreationDate(const std::string& creationTime);
@@ -38,8 +41,8 @@ public:
 
 private:
 	int m_pictureId;
-	std::string m_name;
-	std::string m_pathOnDisk;
+	InternedString m_name;
+	InternedString m_pathOnDisk;
 	std::string m_creationDate;
 	std::set<int> m_usersTags;
 };
@@ -0,0 +1,162 @@
+#include "StringPool.h"
+
+#include <mutex>
+
+
+// never destroyed, a handle in a static object may be released after the other statics are gone
+StringPool& StringPool::instance()
+{
+	static StringPool* pool = new StringPool();
+	return *pool;
+}
+
+StringPool::Entry* StringPool::intern(std::string_view value)
+{
+	if (Entry* pooled = find(value))
+		return pooled;
+
+	std::unique_lock lock(m_mutex);
+
+	// another thread may have added the value between the two locks
+	const auto existing = m_index.find(value);
+	if (existing != m_index.end())
+	{
+		if (tryAddReference(existing->second))
+			return existing->second;
+
+		// the last handle of the entry is being released, the releasing thread frees it once it is replaced
+		m_index.erase(existing);
+	}
+
+	Entry* pooled = new Entry{ std::string(value), 1 };
+	m_index.emplace(pooled->value, pooled);
+
+	return pooled;
+}
+
+StringPool::Entry* StringPool::find(std::string_view value)
+{
+	std::shared_lock lock(m_mutex);
+
+	const auto existing = m_index.find(value);
+	return existing != m_index.end() && tryAddReference(existing->second) ? existing->second : nullptr;
+}
+
+void StringPool::addReference(Entry* entry)
+{
+	// the caller holds a reference, so the entry is alive
+	entry->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void StringPool::release(Entry* entry)
+{
+	if (entry->references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	// no reference is ever taken on an entry at zero, so only this thread frees it
+	{
+		std::unique_lock lock(m_mutex);
+
+		const auto existing = m_index.find(entry->value);
+		if (existing != m_index.end() && existing->second == entry)
+			m_index.erase(existing);
+	}
+
+	delete entry;
+}
+
+size_t StringPool::size() const
+{
+	std::shared_lock lock(m_mutex);
+	return m_index.size();
+}
+
+// an entry at zero is on its way out, it is never handed out again
+bool StringPool::tryAddReference(Entry* entry)
+{
+	size_t references = entry->references.load(std::memory_order_relaxed);
+
+	while (references != 0)
+	{
+		if (entry->references.compare_exchange_weak(references, references + 1, std::memory_order_acquire, std::memory_order_relaxed))
+			return true;
+	}
+
+	return false;
+}
+
+
+InternedString::InternedString()
+{
+	// the empty value is held by this static handle, so it stays pooled
+	static const InternedString emptyString(std::string_view{});
+
+	m_entry = emptyString.m_entry;
+	StringPool::instance().addReference(m_entry);
+}
+
+InternedString::InternedString(std::string_view value) :
+	m_entry(StringPool::instance().intern(value))
+{
+	// Left empty
+}
+
+InternedString::InternedString(const InternedString& other) :
+	m_entry(other.m_entry)
+{
+	StringPool::instance().addReference(m_entry);
+}
+
+InternedString::InternedString(InternedString&& other) noexcept :
+	m_entry(other.m_entry)
+{
+	other.m_entry = nullptr;
+}
+
+InternedString& InternedString::operator=(const InternedString& other)
+{
+	StringPool::instance().addReference(other.m_entry);
+
+	if (m_entry != nullptr)
+		StringPool::instance().release(m_entry);
+
+	m_entry = other.m_entry;
+
+	return *this;
+}
+
+InternedString& InternedString::operator=(InternedString&& other) noexcept
+{
+	if (this == &other)
+		return *this;
+
+	if (m_entry != nullptr)
+		StringPool::instance().release(m_entry);
+
+	m_entry = other.m_entry;
+	other.m_entry = nullptr;
+
+	return *this;
+}
+
+InternedString::~InternedString()
+{
+	if (m_entry != nullptr)
+		StringPool::instance().release(m_entry);
+}
+
+InternedString::InternedString(StringPool::Entry* entry) :
+	m_entry(entry)
+{
+	// Left empty
+}
+
+std::optional<InternedString> InternedString::find(std::string_view value)
+{
+	StringPool::Entry* pooled = StringPool::instance().find(value);
+
+	if (pooled == nullptr)
+		return std::nullopt;
+
+	return InternedString(pooled);
+}